@@ -0,0 +1,678 @@
+/*
+ SmoothMouseBench measures the cost per event of the acceleration curves and
+ of the whole event pipeline, in the style of Google Benchmark: every
+ benchmark runs for a doubling number of iterations (one iteration is one
+ event) until it took at least --min-time seconds, and reports the time per
+ event. --json writes the results in Google Benchmark's JSON format, so they
+ can be compared between builds with its tools.
+
+ Deltas come from three generated distributions that resemble precise
+ pointing (slow), normal movement (normal) and fast flicks (flick), or from
+ the moves of a capture given with --capture.
+
+ The queue benchmarks pass events from one thread to another through the
+ driver event queue (eventqueue.h) and through the std::list with a mutex and
+ a condition variable it replaced. handoff waits for every event to be taken
+ before posting the next, so it measures the latency of waking up the
+ consumer, burst measures the throughput.
+
+ It does not depend on OS X and builds on Linux with:
+
+   c++ -O2 -ISmoothMouseDaemon -ISmoothMouseDaemon/core -ISmoothMouseDaemon/libpointing \
+       SmoothMouseBench/main.cpp \
+       SmoothMouseDaemon/core/pipeline.cpp SmoothMouseDaemon/core/processor.cpp \
+       SmoothMouseDaemon/core/capture.cpp SmoothMouseDaemon/core/eventqueue.cpp \
+       SmoothMouseDaemon/core/latency.cpp \
+       SmoothMouseDaemon/libpointing/OSXFunction.cpp SmoothMouseDaemon/libpointing/WindowsFunction.cpp \
+       -lpthread -o smoothmouse-bench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+#include <list>
+#include <string>
+#include <vector>
+
+#include "pipeline.h"
+#include "processor.h"
+#include "capture.h"
+#include "eventqueue.h"
+#include "OSXFunction.hpp"
+#include "WindowsFunction.hpp"
+
+#define NUM_DELTAS (4096) // per distribution, a power of two
+#define BURST (64)        // events read from the kext at once, see KernelEventRingLoop()
+
+typedef struct distribution_s {
+    std::string name;
+    std::vector<int> dx;
+    std::vector<int> dy;
+    // the same deltas for apply_batch(), limited to 16 bits like a HID report
+    std::vector<int16_t> dx16;
+    std::vector<int16_t> dy16;
+} distribution_t;
+
+typedef struct bench_s bench_t;
+typedef void (*bench_function_t)(bench_t *bench, uint64_t iterations);
+
+struct bench_s {
+    std::string name;
+    bench_function_t function;
+    const distribution_t *distribution;
+    AccelerationCurve curve;
+    const char *deviceType;
+};
+
+typedef struct result_s {
+    std::string name;
+    uint64_t iterations;
+    double realTime; // ns per event
+    double cpuTime;
+} result_t;
+
+// keeps the compiler from dropping the benchmarked work
+static volatile int sink;
+
+static double timestamp() {
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return (double)t.tv_sec + 1.0e-6 * (double)t.tv_usec;
+}
+
+static double cpu_timestamp() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (double)usage.ru_utime.tv_sec + 1.0e-6 * (double)usage.ru_utime.tv_usec +
+           (double)usage.ru_stime.tv_sec + 1.0e-6 * (double)usage.ru_stime.tv_usec;
+}
+
+// deterministic, so every build measures the same input
+static uint32_t next_random(uint32_t *state) {
+    *state = *state * 1664525 + 1013904223;
+    return *state >> 8;
+}
+
+static int random_delta(uint32_t *state, int max) {
+    // mostly small deltas, rarely large ones, like real movement
+    int magnitude = (int)(next_random(state) % (max + 1));
+    magnitude = (magnitude * (int)(next_random(state) % (max + 1))) / (max > 0 ? max : 1);
+    return (next_random(state) & 1) ? magnitude : -magnitude;
+}
+
+static int16_t clamp16(int delta) {
+    return (int16_t)(delta < INT16_MIN ? INT16_MIN : (delta > INT16_MAX ? INT16_MAX : delta));
+}
+
+static void fill_distribution16(distribution_t *distribution) {
+    distribution->dx16.clear();
+    distribution->dy16.clear();
+    for (size_t i = 0; i < distribution->dx.size(); i++) {
+        distribution->dx16.push_back(clamp16(distribution->dx[i]));
+        distribution->dy16.push_back(clamp16(distribution->dy[i]));
+    }
+}
+
+static distribution_t generate_distribution(const char *name, int max, uint32_t seed) {
+    distribution_t distribution;
+    distribution.name = name;
+    for (int i = 0; i < NUM_DELTAS; i++) {
+        distribution.dx.push_back(random_delta(&seed, max));
+        distribution.dy.push_back(random_delta(&seed, max));
+    }
+    fill_distribution16(&distribution);
+    return distribution;
+}
+
+static BOOL load_distribution(const char *path, distribution_t *distribution) {
+    capture_settings_t settings;
+    capture_file_t *capture = capture_open(path, &settings);
+    if (capture == NULL) {
+        return NO;
+    }
+    capture_settings_cleanup(&settings);
+
+    distribution->name = "capture";
+    mouse_event_t event;
+    while (capture_read_event(capture, &event) && distribution->dx.size() < NUM_DELTAS) {
+        if (event.dx != 0 || event.dy != 0) {
+            distribution->dx.push_back(event.dx);
+            distribution->dy.push_back(event.dy);
+        }
+    }
+    capture_close(capture);
+
+    if (distribution->dx.empty()) {
+        return NO;
+    }
+
+    // repeat the moves to fill all slots, the benchmarks index with a mask
+    for (size_t i = 0; distribution->dx.size() < NUM_DELTAS; i++) {
+        distribution->dx.push_back(distribution->dx[i]);
+        distribution->dy.push_back(distribution->dy[i]);
+    }
+    fill_distribution16(distribution);
+
+    return YES;
+}
+
+static const char *curve_name(AccelerationCurve curve, const char *deviceType) {
+    switch (curve) {
+        case ACCELERATION_CURVE_LINEAR:     return "linear";
+        case ACCELERATION_CURVE_WINDOWS:    return "windows";
+        case ACCELERATION_CURVE_OSX:        return (strcmp(deviceType, "mouse") == 0 ? "osx_mouse" : "osx_touchpad");
+        default:                            return "?";
+    }
+}
+
+// pipeline_accelerate() as mouse_handle_move() calls it, with the sub pixel
+// accumulation
+static void bench_accelerate(bench_t *bench, uint64_t iterations) {
+    pipeline_curves_t *curves = pipeline_curves_create(bench->curve, 1.0, NULL, bench->curve, 1.0, NULL);
+    pipeline_state_t state;
+    CGPoint pos = { 0, 0 };
+    pipeline_init(&state, pos);
+
+    mouse_event_t event;
+    memset(&event, 0, sizeof(event));
+    event.device_type = (strcmp(bench->deviceType, "mouse") == 0 ? kDeviceTypeMouse : kDeviceTypeTrackpad);
+
+    const distribution_t *distribution = bench->distribution;
+    int sum = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        event.dx = distribution->dx[i & (NUM_DELTAS - 1)];
+        event.dy = distribution->dy[i & (NUM_DELTAS - 1)];
+        int deltaX;
+        int deltaY;
+        pipeline_accelerate(&state, curves, &event, &deltaX, &deltaY);
+        sum += deltaX + deltaY;
+    }
+    sink = sum;
+
+    pipeline_curves_release(curves);
+}
+
+static void bench_osx_apply(bench_t *bench, uint64_t iterations) {
+    OSXFunction function(bench->deviceType, 1.0);
+    const distribution_t *distribution = bench->distribution;
+    int sum = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        int deltaX;
+        int deltaY;
+        function.apply(distribution->dx[i & (NUM_DELTAS - 1)], distribution->dy[i & (NUM_DELTAS - 1)], &deltaX, &deltaY);
+        sum += deltaX + deltaY;
+    }
+    sink = sum;
+}
+
+// the same events as bench_osx_apply() in bursts of BURST
+static void bench_osx_apply_batch(bench_t *bench, uint64_t iterations) {
+    OSXFunction function(bench->deviceType, 1.0);
+    const distribution_t *distribution = bench->distribution;
+    int deltaX[BURST];
+    int deltaY[BURST];
+    int sum = 0;
+    for (uint64_t i = 0; i < iterations; i += BURST) {
+        size_t count = (iterations - i < BURST ? (size_t)(iterations - i) : BURST);
+        size_t first = i & (NUM_DELTAS - 1);
+        function.apply_batch(&distribution->dx16[first], &distribution->dy16[first], deltaX, deltaY, count);
+        sum += deltaX[count - 1] + deltaY[count - 1];
+    }
+    sink = sum;
+}
+
+static void bench_osx_apply_reference(bench_t *bench, uint64_t iterations) {
+    OSXFunction function(bench->deviceType, 1.0);
+    const distribution_t *distribution = bench->distribution;
+    int sum = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        int deltaX;
+        int deltaY;
+        function.applyReference(distribution->dx[i & (NUM_DELTAS - 1)], distribution->dy[i & (NUM_DELTAS - 1)], &deltaX, &deltaY);
+        sum += deltaX + deltaY;
+    }
+    sink = sum;
+}
+
+static void bench_windows_apply(bench_t *bench, uint64_t iterations) {
+    WindowsFunction function(0);
+    const distribution_t *distribution = bench->distribution;
+    int sum = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        int deltaX;
+        int deltaY;
+        function.apply(distribution->dx[i & (NUM_DELTAS - 1)], distribution->dy[i & (NUM_DELTAS - 1)], &deltaX, &deltaY);
+        sum += deltaX + deltaY;
+    }
+    sink = sum;
+}
+
+static void bench_windows_apply_batch(bench_t *bench, uint64_t iterations) {
+    WindowsFunction function(0);
+    const distribution_t *distribution = bench->distribution;
+    int deltaX[BURST];
+    int deltaY[BURST];
+    int sum = 0;
+    for (uint64_t i = 0; i < iterations; i += BURST) {
+        size_t count = (iterations - i < BURST ? (size_t)(iterations - i) : BURST);
+        size_t first = i & (NUM_DELTAS - 1);
+        function.apply_batch(&distribution->dx16[first], &distribution->dy16[first], deltaX, deltaY, count);
+        sum += deltaX[count - 1] + deltaY[count - 1];
+    }
+    sink = sum;
+}
+
+static void null_post_callback(driver_event_t *, void *context) {
+    (*(int *)context)++;
+}
+
+// the portable equivalent of mouse_process_kext_event(), with a driver that
+// drops every event, one button change every 64 events
+static void bench_process(bench_t *bench, uint64_t iterations) {
+    pipeline_curves_t *curves = pipeline_curves_create(bench->curve, 1.0, NULL, bench->curve, 1.0, NULL);
+    int posted = 0;
+    processor_t processor;
+    CGPoint pos = { 0, 0 };
+    processor_init(&processor, pos, curves, null_post_callback, &posted);
+
+    const distribution_t *distribution = bench->distribution;
+    mouse_event_t event;
+    memset(&event, 0, sizeof(event));
+    event.device_type = kDeviceTypeMouse;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        event.dx = distribution->dx[i & (NUM_DELTAS - 1)];
+        event.dy = distribution->dy[i & (NUM_DELTAS - 1)];
+        event.buttons = ((i >> 6) & 1) ? 4 : 0; // raw left button
+        event.seqnum = i + 1;
+        event.timestamp = i * 1000000;
+        processor_process_event(&processor, &event);
+    }
+    sink = posted;
+
+    pipeline_curves_release(curves);
+}
+
+// the same events as bench_process() in bursts of BURST, as the daemon reads
+// them from the kext
+static void bench_process_burst(bench_t *bench, uint64_t iterations) {
+    pipeline_curves_t *curves = pipeline_curves_create(bench->curve, 1.0, NULL, bench->curve, 1.0, NULL);
+    int posted = 0;
+    processor_t processor;
+    CGPoint pos = { 0, 0 };
+    processor_init(&processor, pos, curves, null_post_callback, &posted);
+
+    const distribution_t *distribution = bench->distribution;
+    mouse_event_t events[BURST];
+    memset(events, 0, sizeof(events));
+
+    for (uint64_t i = 0; i < iterations; i += BURST) {
+        size_t count = (iterations - i < BURST ? (size_t)(iterations - i) : BURST);
+        for (size_t j = 0; j < count; j++) {
+            uint64_t n = i + j;
+            events[j].device_type = kDeviceTypeMouse;
+            events[j].dx = distribution->dx[n & (NUM_DELTAS - 1)];
+            events[j].dy = distribution->dy[n & (NUM_DELTAS - 1)];
+            events[j].buttons = ((n >> 6) & 1) ? 4 : 0; // raw left button
+            events[j].seqnum = n + 1;
+            events[j].timestamp = n * 1000000;
+        }
+        processor_process_events(&processor, events, count);
+    }
+    sink = posted;
+
+    pipeline_curves_release(curves);
+}
+
+// the driver event queue (eventqueue.h) against what it replaced, a std::list
+// guarded by a mutex and a condition variable, with one producer and one
+// consumer thread
+typedef struct list_queue_s {
+    pthread_mutex_t mutex;
+    pthread_cond_t dataAvailable;
+    std::list<driver_event_t> events;
+} list_queue_t;
+
+static void list_queue_push(list_queue_t *queue, driver_event_t *event) {
+    pthread_mutex_lock(&queue->mutex);
+    if (!queue->events.empty() && event->id == DRIVER_EVENT_ID_MOVE && queue->events.back().id == DRIVER_EVENT_ID_MOVE &&
+        pipeline_can_coalesce(&event->move, &queue->events.back().move)) {
+        pipeline_coalesce(&queue->events.back(), event);
+    } else {
+        queue->events.push_back(*event);
+    }
+    pthread_cond_signal(&queue->dataAvailable);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+static void list_queue_pop(list_queue_t *queue, driver_event_t *event) {
+    pthread_mutex_lock(&queue->mutex);
+    while (queue->events.empty()) {
+        pthread_cond_wait(&queue->dataAvailable, &queue->mutex);
+    }
+    *event = queue->events.front();
+    queue->events.pop_front();
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+typedef struct handoff_s {
+    event_queue_t *ring;    // NULL for the list
+    list_queue_t *list;
+    volatile uint64_t popped;
+} handoff_t;
+
+static void *handoff_consumer(void *context) {
+    handoff_t *handoff = (handoff_t *) context;
+    pipeline_pacer_t pacer;
+    pipeline_pacer_init(&pacer, 0);
+    for (;;) {
+        driver_event_t event;
+        if (handoff->ring != NULL) {
+            event_queue_pop(handoff->ring, &event, &pacer);
+        } else {
+            list_queue_pop(handoff->list, &event);
+        }
+        if (event.id == DRIVER_EVENT_ID_TERMINATE) {
+            return NULL;
+        }
+        __sync_synchronize();
+        handoff->popped++;
+    }
+}
+
+/*
+ Posts iterations button events (which are never coalesced) from this thread
+ to a consumer thread. With wait set every event is only posted once the
+ previous one was taken, so the consumer is asleep each time and the time
+ per event is the latency of a handoff including the wakeup. Without, events
+ are posted as fast as possible, which measures the throughput.
+ */
+static void run_handoff(BOOL useRing, uint64_t iterations, BOOL wait) {
+    static event_queue_t ring;
+    static BOOL ringCreated = NO;
+    static list_queue_t list = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, std::list<driver_event_t>() };
+
+    handoff_t handoff;
+    handoff.ring = NULL;
+    handoff.list = &list;
+    handoff.popped = 0;
+    if (useRing) {
+        if (!ringCreated) {
+            if (!event_queue_init(&ring)) {
+                fprintf(stderr, "failed to create the event queue\n");
+                exit(1);
+            }
+            ringCreated = YES;
+        }
+        event_queue_reset(&ring);
+        handoff.ring = &ring;
+    }
+
+    pthread_t consumer;
+    if (pthread_create(&consumer, NULL, handoff_consumer, &handoff) != 0) {
+        fprintf(stderr, "failed to start the consumer thread\n");
+        exit(1);
+    }
+
+    driver_event_t event;
+    memset(&event, 0, sizeof(event));
+    event.id = DRIVER_EVENT_ID_BUTTON;
+    event.button.type = kCGEventLeftMouseDown;
+    for (uint64_t i = 0; i < iterations; i++) {
+        event.kextSeqnum = i + 1;
+        if (useRing) {
+            event_queue_push(&ring, &event, NULL, NULL);
+        } else {
+            list_queue_push(&list, &event);
+        }
+        if (wait) {
+            while (handoff.popped <= i) {
+                sched_yield();
+            }
+        }
+    }
+
+    event.id = DRIVER_EVENT_ID_TERMINATE;
+    if (useRing) {
+        event_queue_push(&ring, &event, NULL, NULL);
+    } else {
+        list_queue_push(&list, &event);
+    }
+    pthread_join(consumer, NULL);
+    sink = (int)handoff.popped;
+}
+
+static void bench_queue_ring_handoff(bench_t *, uint64_t iterations) {
+    run_handoff(YES, iterations, YES);
+}
+
+static void bench_queue_list_handoff(bench_t *, uint64_t iterations) {
+    run_handoff(NO, iterations, YES);
+}
+
+static void bench_queue_ring_burst(bench_t *, uint64_t iterations) {
+    run_handoff(YES, iterations, NO);
+}
+
+static void bench_queue_list_burst(bench_t *, uint64_t iterations) {
+    run_handoff(NO, iterations, NO);
+}
+
+static result_t run_benchmark(bench_t *bench, double minTime) {
+    result_t result;
+    result.name = bench->name;
+
+    // warm up caches and tables outside of the measurement
+    bench->function(bench, NUM_DELTAS);
+
+    uint64_t iterations = NUM_DELTAS;
+    for (;;) {
+        double start = timestamp();
+        double cpuStart = cpu_timestamp();
+        bench->function(bench, iterations);
+        double elapsed = timestamp() - start;
+        double cpuElapsed = cpu_timestamp() - cpuStart;
+
+        if (elapsed >= minTime || iterations >= (1ULL << 40)) {
+            result.iterations = iterations;
+            result.realTime = elapsed * 1.0e9 / (double)iterations;
+            result.cpuTime = cpuElapsed * 1.0e9 / (double)iterations;
+            return result;
+        }
+
+        // aim a bit past minTime, at most ten times as many iterations
+        double factor = (elapsed > 0 ? minTime * 1.4 / elapsed : 10.0);
+        if (factor > 10.0) {
+            factor = 10.0;
+        } else if (factor < 2.0) {
+            factor = 2.0;
+        }
+        iterations = (uint64_t)(iterations * factor);
+    }
+}
+
+static void add_benchmark(std::vector<bench_t> &benches, const std::string &name, bench_function_t function,
+                          const distribution_t *distribution, AccelerationCurve curve, const char *deviceType) {
+    bench_t bench;
+    bench.name = name;
+    bench.function = function;
+    bench.distribution = distribution;
+    bench.curve = curve;
+    bench.deviceType = deviceType;
+    benches.push_back(bench);
+}
+
+static std::vector<bench_t> create_benchmarks(const std::vector<distribution_t> &distributions) {
+    static const struct {
+        AccelerationCurve curve;
+        const char *deviceType;
+    } curves[] = {
+        { ACCELERATION_CURVE_LINEAR,    "mouse" },
+        { ACCELERATION_CURVE_WINDOWS,   "mouse" },
+        { ACCELERATION_CURVE_OSX,       "mouse" },
+        { ACCELERATION_CURVE_OSX,       "touchpad" },
+    };
+
+    std::vector<bench_t> benches;
+
+    std::vector<distribution_t>::const_iterator it;
+    for (it = distributions.begin(); it != distributions.end(); it++) {
+        const distribution_t *distribution = &(*it);
+        for (size_t i = 0; i < sizeof(curves) / sizeof(curves[0]); i++) {
+            std::string name = std::string("accelerate/") + curve_name(curves[i].curve, curves[i].deviceType) + "/" + distribution->name;
+            add_benchmark(benches, name, bench_accelerate, distribution, curves[i].curve, curves[i].deviceType);
+        }
+        add_benchmark(benches, "osx_mouse/apply/" + distribution->name, bench_osx_apply, distribution, ACCELERATION_CURVE_OSX, "mouse");
+        add_benchmark(benches, "osx_mouse/apply_batch/" + distribution->name, bench_osx_apply_batch, distribution, ACCELERATION_CURVE_OSX, "mouse");
+        add_benchmark(benches, "osx_mouse/apply_reference/" + distribution->name, bench_osx_apply_reference, distribution, ACCELERATION_CURVE_OSX, "mouse");
+        add_benchmark(benches, "windows/apply/" + distribution->name, bench_windows_apply, distribution, ACCELERATION_CURVE_WINDOWS, "mouse");
+        add_benchmark(benches, "windows/apply_batch/" + distribution->name, bench_windows_apply_batch, distribution, ACCELERATION_CURVE_WINDOWS, "mouse");
+        for (size_t i = 0; i < 3; i++) {
+            std::string name = std::string("process/") + curve_name(curves[i].curve, curves[i].deviceType) + "/" + distribution->name;
+            add_benchmark(benches, name, bench_process, distribution, curves[i].curve, curves[i].deviceType);
+            name = std::string("process_burst/") + curve_name(curves[i].curve, curves[i].deviceType) + "/" + distribution->name;
+            add_benchmark(benches, name, bench_process_burst, distribution, curves[i].curve, curves[i].deviceType);
+        }
+    }
+
+    add_benchmark(benches, "queue/ring/handoff", bench_queue_ring_handoff, NULL, ACCELERATION_CURVE_LINEAR, "mouse");
+    add_benchmark(benches, "queue/list_condvar/handoff", bench_queue_list_handoff, NULL, ACCELERATION_CURVE_LINEAR, "mouse");
+    add_benchmark(benches, "queue/ring/burst", bench_queue_ring_burst, NULL, ACCELERATION_CURVE_LINEAR, "mouse");
+    add_benchmark(benches, "queue/list_condvar/burst", bench_queue_list_burst, NULL, ACCELERATION_CURVE_LINEAR, "mouse");
+
+    return benches;
+}
+
+static BOOL write_json(const char *path, const char *executable, const std::vector<result_t> &results) {
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        return NO;
+    }
+
+    char date[64];
+    time_t now = time(NULL);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"context\": {\n");
+    fprintf(file, "    \"date\": \"%s\",\n", date);
+    fprintf(file, "    \"executable\": \"%s\",\n", executable);
+    fprintf(file, "    \"num_cpus\": %ld,\n", sysconf(_SC_NPROCESSORS_ONLN));
+    fprintf(file, "    \"library_build_type\": \"%s\"\n",
+#ifdef NDEBUG
+            "release"
+#else
+            "debug"
+#endif
+            );
+    fprintf(file, "  },\n");
+    fprintf(file, "  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const result_t *result = &results[i];
+        fprintf(file, "    {\n");
+        fprintf(file, "      \"name\": \"%s\",\n", result->name.c_str());
+        fprintf(file, "      \"run_name\": \"%s\",\n", result->name.c_str());
+        fprintf(file, "      \"run_type\": \"iteration\",\n");
+        fprintf(file, "      \"iterations\": %llu,\n", (unsigned long long)result->iterations);
+        fprintf(file, "      \"real_time\": %.4f,\n", result->realTime);
+        fprintf(file, "      \"cpu_time\": %.4f,\n", result->cpuTime);
+        fprintf(file, "      \"time_unit\": \"ns\",\n");
+        fprintf(file, "      \"items_per_second\": %.1f\n", result->realTime > 0 ? 1.0e9 / result->realTime : 0.0);
+        fprintf(file, "    }%s\n", (i + 1 < results.size() ? "," : ""));
+    }
+    fprintf(file, "  ]\n");
+    fprintf(file, "}\n");
+
+    return (fclose(file) == 0);
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [--filter <text>] [--min-time <seconds>] [--capture <file>] [--json <file>] [--list]\n", argv0);
+    fprintf(stderr, "  --filter <text>      only run benchmarks whose name contains <text>\n");
+    fprintf(stderr, "  --min-time <s>       minimum time per benchmark (default 0.5)\n");
+    fprintf(stderr, "  --capture <file>     also benchmark with the moves of a capture\n");
+    fprintf(stderr, "  --json <file>        write the results as JSON\n");
+    fprintf(stderr, "  --list               list the benchmarks without running them\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *filter = NULL;
+    const char *capturePath = NULL;
+    const char *jsonPath = NULL;
+    double minTime = 0.5;
+    BOOL list = NO;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            minTime = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+            capturePath = argv[++i];
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else if (strcmp(argv[i], "--list") == 0) {
+            list = YES;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (minTime <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<distribution_t> distributions;
+    distributions.push_back(generate_distribution("slow", 3, 1));
+    distributions.push_back(generate_distribution("normal", 15, 2));
+    distributions.push_back(generate_distribution("flick", 80, 3));
+
+    if (capturePath != NULL) {
+        distribution_t distribution;
+        if (!load_distribution(capturePath, &distribution)) {
+            fprintf(stderr, "%s: not a capture file or no moves\n", capturePath);
+            return 1;
+        }
+        distributions.push_back(distribution);
+    }
+
+    std::vector<bench_t> benches = create_benchmarks(distributions);
+    std::vector<result_t> results;
+
+    if (!list) {
+        printf("%-40s %14s %14s %12s\n", "Benchmark", "Time", "CPU", "Iterations");
+        printf("%s\n", std::string(83, '-').c_str());
+    }
+
+    std::vector<bench_t>::iterator it;
+    for (it = benches.begin(); it != benches.end(); it++) {
+        if (filter != NULL && it->name.find(filter) == std::string::npos) {
+            continue;
+        }
+        if (list) {
+            printf("%s\n", it->name.c_str());
+            continue;
+        }
+        result_t result = run_benchmark(&(*it), minTime);
+        printf("%-40s %11.2f ns %11.2f ns %12llu\n",
+               result.name.c_str(), result.realTime, result.cpuTime, (unsigned long long)result.iterations);
+        fflush(stdout);
+        results.push_back(result);
+    }
+
+    if (jsonPath != NULL && !list && !write_json(jsonPath, argv[0], results)) {
+        fprintf(stderr, "%s: failed to write\n", jsonPath);
+        return 1;
+    }
+
+    return 0;
+}
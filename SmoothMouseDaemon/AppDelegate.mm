@@ -19,6 +19,8 @@
         exit(-1);
     }
 
+    debug_start();
+
     ok = [config readSettingsPlist];
     if (!ok) {
         NSLog(@"Failed to read settings .plist file (please open preference plane)");
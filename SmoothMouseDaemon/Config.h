@@ -4,6 +4,78 @@
 #import "mouse.h"
 #import "driver.h"
 
+#include <limits.h>
+#include <time.h>
+
+/*
+ The event threads do not read Config directly. Every change to Config
+ publishes a new immutable snapshot, and readers pick up the current one with
+ config_acquire() once per burst of events and keep using it until
+ config_release(). A snapshot that was replaced is only freed once no reader
+ holds it anymore (hazard pointers, one per reader thread).
+ */
+typedef struct config_snapshot_s {
+    uint32_t version;
+
+    // from plist
+    BOOL mouseEnabled;
+    BOOL trackpadEnabled;
+    double mouseVelocity;
+    double trackpadVelocity;
+    AccelerationCurve mouseCurve;
+    AccelerationCurve trackpadCurve;
+    Driver driver;
+    BOOL forceDragRefreshEnabled;
+    // in milliseconds, see pipeline_pacer_t, 0 only merges moves that queued up
+    double coalescingInterval;
+
+    // custom curve files and their modification times, a file that changed
+    // is loaded again with the next snapshot
+    char mouseCurveFile[PATH_MAX];
+    char trackpadCurveFile[PATH_MAX];
+    time_t mouseCurveFileModified;
+    time_t trackpadCurveFileModified;
+    BOOL mouseTimeBased;
+    BOOL trackpadTimeBased;
+    double mouseDpi;
+    double trackpadDpi;
+    double screenResolution;
+    double screenRefreshRate;
+
+    // from the HID system, in the unit of mouse_event_t.timestamp (ns), see
+    // mouse_update_clicktime()
+    uint64_t doubleClickInterval;
+
+    // transfer functions for the curves and velocities above, shared with the
+    // previous snapshot if those did not change
+    pipeline_curves_t *curves;
+
+    // from command line
+    BOOL debugEnabled;
+    BOOL memoryLoggingEnabled;
+    BOOL timingsEnabled;
+    BOOL sendAuxEventsEnabled;
+    BOOL overlayEnabled;
+    BOOL sayEnabled;
+    BOOL latencyEnabled;
+    BOOL captureEnabled;
+
+    // from active app
+    BOOL activeAppRequiresRefreshOnDrag;
+    BOOL activeAppIsExcluded;
+    BOOL activeAppRequiresMouseEventListener;
+    BOOL activeAppRequiresTabletPointSubtype;
+} config_snapshot_t;
+
+typedef enum config_reader_e {
+    CONFIG_READER_KERNEL_EVENT_THREAD,
+    CONFIG_READER_DRIVER_EVENT_THREAD,
+    CONFIG_READER_NUM
+} config_reader_t;
+
+const config_snapshot_t *config_acquire(config_reader_t reader);
+void config_release(config_reader_t reader);
+
 @interface Config : NSObject {
     // from plist
     BOOL mouseEnabled;
@@ -12,8 +84,21 @@
     double trackpadVelocity;
     AccelerationCurve mouseCurve;
     AccelerationCurve trackpadCurve;
+    NSString *mouseCurveFile;
+    NSString *trackpadCurveFile;
+    BOOL mouseTimeBased;
+    BOOL trackpadTimeBased;
+    double mouseDpi;
+    double trackpadDpi;
+    double screenResolution;
+    double screenRefreshRate;
     Driver driver;
     BOOL forceDragRefreshEnabled;
+    double coalescingInterval;
+    BOOL coalescePerFrame;
+
+    // from the HID system, in seconds
+    double doubleClickInterval;
 
     // from command line
     BOOL debugEnabled;
@@ -23,6 +108,7 @@
     BOOL overlayEnabled;
     BOOL sayEnabled;
     BOOL latencyEnabled;
+    BOOL captureEnabled;
 
     BOOL activeAppRequiresRefreshOnDrag;
     BOOL activeAppIsExcluded;
@@ -38,8 +124,19 @@
 @property double trackpadVelocity;
 @property AccelerationCurve mouseCurve;
 @property AccelerationCurve trackpadCurve;
+@property (copy) NSString *mouseCurveFile;
+@property (copy) NSString *trackpadCurveFile;
+@property BOOL mouseTimeBased;
+@property BOOL trackpadTimeBased;
+@property double mouseDpi;
+@property double trackpadDpi;
+@property double screenResolution;
+@property double screenRefreshRate;
 @property Driver driver;
 @property BOOL forceDragRefreshEnabled;
+@property double coalescingInterval;
+@property BOOL coalescePerFrame;
+@property double doubleClickInterval;
 @property BOOL debugEnabled;
 @property BOOL memoryLoggingEnabled;
 @property BOOL timingsEnabled;
@@ -47,11 +144,13 @@
 @property BOOL overlayEnabled;
 @property BOOL sayEnabled;
 @property BOOL latencyEnabled;
+@property BOOL captureEnabled;
 
 +(Config *) instance;
 -(id) init;
 -(BOOL) parseCommandLineArguments;
 -(BOOL) readSettingsPlist;
+-(void) publishSnapshot;
 -(AccelerationCurve) getAccelerationCurveFromDict:(NSDictionary *)dictionary withKey:(NSString *)key;
 - (void)setActiveAppId:(NSString *)activeAppId;
 -(BOOL) activeAppRequiresRefreshOnDrag;
@@ -4,6 +4,98 @@
 #include "constants.h"
 #include "debug.h"
 
+#include <libkern/OSAtomic.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <list>
+
+static config_snapshot_t * volatile current_snapshot = NULL;
+static config_snapshot_t * volatile hazards[CONFIG_READER_NUM];
+static std::list<config_snapshot_t *> retired_snapshots;
+static pthread_mutex_t publish_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+const config_snapshot_t *config_acquire(config_reader_t reader) {
+    config_snapshot_t *snapshot;
+    do {
+        snapshot = current_snapshot;
+        hazards[reader] = snapshot;
+        OSMemoryBarrier();
+    } while (snapshot != current_snapshot);
+    return snapshot;
+}
+
+void config_release(config_reader_t reader) {
+    OSMemoryBarrier();
+    hazards[reader] = NULL;
+}
+
+static void config_snapshot_delete(config_snapshot_t *snapshot) {
+    pipeline_curves_release(snapshot->curves);
+    delete snapshot;
+}
+
+static BOOL config_snapshot_curves_changed(config_snapshot_t *snapshot, config_snapshot_t *previous) {
+    return (snapshot->mouseCurve != previous->mouseCurve ||
+            snapshot->mouseVelocity != previous->mouseVelocity ||
+            snapshot->trackpadCurve != previous->trackpadCurve ||
+            snapshot->trackpadVelocity != previous->trackpadVelocity ||
+            strcmp(snapshot->mouseCurveFile, previous->mouseCurveFile) != 0 ||
+            strcmp(snapshot->trackpadCurveFile, previous->trackpadCurveFile) != 0 ||
+            snapshot->mouseCurveFileModified != previous->mouseCurveFileModified ||
+            snapshot->trackpadCurveFileModified != previous->trackpadCurveFileModified ||
+            snapshot->mouseTimeBased != previous->mouseTimeBased ||
+            snapshot->trackpadTimeBased != previous->trackpadTimeBased ||
+            snapshot->mouseDpi != previous->mouseDpi ||
+            snapshot->trackpadDpi != previous->trackpadDpi ||
+            snapshot->screenResolution != previous->screenResolution ||
+            snapshot->screenRefreshRate != previous->screenRefreshRate);
+}
+
+// only custom curves use the file, the path is cleared otherwise so changing
+// an unused file does not rebuild the curves
+static void config_snapshot_set_curve_file(AccelerationCurve curve, NSString *path, char *file, time_t *modified) {
+    file[0] = '\0';
+    *modified = 0;
+    if (curve == ACCELERATION_CURVE_CUSTOM && path != nil) {
+        strlcpy(file, [path fileSystemRepresentation], PATH_MAX);
+        struct stat st;
+        if (stat(file, &st) == 0) {
+            *modified = st.st_mtime;
+        }
+    }
+}
+
+static void config_log_curve_error(const char *device, const pipeline_curve_t *curve) {
+    if (curve->error[0] != '\0') {
+        NSLog(@"Cannot load custom %s acceleration curve, using linear: %s", device, curve->error);
+    }
+}
+
+// the curves only accept resolutions within [min, max], see
+// pipeline_curve_set_resolution(), anything else falls back to fallback
+static double config_resolution(id value, const char *name, double min, double max, double fallback) {
+    if (value == nil || [value doubleValue] <= 0) {
+        return fallback;
+    }
+    double resolution = [value doubleValue];
+    if (!(resolution >= min && resolution <= max)) {
+        NSLog(@"Unsupported %s %f (%.0f to %.0f), using %.0f", name, resolution, min, max, fallback);
+        return fallback;
+    }
+    return resolution;
+}
+
+static BOOL config_snapshot_in_use(config_snapshot_t *snapshot) {
+    for (int i = 0; i < CONFIG_READER_NUM; i++) {
+        if (hazards[i] == snapshot) {
+            return YES;
+        }
+    }
+    return NO;
+}
+
 @implementation Config
 
 @synthesize mouseEnabled;
@@ -12,6 +104,17 @@
 @synthesize trackpadVelocity;
 @synthesize mouseCurve;
 @synthesize trackpadCurve;
+@synthesize mouseCurveFile;
+@synthesize trackpadCurveFile;
+@synthesize mouseTimeBased;
+@synthesize trackpadTimeBased;
+@synthesize mouseDpi;
+@synthesize trackpadDpi;
+@synthesize screenResolution;
+@synthesize screenRefreshRate;
+@synthesize coalescingInterval;
+@synthesize coalescePerFrame;
+@synthesize doubleClickInterval;
 @synthesize driver;
 @synthesize forceDragRefreshEnabled;
 @synthesize debugEnabled;
@@ -21,6 +124,7 @@
 @synthesize overlayEnabled;
 @synthesize sayEnabled;
 @synthesize latencyEnabled;
+@synthesize captureEnabled;
 
 +(Config *) instance
 {
@@ -43,6 +147,8 @@
     overlayEnabled = NO;
     sayEnabled = NO;
     latencyEnabled = NO;
+    captureEnabled = NO;
+    [self publishSnapshot];
     return self;
 }
 
@@ -84,8 +190,15 @@
             [self setLatencyEnabled: YES];
             NSLog(@"Latency measuring enabled (EXPERIMENTAL!)");
         }
+
+        if ([argument isEqualToString: @"--capture"]) {
+            [self setCaptureEnabled: YES];
+            NSLog(@"Capturing kext events enabled");
+        }
     }
 
+    [self publishSnapshot];
+
     return YES;
 }
 
@@ -99,6 +212,9 @@
         if ([value compare:@"OS X"] == NSOrderedSame) {
             return ACCELERATION_CURVE_OSX;
         }
+        if ([value compare:@"Custom"] == NSOrderedSame) {
+            return ACCELERATION_CURVE_CUSTOM;
+        }
     }
     return ACCELERATION_CURVE_LINEAR;
 }
@@ -115,6 +231,9 @@
 
     NSLog(@"found %@", file);
 
+    // the settings are read again when they change
+    [excludedApps release];
+
     excludedApps = [dict objectForKey:SETTINGS_EXCLUDED_APPS];
     if (excludedApps) {
         excludedApps = [excludedApps copy];
@@ -155,7 +274,10 @@
     }
 
     value = [dict valueForKey:SETTINGS_DRIVER];
-    if (value) {
+    if (value && [value intValue] == DRIVER_UINPUT) {
+        NSLog(@"Driver %s is not available on OS X, using the default driver", driver_get_driver_string([value intValue]));
+        [self setDriver:(Driver) SETTINGS_DRIVER_DEFAULT];
+    } else if (value) {
         [self setDriver:(Driver)[value intValue]];
     } else {
         [self setDriver:(Driver) SETTINGS_DRIVER_DEFAULT];
@@ -171,6 +293,41 @@
     [self setMouseCurve: [self getAccelerationCurveFromDict:dict withKey:SETTINGS_MOUSE_ACCELERATION_CURVE]];
     [self setTrackpadCurve: [self getAccelerationCurveFromDict:dict withKey:SETTINGS_TRACKPAD_ACCELERATION_CURVE]];
 
+    NSString *path;
+
+    path = [dict valueForKey:SETTINGS_MOUSE_ACCELERATION_CURVE_FILE];
+    [self setMouseCurveFile: (path ? [path stringByExpandingTildeInPath] : nil)];
+
+    path = [dict valueForKey:SETTINGS_TRACKPAD_ACCELERATION_CURVE_FILE];
+    [self setTrackpadCurveFile: (path ? [path stringByExpandingTildeInPath] : nil)];
+
+    value = [dict valueForKey:SETTINGS_MOUSE_TIME_BASED_ACCELERATION];
+    [self setMouseTimeBased: (value ? [value boolValue] : SETTINGS_TIME_BASED_ACCELERATION_DEFAULT)];
+
+    value = [dict valueForKey:SETTINGS_TRACKPAD_TIME_BASED_ACCELERATION];
+    [self setTrackpadTimeBased: (value ? [value boolValue] : SETTINGS_TIME_BASED_ACCELERATION_DEFAULT)];
+
+    value = [dict valueForKey:SETTINGS_MOUSE_DPI];
+    [self setMouseDpi: config_resolution(value, "mouse dpi", PIPELINE_MIN_DPI, PIPELINE_MAX_DPI, SETTINGS_DPI_DEFAULT)];
+
+    value = [dict valueForKey:SETTINGS_TRACKPAD_DPI];
+    [self setTrackpadDpi: config_resolution(value, "trackpad dpi", PIPELINE_MIN_DPI, PIPELINE_MAX_DPI, SETTINGS_DPI_DEFAULT)];
+
+    // 0 leaves them to the curve, see pipeline_curve_set_resolution()
+    value = [dict valueForKey:SETTINGS_SCREEN_RESOLUTION];
+    [self setScreenResolution: config_resolution(value, "screen resolution", PIPELINE_MIN_PPI, PIPELINE_MAX_PPI, 0)];
+
+    value = [dict valueForKey:SETTINGS_SCREEN_REFRESH_RATE];
+    [self setScreenRefreshRate: config_resolution(value, "screen refresh rate", PIPELINE_MIN_HZ, PIPELINE_MAX_HZ, 0)];
+
+    value = [dict valueForKey:SETTINGS_COALESCING_INTERVAL];
+    [self setCoalescingInterval: (value && [value doubleValue] > 0 ? [value doubleValue] : SETTINGS_COALESCING_INTERVAL_DEFAULT)];
+
+    value = [dict valueForKey:SETTINGS_COALESCE_PER_FRAME];
+    [self setCoalescePerFrame: (value ? [value boolValue] : SETTINGS_COALESCE_PER_FRAME_DEFAULT)];
+
+    [self publishSnapshot];
+
     return YES;
 }
 
@@ -223,6 +380,88 @@
             activeAppRequiresMouseEventListener,
             activeAppRequiresTabletPointSubtype);
     }
+
+    [self publishSnapshot];
+}
+
+-(void) publishSnapshot {
+    pthread_mutex_lock(&publish_mutex);
+
+    config_snapshot_t *snapshot = new config_snapshot_t;
+    snapshot->version = (current_snapshot != NULL) ? current_snapshot->version + 1 : 1;
+    snapshot->mouseEnabled = mouseEnabled;
+    snapshot->trackpadEnabled = trackpadEnabled;
+    snapshot->mouseVelocity = mouseVelocity;
+    snapshot->trackpadVelocity = trackpadVelocity;
+    snapshot->mouseCurve = mouseCurve;
+    snapshot->trackpadCurve = trackpadCurve;
+    config_snapshot_set_curve_file(mouseCurve, mouseCurveFile, snapshot->mouseCurveFile, &snapshot->mouseCurveFileModified);
+    config_snapshot_set_curve_file(trackpadCurve, trackpadCurveFile, snapshot->trackpadCurveFile, &snapshot->trackpadCurveFileModified);
+    snapshot->mouseTimeBased = mouseTimeBased;
+    snapshot->trackpadTimeBased = trackpadTimeBased;
+    snapshot->mouseDpi = mouseDpi;
+    snapshot->trackpadDpi = trackpadDpi;
+    snapshot->screenResolution = screenResolution;
+    snapshot->screenRefreshRate = screenRefreshRate;
+    snapshot->driver = driver;
+    snapshot->forceDragRefreshEnabled = forceDragRefreshEnabled;
+    if (coalescePerFrame) {
+        snapshot->coalescingInterval = 1000.0 / (screenRefreshRate > 0 ? screenRefreshRate : SETTINGS_COALESCING_FRAME_RATE_DEFAULT);
+    } else {
+        snapshot->coalescingInterval = coalescingInterval;
+    }
+    snapshot->doubleClickInterval = (uint64_t) (doubleClickInterval * 1e9);
+    snapshot->debugEnabled = debugEnabled;
+    snapshot->memoryLoggingEnabled = memoryLoggingEnabled;
+    snapshot->timingsEnabled = timingsEnabled;
+    snapshot->sendAuxEventsEnabled = sendAuxEventsEnabled;
+    snapshot->overlayEnabled = overlayEnabled;
+    snapshot->sayEnabled = sayEnabled;
+    snapshot->latencyEnabled = latencyEnabled;
+    snapshot->captureEnabled = captureEnabled;
+    snapshot->activeAppRequiresRefreshOnDrag = activeAppRequiresRefreshOnDrag;
+    snapshot->activeAppIsExcluded = activeAppIsExcluded;
+    snapshot->activeAppRequiresMouseEventListener = activeAppRequiresMouseEventListener;
+    snapshot->activeAppRequiresTabletPointSubtype = activeAppRequiresTabletPointSubtype;
+
+    if (current_snapshot != NULL && !config_snapshot_curves_changed(snapshot, current_snapshot)) {
+        snapshot->curves = current_snapshot->curves;
+        pipeline_curves_retain(snapshot->curves);
+    } else {
+        snapshot->curves = pipeline_curves_create(mouseCurve, mouseVelocity, snapshot->mouseCurveFile,
+                                                  trackpadCurve, trackpadVelocity, snapshot->trackpadCurveFile);
+        pipeline_curve_set_resolution(&snapshot->curves->mouse, mouseDpi, screenResolution, screenRefreshRate);
+        pipeline_curve_set_resolution(&snapshot->curves->trackpad, trackpadDpi, screenResolution, screenRefreshRate);
+        if (mouseTimeBased) {
+            pipeline_curve_use_timestamps(&snapshot->curves->mouse, mouseDpi);
+        }
+        if (trackpadTimeBased) {
+            pipeline_curve_use_timestamps(&snapshot->curves->trackpad, trackpadDpi);
+        }
+        config_log_curve_error("mouse", &snapshot->curves->mouse);
+        config_log_curve_error("trackpad", &snapshot->curves->trackpad);
+    }
+
+    OSMemoryBarrier();
+    config_snapshot_t *old = current_snapshot;
+    current_snapshot = snapshot;
+    OSMemoryBarrier();
+
+    if (old != NULL) {
+        retired_snapshots.push_back(old);
+    }
+
+    std::list<config_snapshot_t *>::iterator it = retired_snapshots.begin();
+    while (it != retired_snapshots.end()) {
+        if (!config_snapshot_in_use(*it)) {
+            config_snapshot_delete(*it);
+            it = retired_snapshots.erase(it);
+        } else {
+            it++;
+        }
+    }
+
+    pthread_mutex_unlock(&publish_mutex);
 }
 
 -(BOOL) appId:(NSString *)activeAppId contains:(NSString *)string {
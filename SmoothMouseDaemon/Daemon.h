@@ -8,6 +8,9 @@
 #import "MouseEventListener.h"
 #import "InterruptListener.h"
 
+#include "eventring.h"
+#include "eventloop.h"
+
 @interface Daemon : NSObject {
 @private
     NSRunLoop *runLoop;
@@ -17,13 +20,25 @@
     SystemMouseAcceleration *accel;
     id globalMouseMonitor;
     BOOL connected;
+    BOOL paused;
     pthread_t mouseEventThreadID;
     io_service_t service;
     io_connect_t connect;
     IODataQueueMemory *queueMappedMemory;
     mach_port_t	recvPort;
     uint32_t dataSize;
+    BOOL useEventRing;
+    event_ring_t eventRing;
     uint64_t eventsSinceStart;
+    event_loop_t *supervisorLoop;
+    int supervisorWakeup;
+    int supervisorRetry;
+    int retriesLeft;
+    BOOL kextPresent;
+    IONotificationPortRef notificationPort;
+    io_iterator_t kextArrivedIterator;
+    io_iterator_t kextTerminatedIterator;
+    io_object_t hidSystemNotification;
     time_t startTime;
 #if !__LP64__ || defined(IOCONNECT_MAPMEMORY_10_6)
     vm_address_t address;
@@ -41,12 +56,15 @@
 -(BOOL) loadDriver;
 -(BOOL) connectToDriver;
 -(BOOL) configureDriver;
+-(BOOL) pauseDriver:(BOOL)pause;
 -(BOOL) disconnectFromKext;
 -(BOOL) isActive;
+-(void) wakeSupervisor;
 -(BOOL) isMouseEventListenerActive;
 -(void) redrawOverlay;
 -(void) say:(NSString *)message;
 -(void) dumpState;
+-(void) settingsChanged:(NSNotification *)notification;
 
 @end
 
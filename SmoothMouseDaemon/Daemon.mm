@@ -2,6 +2,7 @@
 
 #import <IOKit/IODataQueueClient.h>
 #import <IOKit/kext/KextManager.h>
+#import <IOKit/hidsystem/IOHIDShared.h>
 #import <mach/mach.h>
 #include <pthread.h>
 
@@ -21,15 +22,64 @@
 #import "InterruptListener.h"
 #import "DriverEventLog.h"
 
-#define KEXT_CONNECT_RETRIES (3)
-#define SUPERVISOR_SLEEP_TIME_USEC (500000)
+#include "capture.h"
+#include "latency.h"
 
-double start, end, e1, e2, mhs, mhe, outerstart, outerend, outersum = 0, outernum = 0;
+#define KEXT_CONNECT_RETRIES (3)
+#define KEXT_CONNECT_RETRY_DELAY (500000000ull) // ns
 
 static int terminating_smoothmouse = 0;
 
 static void *KernelEventThread(void *instance);
 
+static uint32_t event_memory_type(BOOL useEventRing) {
+    return useEventRing ? KEXT_EVENT_RING_MEMORY_TYPE : kIODefaultMemoryType;
+}
+
+static void capture_load_curve_file(capture_curve_file_t *file, const char *path) {
+    if (path[0] != '\0' && !capture_curve_file_load(file, path)) {
+        NSLog(@"Failed to read curve file %s for the capture", path);
+    }
+}
+
+// called on the KernelEventThread, whose snapshot has what the pipeline uses
+static capture_file_t *capture_start() {
+    const config_snapshot_t *config = config_acquire(CONFIG_READER_KERNEL_EVENT_THREAD);
+
+    capture_settings_t settings;
+    capture_settings_init(&settings);
+    settings.mouseCurve = config->mouseCurve;
+    settings.mouseVelocity = config->mouseVelocity;
+    settings.trackpadCurve = config->trackpadCurve;
+    settings.trackpadVelocity = config->trackpadVelocity;
+    settings.startPos = mouse_get_current_pos();
+    settings.mouseTimeBasedDpi = config->mouseTimeBased ? config->mouseDpi : 0;
+    settings.trackpadTimeBasedDpi = config->trackpadTimeBased ? config->trackpadDpi : 0;
+    settings.mouseResolution = config->mouseDpi;
+    settings.trackpadResolution = config->trackpadDpi;
+    settings.screenResolution = config->screenResolution;
+    settings.screenRefreshRate = config->screenRefreshRate;
+    settings.coalescingInterval = config->coalescingInterval;
+    // only set for custom curves
+    capture_load_curve_file(&settings.mouseCurveFile, config->mouseCurveFile);
+    capture_load_curve_file(&settings.trackpadCurveFile, config->trackpadCurveFile);
+
+    config_release(CONFIG_READER_KERNEL_EVENT_THREAD);
+
+    NSString *filename = [NSString stringWithFormat:@"SmoothMouse-%ld.capture", (long)time(NULL)];
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:filename];
+
+    capture_file_t *capture = capture_create([path fileSystemRepresentation], &settings);
+    capture_settings_cleanup(&settings);
+    if (capture == NULL) {
+        NSLog(@"Failed to create capture file %@", path);
+    } else {
+        NSLog(@"Capturing kext events to %@", path);
+    }
+
+    return capture;
+}
+
 void trap_signals(int sig)
 {
     if (terminating_smoothmouse) {
@@ -46,10 +96,6 @@ void trap_signals(int sig)
     [NSApp terminate:nil];
 }
 
-void trap_sigusr(int sig) {
-    [[Daemon instance] dumpState];
-}
-
 // more information about getting notified when fron app changes:
 // http://stackoverflow.com/questions/763002/getting-notified-when-the-current-application-changes-in-cocoa
 static OSStatus AppFrontSwitchedHandler(EventHandlerCallRef inHandlerCallRef, EventRef inEvent, void *inUserData)
@@ -58,11 +104,61 @@ static OSStatus AppFrontSwitchedHandler(EventHandlerCallRef inHandlerCallRef, Ev
     return 0;
 }
 
+static void SupervisorHandler(event_loop_t *loop, void *context)
+{
+    NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+    [(id)context supervise];
+    [pool drain];
+}
+
+// SIGUSR1, on the supervisor thread so dumpState may log and write files
+static void DumpStateHandler(event_loop_t *loop, void *context)
+{
+    NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+    [(id)context dumpState];
+    [pool drain];
+}
+
+// releases the services of a matching notification, which also re-arms it
+static BOOL DrainIterator(io_iterator_t iterator)
+{
+    BOOL any = NO;
+    io_object_t object;
+    while ((object = IOIteratorNext(iterator)) != IO_OBJECT_NULL) {
+        IOObjectRelease(object);
+        any = YES;
+    }
+    return any;
+}
+
+static void KextArrivedHandler(void *refcon, io_iterator_t iterator)
+{
+    if (DrainIterator(iterator)) {
+        [(id)refcon kextPresenceChanged:YES];
+    }
+}
+
+static void KextTerminatedHandler(void *refcon, io_iterator_t iterator)
+{
+    if (DrainIterator(iterator)) {
+        [(id)refcon kextPresenceChanged:NO];
+    }
+}
+
+// the HID system notifies its clients when its parameters change, e.g. the
+// acceleration or the double click speed set in System Preferences
+static void HIDSystemInterestHandler(void *refcon, io_service_t service, natural_t messageType, void *messageArgument)
+{
+    mouse_update_clicktime();
+    [(id)refcon wakeSupervisor];
+}
+
 const char *get_acceleration_string(AccelerationCurve curve) {
     switch (curve) {
         case ACCELERATION_CURVE_LINEAR: return "LINEAR";
         case ACCELERATION_CURVE_WINDOWS: return "WINDOWS";
         case ACCELERATION_CURVE_OSX: return "OSX";
+        case ACCELERATION_CURVE_CUSTOM: return "CUSTOM";
         default: return "?";
     }
 }
@@ -85,6 +181,7 @@ const char *get_acceleration_string(AccelerationCurve curve) {
 	self = [super init];
 
     connected = NO;
+    paused = NO;
     globalMouseMonitor = NULL;
     eventsSinceStart = 0;
     runLoop = [NSRunLoop currentRunLoop];
@@ -97,6 +194,19 @@ const char *get_acceleration_string(AccelerationCurve curve) {
         }
     }
 
+    // the supervisor only wakes up for the notifications below and SIGUSR1
+    supervisorLoop = event_loop_create();
+    if (supervisorLoop == NULL ||
+        (supervisorWakeup = event_loop_add_signal(supervisorLoop, SupervisorHandler, self)) == -1 ||
+        (supervisorRetry = event_loop_add_timer(supervisorLoop, SupervisorHandler, self)) == -1 ||
+        event_loop_add_unix_signal(supervisorLoop, SIGUSR1, DumpStateHandler, self) == -1) {
+        NSLog(@"Failed to create the supervisor loop: %s", strerror(errno));
+        [self dealloc];
+        return nil;
+    }
+    retriesLeft = KEXT_CONNECT_RETRIES;
+    kextPresent = YES;
+
     accel = [[SystemMouseAcceleration alloc] init];
     sMouseSupervisor = [[MouseSupervisor alloc] init];
     sDriverEventLog = [[DriverEventLog alloc] init];
@@ -119,6 +229,18 @@ const char *get_acceleration_string(AccelerationCurve curve) {
 
     [self hookAppFrontChanged];
 
+    mouse_watch_displays();
+    mouse_update_clicktime();
+
+    [self watchKext];
+    [self watchHIDSystem];
+    [self watchSession];
+
+    [[NSDistributedNotificationCenter defaultCenter] addObserver:self
+                                                        selector:@selector(settingsChanged:)
+                                                            name:SETTINGS_CHANGED_NOTIFICATION
+                                                          object:nil];
+
     if ([config overlayEnabled]) {
         overlay = [[OverlayWindow alloc] init];
     }
@@ -143,7 +265,7 @@ const char *get_acceleration_string(AccelerationCurve curve) {
     signal(SIGINT, trap_signals);
     signal(SIGKILL, trap_signals);
     signal(SIGTERM, trap_signals);
-    signal(SIGUSR1, trap_sigusr);
+    // SIGUSR1 (dumpState) is taken by the supervisor loop, see init
 }
 
 -(BOOL) loadDriver
@@ -179,20 +301,39 @@ const char *get_acceleration_string(AccelerationCurve curve) {
                 goto error;
             }
 
-            error = IOConnectSetNotificationPort(connect, kIODefaultMemoryType, recvPort, 0);
-            if (kIOReturnSuccess != error) {
-                NSLog(@"IOConnectSetNotificationPort returned %d\n", error);
-                goto error;
+            // kexts without the event ring fail to map it, they get the data
+            // queue. No kext fills the ring yet, it is only mapped when built
+            // with SMOOTHMOUSE_EVENT_RING for trying out one that does.
+            useEventRing = NO;
+#ifdef SMOOTHMOUSE_EVENT_RING
+            error = IOConnectMapMemory(connect, KEXT_EVENT_RING_MEMORY_TYPE, mach_task_self(), &address, &size, kIOMapAnywhere);
+            if (kIOReturnSuccess == error) {
+                if (event_ring_attach(&eventRing, (void *) address, (size_t) size)) {
+                    useEventRing = YES;
+                } else {
+                    NSLog(@"Unsupported kext event ring, using the data queue");
+                    IOConnectUnmapMemory(connect, KEXT_EVENT_RING_MEMORY_TYPE, mach_task_self(), address);
+                    address = 0;
+                }
             }
+#endif
 
-            error = IOConnectMapMemory(connect, kIODefaultMemoryType, mach_task_self(), &address, &size, kIOMapAnywhere);
+            error = IOConnectSetNotificationPort(connect, event_memory_type(useEventRing), recvPort, 0);
             if (kIOReturnSuccess != error) {
-                NSLog(@"IOConnectMapMemory returned %d\n", error);
+                NSLog(@"IOConnectSetNotificationPort returned %d\n", error);
                 goto error;
             }
 
-            queueMappedMemory = (IODataQueueMemory *) address;
-            dataSize = (uint32_t) size;
+            if (!useEventRing) {
+                error = IOConnectMapMemory(connect, kIODefaultMemoryType, mach_task_self(), &address, &size, kIOMapAnywhere);
+                if (kIOReturnSuccess != error) {
+                    NSLog(@"IOConnectMapMemory returned %d\n", error);
+                    goto error;
+                }
+
+                queueMappedMemory = (IODataQueueMemory *) address;
+                dataSize = (uint32_t) size;
+            }
 
             BOOL ok = [self configureDriver];
             if (!ok) {
@@ -209,6 +350,10 @@ const char *get_acceleration_string(AccelerationCurve curve) {
 
             [accel reset];
 
+            // in case a change was missed while we were disconnected, e.g.
+            // in another session
+            mouse_update_clicktime();
+
             if ([[Config instance] latencyEnabled]) {
                 [interruptListener start];
             }
@@ -268,9 +413,98 @@ error:
 
     [[Config instance] setActiveAppId: appId];
 
+    // takes effect with the next event, pausing the kext is left to the
+    // supervisor and only saves the round trip through the daemon
+    mouse_set_paused([[Config instance] activeAppIsExcluded]);
+
     [self handleAppChanged];
 }
 
+- (void) watchKext
+{
+    notificationPort = IONotificationPortCreate(kIOMasterPortDefault);
+    CFRunLoopAddSource(CFRunLoopGetCurrent(), IONotificationPortGetRunLoopSource(notificationPort), kCFRunLoopDefaultMode);
+
+    // each call consumes the matching dictionary
+    kern_return_t error = IOServiceAddMatchingNotification(notificationPort, kIOFirstMatchNotification,
+                                                           IOServiceMatching("com_cyberic_SmoothMouse"),
+                                                           KextArrivedHandler, self, &kextArrivedIterator);
+    if (error == KERN_SUCCESS) {
+        // the kext is usually there already, connecting is up to the supervisor
+        DrainIterator(kextArrivedIterator);
+    } else {
+        NSLog(@"IOServiceAddMatchingNotification returned %d, kext reloads are not picked up", error);
+    }
+
+    error = IOServiceAddMatchingNotification(notificationPort, kIOTerminatedNotification,
+                                             IOServiceMatching("com_cyberic_SmoothMouse"),
+                                             KextTerminatedHandler, self, &kextTerminatedIterator);
+    if (error == KERN_SUCCESS) {
+        DrainIterator(kextTerminatedIterator);
+    } else {
+        NSLog(@"IOServiceAddMatchingNotification returned %d, kext unloads are not picked up", error);
+    }
+}
+
+- (void) watchHIDSystem
+{
+    io_service_t hidSystem = IOServiceGetMatchingService(kIOMasterPortDefault, IOServiceMatching(kIOHIDSystemClass));
+    if (hidSystem == IO_OBJECT_NULL) {
+        NSLog(@"Failed to find the HID system, its parameters are reset on reconnect only");
+        return;
+    }
+
+    kern_return_t error = IOServiceAddInterestNotification(notificationPort, hidSystem, kIOGeneralInterest,
+                                                           HIDSystemInterestHandler, self, &hidSystemNotification);
+    IOObjectRelease(hidSystem);
+    if (error != KERN_SUCCESS) {
+        NSLog(@"IOServiceAddInterestNotification returned %d, HID parameters are reset on reconnect only", error);
+    }
+}
+
+- (void) watchSession
+{
+    NSNotificationCenter *center = [[NSWorkspace sharedWorkspace] notificationCenter];
+
+    // fast user switching, and the acceleration may be back after sleep
+    [center addObserver:self selector:@selector(workspaceChanged:) name:NSWorkspaceSessionDidBecomeActiveNotification object:nil];
+    [center addObserver:self selector:@selector(workspaceChanged:) name:NSWorkspaceSessionDidResignActiveNotification object:nil];
+    [center addObserver:self selector:@selector(workspaceChanged:) name:NSWorkspaceDidWakeNotification object:nil];
+}
+
+- (void) workspaceChanged:(NSNotification *)notification {
+    [self wakeSupervisor];
+}
+
+- (void) kextPresenceChanged:(BOOL)present {
+    NSLog(@"Kext %@", present ? @"loaded" : @"unloaded");
+    kextPresent = present;
+    [self wakeSupervisor];
+}
+
+- (void) wakeSupervisor {
+    event_loop_signal(supervisorLoop, supervisorWakeup);
+}
+
+- (void) settingsChanged:(NSNotification *)notification {
+    Config *config = [Config instance];
+
+    // the new snapshot with the rebuilt transfer functions is picked up by
+    // the KernelEventThread with the next event
+    if (![config readSettingsPlist]) {
+        NSLog(@"Failed to reload settings");
+        return;
+    }
+
+    NSLog(@"Settings reloaded, mouse velocity: %f, mouse curve: %s, trackpad velocity: %f, trackpad curve: %s",
+          [config mouseVelocity],
+          get_acceleration_string([config mouseCurve]),
+          [config trackpadVelocity],
+          get_acceleration_string([config trackpadCurve]));
+
+    [self wakeSupervisor];
+}
+
 -(void) handleAppChanged {
     if ([[Config instance] activeAppRequiresMouseEventListener]) {
         [sMouseSupervisor clearMoveEvents];
@@ -278,6 +512,9 @@ error:
     } else {
         [mouseEventListener stop:runLoop];
     }
+
+    // the supervisor decides whether the new app is excluded
+    [self wakeSupervisor];
 }
 
 -(BOOL) configureDriver
@@ -290,11 +527,12 @@ error:
 
     Config *config = [Config instance];
 
-    if ([config mouseEnabled]) {
+    // while paused the kext leaves all devices to the system
+    if ([config mouseEnabled] && !paused) {
         configuration |= KEXT_CONF_MOUSE_ENABLED;
     }
 
-    if ([config trackpadEnabled]) {
+    if ([config trackpadEnabled] && !paused) {
         configuration |= KEXT_CONF_TRACKPAD_ENABLED;
     }
 
@@ -302,6 +540,10 @@ error:
         configuration |= KEXT_CONF_QUARTZ_OLD; // set compatibility mode in kernel
     }
 
+    if (useEventRing) {
+        configuration |= KEXT_CONF_EVENT_RING;
+    }
+
     scalarI_64[0] = configuration;
 
     kernResult = IOConnectCallScalarMethod(connect,
@@ -318,6 +560,33 @@ error:
     }
 }
 
+// reconfigures the kext instead of disconnecting from it, so the connection
+// and the KernelEventThread stay up while an excluded app is in front. The
+// events are passed through as soon as the app is switched (see
+// mouse_set_paused()), this only spares the kext and the daemon the work.
+-(BOOL) pauseDriver:(BOOL)pause
+{
+    @synchronized(self) {
+        if (pause == paused) {
+            return YES;
+        }
+        paused = pause;
+        mouse_set_paused(pause);
+        if (!connected) {
+            // connectToDriver configures it
+            return YES;
+        }
+        if (![self configureDriver]) {
+            return NO;
+        }
+        if (!pause) {
+            mouse_resume();
+        }
+        NSLog(@"%@ the kext", pause ? @"Paused" : @"Resumed");
+        return YES;
+    }
+}
+
 -(BOOL) disconnectFromKext
 {
     @synchronized(self) {
@@ -335,7 +604,7 @@ error:
             }
 
             if (address) {
-                IOConnectUnmapMemory(connect, kIODefaultMemoryType, mach_task_self(), address);
+                IOConnectUnmapMemory(connect, event_memory_type(useEventRing), mach_task_self(), address);
             }
 
             if (connect) {
@@ -361,61 +630,182 @@ error:
     [accel restore];
 }
 
-static void *KernelEventThread(void *instance)
-{
-    Daemon *self = (Daemon *) instance;
+// the events read from the kext at once are processed together, see
+// mouse_process_kext_events()
+#define KERNEL_EVENT_BURST (64)
 
-    //NSLog(@"KernelEventThread: Start");
+// events from the kext, from the data queue or the event ring
+static void KernelEventProcess(Daemon *self, mouse_event_t *mouse_events, size_t count, const config_snapshot_t *config,
+                               capture_file_t **capture, uint64_t start, uint64_t outerstart, uint64_t outerend,
+                               int numPackets)
+{
+    //LOG(@"Got event from kernel with timestamp: %llu", mouse_events[0].timestamp);
+    // as the kext sent them, processing remaps the buttons in place
+    for (size_t i = 0; i < count && *capture != NULL; i++) {
+        if (!capture_write_event(*capture, &mouse_events[i])) {
+            NSLog(@"Failed to write capture file, capture stopped");
+            capture_close(*capture);
+            *capture = NULL;
+        }
+    }
+    uint64_t mhs = latency_now();
+    mouse_process_kext_events(mouse_events, count, config);
+    self->eventsSinceStart += count;
+    uint64_t mhe = latency_now();
+    latency_record(LATENCY_STAGE_MOUSE_PROCESS, mhs, mhe);
+    if (config->timingsEnabled) {
+        TRACE(TRACE_EVENT_KEXT_TIMINGS,
+              TRACE_TIME_SPAN(outerstart, outerend),
+              TRACE_TIME_SPAN(start, mhe),
+              TRACE_TIME_SPAN(mhs, mhe),
+              TRACE_U64_LO(mouse_events[count - 1].seqnum),
+              TRACE_U64_HI(mouse_events[count - 1].seqnum),
+              numPackets,
+              driver_num_coalesced_events());
+    }
+}
 
+static void KernelEventQueueLoop(Daemon *self, capture_file_t **capture)
+{
     kern_return_t error;
+    mouse_event_t events[KERNEL_EVENT_BURST];
 
-    char *buf = (char *)malloc(self->dataSize);
+    char *buf = (char *)malloc(MAX(self->dataSize, sizeof(mouse_event_t)));
     if (!buf) {
         NSLog(@"malloc error");
-        return NULL;
+        return;
     }
 
-    [Prio setRealtimePrio: @"KernelEventThread" withComputation:20000 withConstraint:50000];
-
-    (void) mouse_init();
-
-    static int counter = 0;
+    uint64_t outerstart = 0;
     while (IODataQueueWaitForAvailableData(self->queueMappedMemory, self->recvPort) == kIOReturnSuccess) {
-        outerend = GET_TIME();
+        uint64_t outerend = latency_now();
+        const config_snapshot_t *config = config_acquire(CONFIG_READER_KERNEL_EVENT_THREAD);
         int numPackets = 0;
         while (IODataQueueDataAvailable(self->queueMappedMemory)) {
-            start = GET_TIME();
-            numPackets++;
-            counter++;
-            error = IODataQueueDequeue(self->queueMappedMemory, buf, &(self->dataSize));
-            mouse_event_t *mouse_event = (mouse_event_t *) buf;
-            //LOG(@"Got event from kernel with timestamp: %llu", mouse_event->timestamp);
-            if (!error) {
-                mhs = GET_TIME();
-                mouse_process_kext_event(mouse_event);
-                self->eventsSinceStart++;
-                mhe = GET_TIME();
-            } else {
-                LOG(@"IODataQueueDequeue() failed");
-                exit(0);
-            }
-            end = GET_TIME();
-            if ([[Config instance] timingsEnabled]) {
-                LOG(@"timings: outer: %f, inner: %f, process mouse event: %f, seqnum: %llu, burst: %d, coalesced: %d", outerend-outerstart, end-start, mhe-mhs, mouse_event->seqnum, numPackets, numCoalescedEvents);
+            uint64_t start = latency_now();
+            // what is queued up to now is processed together
+            size_t numEvents = 0;
+            while (numEvents < KERNEL_EVENT_BURST && IODataQueueDataAvailable(self->queueMappedMemory)) {
+                numPackets++;
+                // the size is in/out, it has to be reset or an entry smaller
+                // than the last one would cut off the ones after it
+                uint32_t entrySize = self->dataSize;
+                error = IODataQueueDequeue(self->queueMappedMemory, buf, &entrySize);
+                if (error) {
+                    LOG(@"IODataQueueDequeue() failed");
+                    exit(0);
+                }
+                if (entrySize < sizeof(mouse_event_t)) {
+                    // older kext without the device id, all its devices of a
+                    // type share one device state in the pipeline
+                    memset(buf + entrySize, 0, sizeof(mouse_event_t) - entrySize);
+                }
+                memcpy(&events[numEvents++], buf, sizeof(mouse_event_t));
             }
+            latency_record(LATENCY_STAGE_KEXT_DEQUEUE, start, latency_now());
+            KernelEventProcess(self, events, numEvents, config, capture, start, outerstart, outerend, numPackets);
         }
 
-        if (outerstart != 0 && outerend != 0) {
-            outernum += 1;
-            outersum += (outerend-outerstart);
+        config_release(CONFIG_READER_KERNEL_EVENT_THREAD);
+
+        outerstart = latency_now();
+    }
+
+    free(buf);
+}
+
+#ifdef SMOOTHMOUSE_EVENT_RING
+// the event ring counterpart of IODataQueueWaitForAvailableData(), the kext
+// only sends a notification while we wait
+static BOOL KernelEventRingWait(Daemon *self)
+{
+    if (!self->connected) {
+        return NO;
+    }
+
+    if (!event_ring_begin_wait(&self->eventRing)) {
+        return YES;
+    }
+
+    struct {
+        mach_msg_header_t header;
+        mach_msg_trailer_t trailer;
+    } msg;
+    kern_return_t error = mach_msg(&msg.header, MACH_RCV_MSG, 0, sizeof(msg), self->recvPort, MACH_MSG_TIMEOUT_NONE, MACH_PORT_NULL);
+
+    event_ring_end_wait(&self->eventRing);
+
+    return error == KERN_SUCCESS;
+}
+
+static void KernelEventRingLoop(Daemon *self, capture_file_t **capture)
+{
+    event_ring_t *ring = &self->eventRing;
+    mouse_event_t events[KERNEL_EVENT_BURST];
+
+    uint64_t outerstart = 0;
+    while (KernelEventRingWait(self)) {
+        uint64_t outerend = latency_now();
+        const config_snapshot_t *config = config_acquire(CONFIG_READER_KERNEL_EVENT_THREAD);
+        int numPackets = 0;
+        event_ring_record_t *record;
+        // the events of the records published up to now are processed
+        // together, copied out since they are event_size apart in the ring
+        size_t numEvents = 0;
+        uint64_t start = latency_now();
+        while ((record = event_ring_peek(ring)) != NULL) {
+            latency_record(LATENCY_STAGE_KEXT_DEQUEUE, start, latency_now());
+            uint32_t numRecordEvents = event_ring_num_events(ring, record);
+            for (uint32_t i = 0; i < numRecordEvents; i++) {
+                numPackets++;
+                events[numEvents++] = *event_ring_event(ring, record, i);
+                if (numEvents == KERNEL_EVENT_BURST) {
+                    KernelEventProcess(self, events, numEvents, config, capture, start, outerstart, outerend, numPackets);
+                    numEvents = 0;
+                    start = latency_now();
+                }
+            }
+            event_ring_consume(ring);
         }
+        if (numEvents > 0) {
+            KernelEventProcess(self, events, numEvents, config, capture, start, outerstart, outerend, numPackets);
+        }
+
+        config_release(CONFIG_READER_KERNEL_EVENT_THREAD);
 
-        outerstart = GET_TIME();
+        outerstart = latency_now();
     }
+}
+#endif
+
+static void *KernelEventThread(void *instance)
+{
+    Daemon *self = (Daemon *) instance;
+
+    //NSLog(@"KernelEventThread: Start");
+
+    [Prio setRealtimePrio: @"KernelEventThread" withComputation:20000 withConstraint:50000];
+
+    (void) mouse_init();
+
+    capture_file_t *capture = NULL;
+    if ([[Config instance] captureEnabled]) {
+        capture = capture_start();
+    }
+
+#ifdef SMOOTHMOUSE_EVENT_RING
+    if (self->useEventRing) {
+        KernelEventRingLoop(self, &capture);
+    } else {
+        KernelEventQueueLoop(self, &capture);
+    }
+#else
+    KernelEventQueueLoop(self, &capture);
+#endif
 
     (void) mouse_cleanup();
 
-    free(buf);
+    capture_close(capture);
 
     //NSLog(@"KernelEventThread: End");
 
@@ -425,30 +815,42 @@ static void *KernelEventThread(void *instance)
 -(void) mainLoop
 {
     startTime = time(NULL);
-    int retries_left = KEXT_CONNECT_RETRIES;
-    while(1) {
-        BOOL active = [self isActive];
-        if (active) {
-            BOOL ok = [self connectToDriver];
-            if (!ok) {
-                NSLog(@"Failed to connect to kext (retries_left = %d)", retries_left);
-                if (retries_left < 1) {
-                    exit(-1);
-                }
-                retries_left--;
-            } else {
-                retries_left = KEXT_CONNECT_RETRIES;
-                // TODO: refactor this (read: what a fucking mess this has become)
-                if (!terminating_smoothmouse) {
-                    [accel reset];
-                    mouse_update_clicktime();
-                }
+    [self wakeSupervisor];
+    if (!event_loop_run(supervisorLoop)) {
+        NSLog(@"Supervisor loop failed: %s", strerror(errno));
+        exit(-1);
+    }
+}
+
+// runs on the mainLoop thread whenever something that affects the connection
+// changed, or to retry a failed connection
+-(void) supervise
+{
+    event_loop_disarm_timer(supervisorLoop, supervisorRetry);
+
+    BOOL active = [self isActive] && kextPresent;
+    if (active) {
+        if (![self pauseDriver:[[Config instance] activeAppIsExcluded]]) {
+            NSLog(@"Failed to reconfigure the kext, reconnecting");
+            [self disconnectFromKext];
+        }
+        BOOL ok = [self connectToDriver];
+        if (!ok) {
+            NSLog(@"Failed to connect to kext (retries_left = %d)", retriesLeft);
+            if (retriesLeft < 1) {
+                exit(-1);
             }
+            retriesLeft--;
+            event_loop_arm_timer(supervisorLoop, supervisorRetry, KEXT_CONNECT_RETRY_DELAY);
         } else {
-            //NSLog(@"calling disconnectFromKext from mainloop");
-            [self disconnectFromKext];
+            retriesLeft = KEXT_CONNECT_RETRIES;
+            // the system acceleration may have been changed behind our back
+            if (!terminating_smoothmouse) {
+                [accel reset];
+            }
         }
-        usleep(SUPERVISOR_SLEEP_TIME_USEC);
+    } else {
+        [self disconnectFromKext];
     }
 }
 
@@ -465,12 +867,7 @@ static void *KernelEventThread(void *instance)
             active = YES;
         }
     }
-    // yes we are logged in, check if we want smoothmouse to be enabled in the current app
-    if (active) {
-        if ([[Config instance] activeAppIsExcluded]) {
-            active = NO;
-        }
-    }
+    // excluded apps pause the kext instead, see pauseDriver:
     return active;
 }
 
@@ -482,11 +879,24 @@ static void *KernelEventThread(void *instance)
     NSLog(@"=== DAEMON STATE ===");
     NSLog(@"Uptime seconds: %d", (int) (time(NULL) - startTime));
     NSLog(@"Connected: %d", connected);
+    NSLog(@"Paused: %d", paused);
+    NSLog(@"Supervisor wakeups: %llu", event_loop_num_wakeups(supervisorLoop));
     NSLog(@"Mouse enabled: %d", [[Config instance] mouseEnabled]);
     NSLog(@"Trackpad enabled: %d", [[Config instance] trackpadEnabled]);
     NSLog(@"Kernel events since start: %llu", eventsSinceStart);
     NSLog(@"Number of lost kext events: %d", totalNumberOfLostEvents);
+    NSLog(@"Number of coalesced moves: %d (held for the coalescing interval: %d)", driver_num_coalesced_events(), driver_num_held_move_events());
     NSLog(@"Number of lost clicks: %d", [sMouseSupervisor numClickEvents]);
+    NSLog(@"Number of unmatched moves: %d (dropped: %llu)", [sMouseSupervisor numMoveEvents], [sMouseSupervisor numDroppedMoveEvents]);
+    debug_log_latency();
+
+    NSString *filename = [NSString stringWithFormat:@"SmoothMouse-latency-%ld.txt", (long)time(NULL)];
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:filename];
+    if (latency_write([path fileSystemRepresentation])) {
+        NSLog(@"Latency histograms written to %@", path);
+    } else {
+        NSLog(@"Failed to write latency histograms to %@", path);
+    }
     NSLog(@"===");
 }
 
@@ -1,12 +1,18 @@
 
 #pragma once
 
-extern int numCoalescedEvents;
+#include <stdint.h>
+
+#include "platform.h"
+
+struct config_snapshot_s;
+typedef struct config_snapshot_s config_snapshot_t;
 
 typedef enum Driver_s {
     DRIVER_QUARTZ_OLD,
     DRIVER_QUARTZ,
-    DRIVER_IOHID
+    DRIVER_IOHID,
+    DRIVER_UINPUT   // Linux only, see SmoothMouseLinux/uinput.h
 } Driver;
 
 typedef enum driver_event_id_s {
@@ -36,6 +42,7 @@ typedef struct {
     driver_event_id_t id;
     uint64_t kextTimestamp;
     uint64_t kextSeqnum;
+    uint64_t queueTimestamp; // latency_now() when posted, set by driver_post_event
     union {
         driver_move_event_t move;
         driver_button_event_t button;
@@ -44,7 +51,9 @@ typedef struct {
 
 BOOL driver_init();
 BOOL driver_cleanup();
-BOOL driver_post_event(driver_event_t *event);
+BOOL driver_post_event(driver_event_t *event, const config_snapshot_t *config);
+int driver_num_coalesced_events();
+int driver_num_held_move_events(); // held back for the coalescing interval
 const char *driver_quartz_event_type_to_string(CGEventType type);
 const char *driver_iohid_event_type_to_string(int type);
 const char *driver_get_driver_string(int driver);
@@ -9,101 +9,67 @@
 #import "Daemon.h"
 #import "DriverEventLog.h"
 
-#include <list>
+#include <mach/mach_time.h>
 
 #include "prio.h"
+#include "latency.h"
+#include "eventqueue.h"
 #include "driver.h"
 #include "debug.h"
-
-int numCoalescedEvents;
+#include "mach_timebase_util.h"
 
 static CGEventSourceRef eventSource = NULL;
 static io_connect_t iohid_connect = MACH_PORT_NULL;
 static pthread_t driverEventThreadID;
 
-static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t data_available = PTHREAD_COND_INITIALIZER;
+// from the KernelEventThread to the DriverEventThread, see eventqueue.h
+static event_queue_t event_queue;
+static BOOL event_queue_created = NO;
+static mach_timebase_info_data_t timebase;
 
-static std::list<driver_event_t> event_queue;
 static BOOL keep_running;
 
 static void *DriverEventThread(void *instance);
-static BOOL driver_handle_button_event(driver_button_event_t *event);
-static BOOL driver_handle_move_event(driver_move_event_t *event);
-
-BOOL is_move_event(driver_event_t *event) {
-    return (event->id == DRIVER_EVENT_ID_MOVE);
-}
+static BOOL driver_handle_button_event(driver_button_event_t *event, const config_snapshot_t *config);
+static BOOL driver_handle_move_event(driver_move_event_t *event, const config_snapshot_t *config);
 
-BOOL can_coalesce(driver_move_event_t *e1, driver_move_event_t *e2)
+static BOOL can_coalesce(const driver_move_event_t *e1, const driver_move_event_t *e2, void *context)
 {
-    if (e1->type == e2->type &&
-        e1->buttons == e2->buttons &&
-        e1->otherButton == e2->otherButton) {
+    const config_snapshot_t *config = (const config_snapshot_t *) context;
+    if (pipeline_can_coalesce(e1, e2)) {
         return YES;
     } else {
-        if ([[Config instance] debugEnabled]) {
-            LOG(@"Can't Coalesce, t1: %d, t2: %d, b1: %d, b2: %d, ob1: %d, ob2: %d",
-                e1->type,
-                e2->type,
-                e1->buttons,
-                e2->buttons,
-                e1->otherButton,
-                e2->otherButton);
+        if (config->debugEnabled) {
+            TRACE(TRACE_EVENT_DRIVER_CANT_COALESCE,
+                  (int)e1->type,
+                  (int)e2->type,
+                  e1->buttons,
+                  e2->buttons,
+                  e1->otherButton,
+                  e2->otherButton);
         }
         return NO;
     }
 }
 
-BOOL driver_post_event(driver_event_t *event) {
-    pthread_mutex_lock(&mutex);
-    if (!event_queue.empty() && is_move_event(event)) {
-        driver_event_t back = event_queue.back();
-        if (can_coalesce(&event->move, &(back.move))) {
-            event_queue.pop_back();
-            event->move.deltaX += back.move.deltaX;
-            event->move.deltaY += back.move.deltaY;
-            ++numCoalescedEvents;
-        }
+BOOL driver_post_event(driver_event_t *event, const config_snapshot_t *config) {
+    event->queueTimestamp = latency_now();
+
+    int numFull = event_queue.numFull;
+    event_queue_push(&event_queue, event, can_coalesce, (void *) config);
+    if (event_queue.numFull != numFull) {
+        LOG(@"Driver event queue was full, waited for DriverEventThread");
     }
-    event_queue.push_back(*event);
-    pthread_cond_signal(&data_available);
-    pthread_mutex_unlock(&mutex);
+
     return YES;
 }
 
-const char *driver_quartz_event_type_to_string(CGEventType type) {
-    switch(type) {
-        case kCGEventNull:              return "kCGEventNull";
-        case kCGEventLeftMouseUp:       return "kCGEventLeftMouseUp";
-        case kCGEventLeftMouseDown:     return "kCGEventLeftMouseDown";
-        case kCGEventLeftMouseDragged:  return "kCGEventLeftMouseDragged";
-        case kCGEventRightMouseUp:      return "kCGEventRightMouseUp";
-        case kCGEventRightMouseDown:    return "kCGEventRightMouseDown";
-        case kCGEventRightMouseDragged: return "kCGEventRightMouseDragged";
-        case kCGEventOtherMouseUp:      return "kCGEventOtherMouseUp";
-        case kCGEventOtherMouseDown:    return "kCGEventOtherMouseDown";
-        case kCGEventOtherMouseDragged: return "kCGEventOtherMouseDragged";
-        case kCGEventMouseMoved:        return "kCGEventMouseMoved";
-        default:                        return "?";
-    }
+int driver_num_coalesced_events() {
+    return event_queue.numCoalesced;
 }
 
-const char *driver_iohid_event_type_to_string(int type) {
-    switch(type) {
-        case NX_NULLEVENT:      return "NX_NULLEVENT";
-        case NX_LMOUSEUP:       return "NX_LMOUSEUP";
-        case NX_LMOUSEDOWN:     return "NX_LMOUSEDOWN";
-        case NX_LMOUSEDRAGGED:  return "NX_LMOUSEDRAGGED";
-        case NX_RMOUSEUP:       return "NX_RMOUSEUP";
-        case NX_RMOUSEDOWN:     return "NX_RMOUSEDOWN";
-        case NX_RMOUSEDRAGGED:  return "NX_RMOUSEDRAGGED";
-        case NX_OMOUSEUP:       return "NX_OMOUSEUP";
-        case NX_OMOUSEDOWN:     return "NX_OMOUSEDOWN";
-        case NX_OMOUSEDRAGGED:  return "NX_OMOUSEDRAGGED";
-        case NX_MOUSEMOVED:     return "NX_MOUSEMOVED";
-        default:                return "?";
-    }
+int driver_num_held_move_events() {
+    return event_queue.numHeld;
 }
 
 static void *DriverEventThread(void *instance)
@@ -112,29 +78,37 @@ static void *DriverEventThread(void *instance)
 
     [Prio setRealtimePrio: @"DriverEventThread" withComputation:200000 withConstraint:300000];
 
+    // the interval is taken from the config of the previous event, events
+    // are only held back once one came in
+    pipeline_pacer_t pacer;
+    pipeline_pacer_init(&pacer, 0);
+    uint32_t pacerConfigVersion = 0;
+
     while(keep_running) {
         driver_event_t event;
-        pthread_mutex_lock(&mutex);
-        while(event_queue.empty()) {
-            pthread_cond_wait(&data_available, &mutex);
+        event_queue_pop(&event_queue, &event, &pacer);
+        uint64_t start = latency_now();
+        latency_record(LATENCY_STAGE_QUEUE_WAIT, event.queueTimestamp, start);
+
+        const config_snapshot_t *config = config_acquire(CONFIG_READER_DRIVER_EVENT_THREAD);
+
+        if (config->version != pacerConfigVersion) {
+            pacerConfigVersion = config->version;
+            pacer.interval = convert_from_nanos_to_mach_timebase((uint64_t)(config->coalescingInterval * 1.0e6), &timebase);
         }
-        double start = GET_TIME();
-        event = event_queue.front();
-        event_queue.pop_front();
-        pthread_mutex_unlock(&mutex);
 
-        if ([[Config instance] latencyEnabled]) {
+        if (config->latencyEnabled) {
             [sDriverEventLog add:&event];
         }
 
         switch(event.id) {
             case DRIVER_EVENT_ID_MOVE:
                 //LOG(@"DRIVER_EVENT_ID_MOVE");
-                driver_handle_move_event((driver_move_event_t *)&(event.move));
+                driver_handle_move_event((driver_move_event_t *)&(event.move), config);
                 break;
             case DRIVER_EVENT_ID_BUTTON:
                 //LOG(@"DRIVER_EVENT_ID_BUTTON");
-                driver_handle_button_event((driver_button_event_t *)&(event.button));
+                driver_handle_button_event((driver_button_event_t *)&(event.button), config);
                 break;
             case DRIVER_EVENT_ID_TERMINATE:
                 //LOG(@"DRIVER_EVENT_ID_TERMINATE");
@@ -143,11 +117,14 @@ static void *DriverEventThread(void *instance)
                 //LOG(@"UNKNOWN DRIVER EVENT (%d)", event.id);
                 break;
         }
-        double end = GET_TIME();
-        if ([[Config instance] timingsEnabled]) {
-            LOG(@"driver timings: total time time in mach time units: %f", (end-start));
+        uint64_t end = latency_now();
+        latency_record(LATENCY_STAGE_DRIVER_POST, start, end);
+        if (config->timingsEnabled) {
+            TRACE(TRACE_EVENT_DRIVER_TIMINGS, TRACE_TIME_SPAN(start, end));
         }
 
+        config_release(CONFIG_READER_DRIVER_EVENT_THREAD);
+
     }
 
     //NSLog(@"DriverEventThread: End");
@@ -156,7 +133,17 @@ static void *DriverEventThread(void *instance)
 }
 
 BOOL driver_init() {
-    numCoalescedEvents = 0;
+    mach_timebase_info(&timebase);
+
+    if (!event_queue_created) {
+        if (!event_queue_init(&event_queue)) {
+            NSLog(@"call to semaphore_create failed");
+            return NO;
+        }
+        event_queue_created = YES;
+    } else {
+        event_queue_reset(&event_queue);
+    }
 
     switch ([[Config instance] driver]) {
         case DRIVER_QUARTZ_OLD:
@@ -226,7 +213,7 @@ BOOL driver_cleanup() {
 
     driver_event_t terminate_event;
     terminate_event.id = DRIVER_EVENT_ID_TERMINATE;
-    driver_post_event(&terminate_event);
+    driver_post_event(&terminate_event, NULL); // never coalesced, no config needed
 
     int rv = pthread_join(driverEventThreadID, NULL);
     if (rv != 0) {
@@ -255,16 +242,15 @@ BOOL driver_cleanup() {
     return YES;
 }
 
-BOOL driver_handle_move_event(driver_move_event_t *event) {
-    int driver_to_use = [[Config instance] driver];
-
-    const char *driverString = driver_get_driver_string(driver_to_use);
+BOOL driver_handle_move_event(driver_move_event_t *event, const config_snapshot_t *config) {
+    int driver_to_use = config->driver;
 
-    if ([[Daemon instance] isMouseEventListenerActive]) {
+    if (config->activeAppRequiresMouseEventListener) {
         [sMouseSupervisor pushMoveEvent: event->deltaX: event->deltaY];
     }
 
-    e1 = GET_TIME();
+    double e1 = GET_TIME();
+    double e2;
     switch (driver_to_use) {
         case DRIVER_QUARTZ_OLD:
         {
@@ -275,12 +261,11 @@ BOOL driver_handle_move_event(driver_move_event_t *event) {
 
             e2 = GET_TIME();
 
-            if ([[Config instance] debugEnabled]) {
-                LOG(@"%s:MOVE: pos.x: %d, pos.y: %d, time: %f",
-                    driverString,
-                    (int)event->pos.x,
-                    (int)event->pos.y,
-                    (e2-e1));
+            if (config->debugEnabled) {
+                TRACE(TRACE_EVENT_DRIVER_MOVE_QUARTZ_OLD,
+                      (int)event->pos.x,
+                      (int)event->pos.y,
+                      TRACE_TIME(e2-e1));
             }
             break;
         }
@@ -294,16 +279,14 @@ BOOL driver_handle_move_event(driver_move_event_t *event) {
 
             e2 = GET_TIME();
 
-            if ([[Config instance] debugEnabled]) {
-                LOG(@"%s:MOVE: eventType: %s(%d), pos.x: %d, pos.y: %d, dx: %d, dy: %d, time: %f",
-                    driverString,
-                    driver_quartz_event_type_to_string(event->type),
-                    (int)event->type,
-                    (int)event->pos.x,
-                    (int)event->pos.y,
-                    (int)event->deltaX,
-                    (int)event->deltaY,
-                    (e2-e1));
+            if (config->debugEnabled) {
+                TRACE(TRACE_EVENT_DRIVER_MOVE_QUARTZ,
+                      (int)event->type,
+                      (int)event->pos.x,
+                      (int)event->pos.y,
+                      (int)event->deltaX,
+                      (int)event->deltaY,
+                      TRACE_TIME(e2-e1));
             }
             break;
         }
@@ -356,16 +339,14 @@ BOOL driver_handle_move_event(driver_move_event_t *event) {
 
             e2 = GET_TIME();
 
-            if ([[Config instance] debugEnabled]) {
-                LOG(@"%s:MOVE: eventType: %s(%d), newPoint: %dx%d, dx: %d, dy: %d, time: %f",
-                    driverString,
-                    driver_iohid_event_type_to_string(iohidEventType),
-                    (int)iohidEventType,
-                    (int)newPoint.x,
-                    (int)newPoint.y,
-                    (int)eventData.mouseMove.dx,
-                    (int)eventData.mouseMove.dy,
-                    (e2-e1));
+            if (config->debugEnabled) {
+                TRACE(TRACE_EVENT_DRIVER_MOVE_IOHID,
+                      (int)iohidEventType,
+                      (int)newPoint.x,
+                      (int)newPoint.y,
+                      (int)eventData.mouseMove.dx,
+                      (int)eventData.mouseMove.dy,
+                      TRACE_TIME(e2-e1));
             }
 
             break;
@@ -377,13 +358,11 @@ BOOL driver_handle_move_event(driver_move_event_t *event) {
         }
     }
 
-    e2 = GET_TIME();
-
     return YES;
 }
 
-BOOL driver_handle_button_event(driver_button_event_t *event) {
-    int driver_to_use = [[Config instance] driver];
+BOOL driver_handle_button_event(driver_button_event_t *event, const config_snapshot_t *config) {
+    int driver_to_use = config->driver;
 
     const char *driverString = driver_get_driver_string(driver_to_use);
 
@@ -408,7 +387,8 @@ BOOL driver_handle_button_event(driver_button_event_t *event) {
         [sMouseSupervisor pushClickEvent];
     }
 
-    e1 = GET_TIME();
+    double e1 = GET_TIME();
+    double e2;
     switch (driver_to_use) {
         case DRIVER_QUARTZ_OLD:
         {
@@ -419,12 +399,11 @@ BOOL driver_handle_button_event(driver_button_event_t *event) {
 
             e2 = GET_TIME();
 
-            if ([[Config instance] debugEnabled]) {
-                LOG(@"%s:BUTTON: pos.x: %d, pos.y: %d, time: %f",
-                    driverString,
-                    (int)event->pos.x,
-                    (int)event->pos.y,
-                    (e2-e1));
+            if (config->debugEnabled) {
+                TRACE(TRACE_EVENT_DRIVER_BUTTON_QUARTZ_OLD,
+                      (int)event->pos.x,
+                      (int)event->pos.y,
+                      TRACE_TIME(e2-e1));
             }
 
             break;
@@ -438,15 +417,13 @@ BOOL driver_handle_button_event(driver_button_event_t *event) {
 
             e2 = GET_TIME();
 
-            if ([[Config instance] debugEnabled]) {
-                LOG(@"%s:BUTTON: eventType: %s(%d), pos: %dx%d, csv: %d, time: %f",
-                    driverString,
-                    driver_quartz_event_type_to_string(event->type),
-                    (int)event->type,
-                    (int)event->pos.x,
-                    (int)event->pos.y,
-                    clickStateValue,
-                    (e2-e1));
+            if (config->debugEnabled) {
+                TRACE(TRACE_EVENT_DRIVER_BUTTON_QUARTZ,
+                      (int)event->type,
+                      (int)event->pos.x,
+                      (int)event->pos.y,
+                      clickStateValue,
+                      TRACE_TIME(e2-e1));
             }
             break;
         }
@@ -494,7 +471,7 @@ BOOL driver_handle_button_event(driver_button_event_t *event) {
             NXEventData eventData;
             kern_return_t result;
 
-            if ([[Config instance] debugEnabled]) {
+            if (config->debugEnabled) {
                 LOG(@"%s:BUTTON: Sending AUX mouse button event", driverString);
             }
 
@@ -534,8 +511,8 @@ BOOL driver_handle_button_event(driver_button_event_t *event) {
             if (is_down_event) eventNumber++;
 
             UInt8 subType = NX_SUBTYPE_DEFAULT;
-            if ([[Config instance ] activeAppRequiresTabletPointSubtype]) {
-                if ([[Config instance] debugEnabled]) {
+            if (config->activeAppRequiresTabletPointSubtype) {
+                if (config->debugEnabled) {
                     LOG(@"Setting subType to TABLET_POINT");
                 }
                 subType = NX_SUBTYPE_TABLET_POINT;
@@ -562,19 +539,17 @@ BOOL driver_handle_button_event(driver_button_event_t *event) {
 
             e2 = GET_TIME();
 
-            if ([[Config instance] debugEnabled]) {
-                LOG(@"%s:BUTTON: eventType: %s(%d), pos: %dx%d, subt: %d, click: %d, pressure: %d, eventNumber: %d, buttonNumber: %d, time: %f",
-                    driverString,
-                    driver_iohid_event_type_to_string(iohidEventType),
-                    (int)iohidEventType,
-                    (int)newPoint.x,
-                    (int)newPoint.y,
-                    (int)eventData.mouse.subType,
-                    (int)eventData.mouse.click,
-                    (int)eventData.mouse.pressure,
-                    (int)eventData.mouse.eventNum,
-                    (int)eventData.mouse.buttonNumber,
-                    (e2-e1));
+            if (config->debugEnabled) {
+                TRACE(TRACE_EVENT_DRIVER_BUTTON_IOHID,
+                      (int)iohidEventType,
+                      (int)newPoint.x,
+                      (int)newPoint.y,
+                      (int)eventData.mouse.subType,
+                      (int)eventData.mouse.click,
+                      (int)eventData.mouse.pressure,
+                      (int)eventData.mouse.eventNum,
+                      (int)eventData.mouse.buttonNumber,
+                      TRACE_TIME(e2-e1));
             }
 
             break;
@@ -586,17 +561,6 @@ BOOL driver_handle_button_event(driver_button_event_t *event) {
         }
     }
 
-    e2 = GET_TIME();
-
     return YES;
 }
 
-const char *driver_get_driver_string(int driver) {
-    switch (driver) {
-        case DRIVER_QUARTZ_OLD: return "QUARTZ_OLD";
-        case DRIVER_QUARTZ: return "QUARTZ";
-        case DRIVER_IOHID: return "IOHID";
-        default: return "?";
-    }
-}
-
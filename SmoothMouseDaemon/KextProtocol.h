@@ -2,6 +2,8 @@
 
 #include <stdint.h>
 
+// devices of a type that is not enabled are left to the system, kConfigureMethod
+// may be called again while connected, e.g. to pause for an excluded app
 #define KEXT_CONF_MOUSE_ENABLED     (1 << 0)
 #define KEXT_CONF_TRACKPAD_ENABLED  (1 << 1)
 #define KEXT_CONF_QUARTZ_OLD        (1 << 2)
@@ -19,6 +21,10 @@ typedef struct mouse_event_s {
 	int dy;
     uint64_t timestamp;
     uint64_t seqnum;
+    // identifies the device among those of the same type, 0 if unknown.
+    // Kexts older than this field send the event without the last 8 bytes.
+    uint32_t device_id;
+    uint32_t reserved;
 } mouse_event_t;
 
 enum {
@@ -26,3 +32,66 @@ enum {
     kNumberOfMethods
 };
 
+
+/*
+ Event ring, the successor of the IODataQueue. The kext maps it as memory
+ type KEXT_EVENT_RING_MEMORY_TYPE and fills it once it is configured with
+ KEXT_CONF_EVENT_RING, kexts without it fail to map that type and keep using
+ the IODataQueue (kIODefaultMemoryType).
+
+ The ring is a header followed by num_records records of record_size bytes,
+ every record carries the events of one report or interrupt. The producer
+ fills the record at producer_index and then increments it, the consumer reads
+ the records in place up to producer_index and increments consumer_index when
+ it is done with a record. Indices count records and wrap, num_records is a
+ power of two. Both sides own one cache line of the header.
+
+ Before the consumer sleeps it sets consumer_waiting and checks the indices
+ again; the producer sends a notification to the port registered for the ring
+ memory type only if consumer_waiting is set after it published a record, and
+ clears it. Events that do not fit into the ring are dropped by the producer
+ and counted in dropped.
+
+ The events of a record follow each other every event_size bytes, which may
+ be more than sizeof(mouse_event_t) if the producer is newer. Rings of minor
+ version 0 leave event_size 0, their events are the 40 bytes of mouse_event_t.
+
+ A consumer accepts a ring with a different version only if the magic and
+ major version match and the events are at least as large as its own.
+ */
+
+#define KEXT_CONF_EVENT_RING        (1 << 3)
+
+#define KEXT_EVENT_RING_MEMORY_TYPE (1)
+#define KEXT_EVENT_RING_MAGIC       (0x534d5247) // "SMRG"
+#define KEXT_EVENT_RING_VERSION     (0x00010001) // major 1, minor 1
+#define KEXT_EVENT_RING_MAX_EVENTS  (8)          // per record
+#define KEXT_EVENT_RING_V1_0_EVENT_SIZE (40)     // rings without event_size
+
+typedef struct event_ring_record_s {
+    uint32_t num_events;
+    uint32_t reserved;
+    // laid out for this side's event size, the other side's may differ (see
+    // event_ring_event())
+    mouse_event_t events[KEXT_EVENT_RING_MAX_EVENTS];
+} event_ring_record_t;
+
+typedef struct event_ring_header_s {
+    // written by the producer before the ring is mapped
+    uint32_t magic;
+    uint32_t version;
+    uint32_t header_size;       // offset of the first record
+    uint32_t record_size;
+    uint32_t num_records;
+    uint32_t max_events;        // per record
+    uint32_t event_size;        // distance of the events in a record
+    uint8_t pad0[36];
+    // producer
+    volatile uint32_t producer_index;
+    volatile uint32_t dropped;
+    uint8_t pad1[56];
+    // consumer
+    volatile uint32_t consumer_index;
+    volatile uint32_t consumer_waiting;
+    uint8_t pad2[56];
+} event_ring_header_t;
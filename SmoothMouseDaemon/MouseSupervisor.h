@@ -1,10 +1,10 @@
 
 #import <Foundation/Foundation.h>
 
-#include <queue>
+#include "movering.h"
 
 @interface MouseSupervisor : NSObject {
-    std::queue<int> moveEvents;
+    move_ring_t moveEvents;
     int clickEvents;
     int clickEventsZeroLevel;
 }
@@ -16,6 +16,7 @@
 - (void) pushClickEvent;
 - (void) popClickEvent;
 - (int) numMoveEvents;
+- (uint64_t) numDroppedMoveEvents;
 - (BOOL) hasClickEvents;
 - (int) numClickEvents;
 - (void) resetClickEvents;
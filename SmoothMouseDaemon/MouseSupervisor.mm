@@ -6,6 +6,7 @@
 
 MouseSupervisor *sMouseSupervisor;
 
+// only protects the click counters, moves go through a lock free ring
 static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 
 @implementation MouseSupervisor
@@ -14,64 +15,31 @@ static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 {
     self = [super init];
     if (self) {
+        move_ring_init(&moveEvents);
         clickEvents = 0;
         clickEventsZeroLevel = 0;
     }
     return self;
 }
 
+// DriverEventThread
 - (void) pushMoveEvent: (int) deltaX : (int) deltaY {
-    pthread_mutex_lock(&mutex);
-    moveEvents.push(deltaX);
-    moveEvents.push(deltaY);
-    //LOG(@"SUPERVISOR: Pushed %d, %d", deltaX, deltaY);
-    pthread_mutex_unlock(&mutex);
+    // if the listener is behind and the ring is full the move is dropped, it
+    // is still part of the sums so later events that include it will match
+    move_ring_push(&moveEvents, deltaX, deltaY);
 }
 
+// main thread (MouseEventListener)
 - (BOOL) popMoveEvent: (int) deltaX :(int)deltaY {
-    int storedDeltaSumX = 0;
-    int storedDeltaSumY = 0;
-    //LOG(@"SUPERVISOR: Searching for %d %d", deltaX, deltaY);
-    pthread_mutex_lock(&mutex);
-    while (!moveEvents.empty()) {
-        int storedDeltaX = moveEvents.front();
-        moveEvents.pop();
-        int storedDeltaY = moveEvents.front();
-        moveEvents.pop();
-
-        storedDeltaSumX += storedDeltaX;
-        storedDeltaSumY += storedDeltaY;
-
-        //NSLog(@"searching for %d %d: storedDeltaSumX: %d, storedDeltaSumY: %d",
-        //      deltaX, deltaY, storedDeltaSumX, storedDeltaSumY);
-
-        if (storedDeltaSumX == deltaX && storedDeltaSumY == deltaY) {
-            //NSLog(@"Equal!");
-            pthread_mutex_unlock(&mutex);
-            return YES;
-        } else {
-            // either means that another app generated an event
-            // or that mouse coalescing is enabled
-            // UPDATE: Damn, we still have coalescing in normal use case. For example
-            //         if we try to move a window. So I have to remove this log for now.
-            //LOG(@"WARNING: Tampering detected or coalescing enabled (%d != %d, %d != %d)",
-            //    deltaX, storedDeltaSumX, deltaY, storedDeltaSumY);
-        }
-    }
-
-    //NSLog(@"no more");
-
-    pthread_mutex_unlock(&mutex);
-
-    return NO;
+    // no match means that either another app generated an event or that the
+    // window server merged our events with one that was not ours, coalescing
+    // of our own events alone still matches
+    return move_ring_match(&moveEvents, deltaX, deltaY);
 }
 
+// main thread
 - (void) clearMoveEvents {
-    pthread_mutex_lock(&mutex);
-    while (!moveEvents.empty()) {
-        moveEvents.pop();
-    }
-    pthread_mutex_unlock(&mutex);
+    move_ring_clear(&moveEvents);
 }
 
 - (void) pushClickEvent {
@@ -87,11 +55,11 @@ static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 }
 
 - (int) numMoveEvents {
-    int s;
-    pthread_mutex_lock(&mutex);
-    s = (int) moveEvents.size();
-    pthread_mutex_unlock(&mutex);
-    return s;
+    return move_ring_size(&moveEvents);
+}
+
+- (uint64_t) numDroppedMoveEvents {
+    return move_ring_dropped(&moveEvents);
 }
 
 - (BOOL) hasClickEvents {
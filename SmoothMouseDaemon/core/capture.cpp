@@ -0,0 +1,355 @@
+#include "capture.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CAPTURE_BUFFER_SIZE (64 * 1024)
+
+static const char capture_magic[4] = { 'S', 'M', 'C', 'P' };
+
+struct capture_file_s {
+    FILE *fp;
+    char *buffer;
+    BOOL ok;
+    int version;
+    uint64_t lastTimestamp;
+    uint64_t lastSeqnum;
+};
+
+static void put_u8(uint8_t *buf, size_t *len, uint8_t value) {
+    buf[(*len)++] = value;
+}
+
+static void put_le(uint8_t *buf, size_t *len, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        buf[(*len)++] = (uint8_t)(value >> (i * 8));
+    }
+}
+
+static void put_varint(uint8_t *buf, size_t *len, uint64_t value) {
+    while (value >= 0x80) {
+        buf[(*len)++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    buf[(*len)++] = (uint8_t)value;
+}
+
+static void put_signed(uint8_t *buf, size_t *len, int64_t value) {
+    put_varint(buf, len, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+static BOOL get_le(FILE *fp, uint64_t *value, int bytes) {
+    uint8_t buf[8];
+    if (fread(buf, 1, bytes, fp) != (size_t)bytes) {
+        return NO;
+    }
+    *value = 0;
+    for (int i = 0; i < bytes; i++) {
+        *value |= (uint64_t)buf[i] << (i * 8);
+    }
+    return YES;
+}
+
+static BOOL get_varint(FILE *fp, uint64_t *value) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int c = fgetc(fp);
+        if (c == EOF) {
+            return NO;
+        }
+        *value |= (uint64_t)(c & 0x7f) << shift;
+        if ((c & 0x80) == 0) {
+            return YES;
+        }
+    }
+    return NO;
+}
+
+static BOOL get_signed(FILE *fp, int64_t *value) {
+    uint64_t encoded;
+    if (!get_varint(fp, &encoded)) {
+        return NO;
+    }
+    *value = (int64_t)(encoded >> 1) ^ -(int64_t)(encoded & 1);
+    return YES;
+}
+
+static uint64_t double_bits(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static double bits_double(uint64_t bits) {
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+void capture_settings_init(capture_settings_t *settings) {
+    memset(settings, 0, sizeof(capture_settings_t));
+}
+
+BOOL capture_curve_file_load(capture_curve_file_t *file, const char *path) {
+    file->data = NULL;
+    file->size = 0;
+
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return NO;
+    }
+
+    char *data = (char *)malloc(CAPTURE_MAX_CURVE_FILE_SIZE + 1);
+    size_t size = (data != NULL) ? fread(data, 1, CAPTURE_MAX_CURVE_FILE_SIZE + 1, fp) : 0;
+    BOOL ok = (data != NULL && !ferror(fp) && size <= CAPTURE_MAX_CURVE_FILE_SIZE);
+    fclose(fp);
+
+    if (!ok) {
+        free(data);
+        return NO;
+    }
+
+    file->data = data;
+    file->size = (uint32_t)size;
+    return YES;
+}
+
+void capture_settings_cleanup(capture_settings_t *settings) {
+    free(settings->mouseCurveFile.data);
+    settings->mouseCurveFile.data = NULL;
+    settings->mouseCurveFile.size = 0;
+    free(settings->trackpadCurveFile.data);
+    settings->trackpadCurveFile.data = NULL;
+    settings->trackpadCurveFile.size = 0;
+}
+
+static BOOL put_curve_file(FILE *fp, const capture_curve_file_t *file) {
+    uint8_t size[4];
+    size_t len = 0;
+    uint32_t fileSize = (file->data != NULL) ? file->size : 0;
+    put_le(size, &len, fileSize, 4);
+    return (fwrite(size, 1, len, fp) == len &&
+            (fileSize == 0 || fwrite(file->data, 1, fileSize, fp) == fileSize));
+}
+
+static BOOL get_double(FILE *fp, double *value) {
+    uint64_t bits;
+    if (!get_le(fp, &bits, 8)) {
+        return NO;
+    }
+    *value = bits_double(bits);
+    return YES;
+}
+
+static BOOL get_curve_file(FILE *fp, capture_curve_file_t *file) {
+    uint64_t size;
+    if (!get_le(fp, &size, 4) || size > CAPTURE_MAX_CURVE_FILE_SIZE) {
+        return NO;
+    }
+    if (size == 0) {
+        return YES;
+    }
+    file->data = (char *)malloc(size);
+    if (file->data == NULL || fread(file->data, 1, size, fp) != size) {
+        return NO;
+    }
+    file->size = (uint32_t)size;
+    return YES;
+}
+
+static capture_file_t *capture_alloc(FILE *fp) {
+    capture_file_t *file = (capture_file_t *)calloc(1, sizeof(capture_file_t));
+    if (file == NULL) {
+        fclose(fp);
+        return NULL;
+    }
+    file->fp = fp;
+    file->ok = YES;
+    file->version = CAPTURE_VERSION;
+    file->buffer = (char *)malloc(CAPTURE_BUFFER_SIZE);
+    if (file->buffer != NULL) {
+        setvbuf(fp, file->buffer, _IOFBF, CAPTURE_BUFFER_SIZE);
+    }
+    return file;
+}
+
+capture_file_t *capture_create(const char *path, const capture_settings_t *settings) {
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) {
+        return NULL;
+    }
+
+    capture_file_t *file = capture_alloc(fp);
+    if (file == NULL) {
+        return NULL;
+    }
+
+    uint8_t header[64];
+    size_t len = 0;
+    memcpy(header, capture_magic, sizeof(capture_magic));
+    len += sizeof(capture_magic);
+    put_le(header, &len, CAPTURE_VERSION, 2);
+    put_le(header, &len, 0, 2);
+    put_u8(header, &len, (uint8_t)settings->mouseCurve);
+    put_le(header, &len, double_bits(settings->mouseVelocity), 8);
+    put_u8(header, &len, (uint8_t)settings->trackpadCurve);
+    put_le(header, &len, double_bits(settings->trackpadVelocity), 8);
+    put_le(header, &len, (uint32_t)(int32_t)settings->startPos.x, 4);
+    put_le(header, &len, (uint32_t)(int32_t)settings->startPos.y, 4);
+
+    uint8_t mouse[16];
+    size_t mouseLen = 0;
+    put_le(mouse, &mouseLen, double_bits(settings->mouseTimeBasedDpi), 8);
+    put_le(mouse, &mouseLen, double_bits(settings->mouseResolution), 8);
+
+    uint8_t trackpad[16];
+    size_t trackpadLen = 0;
+    put_le(trackpad, &trackpadLen, double_bits(settings->trackpadTimeBasedDpi), 8);
+    put_le(trackpad, &trackpadLen, double_bits(settings->trackpadResolution), 8);
+
+    uint8_t screen[24];
+    size_t screenLen = 0;
+    put_le(screen, &screenLen, double_bits(settings->screenResolution), 8);
+    put_le(screen, &screenLen, double_bits(settings->screenRefreshRate), 8);
+    put_le(screen, &screenLen, double_bits(settings->coalescingInterval), 8);
+
+    if (fwrite(header, 1, len, fp) != len ||
+        fwrite(mouse, 1, mouseLen, fp) != mouseLen ||
+        !put_curve_file(fp, &settings->mouseCurveFile) ||
+        fwrite(trackpad, 1, trackpadLen, fp) != trackpadLen ||
+        !put_curve_file(fp, &settings->trackpadCurveFile) ||
+        fwrite(screen, 1, screenLen, fp) != screenLen) {
+        capture_close(file);
+        return NULL;
+    }
+
+    return file;
+}
+
+capture_file_t *capture_open(const char *path, capture_settings_t *settings) {
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return NULL;
+    }
+
+    capture_file_t *file = capture_alloc(fp);
+    if (file == NULL) {
+        return NULL;
+    }
+
+    char magic[sizeof(capture_magic)];
+    uint64_t version, reserved, mouseCurve, mouseVelocity, trackpadCurve, trackpadVelocity, x, y;
+
+    if (fread(magic, 1, sizeof(magic), fp) != sizeof(magic) ||
+        memcmp(magic, capture_magic, sizeof(magic)) != 0 ||
+        !get_le(fp, &version, 2) ||
+        version < 1 || version > CAPTURE_VERSION ||
+        !get_le(fp, &reserved, 2) ||
+        !get_le(fp, &mouseCurve, 1) ||
+        !get_le(fp, &mouseVelocity, 8) ||
+        !get_le(fp, &trackpadCurve, 1) ||
+        !get_le(fp, &trackpadVelocity, 8) ||
+        !get_le(fp, &x, 4) ||
+        !get_le(fp, &y, 4)) {
+        capture_close(file);
+        return NULL;
+    }
+
+    capture_settings_init(settings);
+    if (version >= 3 &&
+        (!get_double(fp, &settings->mouseTimeBasedDpi) ||
+         !get_double(fp, &settings->mouseResolution) ||
+         !get_curve_file(fp, &settings->mouseCurveFile) ||
+         !get_double(fp, &settings->trackpadTimeBasedDpi) ||
+         !get_double(fp, &settings->trackpadResolution) ||
+         !get_curve_file(fp, &settings->trackpadCurveFile) ||
+         !get_double(fp, &settings->screenResolution) ||
+         !get_double(fp, &settings->screenRefreshRate) ||
+         !get_double(fp, &settings->coalescingInterval))) {
+        capture_settings_cleanup(settings);
+        capture_close(file);
+        return NULL;
+    }
+
+    settings->mouseCurve = (AccelerationCurve)mouseCurve;
+    settings->mouseVelocity = bits_double(mouseVelocity);
+    settings->trackpadCurve = (AccelerationCurve)trackpadCurve;
+    settings->trackpadVelocity = bits_double(trackpadVelocity);
+    settings->startPos.x = (int32_t)(uint32_t)x;
+    settings->startPos.y = (int32_t)(uint32_t)y;
+    file->version = (int)version;
+
+    return file;
+}
+
+BOOL capture_write_event(capture_file_t *file, const mouse_event_t *event) {
+    uint8_t buf[64];
+    size_t len = 0;
+
+    put_u8(buf, &len, (uint8_t)event->device_type);
+    put_signed(buf, &len, event->buttons);
+    put_signed(buf, &len, event->dx);
+    put_signed(buf, &len, event->dy);
+    put_signed(buf, &len, (int64_t)(event->timestamp - file->lastTimestamp));
+    put_signed(buf, &len, (int64_t)(event->seqnum - file->lastSeqnum));
+    put_signed(buf, &len, event->device_id);
+
+    file->lastTimestamp = event->timestamp;
+    file->lastSeqnum = event->seqnum;
+
+    if (fwrite(buf, 1, len, file->fp) != len) {
+        file->ok = NO;
+    }
+
+    return file->ok;
+}
+
+BOOL capture_read_event(capture_file_t *file, mouse_event_t *event) {
+    int deviceType = fgetc(file->fp);
+    if (deviceType == EOF) {
+        if (ferror(file->fp)) {
+            file->ok = NO;
+        }
+        return NO;
+    }
+
+    int64_t buttons, dx, dy, timestampDelta, seqnumDelta;
+    int64_t deviceId = 0;
+    if (!get_signed(file->fp, &buttons) ||
+        !get_signed(file->fp, &dx) ||
+        !get_signed(file->fp, &dy) ||
+        !get_signed(file->fp, &timestampDelta) ||
+        !get_signed(file->fp, &seqnumDelta) ||
+        (file->version >= 2 && !get_signed(file->fp, &deviceId))) {
+        file->ok = NO;
+        return NO;
+    }
+
+    file->lastTimestamp += (uint64_t)timestampDelta;
+    file->lastSeqnum += (uint64_t)seqnumDelta;
+
+    event->device_type = (device_type_t)deviceType;
+    event->buttons = (int)buttons;
+    event->dx = (int)dx;
+    event->dy = (int)dy;
+    event->timestamp = file->lastTimestamp;
+    event->seqnum = file->lastSeqnum;
+    event->device_id = (uint32_t)deviceId;
+    event->reserved = 0;
+
+    return YES;
+}
+
+BOOL capture_ok(capture_file_t *file) {
+    return file->ok;
+}
+
+void capture_close(capture_file_t *file) {
+    if (file == NULL) {
+        return;
+    }
+    fclose(file->fp);
+    free(file->buffer);
+    free(file);
+}
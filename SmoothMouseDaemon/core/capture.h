@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "platform.h"
+#include "KextProtocol.h"
+#include "pipeline.h"
+
+/*
+ Capture files hold the raw events received from the kext (before button
+ remapping) together with the settings that were active when the capture was
+ started, so that SmoothMouseReplay can feed them through the same pipeline
+ again. Events are stored as variable length integers with timestamp and
+ sequence number stored as deltas, a typical event takes 6-8 bytes instead of
+ sizeof(mouse_event_t).
+
+ header: "SMCP", version (u16), reserved (u16),
+         mouse curve (u8), mouse velocity (f64),
+         trackpad curve (u8), trackpad velocity (f64),
+         start position x, y (i32),
+         for the mouse, then the trackpad: time based dpi (f64),
+           device resolution (f64), curve file size (u32), curve file
+         screen resolution (f64), screen refresh rate (f64),
+         coalescing interval (f64)
+ event:  device type (u8), buttons, dx, dy, timestamp delta, seqnum delta,
+         device id (all zigzag varints)
+
+ All fixed size fields are little endian. Version 1 files have no device id,
+ their events are read with device id 0. Versions 1 and 2 end the header
+ after the start position, the settings after it are read as 0 (the curve's
+ defaults) and without curve files.
+ */
+
+#define CAPTURE_VERSION (3)
+
+// the custom curve files are stored as they are, with a sanity limit
+#define CAPTURE_MAX_CURVE_FILE_SIZE (1024 * 1024)
+
+typedef struct capture_curve_file_s {
+    char *data;     // NULL without a custom curve
+    uint32_t size;
+} capture_curve_file_t;
+
+typedef struct capture_settings_s {
+    AccelerationCurve mouseCurve;
+    double mouseVelocity;
+    AccelerationCurve trackpadCurve;
+    double trackpadVelocity;
+    CGPoint startPos;
+    // see pipeline_curve_use_timestamps(), 0 for the gain per report
+    double mouseTimeBasedDpi;
+    double trackpadTimeBasedDpi;
+    // see pipeline_curve_set_resolution(), 0 for the defaults
+    double mouseResolution;
+    double trackpadResolution;
+    double screenResolution;
+    double screenRefreshRate;
+    // in milliseconds, see pipeline_pacer_t
+    double coalescingInterval;
+    capture_curve_file_t mouseCurveFile;
+    capture_curve_file_t trackpadCurveFile;
+} capture_settings_t;
+
+// clears everything, the fields of older versions included
+void capture_settings_init(capture_settings_t *settings);
+// returns NO if the file can not be read or is too large, the curve file is
+// empty then
+BOOL capture_curve_file_load(capture_curve_file_t *file, const char *path);
+// frees the curve files read by capture_open() or loaded above
+void capture_settings_cleanup(capture_settings_t *settings);
+
+typedef struct capture_file_s capture_file_t;
+
+capture_file_t *capture_create(const char *path, const capture_settings_t *settings);
+// the settings have to be cleaned up with capture_settings_cleanup() if the
+// file could be opened
+capture_file_t *capture_open(const char *path, capture_settings_t *settings);
+BOOL capture_write_event(capture_file_t *file, const mouse_event_t *event);
+// returns NO at the end of the file
+BOOL capture_read_event(capture_file_t *file, mouse_event_t *event);
+// returns NO if the file ended in the middle of an event or could not be read
+BOOL capture_ok(capture_file_t *file);
+void capture_close(capture_file_t *file);
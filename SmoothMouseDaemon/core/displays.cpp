@@ -0,0 +1,119 @@
+#include "displays.h"
+
+#include <string.h>
+
+// same as CGRectContainsPoint(), the right and bottom edges are not part of
+// the rect
+static int rect_contains(const CGRect *rect, CGPoint pos) {
+    return (pos.x >= rect->origin.x &&
+            pos.x < rect->origin.x + rect->size.width &&
+            pos.y >= rect->origin.y &&
+            pos.y < rect->origin.y + rect->size.height);
+}
+
+static CGPoint rect_clamp(const CGRect *rect, CGPoint pos) {
+    if (pos.x < rect->origin.x) {
+        pos.x = rect->origin.x;
+    } else if (pos.x > rect->origin.x + rect->size.width - 1) {
+        pos.x = rect->origin.x + rect->size.width - 1;
+    }
+    if (pos.y < rect->origin.y) {
+        pos.y = rect->origin.y;
+    } else if (pos.y > rect->origin.y + rect->size.height - 1) {
+        pos.y = rect->origin.y + rect->size.height - 1;
+    }
+    return pos;
+}
+
+static CGFloat distance_squared(CGPoint a, CGPoint b) {
+    CGFloat dx = a.x - b.x;
+    CGFloat dy = a.y - b.y;
+    return dx * dx + dy * dy;
+}
+
+static int find_display(const display_index_t *index, CGPoint pos) {
+    for (uint32_t i = 0; i < index->count; i++) {
+        if (rect_contains(&index->bounds[i], pos)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static CGPoint restrict_to_displays(const display_index_t *index, CGPoint lastPos, CGPoint newPos) {
+    if (index->count == 0 || find_display(index, newPos) != -1) {
+        return newPos;
+    }
+
+    int display = find_display(index, lastPos);
+    if (display != -1) {
+        return rect_clamp(&index->bounds[display], newPos);
+    }
+
+    CGPoint nearest = rect_clamp(&index->bounds[0], newPos);
+    CGFloat nearestDistance = distance_squared(nearest, newPos);
+    for (uint32_t i = 1; i < index->count; i++) {
+        CGPoint clamped = rect_clamp(&index->bounds[i], newPos);
+        CGFloat distance = distance_squared(clamped, newPos);
+        if (distance < nearestDistance) {
+            nearest = clamped;
+            nearestDistance = distance;
+        }
+    }
+    return nearest;
+}
+
+void display_index_init(display_index_t *index) {
+    index->sequence = 0;
+    index->count = 0;
+}
+
+void display_index_update(display_index_t *index, const CGRect *bounds, uint32_t count) {
+    if (count > DISPLAY_INDEX_MAX_DISPLAYS) {
+        count = DISPLAY_INDEX_MAX_DISPLAYS;
+    }
+
+    index->sequence++;
+    __sync_synchronize();
+    memcpy(index->bounds, bounds, count * sizeof(CGRect));
+    index->count = count;
+    __sync_synchronize();
+    index->sequence++;
+}
+
+// copies the layout, retrying while it is being updated
+static void display_index_read(display_index_t *index, display_index_t *copy) {
+    for (;;) {
+        uint32_t sequence = index->sequence;
+        __sync_synchronize();
+        if ((sequence & 1) == 0) {
+            copy->count = index->count;
+            if (copy->count > DISPLAY_INDEX_MAX_DISPLAYS) {
+                copy->count = DISPLAY_INDEX_MAX_DISPLAYS;
+            }
+            memcpy(copy->bounds, index->bounds, copy->count * sizeof(CGRect));
+            __sync_synchronize();
+            if (index->sequence == sequence) {
+                return;
+            }
+        }
+    }
+}
+
+uint32_t display_index_count(display_index_t *index) {
+    display_index_t copy;
+    display_index_read(index, &copy);
+    return copy.count;
+}
+
+int display_index_find(display_index_t *index, CGPoint pos) {
+    display_index_t copy;
+    display_index_read(index, &copy);
+    return find_display(&copy, pos);
+}
+
+CGPoint display_index_restrict(display_index_t *index, CGPoint lastPos, CGPoint newPos) {
+    display_index_t copy;
+    display_index_read(index, &copy);
+    return restrict_to_displays(&copy, lastPos, newPos);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "platform.h"
+
+/*
+ Local copy of the display layout, so that keeping the cursor on screen does
+ not need a round trip to the window server for every move event. The layout
+ is replaced by display_index_update() whenever the display configuration
+ changes, readers on other threads never block and retry if they raced with
+ an update (sequence lock).
+ */
+
+#define DISPLAY_INDEX_MAX_DISPLAYS (32)
+
+typedef struct display_index_s {
+    volatile uint32_t sequence; // odd while an update is in progress
+    uint32_t count;
+    CGRect bounds[DISPLAY_INDEX_MAX_DISPLAYS];
+} display_index_t;
+
+void display_index_init(display_index_t *index);
+
+// only one thread may update the index at a time
+void display_index_update(display_index_t *index, const CGRect *bounds, uint32_t count);
+
+uint32_t display_index_count(display_index_t *index);
+
+// returns the index of the first display that contains pos, or -1
+int display_index_find(display_index_t *index, CGPoint pos);
+
+/*
+ Returns newPos if it is on a display. Otherwise it is clamped to the display
+ lastPos is on, or to the display nearest to newPos if lastPos is not on any
+ display either (the layout changed). Without any displays newPos is returned
+ unchanged.
+ */
+CGPoint display_index_restrict(display_index_t *index, CGPoint lastPos, CGPoint newPos);
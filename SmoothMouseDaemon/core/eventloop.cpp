@@ -0,0 +1,421 @@
+#include "eventloop.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#else
+#include <sys/types.h>
+#include <sys/event.h>
+#include <sys/time.h>
+#endif
+
+#define EVENT_LOOP_STOP_SOURCE (EVENT_LOOP_MAX_SOURCES) // internal signal source
+
+typedef enum event_loop_source_type_e {
+    EVENT_LOOP_SOURCE_FD,
+    EVENT_LOOP_SOURCE_SIGNAL,
+    EVENT_LOOP_SOURCE_TIMER,
+    EVENT_LOOP_SOURCE_UNIX_SIGNAL
+} event_loop_source_type_t;
+
+typedef struct event_loop_source_s {
+    event_loop_source_type_t type;
+    int fd;     // the caller's fd, or on Linux the eventfd / timerfd
+    int signum; // unix signal sources only
+    event_loop_callback_t callback;
+    void *context;
+} event_loop_source_t;
+
+struct event_loop_s {
+    int pollFd;     // epoll or kqueue
+#ifdef __linux__
+    int stopFd;
+#endif
+    volatile int stopped;
+    uint64_t numWakeups;
+    int numSources;
+    event_loop_source_t sources[EVENT_LOOP_MAX_SOURCES];
+};
+
+static int event_loop_new_source(event_loop_t *loop, event_loop_source_type_t type, int fd,
+                                 event_loop_callback_t callback, void *context) {
+    if (loop->numSources == EVENT_LOOP_MAX_SOURCES) {
+        errno = ENOSPC;
+        return -1;
+    }
+    int index = loop->numSources;
+    event_loop_source_t *source = &loop->sources[index];
+    source->type = type;
+    source->fd = fd;
+    source->signum = -1;
+    source->callback = callback;
+    source->context = context;
+    return index;
+}
+
+static BOOL event_loop_valid_source(event_loop_t *loop, int index, event_loop_source_type_t type) {
+    if (index < 0 || index >= loop->numSources || loop->sources[index].type != type) {
+        errno = EINVAL;
+        return NO;
+    }
+    return YES;
+}
+
+#ifdef __linux__
+
+// the eventfd of the unix signal source of every signal, -1 if none
+static volatile int signal_fds[NSIG];
+static BOOL signal_fds_initialized = NO;
+
+static void event_loop_signal_handler(int signum) {
+    int error = errno;
+    uint64_t one = 1;
+    int fd = signal_fds[signum];
+    if (fd != -1) {
+        (void) write(fd, &one, sizeof(one));
+    }
+    errno = error;
+}
+
+static BOOL event_loop_watch(event_loop_t *loop, int fd, uint32_t index) {
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.u32 = index;
+    return epoll_ctl(loop->pollFd, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+event_loop_t *event_loop_create() {
+    event_loop_t *loop = (event_loop_t *) calloc(1, sizeof(event_loop_t));
+    if (loop == NULL) {
+        return NULL;
+    }
+    loop->pollFd = epoll_create1(EPOLL_CLOEXEC);
+    loop->stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (loop->pollFd == -1 || loop->stopFd == -1 || !event_loop_watch(loop, loop->stopFd, EVENT_LOOP_STOP_SOURCE)) {
+        int error = errno;
+        event_loop_destroy(loop);
+        errno = error;
+        return NULL;
+    }
+    return loop;
+}
+
+void event_loop_destroy(event_loop_t *loop) {
+    for (int i = 0; i < loop->numSources; i++) {
+        if (loop->sources[i].type == EVENT_LOOP_SOURCE_UNIX_SIGNAL) {
+            signal(loop->sources[i].signum, SIG_DFL);
+            signal_fds[loop->sources[i].signum] = -1;
+        }
+        if (loop->sources[i].type != EVENT_LOOP_SOURCE_FD) {
+            close(loop->sources[i].fd);
+        }
+    }
+    if (loop->stopFd != -1) {
+        close(loop->stopFd);
+    }
+    if (loop->pollFd != -1) {
+        close(loop->pollFd);
+    }
+    free(loop);
+}
+
+static int event_loop_add(event_loop_t *loop, event_loop_source_type_t type, int fd,
+                          event_loop_callback_t callback, void *context) {
+    int index = event_loop_new_source(loop, type, fd, callback, context);
+    if (index == -1 || !event_loop_watch(loop, fd, index)) {
+        int error = errno;
+        if (type != EVENT_LOOP_SOURCE_FD) {
+            close(fd);
+        }
+        errno = error;
+        return -1;
+    }
+    loop->numSources++;
+    return index;
+}
+
+int event_loop_add_fd(event_loop_t *loop, int fd, event_loop_callback_t callback, void *context) {
+    return event_loop_add(loop, EVENT_LOOP_SOURCE_FD, fd, callback, context);
+}
+
+int event_loop_add_signal(event_loop_t *loop, event_loop_callback_t callback, void *context) {
+    int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd == -1) {
+        return -1;
+    }
+    return event_loop_add(loop, EVENT_LOOP_SOURCE_SIGNAL, fd, callback, context);
+}
+
+int event_loop_add_timer(event_loop_t *loop, event_loop_callback_t callback, void *context) {
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd == -1) {
+        return -1;
+    }
+    return event_loop_add(loop, EVENT_LOOP_SOURCE_TIMER, fd, callback, context);
+}
+
+int event_loop_add_unix_signal(event_loop_t *loop, int signum, event_loop_callback_t callback, void *context) {
+    if (signum <= 0 || signum >= NSIG) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!signal_fds_initialized) {
+        for (int i = 0; i < NSIG; i++) {
+            signal_fds[i] = -1;
+        }
+        signal_fds_initialized = YES;
+    }
+    int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd == -1) {
+        return -1;
+    }
+    int index = event_loop_add(loop, EVENT_LOOP_SOURCE_UNIX_SIGNAL, fd, callback, context);
+    if (index == -1) {
+        return -1;
+    }
+    loop->sources[index].signum = signum;
+    signal_fds[signum] = fd;
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = event_loop_signal_handler;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(signum, &action, NULL) == -1) {
+        return -1;
+    }
+    return index;
+}
+
+BOOL event_loop_signal(event_loop_t *loop, int source) {
+    if (!event_loop_valid_source(loop, source, EVENT_LOOP_SOURCE_SIGNAL)) {
+        return NO;
+    }
+    uint64_t one = 1;
+    // EAGAIN only if the counter is about to overflow, it is signalled then
+    return write(loop->sources[source].fd, &one, sizeof(one)) == sizeof(one) || errno == EAGAIN;
+}
+
+static BOOL event_loop_set_timer(event_loop_t *loop, int source, uint64_t delay) {
+    if (!event_loop_valid_source(loop, source, EVENT_LOOP_SOURCE_TIMER)) {
+        return NO;
+    }
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_sec = delay / 1000000000ull;
+    spec.it_value.tv_nsec = delay % 1000000000ull;
+    return timerfd_settime(loop->sources[source].fd, 0, &spec, NULL) == 0;
+}
+
+BOOL event_loop_arm_timer(event_loop_t *loop, int source, uint64_t delay) {
+    // a zero it_value disarms the timer, expire right away instead
+    return event_loop_set_timer(loop, source, delay > 0 ? delay : 1);
+}
+
+BOOL event_loop_disarm_timer(event_loop_t *loop, int source) {
+    return event_loop_set_timer(loop, source, 0);
+}
+
+int event_loop_run_once(event_loop_t *loop, int timeout) {
+    if (loop->stopped) {
+        return -1;
+    }
+
+    struct epoll_event ready[EVENT_LOOP_MAX_SOURCES + 1];
+    int numReady = epoll_wait(loop->pollFd, ready, EVENT_LOOP_MAX_SOURCES + 1, timeout);
+    if (numReady == -1) {
+        return (errno == EINTR ? 0 : -1);
+    }
+    loop->numWakeups++;
+
+    int numCallbacks = 0;
+    for (int i = 0; i < numReady && !loop->stopped; i++) {
+        uint32_t index = ready[i].data.u32;
+        if (index == EVENT_LOOP_STOP_SOURCE) {
+            continue;
+        }
+        event_loop_source_t *source = &loop->sources[index];
+        if (source->type != EVENT_LOOP_SOURCE_FD) {
+            // resets the signal counter or the timer expirations, a timer
+            // that was re-armed by an earlier callback has nothing to read
+            uint64_t value;
+            if (read(source->fd, &value, sizeof(value)) != sizeof(value)) {
+                continue;
+            }
+        }
+        source->callback(loop, source->context);
+        numCallbacks++;
+    }
+
+    return loop->stopped ? -1 : numCallbacks;
+}
+
+void event_loop_stop(event_loop_t *loop) {
+    loop->stopped = 1;
+    uint64_t one = 1;
+    (void) write(loop->stopFd, &one, sizeof(one));
+}
+
+#else
+
+event_loop_t *event_loop_create() {
+    event_loop_t *loop = (event_loop_t *) calloc(1, sizeof(event_loop_t));
+    if (loop == NULL) {
+        return NULL;
+    }
+    loop->pollFd = kqueue();
+    struct kevent change;
+    EV_SET(&change, EVENT_LOOP_STOP_SOURCE, EVFILT_USER, EV_ADD | EV_CLEAR, 0, 0, NULL);
+    if (loop->pollFd == -1 || kevent(loop->pollFd, &change, 1, NULL, 0, NULL) == -1) {
+        int error = errno;
+        event_loop_destroy(loop);
+        errno = error;
+        return NULL;
+    }
+    return loop;
+}
+
+void event_loop_destroy(event_loop_t *loop) {
+    if (loop->pollFd != -1) {
+        close(loop->pollFd);
+    }
+    free(loop);
+}
+
+static int event_loop_add(event_loop_t *loop, event_loop_source_type_t type, int fd, int16_t filter,
+                          event_loop_callback_t callback, void *context) {
+    int index = event_loop_new_source(loop, type, fd, callback, context);
+    if (index == -1) {
+        return -1;
+    }
+    // timers are only added to the kqueue when they are armed
+    if (type != EVENT_LOOP_SOURCE_TIMER) {
+        // user events are identified by the index, fds by themselves and
+        // level triggered like with epoll
+        struct kevent change;
+        uintptr_t ident = (type == EVENT_LOOP_SOURCE_FD || type == EVENT_LOOP_SOURCE_UNIX_SIGNAL ? (uintptr_t) fd : (uintptr_t) index);
+        uint16_t flags = EV_ADD | (type != EVENT_LOOP_SOURCE_FD ? EV_CLEAR : 0);
+        EV_SET(&change, ident, filter, flags, 0, 0, (void *) (intptr_t) index);
+        if (kevent(loop->pollFd, &change, 1, NULL, 0, NULL) == -1) {
+            return -1;
+        }
+    }
+    loop->numSources++;
+    return index;
+}
+
+int event_loop_add_fd(event_loop_t *loop, int fd, event_loop_callback_t callback, void *context) {
+    return event_loop_add(loop, EVENT_LOOP_SOURCE_FD, fd, EVFILT_READ, callback, context);
+}
+
+int event_loop_add_signal(event_loop_t *loop, event_loop_callback_t callback, void *context) {
+    return event_loop_add(loop, EVENT_LOOP_SOURCE_SIGNAL, -1, EVFILT_USER, callback, context);
+}
+
+int event_loop_add_timer(event_loop_t *loop, event_loop_callback_t callback, void *context) {
+    return event_loop_add(loop, EVENT_LOOP_SOURCE_TIMER, -1, EVFILT_TIMER, callback, context);
+}
+
+int event_loop_add_unix_signal(event_loop_t *loop, int signum, event_loop_callback_t callback, void *context) {
+    // kqueue still sees signals that are ignored, which keeps the default
+    // action (and any handler) from running
+    int index = event_loop_add(loop, EVENT_LOOP_SOURCE_UNIX_SIGNAL, signum, EVFILT_SIGNAL, callback, context);
+    if (index == -1) {
+        return -1;
+    }
+    loop->sources[index].signum = signum;
+    signal(signum, SIG_IGN);
+    return index;
+}
+
+BOOL event_loop_signal(event_loop_t *loop, int source) {
+    if (!event_loop_valid_source(loop, source, EVENT_LOOP_SOURCE_SIGNAL)) {
+        return NO;
+    }
+    struct kevent change;
+    EV_SET(&change, source, EVFILT_USER, 0, NOTE_TRIGGER, 0, (void *) (intptr_t) source);
+    return kevent(loop->pollFd, &change, 1, NULL, 0, NULL) == 0;
+}
+
+BOOL event_loop_arm_timer(event_loop_t *loop, int source, uint64_t delay) {
+    if (!event_loop_valid_source(loop, source, EVENT_LOOP_SOURCE_TIMER)) {
+        return NO;
+    }
+    // adding a timer that exists replaces it
+    struct kevent change;
+    EV_SET(&change, source, EVFILT_TIMER, EV_ADD | EV_ONESHOT, NOTE_NSECONDS, (intptr_t) delay, (void *) (intptr_t) source);
+    return kevent(loop->pollFd, &change, 1, NULL, 0, NULL) == 0;
+}
+
+BOOL event_loop_disarm_timer(event_loop_t *loop, int source) {
+    if (!event_loop_valid_source(loop, source, EVENT_LOOP_SOURCE_TIMER)) {
+        return NO;
+    }
+    struct kevent change;
+    EV_SET(&change, source, EVFILT_TIMER, EV_DELETE, 0, 0, NULL);
+    // ENOENT if it was not armed or already expired
+    return kevent(loop->pollFd, &change, 1, NULL, 0, NULL) == 0 || errno == ENOENT;
+}
+
+int event_loop_run_once(event_loop_t *loop, int timeout) {
+    if (loop->stopped) {
+        return -1;
+    }
+
+    struct timespec ts;
+    ts.tv_sec = timeout / 1000;
+    ts.tv_nsec = (timeout % 1000) * 1000000;
+
+    struct kevent ready[EVENT_LOOP_MAX_SOURCES + 1];
+    int numReady = kevent(loop->pollFd, NULL, 0, ready, EVENT_LOOP_MAX_SOURCES + 1, timeout < 0 ? NULL : &ts);
+    if (numReady == -1) {
+        return (errno == EINTR ? 0 : -1);
+    }
+    loop->numWakeups++;
+
+    int numCallbacks = 0;
+    for (int i = 0; i < numReady && !loop->stopped; i++) {
+        if (ready[i].flags & EV_ERROR) {
+            continue;
+        }
+        int index = (int) (intptr_t) ready[i].udata;
+        if (ready[i].filter == EVFILT_USER && ready[i].ident == EVENT_LOOP_STOP_SOURCE) {
+            continue;
+        }
+        event_loop_source_t *source = &loop->sources[index];
+        source->callback(loop, source->context);
+        numCallbacks++;
+    }
+
+    return loop->stopped ? -1 : numCallbacks;
+}
+
+void event_loop_stop(event_loop_t *loop) {
+    loop->stopped = 1;
+    struct kevent change;
+    EV_SET(&change, EVENT_LOOP_STOP_SOURCE, EVFILT_USER, 0, NOTE_TRIGGER, 0, NULL);
+    (void) kevent(loop->pollFd, &change, 1, NULL, 0, NULL);
+}
+
+#endif
+
+BOOL event_loop_run(event_loop_t *loop) {
+    while (!loop->stopped) {
+        if (event_loop_run_once(loop, -1) == -1 && !loop->stopped) {
+            return NO;
+        }
+    }
+    return YES;
+}
+
+uint64_t event_loop_num_wakeups(const event_loop_t *loop) {
+    return loop->numWakeups;
+}
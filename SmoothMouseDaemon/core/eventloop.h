@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "platform.h"
+
+/*
+ A single threaded event loop that only wakes up when something happened:
+ one of its file descriptors became readable, another thread (or a signal
+ handler) signalled it, or a timer it armed expired. It has no periodic
+ wakeups of its own.
+
+ On Linux it is built on epoll, with an eventfd per signal source and a
+ timerfd per timer, elsewhere (OS X) on kqueue with EVFILT_USER,
+ EVFILT_TIMER and EVFILT_SIGNAL. Callbacks run on the thread that runs the loop, one source at
+ a time.
+
+ Signals are level triggered until the callback ran: signalling a source
+ several times before its callback runs calls it once. Timers are one-shot
+ and can be re-armed (which replaces the previous expiry) or disarmed at any
+ time from the loop's thread.
+ */
+
+#define EVENT_LOOP_MAX_SOURCES (32)
+
+typedef struct event_loop_s event_loop_t;
+typedef void (*event_loop_callback_t)(event_loop_t *loop, void *context);
+
+// returns NULL and sets errno on failure
+event_loop_t *event_loop_create();
+void event_loop_destroy(event_loop_t *loop);
+
+/*
+ Sources are identified by the returned index, -1 on failure (errno is set).
+ The file descriptor of an fd source stays owned by the caller and must stay
+ open while the loop exists.
+ */
+int event_loop_add_fd(event_loop_t *loop, int fd, event_loop_callback_t callback, void *context);
+int event_loop_add_signal(event_loop_t *loop, event_loop_callback_t callback, void *context);
+int event_loop_add_timer(event_loop_t *loop, event_loop_callback_t callback, void *context);
+
+/*
+ Calls callback on the loop's thread after the process received signum, so
+ the callback is not restricted to async-signal-safe functions. It replaces
+ any handler of signum (kqueue EVFILT_SIGNAL with the signal ignored on OS X,
+ a handler that signals an eventfd on Linux). Only one loop can take a signal.
+ */
+int event_loop_add_unix_signal(event_loop_t *loop, int signum, event_loop_callback_t callback, void *context);
+
+// any thread, and on Linux also from signal handlers
+BOOL event_loop_signal(event_loop_t *loop, int source);
+
+// loop thread only, delay in nanoseconds
+BOOL event_loop_arm_timer(event_loop_t *loop, int source, uint64_t delay);
+BOOL event_loop_disarm_timer(event_loop_t *loop, int source);
+
+/*
+ Waits up to timeout milliseconds (-1 forever) and runs the callbacks of the
+ sources that are ready. Returns the number of callbacks run, -1 on error or
+ if the loop was stopped.
+ */
+int event_loop_run_once(event_loop_t *loop, int timeout);
+
+// runs callbacks until event_loop_stop(), returns NO on error
+BOOL event_loop_run(event_loop_t *loop);
+
+// any thread, makes event_loop_run() return after the current callback
+void event_loop_stop(event_loop_t *loop);
+
+// number of times the loop woke up, for checking it stays idle
+uint64_t event_loop_num_wakeups(const event_loop_t *loop);
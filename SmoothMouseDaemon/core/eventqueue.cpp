@@ -0,0 +1,209 @@
+#include "eventqueue.h"
+
+#include <sched.h>
+#include <time.h>
+
+#include "latency.h"
+
+typedef enum {
+    EVENT_SLOT_FREE,
+    EVENT_SLOT_READY,
+    EVENT_SLOT_TAKEN,
+    EVENT_SLOT_COALESCING
+} event_slot_state_t;
+
+static BOOL is_move_event(const driver_event_t *event) {
+    return (event->id == DRIVER_EVENT_ID_MOVE);
+}
+
+static event_queue_slot_t *event_queue_slot(event_queue_t *queue, uint32_t index) {
+    return &queue->slots[index & (EVENT_QUEUE_SIZE - 1)];
+}
+
+static void event_queue_signal(event_queue_t *queue) {
+#ifdef __APPLE__
+    semaphore_signal(queue->dataAvailable);
+#else
+    sem_post(&queue->dataAvailable);
+#endif
+}
+
+static void event_queue_wait(event_queue_t *queue) {
+#ifdef __APPLE__
+    semaphore_wait(queue->dataAvailable);
+#else
+    while (sem_wait(&queue->dataAvailable) != 0) {
+        // interrupted
+    }
+#endif
+}
+
+static void event_queue_timedwait(event_queue_t *queue, uint64_t nanos) {
+#ifdef __APPLE__
+    mach_timespec_t timeout = { (unsigned int)(nanos / 1000000000ULL), (clock_res_t)(nanos % 1000000000ULL) };
+    semaphore_timedwait(queue->dataAvailable, timeout);
+#else
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    uint64_t total = (uint64_t)deadline.tv_nsec + nanos;
+    deadline.tv_sec += (time_t)(total / 1000000000ULL);
+    deadline.tv_nsec = (long)(total % 1000000000ULL);
+    sem_timedwait(&queue->dataAvailable, &deadline);
+#endif
+}
+
+BOOL event_queue_init(event_queue_t *queue) {
+#ifdef __APPLE__
+    if (semaphore_create(mach_task_self(), &queue->dataAvailable, SYNC_POLICY_FIFO, 0) != KERN_SUCCESS) {
+        return NO;
+    }
+#else
+    if (sem_init(&queue->dataAvailable, 0, 0) != 0) {
+        return NO;
+    }
+#endif
+    event_queue_reset(queue);
+    return YES;
+}
+
+void event_queue_destroy(event_queue_t *queue) {
+#ifdef __APPLE__
+    semaphore_destroy(mach_task_self(), queue->dataAvailable);
+#else
+    sem_destroy(&queue->dataAvailable);
+#endif
+}
+
+void event_queue_reset(event_queue_t *queue) {
+    for (int i = 0; i < EVENT_QUEUE_SIZE; i++) {
+        queue->slots[i].state = EVENT_SLOT_FREE;
+    }
+    queue->writeIndex = 0;
+    queue->readIndex = 0;
+    queue->consumerSleeping = 0;
+    queue->numCoalesced = 0;
+    queue->numFull = 0;
+    queue->numHeld = 0;
+    __sync_synchronize();
+}
+
+static BOOL event_queue_try_coalesce(event_queue_t *queue, driver_event_t *event,
+                                     event_queue_coalesce_callback_t can_coalesce, void *context) {
+    if (queue->writeIndex == 0 || !is_move_event(event)) {
+        return NO;
+    }
+
+    event_queue_slot_t *last = event_queue_slot(queue, queue->writeIndex - 1);
+
+    // the producer is the only one writing events into the slots, so the
+    // last event can be inspected without claiming the slot first
+    if (last->state != EVENT_SLOT_READY || !is_move_event(&last->event)) {
+        return NO;
+    }
+    if (can_coalesce != NULL) {
+        if (!can_coalesce(&event->move, &last->event.move, context)) {
+            return NO;
+        }
+    } else if (!pipeline_can_coalesce(&event->move, &last->event.move)) {
+        return NO;
+    }
+
+    if (!__sync_bool_compare_and_swap(&last->state, EVENT_SLOT_READY, EVENT_SLOT_COALESCING)) {
+        // consumer got there first
+        return NO;
+    }
+
+    pipeline_coalesce(&last->event, event);
+    __sync_synchronize();
+    last->state = EVENT_SLOT_READY;
+    ++queue->numCoalesced;
+
+    return YES;
+}
+
+BOOL event_queue_push(event_queue_t *queue, driver_event_t *event,
+                      event_queue_coalesce_callback_t can_coalesce, void *context) {
+    if (event_queue_try_coalesce(queue, event, can_coalesce, context)) {
+        return YES;
+    }
+
+    event_queue_slot_t *slot = event_queue_slot(queue, queue->writeIndex);
+
+    if (slot->state != EVENT_SLOT_FREE) {
+        ++queue->numFull;
+        while (slot->state != EVENT_SLOT_FREE) {
+            sched_yield();
+        }
+    }
+
+    slot->event = *event;
+    __sync_synchronize();
+    slot->state = EVENT_SLOT_READY;
+    queue->writeIndex++;
+
+    if (__sync_bool_compare_and_swap(&queue->consumerSleeping, 1, 0)) {
+        event_queue_signal(queue);
+    }
+
+    return NO;
+}
+
+// returns YES if the move in the ready slot at the read index should stay in
+// the ring for now, it may be taken at release then
+static BOOL event_queue_hold_move(event_queue_t *queue, event_queue_slot_t *slot, pipeline_pacer_t *pacer,
+                                  uint64_t *now, uint64_t *release) {
+    // the producer does not change the kind of event in a slot it coalesces
+    // into, and it only ever coalesces into the last slot
+    if (pacer->interval == 0 ||
+        !is_move_event(&slot->event) ||
+        event_queue_slot(queue, queue->readIndex + 1)->state != EVENT_SLOT_FREE) {
+        return NO;
+    }
+    *now = latency_now();
+    *release = pipeline_pacer_release_time(pacer, *now);
+    return (*release > *now);
+}
+
+void event_queue_pop(event_queue_t *queue, driver_event_t *event, pipeline_pacer_t *pacer) {
+    BOOL held = NO;
+
+    for (;;) {
+        event_queue_slot_t *slot = event_queue_slot(queue, queue->readIndex);
+        int32_t state = slot->state;
+        uint64_t now, release;
+
+        if (state == EVENT_SLOT_READY && event_queue_hold_move(queue, slot, pacer, &now, &release)) {
+            if (!held) {
+                held = YES;
+                ++queue->numHeld;
+            }
+            __sync_bool_compare_and_swap(&queue->consumerSleeping, 0, 1);
+            if (event_queue_slot(queue, queue->readIndex + 1)->state == EVENT_SLOT_FREE) {
+                event_queue_timedwait(queue, latency_to_nanos(release - now));
+            }
+            __sync_bool_compare_and_swap(&queue->consumerSleeping, 1, 0);
+        } else if (state == EVENT_SLOT_READY) {
+            if (__sync_bool_compare_and_swap(&slot->state, EVENT_SLOT_READY, EVENT_SLOT_TAKEN)) {
+                *event = slot->event;
+                __sync_synchronize();
+                slot->state = EVENT_SLOT_FREE;
+                queue->readIndex++;
+                if (is_move_event(event)) {
+                    pipeline_pacer_passed_on(pacer, latency_now());
+                }
+                return;
+            }
+        } else if (state == EVENT_SLOT_COALESCING) {
+            // producer is updating the slot, this only takes a few instructions
+            continue;
+        } else {
+            // empty, announce that we go to sleep and check again before
+            // actually doing so, the producer might have posted in between
+            __sync_bool_compare_and_swap(&queue->consumerSleeping, 0, 1);
+            if (slot->state == EVENT_SLOT_FREE) {
+                event_queue_wait(queue);
+            }
+            __sync_bool_compare_and_swap(&queue->consumerSleeping, 1, 0);
+        }
+    }
+}
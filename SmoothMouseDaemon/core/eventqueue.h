@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __APPLE__
+#include <mach/mach.h>
+#else
+#include <semaphore.h>
+#endif
+
+#include "platform.h"
+#include "Driver.h"
+#include "pipeline.h"
+
+/*
+ Driver events are passed from the KernelEventThread (the only producer) to
+ the DriverEventThread (the only consumer) through a fixed size ring. Each slot
+ carries its own state, which is what allows the producer to coalesce a new
+ move event into the last posted one as long as the consumer has not claimed
+ it yet. The consumer only sleeps on the semaphore when the ring is empty, so
+ the producer only has to signal it on the empty to non-empty transition.
+
+ With a coalescing interval (see pipeline_pacer_t) the consumer also leaves a
+ move in the ring until the interval since the previous move is over, so the
+ producer keeps merging into it. It sleeps on the semaphore with a timeout
+ then, and a new slot being posted behind the move wakes it up early.
+
+ The semaphore is a Mach semaphore on OS X and a POSIX one elsewhere (tests
+ and benchmarks on Linux).
+ */
+
+#define EVENT_QUEUE_SIZE        (1024) // must be a power of two
+#define EVENT_QUEUE_CACHE_LINE  (64)
+
+typedef struct event_queue_slot_s {
+    volatile int32_t state;
+    driver_event_t event;
+} event_queue_slot_t;
+
+typedef struct event_queue_s {
+    event_queue_slot_t slots[EVENT_QUEUE_SIZE] __attribute__((aligned(EVENT_QUEUE_CACHE_LINE)));
+    uint32_t writeIndex __attribute__((aligned(EVENT_QUEUE_CACHE_LINE)));    // producer only
+    int numCoalesced;   // moves merged into the last slot
+    int numFull;        // times the producer had to wait for a free slot
+    uint32_t readIndex __attribute__((aligned(EVENT_QUEUE_CACHE_LINE)));     // consumer only
+    int numHeld;        // moves held back for the coalescing interval
+    volatile int32_t consumerSleeping __attribute__((aligned(EVENT_QUEUE_CACHE_LINE)));
+#ifdef __APPLE__
+    semaphore_t dataAvailable;
+#else
+    sem_t dataAvailable;
+#endif
+} event_queue_t;
+
+// called by the producer with the new move and the one in the last slot,
+// returns YES if they may be merged
+typedef BOOL (*event_queue_coalesce_callback_t)(const driver_move_event_t *event, const driver_move_event_t *last, void *context);
+
+// returns NO if the semaphore could not be created
+BOOL event_queue_init(event_queue_t *queue);
+void event_queue_destroy(event_queue_t *queue);
+
+// empties the queue and clears the counters, neither side may be running
+void event_queue_reset(event_queue_t *queue);
+
+/*
+ Producer. Merges a move into the last posted one if the consumer has not
+ taken it yet and can_coalesce (pipeline_can_coalesce() if NULL) agrees,
+ otherwise posts it into the next slot, waiting for the consumer if the ring
+ is full. Returns YES if the event was merged.
+ */
+BOOL event_queue_push(event_queue_t *queue, driver_event_t *event,
+                      event_queue_coalesce_callback_t can_coalesce, void *context);
+
+// consumer, waits for the next event, moves are paced by pacer
+void event_queue_pop(event_queue_t *queue, driver_event_t *event, pipeline_pacer_t *pacer);
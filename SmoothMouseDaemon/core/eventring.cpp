@@ -0,0 +1,166 @@
+#include "eventring.h"
+
+#include <string.h>
+
+#define EVENT_RING_MAJOR(version) ((version) >> 16)
+
+size_t event_ring_size(uint32_t numRecords) {
+    return sizeof(event_ring_header_t) + (size_t) numRecords * sizeof(event_ring_record_t);
+}
+
+static uint32_t event_ring_event_size(const event_ring_header_t *header) {
+    return (header->event_size != 0) ? header->event_size : KEXT_EVENT_RING_V1_0_EVENT_SIZE;
+}
+
+static void event_ring_setup(event_ring_t *ring, void *memory) {
+    ring->header = (event_ring_header_t *) memory;
+    ring->records = (uint8_t *) memory + ring->header->header_size;
+    ring->mask = ring->header->num_records - 1;
+    ring->recordSize = ring->header->record_size;
+    ring->maxEvents = ring->header->max_events;
+    ring->eventSize = event_ring_event_size(ring->header);
+    ring->open = NULL;
+}
+
+static event_ring_record_t *event_ring_record(event_ring_t *ring, uint32_t index) {
+    return (event_ring_record_t *) (ring->records + (size_t) (index & ring->mask) * ring->recordSize);
+}
+
+BOOL event_ring_create(event_ring_t *ring, void *memory, size_t size, uint32_t numRecords) {
+    if (numRecords == 0 || (numRecords & (numRecords - 1)) != 0 || size < event_ring_size(numRecords)) {
+        return NO;
+    }
+
+    memset(memory, 0, event_ring_size(numRecords));
+
+    event_ring_header_t *header = (event_ring_header_t *) memory;
+    header->magic = KEXT_EVENT_RING_MAGIC;
+    header->version = KEXT_EVENT_RING_VERSION;
+    header->header_size = sizeof(event_ring_header_t);
+    header->record_size = sizeof(event_ring_record_t);
+    header->num_records = numRecords;
+    header->max_events = KEXT_EVENT_RING_MAX_EVENTS;
+    header->event_size = sizeof(mouse_event_t);
+
+    event_ring_setup(ring, memory);
+    return YES;
+}
+
+BOOL event_ring_attach(event_ring_t *ring, void *memory, size_t size) {
+    if (memory == NULL || size < sizeof(event_ring_header_t)) {
+        return NO;
+    }
+
+    const event_ring_header_t *header = (const event_ring_header_t *) memory;
+    if (header->magic != KEXT_EVENT_RING_MAGIC ||
+        EVENT_RING_MAJOR(header->version) != EVENT_RING_MAJOR(KEXT_EVENT_RING_VERSION)) {
+        return NO;
+    }
+
+    // the events are read in place, each has to hold all of ours and be
+    // aligned like them
+    uint32_t eventSize = event_ring_event_size(header);
+    if (eventSize < sizeof(mouse_event_t) || eventSize % sizeof(uint64_t) != 0) {
+        return NO;
+    }
+
+    uint32_t numRecords = header->num_records;
+    if (header->header_size < sizeof(event_ring_header_t) ||
+        header->header_size % sizeof(uint64_t) != 0 ||
+        header->max_events == 0 ||
+        header->record_size < offsetof(event_ring_record_t, events) + (size_t) header->max_events * eventSize ||
+        header->record_size % sizeof(uint64_t) != 0 ||
+        numRecords == 0 || (numRecords & (numRecords - 1)) != 0 ||
+        size < header->header_size + (size_t) numRecords * header->record_size) {
+        return NO;
+    }
+
+    event_ring_setup(ring, memory);
+    return YES;
+}
+
+event_ring_record_t *event_ring_peek(event_ring_t *ring) {
+    uint32_t index = ring->header->consumer_index;
+    if (index == ring->header->producer_index) {
+        return NULL;
+    }
+    // the record is read after the index that published it
+    __sync_synchronize();
+    return event_ring_record(ring, index);
+}
+
+void event_ring_consume(event_ring_t *ring) {
+    // done reading the record before the producer may reuse it
+    __sync_synchronize();
+    ring->header->consumer_index++;
+}
+
+uint32_t event_ring_num_events(const event_ring_t *ring, const event_ring_record_t *record) {
+    uint32_t numEvents = record->num_events;
+    return numEvents < ring->maxEvents ? numEvents : ring->maxEvents;
+}
+
+mouse_event_t *event_ring_event(const event_ring_t *ring, event_ring_record_t *record, uint32_t index) {
+    return (mouse_event_t *) ((uint8_t *) record->events + (size_t) index * ring->eventSize);
+}
+
+BOOL event_ring_begin_wait(event_ring_t *ring) {
+    ring->header->consumer_waiting = 1;
+    // the producer reads the flag after publishing, we read the index after
+    // setting it, so one of us sees the other
+    __sync_synchronize();
+    if (ring->header->consumer_index != ring->header->producer_index) {
+        ring->header->consumer_waiting = 0;
+        return NO;
+    }
+    return YES;
+}
+
+void event_ring_end_wait(event_ring_t *ring) {
+    ring->header->consumer_waiting = 0;
+}
+
+BOOL event_ring_push(event_ring_t *ring, const mouse_event_t *event) {
+    if (ring->open == NULL) {
+        uint32_t index = ring->header->producer_index;
+        if (index - ring->header->consumer_index > ring->mask) {
+            ring->header->dropped++;
+            return NO;
+        }
+        // the consumer is done with the record before we overwrite it
+        __sync_synchronize();
+        ring->open = event_ring_record(ring, index);
+        ring->open->num_events = 0;
+    }
+
+    *event_ring_event(ring, ring->open, ring->open->num_events++) = *event;
+
+    if (ring->open->num_events == ring->maxEvents) {
+        // the record is full, the consumer is notified with the last one
+        // published by event_ring_publish()
+        ring->open = NULL;
+        __sync_synchronize();
+        ring->header->producer_index++;
+    }
+
+    return YES;
+}
+
+BOOL event_ring_publish(event_ring_t *ring) {
+    if (ring->open != NULL) {
+        ring->open = NULL;
+        __sync_synchronize();
+        ring->header->producer_index++;
+    }
+
+    __sync_synchronize();
+    if (ring->header->consumer_waiting) {
+        ring->header->consumer_waiting = 0;
+        return YES;
+    }
+    return NO;
+}
+
+uint32_t event_ring_dropped(const event_ring_t *ring) {
+    return ring->header->dropped;
+}
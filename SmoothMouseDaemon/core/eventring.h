@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "platform.h"
+#include "KextProtocol.h"
+
+/*
+ Both sides of the event ring described in KextProtocol.h. The consumer side
+ is used by the KernelEventThread, the producer side by the kext simulator
+ (SmoothMouseKextSim) and is what the kext implements.
+
+ There is one producer and one consumer and neither of them blocks: the
+ producer fills the record in the ring directly and the consumer reads it
+ there.
+ */
+
+typedef struct event_ring_s {
+    event_ring_header_t *header;
+    uint8_t *records;
+    uint32_t mask;
+    uint32_t recordSize;
+    uint32_t maxEvents;
+    uint32_t eventSize;
+    // producer only, the record being filled or NULL
+    event_ring_record_t *open;
+} event_ring_t;
+
+// bytes needed for a ring of numRecords records
+size_t event_ring_size(uint32_t numRecords);
+
+// producer, numRecords must be a power of two
+BOOL event_ring_create(event_ring_t *ring, void *memory, size_t size, uint32_t numRecords);
+
+// consumer, returns NO if the memory does not hold a ring it understands
+BOOL event_ring_attach(event_ring_t *ring, void *memory, size_t size);
+
+/*
+ Consumer. Returns the oldest unconsumed record or NULL if there is none, the
+ record belongs to the consumer (which may modify its events in place) until
+ event_ring_consume().
+ */
+event_ring_record_t *event_ring_peek(event_ring_t *ring);
+void event_ring_consume(event_ring_t *ring);
+
+// number of events in a record, never more than fit into the ring's records
+uint32_t event_ring_num_events(const event_ring_t *ring, const event_ring_record_t *record);
+// event index of a record, events are event_size bytes apart in the ring
+mouse_event_t *event_ring_event(const event_ring_t *ring, event_ring_record_t *record, uint32_t index);
+
+/*
+ Consumer, before it sleeps. Returns NO if a record was published meanwhile,
+ in which case the consumer must not sleep. After the wakeup (or without
+ sleeping) the flag is cleared by event_ring_end_wait().
+ */
+BOOL event_ring_begin_wait(event_ring_t *ring);
+void event_ring_end_wait(event_ring_t *ring);
+
+/*
+ Producer. Adds an event to the open record and opens one if needed, returns
+ NO if the ring is full and the event was dropped. A full record is
+ published.
+ */
+BOOL event_ring_push(event_ring_t *ring, const mouse_event_t *event);
+
+// producer, publishes the open record, returns YES if the consumer waits for
+// it and has to be notified
+BOOL event_ring_publish(event_ring_t *ring);
+
+// events the producer dropped because the ring was full
+uint32_t event_ring_dropped(const event_ring_t *ring);
@@ -0,0 +1,161 @@
+#include "latency.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __APPLE__
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+#define LATENCY_SUB_BUCKET_BITS (4)
+#define LATENCY_SUB_BUCKETS     (1 << LATENCY_SUB_BUCKET_BITS)
+#define LATENCY_NUM_BUCKETS     ((64 - LATENCY_SUB_BUCKET_BITS + 1) * LATENCY_SUB_BUCKETS)
+
+typedef struct latency_histogram_s {
+    uint64_t count;
+    uint64_t max;
+    uint64_t buckets[LATENCY_NUM_BUCKETS];
+} latency_histogram_t;
+
+static latency_histogram_t histograms[LATENCY_STAGE_NUM];
+
+#ifdef __APPLE__
+static mach_timebase_info_data_t timebase;
+#endif
+
+uint64_t latency_now() {
+#ifdef __APPLE__
+    return mach_absolute_time();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+uint64_t latency_to_nanos(uint64_t value) {
+#ifdef __APPLE__
+    if (timebase.denom == 0) {
+        mach_timebase_info(&timebase);
+    }
+    if (timebase.numer == timebase.denom) {
+        return value;
+    }
+    return value * timebase.numer / timebase.denom;
+#else
+    return value;
+#endif
+}
+
+static int latency_bucket(uint64_t value) {
+    if (value < LATENCY_SUB_BUCKETS) {
+        return (int)value;
+    }
+    int exponent = 63 - __builtin_clzll(value);
+    int shift = exponent - LATENCY_SUB_BUCKET_BITS;
+    int sub = (int)(value >> shift) - LATENCY_SUB_BUCKETS;
+    return (shift + 1) * LATENCY_SUB_BUCKETS + sub;
+}
+
+static uint64_t latency_bucket_lowest(int bucket) {
+    if (bucket < LATENCY_SUB_BUCKETS) {
+        return bucket;
+    }
+    int shift = bucket / LATENCY_SUB_BUCKETS - 1;
+    uint64_t sub = bucket % LATENCY_SUB_BUCKETS;
+    return (LATENCY_SUB_BUCKETS + sub) << shift;
+}
+
+static uint64_t latency_bucket_highest(int bucket) {
+    if (bucket + 1 >= LATENCY_NUM_BUCKETS) {
+        return UINT64_MAX;
+    }
+    return latency_bucket_lowest(bucket + 1) - 1;
+}
+
+void latency_record(latency_stage_t stage, uint64_t start, uint64_t end) {
+    uint64_t value = latency_to_nanos(end > start ? end - start : 0);
+    latency_histogram_t *histogram = &histograms[stage];
+    histogram->buckets[latency_bucket(value)]++;
+    histogram->count++;
+    if (value > histogram->max) {
+        histogram->max = value;
+    }
+}
+
+void latency_reset() {
+    memset(histograms, 0, sizeof(histograms));
+}
+
+const char *latency_stage_name(latency_stage_t stage) {
+    switch (stage) {
+        case LATENCY_STAGE_KEXT_DEQUEUE: return "kext_dequeue";
+        case LATENCY_STAGE_MOUSE_PROCESS: return "mouse_process";
+        case LATENCY_STAGE_QUEUE_WAIT: return "queue_wait";
+        case LATENCY_STAGE_DRIVER_POST: return "driver_post";
+        default: return "?";
+    }
+}
+
+uint64_t latency_count(latency_stage_t stage) {
+    return histograms[stage].count;
+}
+
+uint64_t latency_max(latency_stage_t stage) {
+    return histograms[stage].max;
+}
+
+// returns the highest value of the bucket the percentile falls into, but
+// never more than the highest value recorded
+uint64_t latency_percentile(latency_stage_t stage, double percentile) {
+    latency_histogram_t *histogram = &histograms[stage];
+    if (histogram->count == 0) {
+        return 0;
+    }
+
+    uint64_t wanted = (uint64_t)(histogram->count * (percentile / 100.0) + 0.5);
+    if (wanted < 1) {
+        wanted = 1;
+    }
+
+    uint64_t seen = 0;
+    for (int i = 0; i < LATENCY_NUM_BUCKETS; i++) {
+        seen += histogram->buckets[i];
+        if (seen >= wanted) {
+            uint64_t highest = latency_bucket_highest(i);
+            return (highest < histogram->max) ? highest : histogram->max;
+        }
+    }
+
+    return histogram->max;
+}
+
+int latency_write(const char *path) {
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) {
+        return 0;
+    }
+
+    fprintf(fp, "# SmoothMouse latency histograms v1\n");
+    fprintf(fp, "# stage lowest_ns highest_ns count\n");
+    for (int stage = 0; stage < LATENCY_STAGE_NUM; stage++) {
+        latency_histogram_t *histogram = &histograms[stage];
+        for (int i = 0; i < LATENCY_NUM_BUCKETS; i++) {
+            if (histogram->buckets[i] != 0) {
+                fprintf(fp, "%s %llu %llu %llu\n",
+                        latency_stage_name((latency_stage_t)stage),
+                        (unsigned long long)latency_bucket_lowest(i),
+                        (unsigned long long)latency_bucket_highest(i),
+                        (unsigned long long)histogram->buckets[i]);
+            }
+        }
+    }
+
+    int ok = (ferror(fp) == 0);
+    if (fclose(fp) != 0) {
+        ok = 0;
+    }
+    return ok;
+}
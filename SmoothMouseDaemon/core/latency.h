@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ Latency histograms for the stages an event passes through on its way from
+ the kext to the window server. Values are kept in log-linear buckets (16
+ buckets per power of two, so every bucket is within 6.25% of the values it
+ holds) which covers anything from 1 ns to minutes in a fixed amount of memory.
+
+ Every stage is only recorded by a single thread, so recording is a plain
+ increment without locks or atomics. Readers may see a histogram that is
+ slightly behind, which is fine for statistics.
+ */
+
+typedef enum latency_stage_e {
+    LATENCY_STAGE_KEXT_DEQUEUE,     // KernelEventThread: IODataQueueDequeue() or taking an event ring record
+    LATENCY_STAGE_MOUSE_PROCESS,    // KernelEventThread: mouse_process_kext_event()
+    LATENCY_STAGE_QUEUE_WAIT,       // driver_post_event() until DriverEventThread picks the event up
+    LATENCY_STAGE_DRIVER_POST,      // DriverEventThread: posting the event to the window server
+    LATENCY_STAGE_NUM
+} latency_stage_t;
+
+// timestamp in the same unit as the timestamps passed to latency_record()
+uint64_t latency_now();
+// converts a difference of latency_now() values to nanoseconds
+uint64_t latency_to_nanos(uint64_t value);
+
+void latency_record(latency_stage_t stage, uint64_t start, uint64_t end);
+void latency_reset();
+
+const char *latency_stage_name(latency_stage_t stage);
+uint64_t latency_count(latency_stage_t stage);
+// all values in nanoseconds
+uint64_t latency_max(latency_stage_t stage);
+uint64_t latency_percentile(latency_stage_t stage, double percentile);
+
+// writes the non-empty buckets of all stages as text, one line per bucket:
+// <stage> <lowest ns> <highest ns> <count>
+int latency_write(const char *path);
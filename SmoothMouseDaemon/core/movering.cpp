@@ -0,0 +1,130 @@
+#include "movering.h"
+
+#include <string.h>
+
+void move_ring_init(move_ring_t *ring) {
+    memset(ring, 0, sizeof(move_ring_t));
+}
+
+BOOL move_ring_push(move_ring_t *ring, int dx, int dy) {
+    uint64_t head = ring->head;
+    BOOL stored = (head - ring->tail < MOVE_RING_SIZE);
+
+    ring->sequence++;
+    __sync_synchronize();
+
+    ring->seq++;
+    ring->sumX += dx;
+    ring->sumY += dy;
+
+    if (stored) {
+        move_ring_entry_t *entry = &ring->entries[head & (MOVE_RING_SIZE - 1)];
+        entry->seq = ring->seq - 1;
+        entry->dx = dx;
+        entry->dy = dy;
+        entry->sumX = ring->sumX;
+        entry->sumY = ring->sumY;
+        ring->head = head + 1;
+    } else {
+        ring->dropped++;
+    }
+
+    __sync_synchronize();
+    ring->sequence++;
+
+    return stored;
+}
+
+// head, the number of moves pushed and their running sums, including dropped
+// ones
+static void move_ring_snapshot(move_ring_t *ring, uint64_t *head, uint64_t *seq, int64_t *sumX, int64_t *sumY) {
+    uint32_t sequence;
+    do {
+        sequence = ring->sequence;
+        __sync_synchronize();
+        *head = ring->head;
+        *seq = ring->seq;
+        *sumX = ring->sumX;
+        *sumY = ring->sumY;
+        __sync_synchronize();
+    } while ((sequence & 1) || sequence != ring->sequence);
+}
+
+static void move_ring_consume(move_ring_t *ring, uint64_t index, uint64_t seq, int64_t sumX, int64_t sumY) {
+    ring->matchedSeq = seq;
+    ring->matchedX = sumX;
+    ring->matchedY = sumY;
+
+    // the entries must have been read before the pushing thread may reuse them
+    __sync_synchronize();
+    ring->tail = index;
+}
+
+BOOL move_ring_match(move_ring_t *ring, int dx, int dy) {
+    uint64_t tail = ring->tail;
+    uint64_t head;
+    uint64_t seq;
+    int64_t sumX;
+    int64_t sumY;
+    move_ring_snapshot(ring, &head, &seq, &sumX, &sumY);
+
+    int64_t wantX = ring->matchedX + dx;
+    int64_t wantY = ring->matchedY + dy;
+
+    // number of moves consumed before entry i
+    uint64_t consumed = ring->matchedSeq;
+    for (uint64_t i = tail; i < head; i++) {
+        const move_ring_entry_t *entry = &ring->entries[i & (MOVE_RING_SIZE - 1)];
+        if (entry->seq - consumed > 1) {
+            // moves were dropped before this entry and the event ends at one
+            // of them, which can not be checked, it is taken to end at the
+            // first one
+            move_ring_consume(ring, i, consumed + 1, wantX, wantY);
+            return YES;
+        }
+        if (entry->seq - consumed == 1 &&
+            entry->sumX - entry->dx == wantX && entry->sumY - entry->dy == wantY) {
+            // ends with the one move dropped before this entry
+            move_ring_consume(ring, i, entry->seq, wantX, wantY);
+            return YES;
+        }
+        if (entry->sumX == wantX && entry->sumY == wantY) {
+            move_ring_consume(ring, i + 1, entry->seq + 1, entry->sumX, entry->sumY);
+            return YES;
+        }
+        consumed = entry->seq + 1;
+    }
+
+    // the same for the moves dropped after the last entry
+    if (seq - consumed > 1) {
+        move_ring_consume(ring, head, consumed + 1, wantX, wantY);
+        return YES;
+    }
+    if (seq - consumed == 1 && sumX == wantX && sumY == wantY) {
+        move_ring_consume(ring, head, seq, sumX, sumY);
+        return YES;
+    }
+
+    // not ours, everything up to now is consumed
+    move_ring_consume(ring, head, seq, sumX, sumY);
+    return NO;
+}
+
+void move_ring_clear(move_ring_t *ring) {
+    uint64_t head;
+    uint64_t seq;
+    int64_t sumX;
+    int64_t sumY;
+    move_ring_snapshot(ring, &head, &seq, &sumX, &sumY);
+    move_ring_consume(ring, head, seq, sumX, sumY);
+}
+
+int move_ring_size(move_ring_t *ring) {
+    uint64_t tail = ring->tail;
+    uint64_t head = ring->head;
+    return (int)(head - tail);
+}
+
+uint64_t move_ring_dropped(move_ring_t *ring) {
+    return ring->dropped;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "platform.h"
+
+/*
+ Moves posted by the driver, kept until the mouse event listener sees them
+ come back from the window server. The window server may coalesce several
+ posted moves into one event, so an event matches if its delta equals the sum
+ of the deltas of the oldest unmatched moves up to some move. Every entry
+ stores the running sum of all deltas pushed so far, which turns that search
+ into a comparison per entry, and entries are consumed by the search whether
+ they match or not, so matching is O(1) amortized.
+
+ One thread pushes (DriverEventThread) and one thread matches and clears (the
+ main thread), neither of them blocks. The ring has a fixed size: when the
+ matching side falls behind, new moves are not stored but still added to the
+ running sums, which are published together with head (sequence lock). The
+ next stored entry tells from its seq that moves were dropped before it, and
+ its running sums minus its delta are the sums at the end of that gap, so an
+ event that ends at the gap, at a stored entry behind it or at the dropped
+ moves behind the last entry still matches. The events within a gap of more
+ than one move can not be checked, each of them is taken for one dropped move
+ and added to the matched sums, so an event that was not ours among them makes
+ the first checked event after them fail. When the window server merges
+ moves, fewer events than moves are taken from the gap and the checks resume
+ later than they could.
+ */
+
+#define MOVE_RING_SIZE (256) // must be a power of two
+
+typedef struct move_ring_entry_s {
+    uint64_t seq;   // number of moves pushed before this one
+    int32_t dx;
+    int32_t dy;
+    int64_t sumX;   // sum of all deltas pushed up to and including this one
+    int64_t sumY;
+} move_ring_entry_t;
+
+typedef struct move_ring_s {
+    // written by the pushing thread only
+    volatile uint32_t sequence; // odd while a push is in progress
+    volatile uint64_t head;
+    volatile uint64_t seq;
+    volatile int64_t sumX;
+    volatile int64_t sumY;
+    volatile uint64_t dropped;
+    // written by the matching thread only
+    volatile uint64_t tail;
+    uint64_t matchedSeq;    // number of moves consumed, stored or dropped
+    int64_t matchedX;       // running sums at the last consumed move
+    int64_t matchedY;
+    move_ring_entry_t entries[MOVE_RING_SIZE];
+} move_ring_t;
+
+void move_ring_init(move_ring_t *ring);
+
+// pushing thread only, returns NO if the ring was full and the move was only
+// added to the running sums
+BOOL move_ring_push(move_ring_t *ring, int dx, int dy);
+
+/*
+ Matching thread only. Consumes the oldest moves up to the first one at which
+ the summed deltas equal dx, dy and returns YES, or the oldest move if it
+ was dropped and is not the last of its gap (see above). Without such a move all moves are consumed
+ and NO is returned, the event did not come from us (or not only from us) and
+ the position is tampered with.
+ */
+BOOL move_ring_match(move_ring_t *ring, int dx, int dy);
+
+// matching thread only
+void move_ring_clear(move_ring_t *ring);
+
+// number of moves waiting to be matched
+int move_ring_size(move_ring_t *ring);
+
+// number of moves that were not stored because the ring was full
+uint64_t move_ring_dropped(move_ring_t *ring);
@@ -0,0 +1,594 @@
+#include "pipeline.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef __APPLE__
+#include <IOKit/hidsystem/IOLLEvent.h>
+#else
+// the event types of IOLLEvent.h, for naming the events of the IOHID driver
+#define NX_NULLEVENT        0
+#define NX_LMOUSEDOWN       1
+#define NX_LMOUSEUP         2
+#define NX_RMOUSEDOWN       3
+#define NX_RMOUSEUP         4
+#define NX_MOUSEMOVED       5
+#define NX_LMOUSEDRAGGED    6
+#define NX_RMOUSEDRAGGED    7
+#define NX_OMOUSEDOWN       25
+#define NX_OMOUSEUP         26
+#define NX_OMOUSEDRAGGED    27
+#endif
+
+// bounds of the interval between two moves used for the speed, reports
+// further apart than this come from a device that started moving again
+#define PIPELINE_MIN_MOVE_INTERVAL (1.0 / 8000)
+#define PIPELINE_MAX_MOVE_INTERVAL (1.0 / 50)
+// the speed is averaged over the moves of the last frame as OS X counts them
+// (67 Hz), with single reports the few counts of a fast polling mouse would
+// alternate between speeds far apart
+#define PIPELINE_SPEED_WINDOW (1.0 / 67)
+
+static void pipeline_speed_init(pipeline_speed_t *speed) {
+    speed->lastTimestamp = 0;
+    speed->head = 0;
+    speed->count = 0;
+}
+
+// same magnitude as the curves compute from the deltas
+static float pipeline_magnitude(int dx, int dy) {
+    int absdx = abs(dx);
+    int absdy = abs(dy);
+    return (absdx > absdy) ? absdx + absdy / 2.0f : absdy + absdx / 2.0f;
+}
+
+// adds a move and returns the speed in counts per second
+//
+// the speed is the distance covered over the window, not the sum of the
+// single moves: at high polling rates a diagonal move arrives as separate
+// steps on each axis, and adding those up would make it look faster than
+// the same move reported less often
+static double pipeline_speed_add(pipeline_speed_t *speed, uint64_t timestamp, int dx, int dy) {
+    // the first move after a pause is taken to have come after the longest
+    // interval, the speed is low then anyway
+    double interval = (double)(timestamp - speed->lastTimestamp) / 1.0e9;
+    if (speed->lastTimestamp == 0 || timestamp < speed->lastTimestamp || interval > PIPELINE_MAX_MOVE_INTERVAL) {
+        interval = PIPELINE_MAX_MOVE_INTERVAL;
+        speed->count = 0;
+    } else if (interval < PIPELINE_MIN_MOVE_INTERVAL) {
+        interval = PIPELINE_MIN_MOVE_INTERVAL;
+    }
+    speed->lastTimestamp = timestamp;
+
+    speed->head = (speed->head + 1) % PIPELINE_SPEED_HISTORY;
+    speed->deltasX[speed->head] = dx;
+    speed->deltasY[speed->head] = dy;
+    speed->intervals[speed->head] = (float)interval;
+    if (speed->count < PIPELINE_SPEED_HISTORY) {
+        speed->count++;
+    }
+
+    int sumX = 0;
+    int sumY = 0;
+    double sumInterval = 0;
+    int index = speed->head;
+    for (int i = 0; i < speed->count && sumInterval < PIPELINE_SPEED_WINDOW; i++) {
+        sumX += speed->deltasX[index];
+        sumY += speed->deltasY[index];
+        sumInterval += speed->intervals[index];
+        index = (index + PIPELINE_SPEED_HISTORY - 1) % PIPELINE_SPEED_HISTORY;
+    }
+
+    return pipeline_magnitude(sumX, sumY) / sumInterval;
+}
+
+void pipeline_init(pipeline_state_t *state, CGPoint pos) {
+    state->deltaPosInt = pos;
+    state->lastSequenceNumber = 0;
+    state->useCounter = 0;
+    for (int i = 0; i < PIPELINE_MAX_DEVICES; i++) {
+        state->devices[i].type = kDeviceTypeUnknown;
+    }
+}
+
+// returns the entry of the device, taking one for it if it has none
+static pipeline_device_t *pipeline_device(pipeline_state_t *state, device_type_t type, uint32_t id) {
+    pipeline_device_t *device = NULL;
+    for (int i = 0; i < PIPELINE_MAX_DEVICES; i++) {
+        pipeline_device_t *entry = &state->devices[i];
+        if (entry->type == type && entry->id == id) {
+            device = entry;
+            break;
+        }
+        if (device == NULL || (device->type != kDeviceTypeUnknown &&
+                               (entry->type == kDeviceTypeUnknown || entry->lastUsed < device->lastUsed))) {
+            device = entry;
+        }
+    }
+
+    if (device->type != type || device->id != id) {
+        device->type = type;
+        device->id = id;
+        device->curvesGeneration = 0;
+        device->remainder.x = 0;
+        device->remainder.y = 0;
+        pipeline_speed_init(&device->speed);
+    }
+    device->lastUsed = ++state->useCounter;
+
+    return device;
+}
+
+static void pipeline_curve_init(pipeline_curve_t *curve, AccelerationCurve type, double velocity, const char *deviceType, const char *curveFile) {
+    curve->curve = type;
+    curve->velocity = velocity;
+    curve->win = NULL;
+    curve->osx = NULL;
+    curve->dpi = 0;
+    curve->error[0] = '\0';
+
+    if (type == ACCELERATION_CURVE_WINDOWS) {
+        // map slider to [-5 <=> +5]
+        int slider = (int)((velocity * 4) - 6);
+        if (slider > 5) {
+            slider = 5;
+        }
+        curve->win = new WindowsFunction(slider);
+    } else if (type == ACCELERATION_CURVE_OSX) {
+        curve->osx = new OSXFunction(deviceType, (float)velocity);
+    } else if (type == ACCELERATION_CURVE_CUSTOM) {
+        if (curveFile == NULL || curveFile[0] == '\0') {
+            snprintf(curve->error, sizeof(curve->error), "no curve file set");
+        } else {
+            curve->osx = new OSXFunction(curveFile, (float)velocity);
+            if (!curve->osx->getTableError().empty()) {
+                snprintf(curve->error, sizeof(curve->error), "%s", curve->osx->getTableError().c_str());
+                delete curve->osx;
+                curve->osx = NULL;
+            }
+        }
+        if (curve->osx == NULL) {
+            curve->curve = ACCELERATION_CURVE_LINEAR;
+        }
+    }
+}
+
+static void pipeline_curve_cleanup(pipeline_curve_t *curve) {
+    if (curve->win != NULL) {
+        delete curve->win;
+        curve->win = NULL;
+    }
+    if (curve->osx != NULL) {
+        delete curve->osx;
+        curve->osx = NULL;
+    }
+}
+
+pipeline_curves_t *pipeline_curves_create(AccelerationCurve mouseCurve, double mouseVelocity, const char *mouseCurveFile,
+                                          AccelerationCurve trackpadCurve, double trackpadVelocity, const char *trackpadCurveFile) {
+    static uint32_t lastGeneration = 0;
+
+    pipeline_curves_t *curves = new pipeline_curves_t;
+    pipeline_curve_init(&curves->mouse, mouseCurve, mouseVelocity, "mouse", mouseCurveFile);
+    pipeline_curve_init(&curves->trackpad, trackpadCurve, trackpadVelocity, "touchpad", trackpadCurveFile);
+    // 0 is what devices start with
+    do {
+        curves->generation = __sync_add_and_fetch(&lastGeneration, 1);
+    } while (curves->generation == 0);
+    curves->refcount = 1;
+    return curves;
+}
+
+void pipeline_curve_use_timestamps(pipeline_curve_t *curve, double dpi) {
+    curve->dpi = dpi;
+}
+
+// checked before the conversion to int, which is undefined for huge values
+static BOOL pipeline_resolution_in_range(double value, double min, double max) {
+    return value == 0 || (value >= min && value <= max);
+}
+
+BOOL pipeline_curve_set_resolution(pipeline_curve_t *curve, double dpi, double ppi, double hz) {
+    if (!pipeline_resolution_in_range(dpi, PIPELINE_MIN_DPI, PIPELINE_MAX_DPI) ||
+        !pipeline_resolution_in_range(ppi, PIPELINE_MIN_PPI, PIPELINE_MAX_PPI) ||
+        !pipeline_resolution_in_range(hz, PIPELINE_MIN_HZ, PIPELINE_MAX_HZ)) {
+        return NO;
+    }
+    if (curve->win != NULL) {
+        curve->win->setResolutions((int)lround(dpi), (int)lround(ppi), (int)lround(hz));
+    }
+    if (curve->osx != NULL) {
+        curve->osx->setResolutions((int)lround(dpi), (int)lround(ppi), (int)lround(hz));
+    }
+    return YES;
+}
+
+void pipeline_curves_retain(pipeline_curves_t *curves) {
+    curves->refcount++;
+}
+
+void pipeline_curves_release(pipeline_curves_t *curves) {
+    if (--curves->refcount == 0) {
+        pipeline_curve_cleanup(&curves->mouse);
+        pipeline_curve_cleanup(&curves->trackpad);
+        delete curves;
+    }
+}
+
+int pipeline_remap_buttons(int buttons) {
+
+    int bl = !!(buttons & 4);
+    int bm = !!(buttons & 2);
+    int br = !!(buttons & 1);
+    int b4 = !!(buttons & 8);
+    int b5 = !!(buttons & 16);
+    int b6 = !!(buttons & 32);
+
+    int remapped = 0;
+
+    remapped |= (bl << 0);
+    remapped |= (br << 1);
+    remapped |= (bm << 2);
+    remapped |= (b4 << 3);
+    remapped |= (b5 << 4);
+    remapped |= (b6 << 5);
+
+    return remapped;
+}
+
+BOOL pipeline_check_sequence_number(pipeline_state_t *state, uint64_t seqnum, uint64_t *expected, uint64_t *lostEvents) {
+    uint64_t seqnumExpected = (state->lastSequenceNumber + 1);
+    *expected = seqnumExpected;
+    *lostEvents = (seqnum - seqnumExpected);
+    if (state->lastSequenceNumber == 0) {
+        *lostEvents = 0;
+    }
+    return (seqnum == seqnumExpected);
+}
+
+void pipeline_cursor_moved(pipeline_state_t *state, float movedX, float movedY) {
+    state->deltaPosInt.x += movedX;
+    state->deltaPosInt.y += movedY;
+}
+
+// the curve for events of the device type, NULL for an unknown type
+static pipeline_curve_t *pipeline_event_curve(pipeline_curves_t *curves, device_type_t type) {
+    switch (type) {
+        case kDeviceTypeMouse:
+            return &curves->mouse;
+        case kDeviceTypeTrackpad:
+            return &curves->trackpad;
+        default:
+            return NULL;
+    }
+}
+
+// the entry of the device of the event, with a state for the curves
+static pipeline_device_t *pipeline_event_device(pipeline_state_t *state, pipeline_curves_t *curves, pipeline_curve_t *curve, const mouse_event_t *event) {
+    pipeline_device_t *device = pipeline_device(state, event->device_type, event->device_id);
+    if (device->curvesGeneration != curves->generation) {
+        // the state of the last curves does not fit these, start over
+        device->curvesGeneration = curves->generation;
+        device->dpi = curve->dpi;
+        if (curve->win != NULL) {
+            curve->win->clearState();
+            curve->win->getState(&device->win);
+        }
+        if (curve->osx != NULL) {
+            curve->osx->clearState();
+            curve->osx->getState(&device->osx);
+        }
+    }
+    return device;
+}
+
+// adds the accelerated move to the sub pixel remainder of the device and
+// takes the whole pixels out of it
+static void pipeline_take_pixels(pipeline_state_t *state, pipeline_device_t *device, float calcdx, float calcdy, int *deltaX, int *deltaY) {
+    device->remainder.x += calcdx;
+    device->remainder.y += calcdy;
+    *deltaX = (int) device->remainder.x;
+    *deltaY = (int) device->remainder.y;
+    device->remainder.x -= *deltaX;
+    device->remainder.y -= *deltaY;
+    state->deltaPosInt.x += *deltaX;
+    state->deltaPosInt.y += *deltaY;
+}
+
+BOOL pipeline_accelerate(pipeline_state_t *state, pipeline_curves_t *curves, const mouse_event_t *event, int *deltaX, int *deltaY) {
+    pipeline_curve_t *curve = pipeline_event_curve(curves, event->device_type);
+    if (curve == NULL) {
+        return NO;
+    }
+
+    pipeline_device_t *device = pipeline_event_device(state, curves, curve, event);
+
+    float calcdx;
+    float calcdy;
+
+    if (device->dpi > 0 && (curve->win != NULL || curve->osx != NULL)) {
+        float gain = 0;
+        if (event->dx != 0 || event->dy != 0) {
+            double countsPerSecond = pipeline_speed_add(&device->speed, event->timestamp, event->dx, event->dy);
+            float speed = (float)(countsPerSecond / device->dpi);
+            gain = (curve->win != NULL) ? curve->win->gainAtSpeed(speed) : curve->osx->gainAtSpeed(speed);
+        }
+        calcdx = gain * event->dx;
+        calcdy = gain * event->dy;
+    } else if (curve->win != NULL) {
+        int newdx;
+        int newdy;
+        curve->win->setState(&device->win);
+        curve->win->apply(event->dx, event->dy, &newdx, &newdy);
+        curve->win->getState(&device->win);
+        calcdx = (float) newdx;
+        calcdy = (float) newdy;
+    } else if (curve->osx != NULL) {
+        int newdx;
+        int newdy;
+        curve->osx->setState(&device->osx);
+        curve->osx->apply(event->dx, event->dy, &newdx, &newdy);
+        curve->osx->getState(&device->osx);
+        calcdx = (float) newdx;
+        calcdy = (float) newdy;
+    }
+    else {
+        calcdx = (curve->velocity * event->dx);
+        calcdy = (curve->velocity * event->dy);
+    }
+
+    pipeline_take_pixels(state, device, calcdx, calcdy, deltaX, deltaY);
+
+    return YES;
+}
+
+static BOOL pipeline_is_move(const mouse_event_t *event) {
+    return (event->dx != 0 || event->dy != 0);
+}
+
+// the transfer functions take the deltas of a burst as 16 bit counts, which
+// is what the HID reports of a mouse carry
+static BOOL pipeline_fits_burst(const mouse_event_t *event) {
+    return (event->dx >= INT16_MIN && event->dx <= INT16_MAX &&
+            event->dy >= INT16_MIN && event->dy <= INT16_MAX);
+}
+
+BOOL pipeline_accelerate_burst(pipeline_state_t *state, pipeline_curves_t *curves, const mouse_event_t *events, size_t count, int *deltaX, int *deltaY) {
+    int16_t mickeysX[PIPELINE_BURST_CHUNK];
+    int16_t mickeysY[PIPELINE_BURST_CHUNK];
+    int pixelsX[PIPELINE_BURST_CHUNK];
+    int pixelsY[PIPELINE_BURST_CHUNK];
+    size_t moves[PIPELINE_BURST_CHUNK];
+    BOOL known = YES;
+
+    size_t i = 0;
+    while (i < count) {
+        const mouse_event_t *event = &events[i];
+        deltaX[i] = 0;
+        deltaY[i] = 0;
+
+        if (!pipeline_is_move(event)) {
+            i++;
+            continue;
+        }
+
+        pipeline_curve_t *curve = pipeline_event_curve(curves, event->device_type);
+        if (curve == NULL) {
+            known = NO;
+            i++;
+            continue;
+        }
+
+        // curves that compute the gain from the speed or have no transfer
+        // function take the events one at a time
+        pipeline_device_t *device = pipeline_event_device(state, curves, curve, event);
+        if (device->dpi > 0 || (curve->win == NULL && curve->osx == NULL) || !pipeline_fits_burst(event)) {
+            pipeline_accelerate(state, curves, event, &deltaX[i], &deltaY[i]);
+            i++;
+            continue;
+        }
+
+        // the moves of this device up to the next event of another one, the
+        // events in between that do not move are left out
+        size_t n = 0;
+        for (; i < count && n < PIPELINE_BURST_CHUNK; i++) {
+            const mouse_event_t *next = &events[i];
+            if (!pipeline_is_move(next)) {
+                deltaX[i] = 0;
+                deltaY[i] = 0;
+                continue;
+            }
+            if (next->device_type != event->device_type || next->device_id != event->device_id || !pipeline_fits_burst(next)) {
+                break;
+            }
+            moves[n] = i;
+            mickeysX[n] = (int16_t) next->dx;
+            mickeysY[n] = (int16_t) next->dy;
+            n++;
+        }
+
+        if (curve->win != NULL) {
+            curve->win->setState(&device->win);
+            curve->win->apply_batch(mickeysX, mickeysY, pixelsX, pixelsY, n);
+            curve->win->getState(&device->win);
+        } else {
+            curve->osx->setState(&device->osx);
+            curve->osx->apply_batch(mickeysX, mickeysY, pixelsX, pixelsY, n);
+            curve->osx->getState(&device->osx);
+        }
+
+        for (size_t j = 0; j < n; j++) {
+            pipeline_take_pixels(state, device, (float) pixelsX[j], (float) pixelsY[j], &deltaX[moves[j]], &deltaY[moves[j]]);
+        }
+    }
+
+    return known;
+}
+
+void pipeline_passthrough(pipeline_state_t *state, const mouse_event_t *event, int *deltaX, int *deltaY) {
+    *deltaX = event->dx;
+    *deltaY = event->dy;
+    state->deltaPosInt.x += *deltaX;
+    state->deltaPosInt.y += *deltaY;
+}
+
+void pipeline_clicks_init(pipeline_clicks_t *clicks) {
+    clicks->lastClickPos.x = 0;
+    clicks->lastClickPos.y = 0;
+    clicks->lastClickTime = 0;
+    clicks->nclicks = 0;
+}
+
+static double get_distance(CGPoint pos0, CGPoint pos1) {
+    CGFloat deltaX = pos1.x - pos0.x;
+    CGFloat deltaY = pos1.y - pos0.y;
+    return sqrt(deltaX * deltaX + deltaY * deltaY);
+}
+
+int pipeline_count_click(pipeline_clicks_t *clicks, CGPoint pos, uint64_t timestamp, uint64_t doubleClickInterval) {
+    CGFloat maxDistanceAllowed = sqrt(2) + 0.0001;
+    CGFloat distanceMovedSinceLastClick = get_distance(clicks->lastClickPos, pos);
+
+    // a timestamp going backwards (another kext instance) starts over
+    if (clicks->nclicks > 0 &&
+        timestamp >= clicks->lastClickTime &&
+        timestamp - clicks->lastClickTime <= doubleClickInterval &&
+        distanceMovedSinceLastClick <= maxDistanceAllowed) {
+        clicks->lastClickTime = timestamp;
+        clicks->nclicks++;
+    } else {
+        clicks->nclicks = 1;
+        clicks->lastClickTime = timestamp;
+        clicks->lastClickPos = pos;
+    }
+
+    return clicks->nclicks;
+}
+
+void pipeline_move_event_type(int buttons, CGEventType *eventType, CGMouseButton *otherButton) {
+    *eventType = kCGEventMouseMoved;
+    *otherButton = 0;
+
+    if (BUTTON_DOWN(buttons, LEFT_BUTTON)) {
+        *eventType = kCGEventLeftMouseDragged;
+        *otherButton = kCGMouseButtonLeft;
+    } else if (BUTTON_DOWN(buttons, RIGHT_BUTTON)) {
+        *eventType = kCGEventRightMouseDragged;
+        *otherButton = kCGMouseButtonRight;
+    } else if (BUTTON_DOWN(buttons, MIDDLE_BUTTON)) {
+        *eventType = kCGEventOtherMouseDragged;
+        *otherButton = kCGMouseButtonCenter;
+    } else if (BUTTON_DOWN(buttons, BUTTON4)) {
+        *eventType = kCGEventOtherMouseDragged;
+        *otherButton = 3;
+    } else if (BUTTON_DOWN(buttons, BUTTON5)) {
+        *eventType = kCGEventOtherMouseDragged;
+        *otherButton = 4;
+    } else if (BUTTON_DOWN(buttons, BUTTON6)) {
+        *eventType = kCGEventOtherMouseDragged;
+        *otherButton = 5;
+    }
+}
+
+void pipeline_button_event_type(int buttonIndex, BOOL down, CGEventType *eventType, CGMouseButton *otherButton) {
+    if (down) {
+        switch(buttonIndex) {
+            case LEFT_BUTTON:   *eventType = kCGEventLeftMouseDown; break;
+            case RIGHT_BUTTON:  *eventType = kCGEventRightMouseDown; break;
+            default:            *eventType = kCGEventOtherMouseDown; break;
+        }
+    } else {
+        switch(buttonIndex) {
+            case LEFT_BUTTON:   *eventType = kCGEventLeftMouseUp; break;
+            case RIGHT_BUTTON:  *eventType = kCGEventRightMouseUp; break;
+            default:            *eventType = kCGEventOtherMouseUp; break;
+        }
+    }
+
+    *otherButton = 0;
+    switch(buttonIndex) {
+        case LEFT_BUTTON: *otherButton = kCGMouseButtonLeft; break;
+        case RIGHT_BUTTON: *otherButton = kCGMouseButtonRight; break;
+        case MIDDLE_BUTTON: *otherButton = kCGMouseButtonCenter; break;
+        case BUTTON4: *otherButton = 3; break;
+        case BUTTON5: *otherButton = 4; break;
+        case BUTTON6: *otherButton = 5; break;
+    }
+}
+
+BOOL pipeline_can_coalesce(const driver_move_event_t *e1, const driver_move_event_t *e2) {
+    return (e1->type == e2->type &&
+            e1->buttons == e2->buttons &&
+            e1->otherButton == e2->otherButton);
+}
+
+void pipeline_coalesce(driver_event_t *last, driver_event_t *event) {
+    event->move.deltaX += last->move.deltaX;
+    event->move.deltaY += last->move.deltaY;
+    *last = *event;
+}
+
+void pipeline_pacer_init(pipeline_pacer_t *pacer, uint64_t interval) {
+    pacer->interval = interval;
+    pacer->lastMove = 0;
+}
+
+uint64_t pipeline_pacer_release_time(const pipeline_pacer_t *pacer, uint64_t now) {
+    if (pacer->interval == 0 || pacer->lastMove == 0 || now - pacer->lastMove >= pacer->interval) {
+        return now;
+    }
+    return pacer->lastMove + pacer->interval;
+}
+
+void pipeline_pacer_passed_on(pipeline_pacer_t *pacer, uint64_t now) {
+    pacer->lastMove = now;
+}
+
+// the names of Driver.h live here so the trace decoder (trace.h) can use them
+// outside of the daemon
+
+const char *driver_quartz_event_type_to_string(CGEventType type) {
+    switch(type) {
+        case kCGEventNull:              return "kCGEventNull";
+        case kCGEventLeftMouseUp:       return "kCGEventLeftMouseUp";
+        case kCGEventLeftMouseDown:     return "kCGEventLeftMouseDown";
+        case kCGEventLeftMouseDragged:  return "kCGEventLeftMouseDragged";
+        case kCGEventRightMouseUp:      return "kCGEventRightMouseUp";
+        case kCGEventRightMouseDown:    return "kCGEventRightMouseDown";
+        case kCGEventRightMouseDragged: return "kCGEventRightMouseDragged";
+        case kCGEventOtherMouseUp:      return "kCGEventOtherMouseUp";
+        case kCGEventOtherMouseDown:    return "kCGEventOtherMouseDown";
+        case kCGEventOtherMouseDragged: return "kCGEventOtherMouseDragged";
+        case kCGEventMouseMoved:        return "kCGEventMouseMoved";
+        default:                        return "?";
+    }
+}
+
+const char *driver_iohid_event_type_to_string(int type) {
+    switch(type) {
+        case NX_NULLEVENT:      return "NX_NULLEVENT";
+        case NX_LMOUSEUP:       return "NX_LMOUSEUP";
+        case NX_LMOUSEDOWN:     return "NX_LMOUSEDOWN";
+        case NX_LMOUSEDRAGGED:  return "NX_LMOUSEDRAGGED";
+        case NX_RMOUSEUP:       return "NX_RMOUSEUP";
+        case NX_RMOUSEDOWN:     return "NX_RMOUSEDOWN";
+        case NX_RMOUSEDRAGGED:  return "NX_RMOUSEDRAGGED";
+        case NX_OMOUSEUP:       return "NX_OMOUSEUP";
+        case NX_OMOUSEDOWN:     return "NX_OMOUSEDOWN";
+        case NX_OMOUSEDRAGGED:  return "NX_OMOUSEDRAGGED";
+        case NX_MOUSEMOVED:     return "NX_MOUSEMOVED";
+        default:                return "?";
+    }
+}
+
+const char *driver_get_driver_string(int driver) {
+    switch (driver) {
+        case DRIVER_QUARTZ_OLD: return "QUARTZ_OLD";
+        case DRIVER_QUARTZ: return "QUARTZ";
+        case DRIVER_IOHID: return "IOHID";
+        case DRIVER_UINPUT: return "UINPUT";
+        default: return "?";
+    }
+}
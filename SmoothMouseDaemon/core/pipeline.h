@@ -0,0 +1,216 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "platform.h"
+#include "KextProtocol.h"
+#include "Driver.h"
+#include "WindowsFunction.hpp"
+#include "OSXFunction.hpp"
+
+/*
+ The parts of the mouse pipeline that do not talk to the window server: button
+ remapping, sequence number checking, acceleration, click counting and event
+ coalescing. They
+ are shared by the daemon (mouse.mm, Driver.mm) and the replay tool
+ (SmoothMouseReplay), which is what makes a replayed capture produce the same
+ driver events as the live daemon did.
+ */
+
+#define LEFT_BUTTON     (1 << 0)
+#define RIGHT_BUTTON    (1 << 1)
+#define MIDDLE_BUTTON   (1 << 2)
+#define BUTTON4         (1 << 3)
+#define BUTTON5         (1 << 4)
+#define BUTTON6         (1 << 5)
+#define NUM_BUTTONS     6
+
+#define BUTTON_DOWN(curbuttons, button)                         (((button) & curbuttons) == (button))
+#define BUTTON_UP(curbuttons, button)                           (((button) & curbuttons) == 0)
+#define BUTTON_STATE_CHANGED(curbuttons, lastbuttons, button)   ((lastButtons & (button)) != (curbuttons & (button)))
+
+typedef enum AccelerationCurve_s {
+    ACCELERATION_CURVE_LINEAR   = 0,
+    ACCELERATION_CURVE_WINDOWS  = 1,
+    ACCELERATION_CURVE_OSX      = 2,
+    ACCELERATION_CURVE_CUSTOM   = 3  // OS X style table loaded from a file
+} AccelerationCurve;
+
+// acceleration settings of one device type together with the transfer
+// function built for them, only the thread calling pipeline_accelerate() may
+// use the transfer function since the state of each device is loaded into it
+typedef struct pipeline_curve_s {
+    AccelerationCurve curve;
+    double velocity;
+    WindowsFunction *win;
+    OSXFunction *osx;
+    // resolution of the device when the gain is computed from its speed
+    // (see pipeline_curve_use_timestamps()), 0 for the gain per report
+    double dpi;
+    // empty unless a custom curve could not be loaded, curve is
+    // ACCELERATION_CURVE_LINEAR then
+    char error[256];
+} pipeline_curve_t;
+
+// building the transfer functions is too slow for the event path, so they
+// are built when the settings change and handed to the event thread complete
+typedef struct pipeline_curves_s {
+    pipeline_curve_t mouse;
+    pipeline_curve_t trackpad;
+    // tells the devices that their transfer function state belongs to other
+    // curves, unique per curves object
+    uint32_t generation;
+    int refcount;
+} pipeline_curves_t;
+
+#define PIPELINE_SPEED_HISTORY 32
+
+// the recent moves of one device, for computing its speed
+typedef struct pipeline_speed_s {
+    uint64_t lastTimestamp;
+    int deltasX[PIPELINE_SPEED_HISTORY];
+    int deltasY[PIPELINE_SPEED_HISTORY];
+    float intervals[PIPELINE_SPEED_HISTORY];
+    int head;
+    int count;
+} pipeline_speed_t;
+
+// devices moving the cursor at the same time each get their own state
+#define PIPELINE_MAX_DEVICES 8
+
+// the state of one device (type and id of the events), taken on its first
+// event, the least recently used device gives up its entry when all are taken
+typedef struct pipeline_device_s {
+    device_type_t type;             // kDeviceTypeUnknown for a free entry
+    uint32_t id;
+    uint64_t lastUsed;
+    uint32_t curvesGeneration;      // of the curves the states below are for
+    WindowsFunctionState win;
+    OSXFunctionState osx;
+    double dpi;
+    CGPoint remainder;              // sub pixel part of the moves
+    pipeline_speed_t speed;
+} pipeline_device_t;
+
+typedef struct pipeline_state_s {
+    CGPoint deltaPosInt;
+    uint64_t lastSequenceNumber;
+    uint64_t useCounter;
+    pipeline_device_t devices[PIPELINE_MAX_DEVICES];
+} pipeline_state_t;
+
+// double click detection for left button presses
+typedef struct pipeline_clicks_s {
+    CGPoint lastClickPos;
+    uint64_t lastClickTime; // event timestamp, ns
+    int nclicks;
+} pipeline_clicks_t;
+
+void pipeline_init(pipeline_state_t *state, CGPoint pos);
+
+// returns a curves object with a refcount of 1, the curve files are only used
+// by ACCELERATION_CURVE_CUSTOM and may be NULL otherwise
+pipeline_curves_t *pipeline_curves_create(AccelerationCurve mouseCurve, double mouseVelocity, const char *mouseCurveFile,
+                                          AccelerationCurve trackpadCurve, double trackpadVelocity, const char *trackpadCurveFile);
+/*
+ The curves compute their gain from the counts of a single report, so the
+ same motion accelerates more on a mouse reporting less often. After this is
+ called (before the curves are used) the gain is looked up for the device's
+ speed in inches per second instead, computed from the event timestamps (in
+ nanoseconds) and the resolution of the device, which makes it independent
+ of the report rate. Linear curves are not affected.
+ */
+void pipeline_curve_use_timestamps(pipeline_curve_t *curve, double dpi);
+
+// what pipeline_curve_set_resolution() accepts, the OS X curve is set up in
+// fixed point and the Windows curve accepts the same
+#define PIPELINE_MIN_DPI OSX_MIN_DEVICE_RESOLUTION
+#define PIPELINE_MAX_DPI OSX_MAX_DEVICE_RESOLUTION
+#define PIPELINE_MIN_PPI OSX_MIN_SCREEN_RESOLUTION
+#define PIPELINE_MAX_PPI OSX_MAX_SCREEN_RESOLUTION
+#define PIPELINE_MIN_HZ  OSX_MIN_FRAME_RATE
+#define PIPELINE_MAX_HZ  OSX_MAX_FRAME_RATE
+
+/*
+ Sets the curve up for a device with a resolution of dpi counts per inch and a
+ screen with ppi pixels per inch refreshed at hz. Without this (or for 0) the
+ curves assume what OS X and Windows assume: a 400 dpi device and a 96 ppi
+ screen refreshed at 67 Hz (OS X) or 60 Hz (Windows). A device with a higher
+ resolution reports more counts for the same motion, which would otherwise be
+ accelerated as a faster motion. Called before the curves are used, linear
+ curves are not affected. Returns NO and leaves the curve as it was if a
+ value other than 0 is outside of the PIPELINE_MIN_* and PIPELINE_MAX_* limits
+ (or not a number).
+ */
+BOOL pipeline_curve_set_resolution(pipeline_curve_t *curve, double dpi, double ppi, double hz);
+void pipeline_curves_retain(pipeline_curves_t *curves);
+void pipeline_curves_release(pipeline_curves_t *curves);
+
+int pipeline_remap_buttons(int buttons);
+
+// returns NO if seqnum is not the one following lastSequenceNumber, the number
+// of events lost in between is returned in lostEvents
+BOOL pipeline_check_sequence_number(pipeline_state_t *state, uint64_t seqnum, uint64_t *expected, uint64_t *lostEvents);
+
+// the cursor was moved by someone else, keep the sub pixel remainders
+void pipeline_cursor_moved(pipeline_state_t *state, float movedX, float movedY);
+
+// returns NO for an unknown device type
+BOOL pipeline_accelerate(pipeline_state_t *state, pipeline_curves_t *curves, const mouse_event_t *event, int *deltaX, int *deltaY);
+
+/*
+ Accelerates count events with the result of pipeline_accelerate() for each
+ move among them, in order. The moves of one device that follow each other
+ are handed to its transfer function together (see OSXFunction::apply_batch()),
+ a burst of reports read at once costs less than the same reports one by one.
+ Events that do not move get 0, 0 and leave the state alone, like those of an
+ unknown device type, for which NO is returned.
+ */
+#define PIPELINE_BURST_CHUNK 64
+
+BOOL pipeline_accelerate_burst(pipeline_state_t *state, pipeline_curves_t *curves, const mouse_event_t *events, size_t count, int *deltaX, int *deltaY);
+
+// the deltas of the event as they are, for events that arrive while the
+// daemon is paused, leaves the curves and the sub pixel remainders alone
+void pipeline_passthrough(pipeline_state_t *state, const mouse_event_t *event, int *deltaX, int *deltaY);
+
+void pipeline_clicks_init(pipeline_clicks_t *clicks);
+
+/*
+ Counts a left button press at pos with the timestamp of its event (monotonic,
+ in nanoseconds like mouse_event_t.timestamp). It continues the previous click
+ if it came within doubleClickInterval nanoseconds of it and the cursor moved
+ at most one pixel (diagonally) since the first click. Since the timestamps
+ are taken by the kext, the count does not depend on how long the events
+ waited in the queue. Returns the click count, which is also kept in
+ clicks->nclicks.
+ */
+int pipeline_count_click(pipeline_clicks_t *clicks, CGPoint pos, uint64_t timestamp, uint64_t doubleClickInterval);
+
+void pipeline_move_event_type(int buttons, CGEventType *eventType, CGMouseButton *otherButton);
+void pipeline_button_event_type(int buttonIndex, BOOL down, CGEventType *eventType, CGMouseButton *otherButton);
+
+BOOL pipeline_can_coalesce(const driver_move_event_t *e1, const driver_move_event_t *e2);
+// merges event into last, the result keeps the position and timestamps of event
+void pipeline_coalesce(driver_event_t *last, driver_event_t *event);
+
+/*
+ Moves are merged into the last queued move as long as the driver has not
+ taken it yet, so a driver keeping up passes on every report of a fast polling
+ mouse. With an interval the driver holds a move back until interval has
+ passed since it passed on the previous move, and the moves arriving in the
+ meantime are merged into it. A held move is passed on right away when an
+ event that cannot be merged with it (see pipeline_can_coalesce()) is queued
+ behind it, so button events are never delayed. Times are in any unit, as long
+ as interval and the times passed in use the same one.
+ */
+typedef struct pipeline_pacer_s {
+    uint64_t interval;      // 0 to pass on moves as soon as possible
+    uint64_t lastMove;      // when the last move was passed on
+} pipeline_pacer_t;
+
+void pipeline_pacer_init(pipeline_pacer_t *pacer, uint64_t interval);
+// when a move that is ready at now may be passed on, now if it need not wait
+uint64_t pipeline_pacer_release_time(const pipeline_pacer_t *pacer, uint64_t now);
+void pipeline_pacer_passed_on(pipeline_pacer_t *pacer, uint64_t now);
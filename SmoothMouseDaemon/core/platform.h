@@ -0,0 +1,66 @@
+#pragma once
+
+/*
+ The core of the daemon (this directory and libpointing) only depends on a
+ handful of CoreGraphics and Objective-C types. On OS X they come from the
+ system headers, elsewhere (replay tool and tests on Linux) they are defined
+ here with the same values.
+ */
+
+#ifdef __APPLE__
+
+#include <ApplicationServices/ApplicationServices.h>
+#include <objc/objc.h>
+
+#else
+
+#include <stdint.h>
+
+#ifndef __OBJC__
+typedef signed char BOOL;
+#define YES ((BOOL)1)
+#define NO  ((BOOL)0)
+#endif
+
+typedef double CGFloat;
+
+typedef struct CGPoint {
+    CGFloat x;
+    CGFloat y;
+} CGPoint;
+
+typedef struct CGSize {
+    CGFloat width;
+    CGFloat height;
+} CGSize;
+
+typedef struct CGRect {
+    CGPoint origin;
+    CGSize size;
+} CGRect;
+
+typedef uint32_t CGMouseButton;
+
+enum {
+    kCGMouseButtonLeft = 0,
+    kCGMouseButtonRight = 1,
+    kCGMouseButtonCenter = 2
+};
+
+typedef uint32_t CGEventType;
+
+enum {
+    kCGEventNull = 0,
+    kCGEventLeftMouseDown = 1,
+    kCGEventLeftMouseUp = 2,
+    kCGEventRightMouseDown = 3,
+    kCGEventRightMouseUp = 4,
+    kCGEventMouseMoved = 5,
+    kCGEventLeftMouseDragged = 6,
+    kCGEventRightMouseDragged = 7,
+    kCGEventOtherMouseDown = 25,
+    kCGEventOtherMouseUp = 26,
+    kCGEventOtherMouseDragged = 27
+};
+
+#endif
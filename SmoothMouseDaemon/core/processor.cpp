@@ -0,0 +1,165 @@
+#include "processor.h"
+
+void processor_init(processor_t *processor, CGPoint pos, pipeline_curves_t *curves, processor_post_callback_t post, void *context) {
+    pipeline_init(&processor->pipeline, pos);
+    processor->curves = curves;
+    processor->currentPos = pos;
+    processor->lastButtons = 0;
+    processor->lostEvents = 0;
+    processor->post = post;
+    processor->context = context;
+    processor->paused = 0;
+}
+
+void processor_set_paused(processor_t *processor, BOOL paused) {
+    processor->paused = paused;
+    __sync_synchronize();
+}
+
+static void processor_handle_buttons(processor_t *processor, int buttons, uint64_t seqnum, uint64_t timestamp) {
+    int lastButtons = processor->lastButtons;
+
+    for (int i = 0; i < NUM_BUTTONS; i++) {
+        int buttonIndex = (1 << i);
+        if (BUTTON_STATE_CHANGED(buttons, lastButtons, buttonIndex)) {
+            CGEventType eventType;
+            CGMouseButton otherButton;
+            pipeline_button_event_type(buttonIndex, BUTTON_DOWN(buttons, buttonIndex), &eventType, &otherButton);
+
+            driver_event_t driverEvent;
+            driverEvent.id = DRIVER_EVENT_ID_BUTTON;
+            driverEvent.kextSeqnum = seqnum;
+            driverEvent.kextTimestamp = timestamp;
+            driverEvent.button.pos = processor->currentPos;
+            driverEvent.button.type = eventType;
+            driverEvent.button.buttons = buttons;
+            driverEvent.button.otherButton = otherButton;
+            driverEvent.button.nclicks = 0;
+            processor->post(&driverEvent, processor->context);
+        }
+    }
+}
+
+static void processor_post_move(processor_t *processor, const mouse_event_t *event, int deltaX, int deltaY) {
+    CGPoint newPos;
+    newPos.x = processor->currentPos.x + deltaX;
+    newPos.y = processor->currentPos.y + deltaY;
+
+    CGEventType eventType;
+    CGMouseButton otherButton;
+    pipeline_move_event_type(event->buttons, &eventType, &otherButton);
+
+    driver_event_t driverEvent;
+    driverEvent.id = DRIVER_EVENT_ID_MOVE;
+    driverEvent.kextSeqnum = event->seqnum;
+    driverEvent.kextTimestamp = event->timestamp;
+    driverEvent.move.pos = newPos;
+    driverEvent.move.type = eventType;
+    driverEvent.move.deltaX = deltaX;
+    driverEvent.move.deltaY = deltaY;
+    driverEvent.move.buttons = event->buttons;
+    driverEvent.move.otherButton = otherButton;
+    processor->post(&driverEvent, processor->context);
+
+    processor->currentPos = newPos;
+}
+
+static BOOL processor_handle_move(processor_t *processor, const mouse_event_t *event) {
+    int deltaX;
+    int deltaY;
+    if (event->device_type != kDeviceTypeMouse && event->device_type != kDeviceTypeTrackpad) {
+        return NO;
+    }
+    if (processor->paused) {
+        pipeline_passthrough(&processor->pipeline, event, &deltaX, &deltaY);
+    } else if (!pipeline_accelerate(&processor->pipeline, processor->curves, event, &deltaX, &deltaY)) {
+        return NO;
+    }
+
+    processor_post_move(processor, event, deltaX, deltaY);
+
+    return YES;
+}
+
+static void processor_check_sequence_number(processor_t *processor, const mouse_event_t *event) {
+    uint64_t seqnumExpected;
+    uint64_t lostEvents;
+    pipeline_check_sequence_number(&processor->pipeline, event->seqnum, &seqnumExpected, &lostEvents);
+    processor->lostEvents += lostEvents;
+}
+
+BOOL processor_process_event(processor_t *processor, mouse_event_t *event) {
+    event->buttons = pipeline_remap_buttons(event->buttons);
+
+    processor_check_sequence_number(processor, event);
+
+    if (event->buttons != processor->lastButtons) {
+        processor_handle_buttons(processor, event->buttons, event->seqnum, event->timestamp);
+    }
+
+    if (event->dx != 0 || event->dy != 0) {
+        if (!processor_handle_move(processor, event)) {
+            return NO;
+        }
+    }
+
+    processor->pipeline.lastSequenceNumber = event->seqnum;
+    processor->lastButtons = event->buttons;
+
+    return YES;
+}
+
+BOOL processor_process_events(processor_t *processor, mouse_event_t *events, size_t count) {
+    int deltaX[PIPELINE_BURST_CHUNK];
+    int deltaY[PIPELINE_BURST_CHUNK];
+    BOOL known = YES;
+
+    for (size_t base = 0; base < count; base += PIPELINE_BURST_CHUNK) {
+        size_t n = count - base;
+        if (n > PIPELINE_BURST_CHUNK) {
+            n = PIPELINE_BURST_CHUNK;
+        }
+
+        // the moves are accelerated first, the buttons do not change them
+        for (size_t i = 0; i < n; i++) {
+            events[base + i].buttons = pipeline_remap_buttons(events[base + i].buttons);
+        }
+        if (processor->paused) {
+            for (size_t i = 0; i < n; i++) {
+                pipeline_passthrough(&processor->pipeline, &events[base + i], &deltaX[i], &deltaY[i]);
+            }
+        } else {
+            pipeline_accelerate_burst(&processor->pipeline, processor->curves, events + base, n, deltaX, deltaY);
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            mouse_event_t *event = &events[base + i];
+
+            processor_check_sequence_number(processor, event);
+
+            if (event->buttons != processor->lastButtons) {
+                processor_handle_buttons(processor, event->buttons, event->seqnum, event->timestamp);
+            }
+
+            if (event->dx != 0 || event->dy != 0) {
+                if (event->device_type != kDeviceTypeMouse && event->device_type != kDeviceTypeTrackpad) {
+                    known = NO;
+                    continue;
+                }
+                processor_post_move(processor, event, deltaX[i], deltaY[i]);
+            }
+
+            processor->pipeline.lastSequenceNumber = event->seqnum;
+            processor->lastButtons = event->buttons;
+        }
+    }
+
+    return known;
+}
+
+void processor_release_buttons(processor_t *processor) {
+    if (processor->lastButtons != 0) {
+        processor_handle_buttons(processor, 0, 0, 0);
+        processor->lastButtons = 0;
+    }
+}
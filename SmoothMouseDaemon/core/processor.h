@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "platform.h"
+#include "KextProtocol.h"
+#include "Driver.h"
+#include "pipeline.h"
+
+/*
+ Turns kext events into driver events the way mouse_process_kext_event()
+ does, for event sources that do not have a window server behind them (the
+ replay tool and the Linux backend): the cursor is not restricted to the
+ screen boundaries, its position is never refreshed and clicks are not
+ counted. The driver events are handed to post, which may coalesce them.
+ */
+
+typedef void (*processor_post_callback_t)(driver_event_t *event, void *context);
+
+typedef struct processor_s {
+    pipeline_state_t pipeline;
+    pipeline_curves_t *curves; // not owned
+    CGPoint currentPos;
+    int lastButtons;
+    uint64_t lostEvents;
+    processor_post_callback_t post;
+    void *context;
+    volatile int paused; // see processor_set_paused()
+} processor_t;
+
+void processor_init(processor_t *processor, CGPoint pos, pipeline_curves_t *curves, processor_post_callback_t post, void *context);
+
+// returns NO for an event with an unknown device type
+BOOL processor_process_event(processor_t *processor, mouse_event_t *event);
+
+// processes count events like processor_process_event() does one by one, the
+// moves are accelerated together (see pipeline_accelerate_burst()). Returns NO
+// if one of them had an unknown device type, the others are still processed.
+BOOL processor_process_events(processor_t *processor, mouse_event_t *events, size_t count);
+
+// any thread, while paused the moves are posted with their raw deltas (see
+// pipeline_passthrough()) instead of being accelerated
+void processor_set_paused(processor_t *processor, BOOL paused);
+
+// releases all buttons that are still down
+void processor_release_buttons(processor_t *processor);
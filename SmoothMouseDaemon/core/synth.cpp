@@ -0,0 +1,276 @@
+#include "synth.h"
+
+#include <math.h>
+#include <string.h>
+
+#define SYNTH_NS_PER_SEC (1000000000.0)
+
+// raw kext button bits, see pipeline_remap_buttons()
+#define SYNTH_BUTTON_LEFT   (4)
+#define SYNTH_BUTTON_MIDDLE (2)
+#define SYNTH_BUTTON_RIGHT  (1)
+
+// Fitts' law constants of a typical mouse user, in seconds
+#define SYNTH_FITTS_A (0.1)
+#define SYNTH_FITTS_B (0.15)
+
+#define SYNTH_CLICK_RATE (0.3) // per aimed movement
+
+enum {
+    SYNTH_SEGMENT_PAUSE,
+    SYNTH_SEGMENT_AIMED,
+    SYNTH_SEGMENT_SWEEP,
+    SYNTH_SEGMENT_MICRO
+};
+
+static uint32_t synth_random(synth_t *synth) {
+    synth->random = synth->random * 1664525 + 1013904223;
+    return synth->random >> 8;
+}
+
+// uniform in [0, 1)
+static double synth_unit(synth_t *synth) {
+    return synth_random(synth) / (double) (1 << 24);
+}
+
+static double synth_uniform(synth_t *synth, double min, double max) {
+    return min + (max - min) * synth_unit(synth);
+}
+
+// uniform on a log scale, for distances and durations
+static double synth_log_uniform(synth_t *synth, double min, double max) {
+    return exp(synth_uniform(synth, log(min), log(max)));
+}
+
+static uint64_t synth_ns(double seconds) {
+    return (uint64_t) (seconds * SYNTH_NS_PER_SEC);
+}
+
+void synth_settings_default(synth_settings_t *settings) {
+    settings->model = SYNTH_MODEL_MIXED;
+    settings->deviceType = kDeviceTypeMouse;
+    settings->deviceId = 0;
+    settings->pollingRate = 1000;
+    settings->jitter = 0.1;
+    settings->dpi = 800;
+    settings->gapRate = 0;
+    settings->maxGap = 1;
+    settings->chordRate = 0;
+    settings->seed = 1;
+    settings->startTime = 1000000000ull;
+}
+
+static void synth_queue_buttons(synth_t *synth, int buttons, double delay) {
+    int i = (synth->firstPending + synth->numPending) % 4;
+    synth->pendingButtons[i] = buttons;
+    synth->pendingDelay[i] = synth_ns(delay);
+    synth->numPending++;
+}
+
+static void synth_queue_click(synth_t *synth) {
+    synth->numClicks++;
+    if (synth_unit(synth) < synth->settings.chordRate) {
+        // the second button of the chord is pressed and released while the
+        // first one is held
+        int second = (synth_random(synth) & 1) ? SYNTH_BUTTON_RIGHT : SYNTH_BUTTON_MIDDLE;
+        synth->numChords++;
+        synth_queue_buttons(synth, SYNTH_BUTTON_LEFT, 0.02);
+        synth_queue_buttons(synth, SYNTH_BUTTON_LEFT | second, synth_uniform(synth, 0.01, 0.05));
+        synth_queue_buttons(synth, SYNTH_BUTTON_LEFT, synth_uniform(synth, 0.05, 0.15));
+        synth_queue_buttons(synth, 0, synth_uniform(synth, 0.01, 0.05));
+    } else {
+        synth_queue_buttons(synth, SYNTH_BUTTON_LEFT, 0.02);
+        synth_queue_buttons(synth, 0, synth_uniform(synth, 0.06, 0.14));
+    }
+}
+
+static void synth_start_segment(synth_t *synth, int segment, double distance, double duration) {
+    double angle = synth_uniform(synth, 0, 2 * M_PI);
+    synth->segment = segment;
+    synth->segmentStart = synth->now;
+    synth->segmentEnd = synth->now + synth_ns(duration);
+    synth->dirX = cos(angle);
+    synth->dirY = sin(angle);
+    synth->distance = distance * synth->settings.dpi;
+    synth->reportedX = 0;
+    synth->reportedY = 0;
+}
+
+static void synth_start_aimed(synth_t *synth) {
+    double distance = synth_log_uniform(synth, 0.2, 8.0);
+    double width = synth_log_uniform(synth, 0.05, 0.3);
+    double duration = SYNTH_FITTS_A + SYNTH_FITTS_B * log2(distance / width + 1);
+    synth_start_segment(synth, SYNTH_SEGMENT_AIMED, distance, duration);
+}
+
+static void synth_start_sweep(synth_t *synth) {
+    double speed = synth_uniform(synth, 2.0, 20.0);
+    double duration = synth_uniform(synth, 0.2, 1.5);
+    synth_start_segment(synth, SYNTH_SEGMENT_SWEEP, speed * duration, duration);
+}
+
+static void synth_start_micro(synth_t *synth) {
+    // a few counts whatever the resolution
+    double distance = synth_uniform(synth, 1.5, 6.0) / synth->settings.dpi;
+    synth_start_segment(synth, SYNTH_SEGMENT_MICRO, distance, synth_uniform(synth, 0.04, 0.12));
+}
+
+static void synth_start_pause(synth_t *synth, double min, double max) {
+    synth_start_segment(synth, SYNTH_SEGMENT_PAUSE, 0, synth_log_uniform(synth, min, max));
+}
+
+// picks the segment after the one that just ended
+static void synth_next_segment(synth_t *synth) {
+    int previous = synth->segment;
+
+    if (previous == SYNTH_SEGMENT_AIMED && synth_unit(synth) < SYNTH_CLICK_RATE) {
+        synth_queue_click(synth);
+    }
+
+    switch (synth->settings.model) {
+        case SYNTH_MODEL_AIMED:
+            if (previous == SYNTH_SEGMENT_AIMED) {
+                synth_start_pause(synth, 0.1, 0.6);
+            } else {
+                synth_start_aimed(synth);
+            }
+            break;
+        case SYNTH_MODEL_SWEEP:
+            synth_start_sweep(synth);
+            break;
+        case SYNTH_MODEL_MICRO:
+            if (previous == SYNTH_SEGMENT_MICRO) {
+                synth_start_pause(synth, 0.02, 0.2);
+            } else {
+                synth_start_micro(synth);
+            }
+            break;
+        case SYNTH_MODEL_MIXED:
+        default:
+            if ((previous == SYNTH_SEGMENT_AIMED || previous == SYNTH_SEGMENT_MICRO) && synth_unit(synth) < 0.5) {
+                synth_start_micro(synth);
+            } else if (previous != SYNTH_SEGMENT_PAUSE) {
+                synth_start_pause(synth, 0.05, 0.8);
+            } else if (synth_unit(synth) < 0.1) {
+                synth_start_sweep(synth);
+            } else {
+                synth_start_aimed(synth);
+            }
+            break;
+    }
+}
+
+// fraction of the distance covered at t (0 to 1) into the segment
+static double synth_profile(int segment, double t) {
+    if (segment == SYNTH_SEGMENT_SWEEP) {
+        return t;
+    }
+    // minimum jerk
+    return t * t * t * (10 - 15 * t + 6 * t * t);
+}
+
+void synth_init(synth_t *synth, const synth_settings_t *settings) {
+    memset(synth, 0, sizeof(synth_t));
+    synth->settings = *settings;
+    if (synth->settings.pollingRate <= 0) {
+        synth->settings.pollingRate = 1000;
+    }
+    if (synth->settings.dpi <= 0) {
+        synth->settings.dpi = 800;
+    }
+    if (synth->settings.maxGap < 1) {
+        synth->settings.maxGap = 1;
+    }
+    synth->random = settings->seed;
+    synth->now = settings->startTime;
+    synth->seqnum = 0;
+    synth->segment = SYNTH_SEGMENT_PAUSE;
+    synth_next_segment(synth);
+}
+
+static uint64_t synth_period(synth_t *synth) {
+    double period = SYNTH_NS_PER_SEC / synth->settings.pollingRate;
+    period *= 1 + synth->settings.jitter * synth_uniform(synth, -1, 1);
+    return period < 1 ? 1 : (uint64_t) period;
+}
+
+void synth_next(synth_t *synth, mouse_event_t *event) {
+    int dx = 0;
+    int dy = 0;
+
+    while (true) {
+        if (synth->numPending > 0) {
+            synth->now += synth->pendingDelay[synth->firstPending];
+            synth->buttons = synth->pendingButtons[synth->firstPending];
+            synth->firstPending = (synth->firstPending + 1) % 4;
+            synth->numPending--;
+            // the segment after the click starts when the click is done
+            uint64_t duration = synth->segmentEnd - synth->segmentStart;
+            synth->segmentStart = synth->now;
+            synth->segmentEnd = synth->now + duration;
+            break;
+        }
+
+        if (synth->segment == SYNTH_SEGMENT_PAUSE) {
+            // nothing is reported while the mouse rests
+            synth->now = synth->segmentEnd;
+            synth_next_segment(synth);
+            continue;
+        }
+
+        synth->now += synth_period(synth);
+
+        BOOL ended = synth->now >= synth->segmentEnd;
+        double t = ended ? 1.0 : (double) (synth->now - synth->segmentStart) / (synth->segmentEnd - synth->segmentStart);
+        double position = synth->distance * synth_profile(synth->segment, t);
+        int x = (int) lround(position * synth->dirX);
+        int y = (int) lround(position * synth->dirY);
+        dx = x - synth->reportedX;
+        dy = y - synth->reportedY;
+        synth->reportedX = x;
+        synth->reportedY = y;
+
+        if (ended) {
+            synth_next_segment(synth);
+        }
+        if (dx != 0 || dy != 0) {
+            break;
+        }
+    }
+
+    if (synth->settings.gapRate > 0 && synth_unit(synth) < synth->settings.gapRate) {
+        uint64_t lost = 1 + synth_random(synth) % synth->settings.maxGap;
+        synth->seqnum += lost;
+        synth->lostEvents += lost;
+    }
+
+    memset(event, 0, sizeof(mouse_event_t));
+    event->device_type = synth->settings.deviceType;
+    event->device_id = synth->settings.deviceId;
+    event->buttons = synth->buttons;
+    event->dx = dx;
+    event->dy = dy;
+    event->timestamp = synth->now;
+    event->seqnum = ++synth->seqnum;
+    synth->numEvents++;
+}
+
+const char *synth_model_name(synth_model_t model) {
+    switch (model) {
+        case SYNTH_MODEL_MIXED: return "mixed";
+        case SYNTH_MODEL_AIMED: return "aimed";
+        case SYNTH_MODEL_SWEEP: return "sweep";
+        case SYNTH_MODEL_MICRO: return "micro";
+    }
+    return "unknown";
+}
+
+BOOL synth_model_from_name(const char *name, synth_model_t *model) {
+    for (int i = SYNTH_MODEL_MIXED; i <= SYNTH_MODEL_MICRO; i++) {
+        if (strcmp(name, synth_model_name((synth_model_t) i)) == 0) {
+            *model = (synth_model_t) i;
+            return YES;
+        }
+    }
+    return NO;
+}
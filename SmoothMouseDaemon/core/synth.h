@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "platform.h"
+#include "KextProtocol.h"
+
+/*
+ Generates the events a kext would send for a user moving a mouse, so that
+ the pipeline can be exercised without a human: one event at a time as an
+ in-process source, or written to a capture file (SmoothMouseSynth).
+
+ Motion is a sequence of segments, each of them sampled at the polling rate
+ with jitter, and reports without motion are not sent like a real mouse does
+ not send them:
+
+ aimed   a Fitts' law movement to a target 0.2 to 8 inches away, its duration
+         a + b log2(D / W + 1) with a minimum jerk velocity profile, sometimes
+         followed by a click
+ sweep   a constant speed movement between 2 and 20 inches per second
+ micro   a correction of a few counts, like at the end of an aimed movement
+
+ The mixed model chains aimed movements with micro-adjustments, pauses and
+ the occasional sweep. Sequence numbers skip events at gapRate to simulate
+ events lost in the kext, clicks become chords of two buttons at chordRate.
+ The same seed gives the same events.
+ */
+
+typedef enum synth_model_e {
+    SYNTH_MODEL_MIXED,
+    SYNTH_MODEL_AIMED,
+    SYNTH_MODEL_SWEEP,
+    SYNTH_MODEL_MICRO
+} synth_model_t;
+
+typedef struct synth_settings_s {
+    synth_model_t model;
+    device_type_t deviceType;
+    uint32_t deviceId;
+    double pollingRate;     // reports per second, e.g. 125, 500, 1000, 8000
+    double jitter;          // of the polling period, 0 to 1
+    double dpi;             // counts per inch
+    double gapRate;         // probability per event of a sequence number gap
+    int maxGap;             // events lost per gap, 1 to maxGap
+    double chordRate;       // probability per click of a chord
+    uint32_t seed;
+    uint64_t startTime;     // timestamp of the first event in ns
+} synth_settings_t;
+
+typedef struct synth_s {
+    synth_settings_t settings;
+    uint32_t random;
+    uint64_t now;           // ns
+    uint64_t seqnum;
+    int buttons;
+
+    // current segment
+    int segment;
+    uint64_t segmentStart;
+    uint64_t segmentEnd;
+    double dirX;
+    double dirY;
+    double distance;        // counts
+    int reportedX;          // counts of the segment already sent
+    int reportedY;
+
+    // button changes waiting to be sent, each after a delay
+    int pendingButtons[4];
+    uint64_t pendingDelay[4];
+    int numPending;
+    int firstPending;
+
+    uint64_t numEvents;
+    uint64_t lostEvents;    // skipped sequence numbers
+    uint64_t numClicks;
+    uint64_t numChords;
+} synth_t;
+
+// a 1000 Hz, 800 dpi mouse with the mixed model, 10% jitter and no gaps
+void synth_settings_default(synth_settings_t *settings);
+
+void synth_init(synth_t *synth, const synth_settings_t *settings);
+
+// the next event, its timestamp is the time of the report
+void synth_next(synth_t *synth, mouse_event_t *event);
+
+const char *synth_model_name(synth_model_t model);
+// returns NO for an unknown name
+BOOL synth_model_from_name(const char *name, synth_model_t *model);
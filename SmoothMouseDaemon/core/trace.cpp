@@ -0,0 +1,478 @@
+#include "trace.h"
+#include "pipeline.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#ifdef __APPLE__
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+#define TRACE_MAX_THREADS (16)
+
+typedef struct trace_ring_s {
+    volatile int32_t in_use;
+    uint64_t head; // number of records ever written to this ring
+    trace_record_t *records;
+} trace_ring_t;
+
+typedef struct trace_entry_s {
+    uint64_t timestamp;
+    uint32_t ring;
+    uint64_t index;
+} trace_entry_t;
+
+static trace_ring_t rings[TRACE_MAX_THREADS];
+static uint32_t ring_size = 0;
+static pthread_key_t ring_key;
+
+static uint64_t trace_timestamp() {
+#ifdef __APPLE__
+    return mach_absolute_time();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+// called when a thread exits, the records stay in the ring and the next new
+// thread continues writing after them
+static void trace_release_ring(void *ring) {
+    __sync_synchronize();
+    ((trace_ring_t *)ring)->in_use = 0;
+}
+
+static trace_ring_t *trace_get_ring() {
+    if (ring_size == 0) {
+        return NULL;
+    }
+
+    trace_ring_t *ring = (trace_ring_t *)pthread_getspecific(ring_key);
+    if (ring != NULL) {
+        return ring;
+    }
+
+    for (int i = 0; i < TRACE_MAX_THREADS; i++) {
+        if (__sync_bool_compare_and_swap(&rings[i].in_use, 0, 1)) {
+            pthread_setspecific(ring_key, &rings[i]);
+            return &rings[i];
+        }
+    }
+
+    // more threads than rings, drop
+    return NULL;
+}
+
+static trace_record_t *trace_next_record(trace_ring_t *ring) {
+    trace_record_t *record = &ring->records[ring->head % ring_size];
+    ring->head++;
+    return record;
+}
+
+int trace_init(uint32_t records_per_thread) {
+    if (ring_size != 0) {
+        return 1;
+    }
+
+    if (pthread_key_create(&ring_key, trace_release_ring) != 0) {
+        return 0;
+    }
+
+    for (int i = 0; i < TRACE_MAX_THREADS; i++) {
+        rings[i].in_use = 0;
+        rings[i].head = 0;
+        rings[i].records = (trace_record_t *)calloc(records_per_thread, sizeof(trace_record_t));
+        if (rings[i].records == NULL) {
+            trace_cleanup();
+            return 0;
+        }
+    }
+
+    __sync_synchronize();
+    ring_size = records_per_thread;
+
+    return 1;
+}
+
+void trace_cleanup() {
+    ring_size = 0;
+    __sync_synchronize();
+    for (int i = 0; i < TRACE_MAX_THREADS; i++) {
+        free(rings[i].records);
+        rings[i].records = NULL;
+        rings[i].head = 0;
+    }
+}
+
+void trace_record(uint16_t id, int nargs, const int32_t *args) {
+    trace_ring_t *ring = trace_get_ring();
+    if (ring == NULL) {
+        return;
+    }
+
+    if (nargs > TRACE_MAX_ARGS) {
+        nargs = TRACE_MAX_ARGS;
+    }
+
+    trace_record_t *record = trace_next_record(ring);
+    record->timestamp = trace_timestamp();
+    record->id = id;
+    record->nargs = nargs;
+    memcpy(record->args, args, nargs * sizeof(int32_t));
+}
+
+void trace_text(const char *text) {
+    trace_ring_t *ring = trace_get_ring();
+    if (ring == NULL || text == NULL) {
+        return;
+    }
+
+    uint64_t timestamp = trace_timestamp();
+    size_t length = strlen(text);
+    uint16_t id = TRACE_EVENT_TEXT;
+
+    do {
+        size_t chunk = std::min(length, (size_t)TRACE_TEXT_BYTES);
+        trace_record_t *record = trace_next_record(ring);
+        record->timestamp = timestamp;
+        record->id = id;
+        record->nargs = chunk;
+        memcpy(record->args, text, chunk);
+        text += chunk;
+        length -= chunk;
+        id = TRACE_EVENT_TEXT_CONTINUED;
+    } while (length > 0);
+}
+
+static bool trace_entry_before(const trace_entry_t &a, const trace_entry_t &b) {
+    if (a.timestamp != b.timestamp) {
+        return a.timestamp < b.timestamp;
+    }
+    if (a.ring != b.ring) {
+        return a.ring < b.ring;
+    }
+    return a.index < b.index;
+}
+
+// calls callback for the records of all rings merged by timestamp
+static void trace_merge(const trace_ring_t *merged, uint32_t numRings, uint32_t size,
+                        trace_dump_callback_t callback, void *context) {
+    std::vector<trace_entry_t> entries;
+
+    for (uint32_t i = 0; i < numRings; i++) {
+        const trace_ring_t *ring = &merged[i];
+        uint64_t first = (ring->head > size) ? ring->head - size : 0;
+        for (uint64_t index = first; index < ring->head; index++) {
+            const trace_record_t *record = &ring->records[index % size];
+            // continuations are emitted together with the record they belong to
+            if (record->id == TRACE_EVENT_TEXT_CONTINUED) {
+                continue;
+            }
+            trace_entry_t entry = { record->timestamp, i, index };
+            entries.push_back(entry);
+        }
+    }
+
+    std::sort(entries.begin(), entries.end(), trace_entry_before);
+
+    std::vector<trace_entry_t>::iterator it;
+    for (it = entries.begin(); it != entries.end(); it++) {
+        const trace_ring_t *ring = &merged[it->ring];
+        const trace_record_t *record = &ring->records[it->index % size];
+
+        if (record->id != TRACE_EVENT_TEXT) {
+            callback(record, NULL, context);
+            continue;
+        }
+
+        std::string text((const char *)record->args, std::min((size_t)record->nargs, (size_t)TRACE_TEXT_BYTES));
+        for (uint64_t index = it->index + 1; index < ring->head; index++) {
+            const trace_record_t *continued = &ring->records[index % size];
+            if (continued->id != TRACE_EVENT_TEXT_CONTINUED) {
+                break;
+            }
+            text.append((const char *)continued->args, std::min((size_t)continued->nargs, (size_t)TRACE_TEXT_BYTES));
+        }
+        callback(record, text.c_str(), context);
+    }
+}
+
+// Must not be called while other threads are still recording
+void trace_dump(trace_dump_callback_t callback, void *context) {
+    if (ring_size == 0) {
+        return;
+    }
+    trace_merge(rings, TRACE_MAX_THREADS, ring_size, callback, context);
+}
+
+/*
+ The file starts with a trace_file_header_t, followed by every ring that was
+ used: its head and its records in ring order, min(head, records_per_ring) of
+ them.
+ */
+#define TRACE_FILE_MAGIC    (0x534d5452) // SMTR
+#define TRACE_FILE_VERSION  (1)
+
+typedef struct trace_file_header_s {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t records_per_ring;
+    uint32_t num_rings;
+    uint32_t timebase_numer;
+    uint32_t timebase_denom;
+    uint32_t reserved;
+} trace_file_header_t;
+
+// Must not be called while other threads are still recording
+int trace_write(const char *path) {
+    if (ring_size == 0) {
+        return 0;
+    }
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        return 0;
+    }
+
+    trace_file_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = TRACE_FILE_MAGIC;
+    header.version = TRACE_FILE_VERSION;
+    header.record_size = sizeof(trace_record_t);
+    header.records_per_ring = ring_size;
+#ifdef __APPLE__
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    header.timebase_numer = timebase.numer;
+    header.timebase_denom = timebase.denom;
+#else
+    header.timebase_numer = 1;
+    header.timebase_denom = 1;
+#endif
+    for (int i = 0; i < TRACE_MAX_THREADS; i++) {
+        if (rings[i].head > 0) {
+            header.num_rings++;
+        }
+    }
+
+    int ok = (fwrite(&header, sizeof(header), 1, file) == 1);
+    for (int i = 0; ok && i < TRACE_MAX_THREADS; i++) {
+        if (rings[i].head == 0) {
+            continue;
+        }
+        size_t count = (size_t)std::min(rings[i].head, (uint64_t)ring_size);
+        ok = (fwrite(&rings[i].head, sizeof(rings[i].head), 1, file) == 1 &&
+              fwrite(rings[i].records, sizeof(trace_record_t), count, file) == count);
+    }
+
+    if (fclose(file) != 0) {
+        ok = 0;
+    }
+    return ok;
+}
+
+int trace_read(const char *path, trace_file_info_t *info, trace_dump_callback_t callback, void *context) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return 0;
+    }
+
+    trace_file_header_t header;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        header.magic != TRACE_FILE_MAGIC ||
+        header.version != TRACE_FILE_VERSION ||
+        header.record_size != sizeof(trace_record_t) ||
+        header.records_per_ring == 0 ||
+        header.num_rings > TRACE_MAX_THREADS ||
+        header.timebase_denom == 0) {
+        fclose(file);
+        return 0;
+    }
+
+    std::vector<trace_ring_t> merged(header.num_rings);
+    std::vector<std::vector<trace_record_t> > records(header.num_rings);
+    int ok = 1;
+    for (uint32_t i = 0; ok && i < header.num_rings; i++) {
+        uint64_t head;
+        if (fread(&head, sizeof(head), 1, file) != 1) {
+            ok = 0;
+            break;
+        }
+        size_t count = (size_t)std::min(head, (uint64_t)header.records_per_ring);
+        records[i].resize(header.records_per_ring);
+        if (fread(&records[i][0], sizeof(trace_record_t), count, file) != count) {
+            ok = 0;
+            break;
+        }
+        merged[i].in_use = 0;
+        merged[i].head = head;
+        merged[i].records = &records[i][0];
+    }
+    fclose(file);
+
+    if (!ok) {
+        return 0;
+    }
+
+    info->timebase_numer = header.timebase_numer;
+    info->timebase_denom = header.timebase_denom;
+    info->num_overwritten = 0;
+    for (uint32_t i = 0; i < header.num_rings; i++) {
+        if (merged[i].head > header.records_per_ring) {
+            info->num_overwritten += merged[i].head - header.records_per_ring;
+        }
+    }
+
+    if (header.num_rings > 0) {
+        trace_merge(&merged[0], header.num_rings, header.records_per_ring, callback, context);
+    }
+    return 1;
+}
+
+uint64_t trace_num_overwritten() {
+    uint64_t overwritten = 0;
+    for (int i = 0; i < TRACE_MAX_THREADS; i++) {
+        if (ring_size != 0 && rings[i].head > ring_size) {
+            overwritten += rings[i].head - ring_size;
+        }
+    }
+    return overwritten;
+}
+
+#define ARG(i) ((i) < record->nargs ? record->args[(i)] : 0)
+#define ARG_TIME(i) (ARG(i) / 1000.0)
+#define ARG_U64(i) ((unsigned long long)TRACE_U64(ARG(i), ARG((i) + 1)))
+
+void trace_render_record(const trace_record_t *record, char *buffer, size_t size) {
+    switch (record->id) {
+        case TRACE_EVENT_MOUSE_MOVE:
+            snprintf(buffer, size, "processed move event: move dx: %02d, dy: %02d, new pos: %03dx%03d, delta: %02d,%02d, deltaPos: %03dx%03d, buttons(LRM456): %d%d%d%d%d%d, eventType: %s(%d), otherButton: %d",
+                     ARG(0),
+                     ARG(1),
+                     ARG(2),
+                     ARG(3),
+                     ARG(4),
+                     ARG(5),
+                     ARG(6),
+                     ARG(7),
+                     BUTTON_DOWN(ARG(8), LEFT_BUTTON),
+                     BUTTON_DOWN(ARG(8), RIGHT_BUTTON),
+                     BUTTON_DOWN(ARG(8), MIDDLE_BUTTON),
+                     BUTTON_DOWN(ARG(8), BUTTON4),
+                     BUTTON_DOWN(ARG(8), BUTTON5),
+                     BUTTON_DOWN(ARG(8), BUTTON6),
+                     driver_quartz_event_type_to_string((CGEventType)ARG(9)),
+                     ARG(9),
+                     ARG(10));
+            break;
+        case TRACE_EVENT_MOUSE_BUTTON:
+            snprintf(buffer, size, "processed button event: buttons(LRM456): %d%d%d%d%d%d, eventType: %s(%d), otherButton: %d, buttonIndex(654MRL): %d, nclicks: %d",
+                     BUTTON_DOWN(ARG(0), LEFT_BUTTON),
+                     BUTTON_DOWN(ARG(0), RIGHT_BUTTON),
+                     BUTTON_DOWN(ARG(0), MIDDLE_BUTTON),
+                     BUTTON_DOWN(ARG(0), BUTTON4),
+                     BUTTON_DOWN(ARG(0), BUTTON5),
+                     BUTTON_DOWN(ARG(0), BUTTON6),
+                     driver_quartz_event_type_to_string((CGEventType)ARG(1)),
+                     ARG(1),
+                     ARG(2),
+                     ARG(3),
+                     ARG(4));
+            break;
+        case TRACE_EVENT_MOUSE_SEQNUM:
+            snprintf(buffer, size, "seqnum: %llu, expected: %llu (%llu lost events)",
+                     ARG_U64(0),
+                     ARG_U64(2),
+                     ARG_U64(4));
+            break;
+        case TRACE_EVENT_KEXT_TIMINGS:
+            snprintf(buffer, size, "timings: outer: %f, inner: %f, process mouse event: %f, seqnum: %llu, burst: %d, coalesced: %d",
+                     ARG_TIME(0),
+                     ARG_TIME(1),
+                     ARG_TIME(2),
+                     ARG_U64(3),
+                     ARG(5),
+                     ARG(6));
+            break;
+        case TRACE_EVENT_DRIVER_CANT_COALESCE:
+            snprintf(buffer, size, "Can't Coalesce, t1: %d, t2: %d, b1: %d, b2: %d, ob1: %d, ob2: %d",
+                     ARG(0), ARG(1), ARG(2), ARG(3), ARG(4), ARG(5));
+            break;
+        case TRACE_EVENT_DRIVER_TIMINGS:
+            snprintf(buffer, size, "driver timings: total time time in mach time units: %f", ARG_TIME(0));
+            break;
+        case TRACE_EVENT_DRIVER_MOVE_QUARTZ_OLD:
+            snprintf(buffer, size, "%s:MOVE: pos.x: %d, pos.y: %d, time: %f",
+                     driver_get_driver_string(DRIVER_QUARTZ_OLD),
+                     ARG(0),
+                     ARG(1),
+                     ARG_TIME(2));
+            break;
+        case TRACE_EVENT_DRIVER_MOVE_QUARTZ:
+            snprintf(buffer, size, "%s:MOVE: eventType: %s(%d), pos.x: %d, pos.y: %d, dx: %d, dy: %d, time: %f",
+                     driver_get_driver_string(DRIVER_QUARTZ),
+                     driver_quartz_event_type_to_string((CGEventType)ARG(0)),
+                     ARG(0),
+                     ARG(1),
+                     ARG(2),
+                     ARG(3),
+                     ARG(4),
+                     ARG_TIME(5));
+            break;
+        case TRACE_EVENT_DRIVER_MOVE_IOHID:
+            snprintf(buffer, size, "%s:MOVE: eventType: %s(%d), newPoint: %dx%d, dx: %d, dy: %d, time: %f",
+                     driver_get_driver_string(DRIVER_IOHID),
+                     driver_iohid_event_type_to_string(ARG(0)),
+                     ARG(0),
+                     ARG(1),
+                     ARG(2),
+                     ARG(3),
+                     ARG(4),
+                     ARG_TIME(5));
+            break;
+        case TRACE_EVENT_DRIVER_BUTTON_QUARTZ_OLD:
+            snprintf(buffer, size, "%s:BUTTON: pos.x: %d, pos.y: %d, time: %f",
+                     driver_get_driver_string(DRIVER_QUARTZ_OLD),
+                     ARG(0),
+                     ARG(1),
+                     ARG_TIME(2));
+            break;
+        case TRACE_EVENT_DRIVER_BUTTON_QUARTZ:
+            snprintf(buffer, size, "%s:BUTTON: eventType: %s(%d), pos: %dx%d, csv: %d, time: %f",
+                     driver_get_driver_string(DRIVER_QUARTZ),
+                     driver_quartz_event_type_to_string((CGEventType)ARG(0)),
+                     ARG(0),
+                     ARG(1),
+                     ARG(2),
+                     ARG(3),
+                     ARG_TIME(4));
+            break;
+        case TRACE_EVENT_DRIVER_BUTTON_IOHID:
+            snprintf(buffer, size, "%s:BUTTON: eventType: %s(%d), pos: %dx%d, subt: %d, click: %d, pressure: %d, eventNumber: %d, buttonNumber: %d, time: %f",
+                     driver_get_driver_string(DRIVER_IOHID),
+                     driver_iohid_event_type_to_string(ARG(0)),
+                     ARG(0),
+                     ARG(1),
+                     ARG(2),
+                     ARG(3),
+                     ARG(4),
+                     ARG(5),
+                     ARG(6),
+                     ARG(7),
+                     ARG_TIME(8));
+            break;
+        default:
+            snprintf(buffer, size, "unknown trace event %d", (int)record->id);
+            break;
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ Binary trace used by memory logging (--memory). Every thread writes into its
+ own preallocated ring of fixed size records, so recording an event does not
+ format, allocate or lock. When a ring is full the oldest records are
+ overwritten. The records are only turned into text (trace_render_record)
+ once the daemon is shutting down, which also writes the rings as they are to
+ a file that smoothmouse-tracedecode (SmoothMouseTraceDecode) turns into text
+ elsewhere.
+ */
+
+#define TRACE_MAX_ARGS          (13)
+#define TRACE_TEXT_BYTES        (TRACE_MAX_ARGS * sizeof(int32_t))
+
+typedef enum trace_event_id_e {
+    TRACE_EVENT_TEXT,                   // LOG() message, args hold the text
+    TRACE_EVENT_TEXT_CONTINUED,         // rest of a LOG() message longer than TRACE_TEXT_BYTES
+    TRACE_EVENT_MOUSE_MOVE,
+    TRACE_EVENT_MOUSE_BUTTON,
+    TRACE_EVENT_MOUSE_SEQNUM,
+    TRACE_EVENT_KEXT_TIMINGS,
+    TRACE_EVENT_DRIVER_CANT_COALESCE,
+    TRACE_EVENT_DRIVER_TIMINGS,
+    TRACE_EVENT_DRIVER_MOVE_QUARTZ_OLD,
+    TRACE_EVENT_DRIVER_MOVE_QUARTZ,
+    TRACE_EVENT_DRIVER_MOVE_IOHID,
+    TRACE_EVENT_DRIVER_BUTTON_QUARTZ_OLD,
+    TRACE_EVENT_DRIVER_BUTTON_QUARTZ,
+    TRACE_EVENT_DRIVER_BUTTON_IOHID,
+    TRACE_EVENT_NUM_IDS
+} trace_event_id_t;
+
+typedef struct trace_record_s {
+    uint64_t timestamp;
+    uint16_t id;
+    uint16_t nargs; // number of args, or number of bytes for text records
+    int32_t args[TRACE_MAX_ARGS];
+} trace_record_t;
+
+// called for every record in timestamp order, text is the complete message for
+// TRACE_EVENT_TEXT records and NULL for all others
+typedef void (*trace_dump_callback_t)(const trace_record_t *record, const char *text, void *context);
+
+// 64-bit values are stored as two args
+#define TRACE_U64_LO(value) ((int32_t)((uint64_t)(value) & 0xffffffff))
+#define TRACE_U64_HI(value) ((int32_t)((uint64_t)(value) >> 32))
+#define TRACE_U64(lo, hi)   (((uint64_t)(uint32_t)(hi) << 32) | (uint32_t)(lo))
+
+// GET_TIME() values, stored with a resolution of 1/1000
+#define TRACE_TIME(value)   ((int32_t)((value) * 1000.0 > INT32_MAX ? INT32_MAX : (value) * 1000.0))
+
+int trace_init(uint32_t records_per_thread);
+void trace_cleanup();
+void trace_record(uint16_t id, int nargs, const int32_t *args);
+void trace_text(const char *text);
+void trace_dump(trace_dump_callback_t callback, void *context);
+uint64_t trace_num_overwritten();
+
+typedef struct trace_file_info_s {
+    // timestamps are in units of numer / denom nanoseconds (mach_timebase_info)
+    uint32_t timebase_numer;
+    uint32_t timebase_denom;
+    uint64_t num_overwritten;
+} trace_file_info_t;
+
+// writes the rings to path, returns 0 on failure, must not be called while
+// other threads are still recording
+int trace_write(const char *path);
+
+// calls callback for every record of a file written by trace_write() like
+// trace_dump() does, returns 0 if the file could not be read
+int trace_read(const char *path, trace_file_info_t *info, trace_dump_callback_t callback, void *context);
+
+// the human readable message of a record other than TRACE_EVENT_TEXT
+void trace_render_record(const trace_record_t *record, char *buffer, size_t size);
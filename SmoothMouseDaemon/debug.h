@@ -3,25 +3,21 @@
 
 #include "KextProtocol.h"
 #import "Config.h"
+#include "trace.h"
 #include <mach/mach_time.h>
-#include <pthread.h>
-#include <vector>
 
-extern double start, end, e1, e2, outerstart, outerend, outersum, outernum;
-extern std::vector<void *> logs;
 extern BOOL is_dumping;
-extern pthread_mutex_t log_mutex;
+extern BOOL memory_logging; // same as Config memoryLoggingEnabled once debug_start() ran
 
 #define GET_TIME() (mach_absolute_time()/1000.0);
+// duration between two latency_now() timestamps in GET_TIME() units
+#define TRACE_TIME_SPAN(start, end) TRACE_TIME(((end) - (start)) / 1000.0)
 #define LOG(format, ...) \
     if (!is_dumping) { \
-        if([[Config instance] memoryLoggingEnabled]) { \
+        if(memory_logging) { \
             NSString *s = [NSString stringWithFormat: format, ##__VA_ARGS__]; \
-            [s retain]; \
             if (s != nil) { \
-                pthread_mutex_lock(&log_mutex); \
-                logs.push_back(s); \
-                pthread_mutex_unlock(&log_mutex); \
+                trace_text([s UTF8String]); \
             } else { \
                 NSLog(@"log string nil! (%s, %d, %@)", __FILE__, __LINE__, format); \
             } \
@@ -30,6 +26,22 @@ extern pthread_mutex_t log_mutex;
         } \
     }
 
+// Same as LOG for the messages of the event path, but only records the
+// integer arguments when memory logging is enabled. The message is rendered
+// from the trace_event_id_t by trace_render_record.
+#define TRACE(id, ...) \
+    if (!is_dumping) { \
+        int32_t trace_args[] = { __VA_ARGS__ }; \
+        if(memory_logging) { \
+            trace_record((id), sizeof(trace_args) / sizeof(trace_args[0]), trace_args); \
+        } else { \
+            debug_log_trace_event((id), sizeof(trace_args) / sizeof(trace_args[0]), trace_args); \
+        } \
+    }
+
+void debug_start();
 void debug_register_event(mouse_event_t *event);
+void debug_log_trace_event(uint16_t id, int nargs, const int32_t *args);
+void debug_log_latency();
 void debug_end();
 
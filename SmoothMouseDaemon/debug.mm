@@ -3,18 +3,31 @@
 
 #import "Config.h"
 #import "Mouse.h"
+#include "latency.h"
 
 #import <Foundation/Foundation.h>
 #import <ApplicationServices/ApplicationServices.h>
 
 BOOL is_dumping;
+BOOL memory_logging;
 
 static int maxHz = -1;
 static int numHz = 0;
 static int sumHz = 0;
 
-std::vector<void *> logs;
-pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define TRACE_RECORDS_PER_THREAD (16384)
+
+void debug_start() {
+    if ([[Config instance] memoryLoggingEnabled]) {
+        if (!trace_init(TRACE_RECORDS_PER_THREAD)) {
+            NSLog(@"Failed to allocate trace buffers, disabling memory logging");
+            [[Config instance] setMemoryLoggingEnabled: NO];
+            [[Config instance] publishSnapshot];
+        }
+    }
+
+    memory_logging = [[Config instance] memoryLoggingEnabled];
+}
 
 void debug_register_event(mouse_event_t *event) {
     static long long lastTimestamp = 0;
@@ -35,32 +48,72 @@ void debug_register_event(mouse_event_t *event) {
     lastTimestamp = event->timestamp;
 }
 
+void debug_log_trace_event(uint16_t id, int nargs, const int32_t *args) {
+    trace_record_t record;
+    char buffer[512];
+
+    record.timestamp = 0;
+    record.id = id;
+    record.nargs = (nargs > TRACE_MAX_ARGS ? TRACE_MAX_ARGS : nargs);
+    memcpy(record.args, args, record.nargs * sizeof(int32_t));
+
+    trace_render_record(&record, buffer, sizeof(buffer));
+    NSLog(@"%s", buffer);
+}
+
+static void debug_dump_trace_record(const trace_record_t *record, const char *text, void *context) {
+    int *numRecords = (int *)context;
+    (*numRecords)++;
+
+    if (text != NULL) {
+        NSLog(@"%s", text);
+    } else {
+        char buffer[512];
+        trace_render_record(record, buffer, sizeof(buffer));
+        NSLog(@"%s", buffer);
+    }
+}
+
+void debug_log_latency() {
+    for (int i = 0; i < LATENCY_STAGE_NUM; i++) {
+        latency_stage_t stage = (latency_stage_t)i;
+        NSLog(@"Latency %s: count: %llu, p50: %.1f us, p99: %.1f us, p99.9: %.1f us, max: %.1f us",
+              latency_stage_name(stage),
+              latency_count(stage),
+              latency_percentile(stage, 50.0) / 1000.0,
+              latency_percentile(stage, 99.0) / 1000.0,
+              latency_percentile(stage, 99.9) / 1000.0,
+              latency_max(stage) / 1000.0);
+    }
+}
+
 void debug_end() {
     is_dumping = 1;
 
-    if (!logs.empty()) {
+    if ([[Config instance] memoryLoggingEnabled]) {
+        int numRecords = 0;
+
+        NSString *filename = [NSString stringWithFormat:@"SmoothMouse-trace-%ld.bin", (long)time(NULL)];
+        NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:filename];
+        if (trace_write([path fileSystemRepresentation])) {
+            NSLog(@"Trace written to %@ (decode with smoothmouse-tracedecode)", path);
+        } else {
+            NSLog(@"Failed to write trace to %@", path);
+        }
+
         NSLog(@"Dumping log");
-    } else {
-        NSLog(@"No logs to dump");
-    }
 
-    std::vector<void *>::iterator it;
-    for (it = logs.begin(); it != logs.end(); it++) {
-        NSString *log = (NSString *)*it;
-        if (log == nil) {
-            NSLog(@"log nil, should never happen");
-            exit(1);
+        trace_dump(debug_dump_trace_record, &numRecords);
+
+        if (numRecords == 0) {
+            NSLog(@"No logs to dump");
+        } else {
+            NSLog(@"Dumping complete (%llu older records overwritten)", trace_num_overwritten());
         }
-        NSLog(@"%@", log);
-        [log release];
     }
 
     if ([[Config instance] timingsEnabled]) {
-        NSLog(@"outer average: %f", (outersum / outernum));
-    }
-
-    if (!logs.empty()) {
-        NSLog(@"Dumping complete");
+        debug_log_latency();
     }
 
     NSLog(@"Number of lost kext events: %d", totalNumberOfLostEvents);
@@ -0,0 +1,138 @@
+/*
+ Generates OSXFunctionTables.h from the acceleration tables libpointing
+ embeds as Base64 encoded big endian data. The tables are written as native
+ structs, so OSXFunction needs neither to decode nor to byte swap them at
+ runtime. Run it after changing a table:
+
+   c++ -o generate-tables SmoothMouseDaemon/libpointing/GenerateOSXFunctionTables.cpp
+   ./generate-tables > SmoothMouseDaemon/libpointing/OSXFunctionTables.h
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+
+typedef struct table_source_s {
+    const char *name;
+    const char *comment;
+    const char *base64;
+} table_source_t;
+
+static const table_source_t sources[] = {
+    { "mouse", "Generic mouse, OS X 10.6.0",
+      "AACAAFVTQioABwAAAAAAAQABAAAAAQAAAAAgAAAQAABxOwAATOMABE7FAA03BAAFRAAAFIAAAAcsAAAj4AAACQAAADSwAAAK2AAARfAAAA0IAABXkAAAD2AAAGkAAAASEAAAeoAAABUAAACJAAAAF8AAAJEAAAAawAAAlrAAAB2QAACZsAAAIKAAAJswAAAj8AAAnDAAACewAACcMAAAAIAAABIAAHE7AABWfwAESgAADqAAAAY6AAAfQAAABygAACkAAAAI2AAAPGAAAAm4AABHQAAACrAAAFMwAAALwAAAYDAAAAzAAABsIAAADuAAAIQgAAARYAAAnSAAABQAAAC0AAAAFsAAAMcAAAAZoAAA1AAAABzgAADbAAAAIIAAAOAAAAAkQAAA4wAAACegAADjAAAAALAAABQAAHE7AABhTgAESgAAD2AAAAUyAAAXYAAABjIAACCgAAAHLAAALCAAAAgIAAA3oAAACOQAAENAAAAJwAAAUIAAAAqgAABfIgAAC5AAAG1wAAAMcAAAewAAAA6AAACYoAAAEMAAALYAAAATQAAA0gAAABZgAADpAAAAGiAAAPoAAAAdoAABAwAAACEgAAEHAAAAJIAAAQoAAAAnoAABDAAAAADgAAARAABxOwAAbXcABBoAABHwAAAFGgAAG/AAAAXwAAAmYAAABvwAADQAAAAITAAAT+AAAAlsAABt4AAACngAAI3AAAALsAAAtkAAAA1QAADZgAAAEQAAAPeAAAAVwAABEQAAABlgAAEgAAAAHUAAASgAAAAhAAABLgAAACSAAAEyAAAAJ4AAATUAAAAAUAAAEgAAcTsAAEuwAARMAAAOAAAABUAAABVQAAAHJAAAJiAAAAi0AAA1wAAACpAAAEmAAAAL6AAAVoAAAA0gAABiAAAADhgAAGrQAAAPGAAAdAAAABGQAACHgAAAFFAAAJoAAAAXYAAAqYAAABpgAAC0AAAAHVAAALkAAAAg0AAAvIAAACQgAAC9gAAAJ7AAAL6AAAABAAAAEAAAcTsAAFZ/AAO4AAASoAAABSAAACVAAAAGCAAAN4AAAAbwAABfAAAAB/AAAIoAAAAJKAAAyyAAAArwAAD3gAAADSAAARyAAAAQAAABOAAAABRAAAFKAAAAGQAAAVMAAAAc0AABVwAAACDgAAFbgAAAJCAAAV2AAAAnoAABXgAAAFJwAAAJlNEAWTAAAAoSaQBf8AAACpAAAGawAAAA4AAAHAABGFUAATAAAAGyKAAC8AAAAlNpAAagAAADb0oAENAAAAOteAAUWAAAA+ulABfgAAAEKdMAG2gAAARoAAAe8AAABKIBACKYAAAE2VYAJiAAAAUUqwApaAAABVAAACywAAAFgAEAMcgAAAW1VgA2QAAABeqrADq4AAAGIAAAPzAAAAZiAABD3AAABp6rAEh4AAAG21YATRQAAAcYAABRsAAAB3oBAFbcAAAH2VYAW/gAAAg4qwBhFAAACJgAAGYwAAAJFgEAbAAAAAmRVgBx0AAACgyrAHegAAAKiAAAfXAAAAEAAAATAAEYVQABMAAAAbIoAAMQAAACU2kABxAAAAMvSgARgAAAA6z7AByIAAAEOqsAKOAAAASBVgAwiAAABMgAADgwAAAFDVYAQJgAAAVQAABI8AAABcarAFKwAAAGOAAAXHAAAAbxVgBnwAAAB0yrAG1YAAAHqAAAcvAAAAhMAAB5BAAACPAAAH8YAAAJlAAAhSwAAAo4AACLQAA=" },
+    { "touchpad", "Multitouch, OS X 10.6.0",
+      "AACAAFVTQioABwAAAAAAAgAEAAAABAAAABAAAAAQAAAAACAAAA0AAIAAAACAAAABQAAAAYAAAAIAAAAC4AAAAwAAAATgAAAEAAAAB0AAAAUAAAAKAAAABgAAAA1AAAAIAAAAFgAAAArAAAAjAAAADQAAAC8AAAAOwAAAOMAAABBAAABBAAAAEcAAAEjAAAAAUAAADwAAgAAAAIAAAAEAAAABQAAAAYAAAAJAAAACAAAAA4AAAAKAAAAE4AAAAwAAAAZgAAAEAAAACgAAAAUAAAAOQAAABgAAABNAAAAIAAAAHsAAAArAAAAuwAAADQAAADyAAAAOwAAARwAAABBAAABPwAAAEcAAAFiAAAAAgAAADwAAgAAAAIAAAAEAAAABYAAAAYAAAAKgAAACAAAABEAAAAKAAAAGAAAAAwAAAAgAAAAEAAAADQAAAAUAAAASwAAABgAAABkAAAAIAAAAKAAAAArAAAA7wAAADQAAAEuAAAAOwAAAV0AAABBAAABgQAAAEcAAAGkAAAAAsAAADwAAgAAAAIAAAAEAAAABoAAAAYAAAAMAAAACAAAABQAAAAKAAAAHQAAAAwAAAAnAAAAEAAAAEEAAAAUAAAAXgAAABgAAAB/AAAAIAAAAMgAAAArAAABKAAAADQAAAFyAAAAOwAAAaQAAABBAAABywAAAEcAAAHrAAAAA4AAADwAAgAAAAKAAAAEAAAABwAAAAYAAAANgAAACAAAABeAAAAKAAAAIoAAAAwAAAAvAAAAEAAAAE8AAAAUAAAAdQAAABgAAACfAAAAIAAAAPcAAAArAAABZAAAADQAAAG3AAAAOwAAAe0AAABBAAACFQAAAEcAAAIxAAAABAAAADwAAgAAAAMAAAAEAAAACAAAAAYAAAAPgAAACAAAABsAAAAKAAAAKQAAAAwAAAA5gAAAEAAAAGMAAAAUAAAAkwAAABgAAADLAAAAIAAAATUAAAArAAABugAAADQAAAIMAAAAOwAAAj0AAABBAAACXAAAAEcAAAJxAAA==" },
+    { "iohipointing", "Hard-coded table of IOHIPointing.cpp",
+      "AACAAEAyMDAAAgAAAAAAAQABAAAAAQAAAAEAAAAJAABxOwAAYAAABE7FABCAAAAMAAAAXwAAABbsTwCLAAAAHTsUAJSAAAAidicAlgAAACRidgCWAAAAJgAAAJYAAAAoAAAAlgAA" },
+};
+
+static std::string decode(const char *input) {
+    std::string result;
+    uint32_t bits = 0;
+    int numBits = 0;
+    for (const char *c = input; *c != '\0' && *c != '='; c++) {
+        int value;
+        if (*c >= 'A' && *c <= 'Z') {
+            value = *c - 'A';
+        } else if (*c >= 'a' && *c <= 'z') {
+            value = *c - 'a' + 26;
+        } else if (*c >= '0' && *c <= '9') {
+            value = *c - '0' + 52;
+        } else if (*c == '+') {
+            value = 62;
+        } else if (*c == '/') {
+            value = 63;
+        } else {
+            continue;
+        }
+        bits = (bits << 6) | value;
+        numBits += 6;
+        if (numBits >= 8) {
+            numBits -= 8;
+            result += (char)((bits >> numBits) & 0xff);
+        }
+    }
+    return result;
+}
+
+static uint32_t read_big(const std::string &data, size_t *offset, int size) {
+    if (*offset + size > data.size()) {
+        fprintf(stderr, "table truncated at %d\n", (int)*offset);
+        exit(1);
+    }
+    uint32_t value = 0;
+    for (int i = 0; i < size; i++) {
+        value = (value << 8) | (uint8_t)data[(*offset)++];
+    }
+    return value;
+}
+
+static void generate(const table_source_t *source) {
+    std::string data = decode(source->base64);
+    size_t offset = 0;
+
+    int32_t scale = (int32_t)read_big(data, &offset, 4);
+    offset += 4; // table signature
+    int count = (int)read_big(data, &offset, 2);
+
+    printf("// %s\n\n", source->comment);
+
+    int32_t accl[64];
+    int points[64];
+    if (count > 64) {
+        fprintf(stderr, "%s: too many curves\n", source->name);
+        exit(1);
+    }
+
+    for (int i = 0; i < count; i++) {
+        accl[i] = (int32_t)read_big(data, &offset, 4);
+        points[i] = (int)read_big(data, &offset, 2);
+        printf("static const int32_t osx_%s_points_%d[][2] = {\n", source->name, i);
+        for (int p = 0; p < points[i]; p++) {
+            int32_t x = (int32_t)read_big(data, &offset, 4);
+            int32_t y = (int32_t)read_big(data, &offset, 4);
+            printf("    { 0x%08x, 0x%08x },\n", (uint32_t)x, (uint32_t)y);
+        }
+        printf("};\n\n");
+    }
+
+    printf("static const OSXAccelerationCurve osx_%s_curves[] = {\n", source->name);
+    for (int i = 0; i < count; i++) {
+        printf("    { 0x%08x, %d, osx_%s_points_%d },\n", (uint32_t)accl[i], points[i], source->name, i);
+    }
+    printf("};\n\n");
+
+    printf("static const OSXAccelerationTable osx_%s_table = { 0x%08x, %d, osx_%s_curves };\n\n",
+           source->name, (uint32_t)scale, count, source->name);
+
+    // some tables have more data after the last curve, SetupAcceleration()
+    // never reads it
+}
+
+int main() {
+    printf("// Generated by GenerateOSXFunctionTables.cpp, do not edit.\n\n");
+    printf("#pragma once\n\n");
+    printf("#include <stdint.h>\n\n");
+    printf("// one acceleration curve, points are (device speed, cursor speed) pairs in\n");
+    printf("// 16.16 fixed point\n");
+    printf("typedef struct OSXAccelerationCurve {\n");
+    printf("    int32_t accl;\n");
+    printf("    int32_t numPoints;\n");
+    printf("    const int32_t (*points)[2];\n");
+    printf("} OSXAccelerationCurve;\n\n");
+    printf("// the curves ordered by acceleration, scale is the table's default setting\n");
+    printf("typedef struct OSXAccelerationTable {\n");
+    printf("    int32_t scale;\n");
+    printf("    int32_t numCurves;\n");
+    printf("    const OSXAccelerationCurve *curves;\n");
+    printf("} OSXAccelerationTable;\n\n");
+
+    for (size_t i = 0; i < sizeof(sources) / sizeof(sources[0]); i++) {
+        generate(&sources[i]);
+    }
+
+    return 0;
+}
@@ -11,6 +11,7 @@
  */
 
 #include "OSXFunction.hpp"
+#include "OSXFunctionTables.h"
 
 //#include <pointing-osx/transferfunctions/OSXFunction.h>
 
@@ -24,8 +25,24 @@
 
 #include <iostream>
 #include <sstream>
+#include <vector>
 
 #include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #undef DEBUG
 #ifdef DEBUG
@@ -49,6 +66,7 @@
 
 #define SInt64 int64_t
 #define SInt32 int32_t
+#define SInt16 int16_t
 #define UInt16 uint16_t
 #define UInt32 uint32_t
 #define UInt8 uint8_t
@@ -57,165 +75,6 @@
 
 
 
-namespace Base64 {
-    std::string encode(std::string input) ;
-    std::string decode(std::string input) ;
-}
-
-std::string
-Base64::encode(std::string input) {
-    std::string result ;
-
-    unsigned char dtable[256] ;
-    for(int i= 0;i<9;i++){
-        dtable[i]= 'A'+i;
-        dtable[i+9]= 'J'+i;
-        dtable[26+i]= 'a'+i;
-        dtable[26+i+9]= 'j'+i;
-    }
-    for(int i= 0;i<8;i++){
-        dtable[i+18]= 'S'+i;
-        dtable[26+i+18]= 's'+i;
-    }
-    for(int i= 0;i<10;i++) dtable[52+i]= '0'+i;
-    dtable[62]= '+';
-    dtable[63]= '/';
-
-    unsigned int length = (unsigned int)input.length() ;
-    for (unsigned int iInput=0; iInput<length;) {
-        unsigned char igroup[3],ogroup[4];
-        igroup[0]= igroup[1]= igroup[2]= 0;
-        int n = 0 ;
-        while (n<3 && iInput<length)
-            igroup[n++]= (unsigned char)input[iInput++] ;
-        if(n> 0){
-            ogroup[0]= dtable[igroup[0]>>2];
-            ogroup[1]= dtable[((igroup[0]&3)<<4)|(igroup[1]>>4)];
-            ogroup[2]= dtable[((igroup[1]&0xF)<<2)|(igroup[2]>>6)];
-            ogroup[3]= dtable[igroup[2]&0x3F];
-            if(n<3){
-                ogroup[3]= '=';
-                if(n<2) ogroup[2]= '=';
-            }
-            for(int i= 0;i<4;i++) result = result + (char)ogroup[i] ;
-        }
-    }
-
-    return result ;
-}
-
-std::string
-Base64::decode(std::string input) {
-    std::string result ;
-
-    unsigned char dtable[256] ;
-    for(int i= 0;i<255;i++) dtable[i]= 0x80;
-    for(int i= 'A';i<='I';i++) dtable[i]= 0+(i-'A');
-    for(int i= 'J';i<='R';i++) dtable[i]= 9+(i-'J');
-    for(int i= 'S';i<='Z';i++) dtable[i]= 18+(i-'S');
-    for(int i= 'a';i<='i';i++) dtable[i]= 26+(i-'a');
-    for(int i= 'j';i<='r';i++) dtable[i]= 35+(i-'j');
-    for(int i= 's';i<='z';i++) dtable[i]= 44+(i-'s');
-    for(int i= '0';i<='9';i++) dtable[i]= 52+(i-'0');
-    dtable[(int)'+']= 62;
-    dtable[(int)'/']= 63;
-    dtable[(int)'=']= 0;
-
-    unsigned int length = (unsigned int)input.length() ;
-    for (unsigned int iInput=0 ;;) {
-        unsigned char a[4],b[4],o[3];
-
-        for(int i= 0;i<4;i++){
-            if (iInput==length) {
-                // Incomplete input
-                return result ;
-            }
-            int c = (int)input[iInput++] ;
-            if(dtable[c]&0x80){
-                i--; // Illegal character
-                continue;
-            }
-            a[i]= (unsigned char)c;
-            b[i]= (unsigned char)dtable[c];
-        }
-
-        o[0]= (b[0]<<2)|(b[1]>>4);
-        o[1]= (b[1]<<4)|(b[2]>>2);
-        o[2]= (b[2]<<6)|b[3];
-
-        int i= a[2]=='='?1:(a[3]=='='?2:3);
-        result.append((char*)o,i) ;
-        if(i<3) return result ;
-    }
-
-    return result ;
-}
-
-
-
-bool isLittleEndian(void) {
-    static uint32_t littleEndianTest = 1 ;
-    return (*(char *)&littleEndianTest == 1) ;
-}
-
-uint16_t swap16(uint16_t arg) {
-    return ((((arg) & 0xff) << 8) | (((arg) >> 8) & 0xff)) ;
-}
-
-uint16_t swap16ifle(uint16_t arg) {
-    return isLittleEndian() ? swap16(arg) : arg ;
-}
-
-uint32_t swap32(uint32_t arg) {
-    return ((((arg) & 0xff000000) >> 24) | \
-            (((arg) & 0x00ff0000) >> 8)  | \
-            (((arg) & 0x0000ff00) << 8)  | \
-            (((arg) & 0x000000ff) << 24)) ;
-}
-
-uint32_t swap32ifle(uint32_t arg) {
-    return isLittleEndian() ? swap32(arg) : arg ;
-    return arg ;
-}
-
-
-// -----------------------------------------------------------------------
-// Inspired from /System/Library/Frameworks/Kernel.framework/Headers/libkern/OSByteOrder.h
-
-static inline uint16_t
-OSReadBigInt16(const volatile void *base, uintptr_t byteOffset) {
-    char *ptr = (char*)base+byteOffset ;
-    return swap16ifle(*(uint16_t*)ptr) ;
-}
-
-static inline uint32_t
-OSReadBigInt32(const volatile void *base, uintptr_t byteOffset) {
-    char *ptr = (char*)base+byteOffset ;
-    return swap32ifle(*(uint32_t*)ptr) ;
-}
-
-
-// -----------------------------------------------------------------------
-// Inspired from /System/Library/Frameworks/Kernel.framework/Headers/libkern/c++/OSData.h
-class OSData {
-    int retainCount ;
-    void *data ;
-    unsigned int length ;
-public:
-    OSData(void *bytes, unsigned int numBytes) : retainCount(1), data(bytes), length(numBytes) {}
-    void release(void) {
-        retainCount-- ;
-        if (!retainCount) delete this ;
-    }
-    const void *getBytesNoCopy(void) {
-        return data ;
-    }
-    static OSData *withBytesNoCopy(void *bytes, unsigned int numBytes) {
-        return new OSData(bytes, numBytes) ;
-    }
-} ;
-
-
 // -----------------------------------------------------------------------
 // From /System/Library/Frameworks/IOKit.framework/Headers/IOTypes.h
 
@@ -249,6 +108,8 @@ typedef SInt32                          Fixed;
 #define abs(_a)	((_a >= 0) ? _a : -_a)
 #endif
 
+// what IOHIPointing sets the acceleration up for, the frame rate and screen
+// resolution can be changed with OSXFunction::setResolutions()
 #define FRAME_RATE                  (67 << 16)
 #define SCREEN_RESOLUTION           (96 << 16)
 
@@ -311,9 +172,13 @@ static SInt32 Interpolate(  SInt32 x1, SInt32 y1,
 // RY: This function contains the original portions of
 // setupForAcceleration.  This was separated out to
 // accomidate the acceleration of scroll axes
-bool SetupAcceleration (OSData * data, IOFixed desired, IOFixed devScale, IOFixed crsrScale, void ** scaleSegments, IOItemCount * scaleSegCount) {
-    const UInt16 *	lowTable = 0;
-    const UInt16 *	highTable;
+// The table is read from the native structs generated from the original big
+// endian data (OSXFunctionTables.h) instead of byte swapping it here.
+bool SetupAcceleration (const OSXAccelerationTable * data, IOFixed desired, IOFixed devScale, IOFixed crsrScale, void ** scaleSegments, IOItemCount * scaleSegCount) {
+    const OSXAccelerationCurve *	lowCurve = 0;
+    const OSXAccelerationCurve *	highCurve;
+    const SInt32 (*	lowTable)[2];
+    const SInt32 (*	highTable)[2];
 
     SInt32	x1, y1, x2, y2, x3, y3;
     SInt32	prevX1, prevY1;
@@ -342,16 +207,14 @@ bool SetupAcceleration (OSData * data, IOFixed desired, IOFixed devScale, IOFixe
                      CursorDeviceSegment, *scaleSegCount );
         *scaleSegments = NULL;
         *scaleSegCount = 0;
-        data->release();
         return false;
     }
 
-    highTable = (const UInt16 *) data->getBytesNoCopy();
+    highCurve = data->curves;
 
     scaledX1 = scaledY1 = 0;
 
-    scale = OSReadBigInt32((volatile void *)highTable, 0);
-    highTable += 4;
+    scale = data->scale;
 
     // normalize table's default (scale) to 0.5
     if( desired > 0x8000) {
@@ -364,14 +227,13 @@ bool SetupAcceleration (OSData * data, IOFixed desired, IOFixed devScale, IOFixe
         desired <<= 1;
     }
 
-    count = OSReadBigInt16((volatile void *)(highTable++), 0);
+    count = data->numCurves;
     scale = (1 << 16);
 
     // find curves bracketing the desired value
     do {
-        highAccl = OSReadBigInt32((volatile void *)highTable, 0);
-        highTable += 2;
-        highPoints = OSReadBigInt16((volatile void *)(highTable++), 0);
+        highAccl = highCurve->accl;
+        highPoints = highCurve->numPoints;
 
         if( desired <= highAccl)
             break;
@@ -379,19 +241,22 @@ bool SetupAcceleration (OSData * data, IOFixed desired, IOFixed devScale, IOFixe
         if( 0 == --count) {
             // this much over the highest table
             scale = (highAccl) ? IOFixedDivide( desired, highAccl ) : 0;
-            lowTable	= 0;
+            lowCurve	= 0;
             break;
         }
 
-        lowTable	= highTable;
+        lowCurve	= highCurve;
         lowAccl		= highAccl;
         lowPoints	= highPoints;
-        highTable	+= lowPoints * 4;
+        highCurve++;
 
     } while( true );
 
+    highTable = highCurve->points;
+
     // scale between the two
-    if( lowTable) {
+    if( lowCurve) {
+        lowTable = lowCurve->points;
         scale = (highAccl == lowAccl) ? 0 :
         IOFixedDivide((desired - lowAccl), (highAccl - lowAccl));
 
@@ -417,14 +282,12 @@ bool SetupAcceleration (OSData * data, IOFixed desired, IOFixed devScale, IOFixe
 
     x1 = prevX1 = y1 = prevY1 = 0;
 
-    lowerX = OSReadBigInt32((volatile void *)lowTable, 0);
-    lowTable += 2;
-    lowerY = OSReadBigInt32((volatile void *)lowTable, 0);
-    lowTable += 2;
-    upperX = OSReadBigInt32((volatile void *)highTable, 0);
-    highTable += 2;
-    upperY = OSReadBigInt32((volatile void *)highTable, 0);
-    highTable += 2;
+    lowerX = (*lowTable)[0];
+    lowerY = (*lowTable)[1];
+    lowTable++;
+    upperX = (*highTable)[0];
+    upperY = (*highTable)[1];
+    highTable++;
 
     do {
         // consume next point from first X
@@ -437,10 +300,9 @@ bool SetupAcceleration (OSData * data, IOFixed desired, IOFixed devScale, IOFixe
             x3 = lowerX;
             y3 = lowerY;
             if( lowPoints && (--lowPoints)) {
-                lowerX = OSReadBigInt32((volatile void *)lowTable, 0);
-                lowTable += 2;
-                lowerY = OSReadBigInt32((volatile void *)lowTable, 0);
-                lowTable += 2;
+                lowerX = (*lowTable)[0];
+                lowerY = (*lowTable)[1];
+                lowTable++;
             }
         } else  {
             /* lowline */
@@ -449,10 +311,9 @@ bool SetupAcceleration (OSData * data, IOFixed desired, IOFixed devScale, IOFixe
             x3 = upperX;
             y3 = upperY;
             if( highPoints && (--highPoints)) {
-                upperX = OSReadBigInt32((volatile void *)highTable, 0);
-                highTable += 2;
-                upperY = OSReadBigInt32((volatile void *)highTable, 0);
-                highTable += 2;
+                upperX = (*highTable)[0];
+                upperY = (*highTable)[1];
+                highTable++;
             }
         }
         {
@@ -575,6 +436,233 @@ void ScaleAxes (void * scaleSegments, int * axis1p, IOFixed *axis1Fractp, int *
         *axis2Fractp = dy | 0xffff0000;
 }
 
+// -----------------------------------------------------------------------
+// Table driven variant of ScaleAxes (not part of IOHIPointing.cpp)
+
+// For integer mickeys ScaleAxes always ends up with mag == (2*max + min) << 15,
+// so the segment and the resulting scale only depend on that integer. The
+// table holds the scale ScaleAxes would compute for every such value below
+// tableSize, which turns the segment walk and the division into a single load.
+
+#define SCALE_TABLE_SIZE            2048
+
+void BuildScaleTable (void * scaleSegments, IOFixed * table, UInt32 tableSize)
+{
+    SInt32			mag;
+    CursorDeviceSegment	*	segment;
+
+    assert( tableSize <= 0x10000 );
+
+    table[0] = 0;
+
+    for( UInt32 index = 1; index < tableSize; index++) {
+        mag = (SInt32) (index << 15);
+
+        for(
+            segment = (CursorDeviceSegment *) scaleSegments;
+            mag > segment->devUnits;
+            segment++)	{}
+
+        table[index] = IOFixedDivide(
+                                     segment->intercept + IOFixedMultiply( mag, segment->slope ),
+                                     mag );
+    }
+}
+
+void ScaleAxesWithTable (const IOFixed * table, UInt32 tableSize, void * scaleSegments, int * axis1p, IOFixed *axis1Fractp, int * axis2p, IOFixed *axis2Fractp)
+{
+    SInt32			dx, dy;
+    UInt32			absX, absY;
+    UInt32			index;
+    IOFixed			scale;
+
+    if( !table) {
+        ScaleAxes(scaleSegments, axis1p, axis1Fractp, axis2p, axis2Fractp);
+        return;
+    }
+
+    absX = abs(*axis1p);
+    absY = abs(*axis2p);
+
+    // larger magnitudes are rare enough to take the segment walk
+    if( absX >= tableSize || absY >= tableSize) {
+        ScaleAxes(scaleSegments, axis1p, axis1Fractp, axis2p, axis2Fractp);
+        return;
+    }
+
+    if( absX > absY)
+        index = 2 * absX + absY;
+    else
+        index = 2 * absY + absX;
+
+    if( index >= tableSize) {
+        ScaleAxes(scaleSegments, axis1p, axis1Fractp, axis2p, axis2Fractp);
+        return;
+    }
+
+    if( !index)
+        return;
+
+    scale = table[index];
+
+    dx = IOFixedMultiply( (*axis1p) << 16, scale );
+    dy = IOFixedMultiply( (*axis2p) << 16, scale );
+
+    // add fract parts
+    dx += *axis1Fractp;
+    dy += *axis2Fractp;
+
+    *axis1p = dx / 65536;
+    *axis2p = dy / 65536;
+
+    // get fractional part with sign extend
+    if( dx >= 0)
+        *axis1Fractp = dx & 0xffff;
+    else
+        *axis1Fractp = dx | 0xffff0000;
+    if( dy >= 0)
+        *axis2Fractp = dy & 0xffff;
+    else
+        *axis2Fractp = dy | 0xffff0000;
+}
+
+// -----------------------------------------------------------------------
+// Batch variant of ScaleAxesWithTable (not part of IOHIPointing.cpp)
+
+// The scale of an event only depends on its own deltas, so a burst is done in
+// two passes over chunks of events: the table indexes (the magnitudes) and
+// the scales are computed for the whole chunk at once, several events per
+// instruction where the CPU can, then the deltas are scaled and the
+// fractional parts carried from one event to the next in order.
+
+#define SCALE_BATCH_CHUNK           64
+
+// 2 * max + min of the absolute deltas, saturated at 0xffff, which is beyond
+// any table
+static void ScaleIndexes (const SInt16 * axis1, const SInt16 * axis2, UInt16 * indexes, UInt32 count)
+{
+    UInt32 i = 0;
+
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for( ; i + 8 <= count; i += 8) {
+        __m128i dx = _mm_loadu_si128((const __m128i *) (axis1 + i));
+        __m128i dy = _mm_loadu_si128((const __m128i *) (axis2 + i));
+        // saturating negation, |-32768| becomes 32767 and stays positive
+        __m128i absX = _mm_max_epi16(dx, _mm_subs_epi16(zero, dx));
+        __m128i absY = _mm_max_epi16(dy, _mm_subs_epi16(zero, dy));
+        __m128i larger = _mm_max_epi16(absX, absY);
+        __m128i smaller = _mm_min_epi16(absX, absY);
+        __m128i index = _mm_adds_epu16(_mm_adds_epu16(larger, larger), smaller);
+        _mm_storeu_si128((__m128i *) (indexes + i), index);
+    }
+#elif defined(__ARM_NEON)
+    for( ; i + 8 <= count; i += 8) {
+        int16x8_t absX = vqabsq_s16(vld1q_s16(axis1 + i));
+        int16x8_t absY = vqabsq_s16(vld1q_s16(axis2 + i));
+        uint16x8_t larger = vreinterpretq_u16_s16(vmaxq_s16(absX, absY));
+        uint16x8_t smaller = vreinterpretq_u16_s16(vminq_s16(absX, absY));
+        vst1q_u16(indexes + i, vqaddq_u16(vqaddq_u16(larger, larger), smaller));
+    }
+#endif
+
+    for( ; i < count; i++) {
+        UInt32 absX = abs((SInt32) axis1[i]);
+        UInt32 absY = abs((SInt32) axis2[i]);
+        UInt32 index = (absX > absY) ? 2 * absX + absY : 2 * absY + absX;
+        indexes[i] = (UInt16) ((index > 0xffff) ? 0xffff : index);
+    }
+}
+
+// the scale of each index below tableSize, 0 for the others
+static void ScaleLookup (const IOFixed * table, UInt32 tableSize, const UInt16 * indexes, IOFixed * scales, UInt32 count)
+{
+    UInt32 i = 0;
+
+#if defined(__AVX2__)
+    const __m256i size = _mm256_set1_epi32((int) tableSize);
+    for( ; i + 8 <= count; i += 8) {
+        __m256i index = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) (indexes + i)));
+        __m256i inTable = _mm256_cmpgt_epi32(size, index);
+        // the others load table[0] and are masked out
+        __m256i scale = _mm256_i32gather_epi32((const int *) table, _mm256_and_si256(index, inTable), 4);
+        _mm256_storeu_si256((__m256i *) (scales + i), _mm256_and_si256(scale, inTable));
+    }
+#endif
+
+    for( ; i < count; i++) {
+        scales[i] = (indexes[i] < tableSize) ? table[indexes[i]] : 0;
+    }
+}
+
+void ScaleAxesBatch (const IOFixed * table, UInt32 tableSize, void * scaleSegments,
+                     const SInt16 * axis1, const SInt16 * axis2, int * axis1Out, int * axis2Out, UInt32 count,
+                     IOFixed *axis1Fractp, IOFixed *axis2Fractp)
+{
+    UInt16			indexes[SCALE_BATCH_CHUNK];
+    IOFixed			scales[SCALE_BATCH_CHUNK];
+    SInt32			dx, dy;
+    IOFixed			axis1Fract, axis2Fract;
+
+    if( !table) {
+        for( UInt32 i = 0; i < count; i++) {
+            axis1Out[i] = axis1[i];
+            axis2Out[i] = axis2[i];
+            ScaleAxes(scaleSegments, &axis1Out[i], axis1Fractp, &axis2Out[i], axis2Fractp);
+        }
+        return;
+    }
+
+    axis1Fract = *axis1Fractp;
+    axis2Fract = *axis2Fractp;
+
+    for( UInt32 base = 0; base < count; base += SCALE_BATCH_CHUNK) {
+        UInt32 n = count - base;
+        if( n > SCALE_BATCH_CHUNK)
+            n = SCALE_BATCH_CHUNK;
+
+        ScaleIndexes(axis1 + base, axis2 + base, indexes, n);
+        ScaleLookup(table, tableSize, indexes, scales, n);
+
+        for( UInt32 i = 0; i < n; i++) {
+            axis1Out[base + i] = axis1[base + i];
+            axis2Out[base + i] = axis2[base + i];
+
+            // larger magnitudes take the segment walk like in
+            // ScaleAxesWithTable
+            if( indexes[i] >= tableSize) {
+                ScaleAxes(scaleSegments, &axis1Out[base + i], &axis1Fract, &axis2Out[base + i], &axis2Fract);
+                continue;
+            }
+
+            if( !indexes[i])
+                continue;
+
+            dx = IOFixedMultiply( axis1[base + i] << 16, scales[i] );
+            dy = IOFixedMultiply( axis2[base + i] << 16, scales[i] );
+
+            // add fract parts
+            dx += axis1Fract;
+            dy += axis2Fract;
+
+            axis1Out[base + i] = dx / 65536;
+            axis2Out[base + i] = dy / 65536;
+
+            // get fractional part with sign extend
+            if( dx >= 0)
+                axis1Fract = dx & 0xffff;
+            else
+                axis1Fract = dx | 0xffff0000;
+            if( dy >= 0)
+                axis2Fract = dy & 0xffff;
+            else
+                axis2Fract = dy | 0xffff0000;
+        }
+    }
+
+    *axis1Fractp = axis1Fract;
+    *axis2Fractp = axis2Fract;
+}
 
 // -----------------------------------------------------------------------
 // Adapted from /System/Library/Frameworks/CoreServices.framework/Frameworks/CarbonCore.framework/Headers/FixMath.h
@@ -631,14 +719,13 @@ void ScaleAxes (void * scaleSegments, int * axis1p, IOFixed *axis1Fractp, int *
 // -----------------------------------------------------------------------
 
 extern "C" int
-Wrapped_SetupAcceleration(void *data, uint32_t datasize,
-                          int32_t inResolution, float desiredAcceleration,
+Wrapped_SetupAcceleration(const OSXAccelerationTable *table,
+                          int32_t inResolution, int32_t outResolution, int32_t frameRate,
+                          float desiredAcceleration,
                           void **scaleSegments, uint32_t *scaleSegCount) {
-    IOFixed devScale  = IOFixedDivide(IntToFixed(inResolution), FRAME_RATE) ;
-    IOFixed crsrScale = IOFixedDivide(SCREEN_RESOLUTION, FRAME_RATE) ;
-    OSData *table = OSData::withBytesNoCopy(data, datasize) ;
+    IOFixed devScale  = IOFixedDivide(IntToFixed(inResolution), IntToFixed(frameRate)) ;
+    IOFixed crsrScale = IOFixedDivide(IntToFixed(outResolution), IntToFixed(frameRate)) ;
     int ok = SetupAcceleration(table, FloatToFixed(desiredAcceleration), devScale, crsrScale, scaleSegments, scaleSegCount) ;
-    if (ok) table->release() ;
     LOG("Wrapped_SetupAcceleration: OK: %d\n", ok);
     return ok ;
 }
@@ -650,6 +737,426 @@ Wrapped_ScaleAxes(void *scaleSegments,
     ScaleAxes(scaleSegments, axis1p, axis1Fractp, axis2p, axis2Fractp) ;
 }
 
+extern "C" void
+Wrapped_BuildScaleTable(void *scaleSegments, int32_t **scaleTable) {
+    if (*scaleTable == NULL)
+        *scaleTable = IONew(IOFixed, SCALE_TABLE_SIZE) ;
+    BuildScaleTable(scaleSegments, *scaleTable, SCALE_TABLE_SIZE) ;
+}
+
+extern "C" void
+Wrapped_ScaleAxesWithTable(int32_t *scaleTable, void *scaleSegments,
+                           int32_t *axis1p, int32_t *axis1Fractp,
+                           int32_t *axis2p, int32_t *axis2Fractp) {
+    ScaleAxesWithTable(scaleTable, SCALE_TABLE_SIZE, scaleSegments, axis1p, axis1Fractp, axis2p, axis2Fractp) ;
+}
+
+extern "C" void
+Wrapped_ScaleAxesBatch(int32_t *scaleTable, void *scaleSegments,
+                       const int16_t *axis1, const int16_t *axis2,
+                       int32_t *axis1Out, int32_t *axis2Out, uint32_t count,
+                       int32_t *axis1Fractp, int32_t *axis2Fractp) {
+    ScaleAxesBatch(scaleTable, SCALE_TABLE_SIZE, scaleSegments, axis1, axis2, axis1Out, axis2Out, count, axis1Fractp, axis2Fractp) ;
+}
+
+extern "C" void
+Wrapped_ReleaseAcceleration(void **scaleSegments, uint32_t *scaleSegCount,
+                            int32_t **scaleTable) {
+    if (*scaleSegments && *scaleSegCount)
+        IODelete(*scaleSegments, CursorDeviceSegment, *scaleSegCount) ;
+    *scaleSegments = NULL ;
+    *scaleSegCount = 0 ;
+    if (*scaleTable)
+        IODelete(*scaleTable, IOFixed, SCALE_TABLE_SIZE) ;
+    *scaleTable = NULL ;
+}
+
+// -----------------------------------------------------------------------
+// Configured accelerations are shared between the OSXFunction instances:
+// the segments and the scale table only depend on the table, the setting
+// and the resolutions, and they are only read once built. Unreferenced entries are
+// kept around so switching back and forth between settings (or creating a
+// function per device) does not rebuild them.
+
+#define OSX_ACCELERATION_CACHE_SIZE 8
+
+// what the segments are built for unless told otherwise: the device in
+// counts per inch, the screen in pixels per inch and its refresh rate in Hz
+#define OSX_DEFAULT_DEVICE_RESOLUTION   400
+#define OSX_DEFAULT_SCREEN_RESOLUTION   (SCREEN_RESOLUTION >> 16)
+#define OSX_DEFAULT_FRAME_RATE          (FRAME_RATE >> 16)
+
+typedef struct {
+    const OSXAccelerationTable *table ;
+    float setting ;
+    int deviceResolution ;
+    int screenResolution ;
+    int frameRate ;
+    void *scaleSegments ;
+    uint32_t scaleSegCount ;
+    int32_t *scaleTable ;
+    int refs ;
+    uint64_t lastUse ;
+} osx_acceleration_cache_entry_t ;
+
+static osx_acceleration_cache_entry_t acceleration_cache[OSX_ACCELERATION_CACHE_SIZE] ;
+static uint64_t acceleration_cache_clock = 0 ;
+static pthread_mutex_t acceleration_cache_mutex = PTHREAD_MUTEX_INITIALIZER ;
+
+// returns the cache slot holding the configured acceleration, or -1 if it
+// could not be set up (the outputs are left untouched then)
+static int
+acceleration_cache_acquire(const OSXAccelerationTable *table, float setting,
+                           int deviceResolution, int screenResolution, int frameRate,
+                           void **scaleSegments, uint32_t *scaleSegCount, int32_t **scaleTable) {
+    int slot = -1 ;
+
+    pthread_mutex_lock(&acceleration_cache_mutex) ;
+
+    for (int i = 0; i < OSX_ACCELERATION_CACHE_SIZE; i++) {
+        osx_acceleration_cache_entry_t *entry = &acceleration_cache[i] ;
+        if (entry->table == table && entry->setting == setting &&
+            entry->deviceResolution == deviceResolution &&
+            entry->screenResolution == screenResolution &&
+            entry->frameRate == frameRate) {
+            slot = i ;
+            break ;
+        }
+    }
+
+    if (slot == -1) {
+        // pick an empty slot, or evict the least recently used free entry
+        for (int i = 0; i < OSX_ACCELERATION_CACHE_SIZE; i++) {
+            osx_acceleration_cache_entry_t *entry = &acceleration_cache[i] ;
+            if (entry->refs != 0)
+                continue ;
+            if (slot == -1 || entry->table == NULL || (acceleration_cache[slot].table != NULL && entry->lastUse < acceleration_cache[slot].lastUse))
+                slot = i ;
+        }
+
+        void *segments = NULL ;
+        uint32_t segCount = 0 ;
+        int32_t *scale = NULL ;
+
+        if (!Wrapped_SetupAcceleration(table, deviceResolution, screenResolution, frameRate,
+                                       setting, &segments, &segCount)) {
+            pthread_mutex_unlock(&acceleration_cache_mutex) ;
+            return -1 ;
+        }
+        Wrapped_BuildScaleTable(segments, &scale) ;
+
+        if (slot == -1) {
+            // every entry is in use, hand out a private copy
+            pthread_mutex_unlock(&acceleration_cache_mutex) ;
+            *scaleSegments = segments ;
+            *scaleSegCount = segCount ;
+            *scaleTable = scale ;
+            return OSX_ACCELERATION_CACHE_SIZE ;
+        }
+
+        osx_acceleration_cache_entry_t *entry = &acceleration_cache[slot] ;
+        Wrapped_ReleaseAcceleration(&entry->scaleSegments, &entry->scaleSegCount, &entry->scaleTable) ;
+        entry->table = table ;
+        entry->setting = setting ;
+        entry->deviceResolution = deviceResolution ;
+        entry->screenResolution = screenResolution ;
+        entry->frameRate = frameRate ;
+        entry->scaleSegments = segments ;
+        entry->scaleSegCount = segCount ;
+        entry->scaleTable = scale ;
+    }
+
+    osx_acceleration_cache_entry_t *entry = &acceleration_cache[slot] ;
+    entry->refs++ ;
+    entry->lastUse = ++acceleration_cache_clock ;
+    *scaleSegments = entry->scaleSegments ;
+    *scaleSegCount = entry->scaleSegCount ;
+    *scaleTable = entry->scaleTable ;
+
+    pthread_mutex_unlock(&acceleration_cache_mutex) ;
+
+    return slot ;
+}
+
+static void
+acceleration_cache_release(int slot, void **scaleSegments, uint32_t *scaleSegCount, int32_t **scaleTable) {
+    if (slot == OSX_ACCELERATION_CACHE_SIZE) {
+        Wrapped_ReleaseAcceleration(scaleSegments, scaleSegCount, scaleTable) ;
+        return ;
+    }
+    if (slot >= 0) {
+        pthread_mutex_lock(&acceleration_cache_mutex) ;
+        acceleration_cache[slot].refs-- ;
+        pthread_mutex_unlock(&acceleration_cache_mutex) ;
+    }
+    *scaleSegments = NULL ;
+    *scaleSegCount = 0 ;
+    *scaleTable = NULL ;
+}
+
+// drops the unreferenced entries built from table, which is about to be freed
+static void
+acceleration_cache_forget(const OSXAccelerationTable *table) {
+    pthread_mutex_lock(&acceleration_cache_mutex) ;
+    for (int i = 0; i < OSX_ACCELERATION_CACHE_SIZE; i++) {
+        osx_acceleration_cache_entry_t *entry = &acceleration_cache[i] ;
+        if (entry->table == table && entry->refs == 0) {
+            Wrapped_ReleaseAcceleration(&entry->scaleSegments, &entry->scaleSegCount, &entry->scaleTable) ;
+            entry->table = NULL ;
+        }
+    }
+    pthread_mutex_unlock(&acceleration_cache_mutex) ;
+}
+
+// -----------------------------------------------------------------------
+// Acceleration tables loaded from a file. Two formats are accepted:
+//
+// - the binary HIDPointerAccelerationTable data as found in the IORegistry
+//   (and in libpointing), all fields big endian: scale (16.16), signature
+//   (4 bytes), curve count (16 bits), then for each curve its acceleration
+//   (16.16), point count (16 bits) and the (x, y) points (16.16 each)
+//
+// - text, one item per line, '#' starts a comment:
+//
+//     default <acceleration>
+//     curve <acceleration>
+//     <device speed> <cursor speed>
+//     ...
+//
+//   Device speeds are in inches per second, cursor speeds in inches per
+//   second at 96 pixels per inch, like in the binary tables. Points before
+//   the first curve line make up a curve with an acceleration of 1.0, so a
+//   file holding only points is a single gain vs. speed curve. The default
+//   line is the table's scale: the acceleration the setting 0.5 maps to.
+//   Without it settings map to the same accelerations.
+//
+// The acceleration picks (and interpolates between) the two curves around
+// it, above the last curve the last curve is scaled. Files holding a NUL
+// byte are taken as binary tables.
+
+#define TABLE_FILE_MAX_SIZE     (64 * 1024)
+#define TABLE_FILE_MAX_CURVES   64
+#define TABLE_FILE_MAX_POINTS   256
+#define TABLE_FILE_MAX_VALUE    32767.0
+
+struct osx_table_file_s {
+    OSXAccelerationTable table ;
+    std::vector<OSXAccelerationCurve> curves ;
+    std::vector<int32_t> points ;
+    std::vector<int32_t> pointOffsets ;
+} ;
+
+static bool
+table_file_error(std::string *error, const std::string &path, int line, const char *message) {
+    char buf[256] ;
+    if (line > 0)
+        snprintf(buf, sizeof(buf), "%s:%d: %s", path.c_str(), line, message) ;
+    else
+        snprintf(buf, sizeof(buf), "%s: %s", path.c_str(), message) ;
+    *error = buf ;
+    return false ;
+}
+
+static bool
+table_file_add_curve(osx_table_file_t *file, IOFixed accl) {
+    if (file->curves.size() == TABLE_FILE_MAX_CURVES)
+        return false ;
+    OSXAccelerationCurve curve = { accl, 0, NULL } ;
+    file->curves.push_back(curve) ;
+    file->pointOffsets.push_back((int32_t)file->points.size()) ;
+    return true ;
+}
+
+static bool
+table_file_add_point(osx_table_file_t *file, IOFixed x, IOFixed y) {
+    OSXAccelerationCurve *curve = &file->curves.back() ;
+    if (curve->numPoints == TABLE_FILE_MAX_POINTS)
+        return false ;
+    file->points.push_back(x) ;
+    file->points.push_back(y) ;
+    curve->numPoints++ ;
+    return true ;
+}
+
+static uint32_t
+table_file_read_big(const std::string &data, size_t *offset, int size, bool *ok) {
+    uint32_t value = 0 ;
+    if (*offset + size > data.size()) {
+        *ok = false ;
+        return 0 ;
+    }
+    for (int i = 0; i < size; i++)
+        value = (value << 8) | (uint8_t)data[(*offset)++] ;
+    return value ;
+}
+
+static bool
+table_file_parse_binary(osx_table_file_t *file, const std::string &data, const std::string &path, std::string *error) {
+    bool ok = true ;
+    size_t offset = 0 ;
+
+    file->table.scale = (int32_t)table_file_read_big(data, &offset, 4, &ok) ;
+    offset += 4 ; // signature
+    int count = (int)table_file_read_big(data, &offset, 2, &ok) ;
+
+    for (int i = 0; ok && i < count; i++) {
+        IOFixed accl = (IOFixed)table_file_read_big(data, &offset, 4, &ok) ;
+        int points = (int)table_file_read_big(data, &offset, 2, &ok) ;
+        if (!ok)
+            break ;
+        if (!table_file_add_curve(file, accl))
+            return table_file_error(error, path, 0, "too many curves") ;
+        for (int p = 0; ok && p < points; p++) {
+            IOFixed x = (IOFixed)table_file_read_big(data, &offset, 4, &ok) ;
+            IOFixed y = (IOFixed)table_file_read_big(data, &offset, 4, &ok) ;
+            if (ok && !table_file_add_point(file, x, y))
+                return table_file_error(error, path, 0, "too many points in a curve") ;
+        }
+    }
+
+    if (!ok)
+        return table_file_error(error, path, 0, "table is truncated") ;
+    return true ;
+}
+
+// rounds to the nearest 16.16 value, so writing out a table with enough
+// decimals and reading it back gives the same table
+static IOFixed
+table_file_fixed(double value) {
+    return (IOFixed)(value * 65536.0 + 0.5) ;
+}
+
+static bool
+table_file_parse_text(osx_table_file_t *file, const std::string &data, const std::string &path, std::string *error) {
+    std::istringstream input(data) ;
+    std::string text ;
+    int line = 0 ;
+
+    file->table.scale = table_file_fixed(0.5) ;
+
+    while (std::getline(input, text)) {
+        line++ ;
+        size_t comment = text.find('#') ;
+        if (comment != std::string::npos)
+            text.erase(comment) ;
+
+        char word[16] ;
+        double a, b ;
+        char extra ;
+        if (sscanf(text.c_str(), " %15s", word) != 1) {
+            continue ;
+        } else if (strcmp(word, "default") == 0) {
+            if (sscanf(text.c_str(), " default %lf %c", &a, &extra) != 1)
+                return table_file_error(error, path, line, "expected: default <acceleration>") ;
+            if (a <= 0 || a >= 1.0)
+                return table_file_error(error, path, line, "default acceleration must be between 0 and 1") ;
+            file->table.scale = table_file_fixed(a) ;
+        } else if (strcmp(word, "curve") == 0) {
+            if (sscanf(text.c_str(), " curve %lf %c", &a, &extra) != 1)
+                return table_file_error(error, path, line, "expected: curve <acceleration>") ;
+            if (a < 0 || a > TABLE_FILE_MAX_VALUE)
+                return table_file_error(error, path, line, "acceleration out of range") ;
+            if (!table_file_add_curve(file, table_file_fixed(a)))
+                return table_file_error(error, path, line, "too many curves") ;
+        } else if (sscanf(text.c_str(), " %lf %lf %c", &a, &b, &extra) == 2) {
+            if (a < 0 || a > TABLE_FILE_MAX_VALUE || b < 0 || b > TABLE_FILE_MAX_VALUE)
+                return table_file_error(error, path, line, "speed out of range") ;
+            if (file->curves.empty())
+                table_file_add_curve(file, table_file_fixed(1.0)) ;
+            if (!table_file_add_point(file, table_file_fixed(a), table_file_fixed(b)))
+                return table_file_error(error, path, line, "too many points in a curve") ;
+        } else {
+            return table_file_error(error, path, line, "expected: <device speed> <cursor speed>") ;
+        }
+    }
+
+    return true ;
+}
+
+// SetupAcceleration() walks the points of each curve in order of device speed.
+// The curves are searched for the first one at or above the setting and do
+// not need to be ordered (the builtin mouse table is not).
+static bool
+table_file_validate(osx_table_file_t *file, const std::string &path, std::string *error) {
+    if (file->curves.empty())
+        return table_file_error(error, path, 0, "no curves") ;
+
+    for (size_t i = 0; i < file->curves.size(); i++) {
+        const OSXAccelerationCurve *curve = &file->curves[i] ;
+        const int32_t *points = &file->points[file->pointOffsets[i]] ;
+        char message[128] ;
+
+        if (curve->numPoints == 0) {
+            snprintf(message, sizeof(message), "curve %d: no points", (int)i + 1) ;
+            return table_file_error(error, path, 0, message) ;
+        }
+        for (int p = 0; p < curve->numPoints; p++) {
+            IOFixed x = points[p * 2] ;
+            IOFixed y = points[p * 2 + 1] ;
+            if (x <= 0 || y < 0 || (p > 0 && x <= points[(p - 1) * 2])) {
+                snprintf(message, sizeof(message), "curve %d: device speeds must be positive and increasing", (int)i + 1) ;
+                return table_file_error(error, path, 0, message) ;
+            }
+        }
+    }
+
+    return true ;
+}
+
+// returns NULL with a message in error if the file cannot be read or is not
+// a valid table
+static osx_table_file_t *
+osx_table_file_load(const std::string &path, std::string *error) {
+    FILE *fp = fopen(path.c_str(), "rb") ;
+    if (fp == NULL) {
+        table_file_error(error, path, 0, strerror(errno)) ;
+        return NULL ;
+    }
+
+    std::string data ;
+    char buf[4096] ;
+    size_t n ;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0 && data.size() <= TABLE_FILE_MAX_SIZE)
+        data.append(buf, n) ;
+    bool readError = (ferror(fp) != 0) ;
+    fclose(fp) ;
+
+    if (readError) {
+        table_file_error(error, path, 0, "read error") ;
+        return NULL ;
+    }
+    if (data.size() > TABLE_FILE_MAX_SIZE) {
+        table_file_error(error, path, 0, "file too large") ;
+        return NULL ;
+    }
+
+    osx_table_file_t *file = new osx_table_file_t ;
+    bool ok ;
+    if (data.find('\0') != std::string::npos)
+        ok = table_file_parse_binary(file, data, path, error) ;
+    else
+        ok = table_file_parse_text(file, data, path, error) ;
+
+    if (!ok || !table_file_validate(file, path, error)) {
+        delete file ;
+        return NULL ;
+    }
+
+    // the vectors do not grow anymore, point the table into them
+    for (size_t i = 0; i < file->curves.size(); i++)
+        file->curves[i].points = (const int32_t (*)[2]) &file->points[file->pointOffsets[i]] ;
+    file->table.numCurves = (int32_t)file->curves.size() ;
+    file->table.curves = &file->curves[0] ;
+
+    return file ;
+}
+
+static void
+osx_table_file_free(osx_table_file_t *file) {
+    acceleration_cache_forget(&file->table) ;
+    delete file ;
+}
+
 // -----------------------------------------------------------------------
 
 #define OSX_DEFAULT_SETTING 0.6875
@@ -657,6 +1164,12 @@ Wrapped_ScaleAxes(void *scaleSegments,
 OSXFunction::OSXFunction(std::string deviceType, float speed) {
     scaleSegments = 0 ;
     scaleSegCount = 0 ;
+    scaleTable = 0 ;
+    cacheSlot = -1 ;
+    tableFile = NULL ;
+    deviceResolution = OSX_DEFAULT_DEVICE_RESOLUTION ;
+    screenResolution = OSX_DEFAULT_SCREEN_RESOLUTION ;
+    frameRate = OSX_DEFAULT_FRAME_RATE ;
 
     clearState() ;
     loadTable(deviceType) ;
@@ -664,28 +1177,34 @@ OSXFunction::OSXFunction(std::string deviceType, float speed) {
     LOG("OSXFunction, deviceType: %s, speed: %f\n", deviceType.c_str(), speed);
 }
 
+OSXFunction::~OSXFunction() {
+    acceleration_cache_release(cacheSlot, &scaleSegments, &scaleSegCount, &scaleTable) ;
+    if (tableFile != NULL)
+        osx_table_file_free(tableFile) ;
+}
+
 void
 OSXFunction::loadTable(std::string nameOrPath) {
-    // Generic mouse, OS X 10.6.0
-    static const char *accl_afe940c03abcb5d03e6d4e1e4bca1470be2fe550 = "AACAAFVTQioABwAAAAAAAQABAAAAAQAAAAAgAAAQAABxOwAATOMABE7FAA03BAAFRAAAFIAAAAcsAAAj4AAACQAAADSwAAAK2AAARfAAAA0IAABXkAAAD2AAAGkAAAASEAAAeoAAABUAAACJAAAAF8AAAJEAAAAawAAAlrAAAB2QAACZsAAAIKAAAJswAAAj8AAAnDAAACewAACcMAAAAIAAABIAAHE7AABWfwAESgAADqAAAAY6AAAfQAAABygAACkAAAAI2AAAPGAAAAm4AABHQAAACrAAAFMwAAALwAAAYDAAAAzAAABsIAAADuAAAIQgAAARYAAAnSAAABQAAAC0AAAAFsAAAMcAAAAZoAAA1AAAABzgAADbAAAAIIAAAOAAAAAkQAAA4wAAACegAADjAAAAALAAABQAAHE7AABhTgAESgAAD2AAAAUyAAAXYAAABjIAACCgAAAHLAAALCAAAAgIAAA3oAAACOQAAENAAAAJwAAAUIAAAAqgAABfIgAAC5AAAG1wAAAMcAAAewAAAA6AAACYoAAAEMAAALYAAAATQAAA0gAAABZgAADpAAAAGiAAAPoAAAAdoAABAwAAACEgAAEHAAAAJIAAAQoAAAAnoAABDAAAAADgAAARAABxOwAAbXcABBoAABHwAAAFGgAAG/AAAAXwAAAmYAAABvwAADQAAAAITAAAT+AAAAlsAABt4AAACngAAI3AAAALsAAAtkAAAA1QAADZgAAAEQAAAPeAAAAVwAABEQAAABlgAAEgAAAAHUAAASgAAAAhAAABLgAAACSAAAEyAAAAJ4AAATUAAAAAUAAAEgAAcTsAAEuwAARMAAAOAAAABUAAABVQAAAHJAAAJiAAAAi0AAA1wAAACpAAAEmAAAAL6AAAVoAAAA0gAABiAAAADhgAAGrQAAAPGAAAdAAAABGQAACHgAAAFFAAAJoAAAAXYAAAqYAAABpgAAC0AAAAHVAAALkAAAAg0AAAvIAAACQgAAC9gAAAJ7AAAL6AAAABAAAAEAAAcTsAAFZ/AAO4AAASoAAABSAAACVAAAAGCAAAN4AAAAbwAABfAAAAB/AAAIoAAAAJKAAAyyAAAArwAAD3gAAADSAAARyAAAAQAAABOAAAABRAAAFKAAAAGQAAAVMAAAAc0AABVwAAACDgAAFbgAAAJCAAAV2AAAAnoAABXgAAAFJwAAAJlNEAWTAAAAoSaQBf8AAACpAAAGawAAAA4AAAHAABGFUAATAAAAGyKAAC8AAAAlNpAAagAAADb0oAENAAAAOteAAUWAAAA+ulABfgAAAEKdMAG2gAAARoAAAe8AAABKIBACKYAAAE2VYAJiAAAAUUqwApaAAABVAAACywAAAFgAEAMcgAAAW1VgA2QAAABeqrADq4AAAGIAAAPzAAAAZiAABD3AAABp6rAEh4AAAG21YATRQAAAcYAABRsAAAB3oBAFbcAAAH2VYAW/gAAAg4qwBhFAAACJgAAGYwAAAJFgEAbAAAAAmRVgBx0AAACgyrAHegAAAKiAAAfXAAAAEAAAATAAEYVQABMAAAAbIoAAMQAAACU2kABxAAAAMvSgARgAAAA6z7AByIAAAEOqsAKOAAAASBVgAwiAAABMgAADgwAAAFDVYAQJgAAAVQAABI8AAABcarAFKwAAAGOAAAXHAAAAbxVgBnwAAAB0yrAG1YAAAHqAAAcvAAAAhMAAB5BAAACPAAAH8YAAAJlAAAhSwAAAo4AACLQAA=" ;
-
-    // Multitouch, OS X 10.6.0
-    static const char *accl_6cae1281d58cf4db979ee8e0be48e55200a933d8 = "AACAAFVTQioABwAAAAAAAgAEAAAABAAAABAAAAAQAAAAACAAAA0AAIAAAACAAAABQAAAAYAAAAIAAAAC4AAAAwAAAATgAAAEAAAAB0AAAAUAAAAKAAAABgAAAA1AAAAIAAAAFgAAAArAAAAjAAAADQAAAC8AAAAOwAAAOMAAABBAAABBAAAAEcAAAEjAAAAAUAAADwAAgAAAAIAAAAEAAAABQAAAAYAAAAJAAAACAAAAA4AAAAKAAAAE4AAAAwAAAAZgAAAEAAAACgAAAAUAAAAOQAAABgAAABNAAAAIAAAAHsAAAArAAAAuwAAADQAAADyAAAAOwAAARwAAABBAAABPwAAAEcAAAFiAAAAAgAAADwAAgAAAAIAAAAEAAAABYAAAAYAAAAKgAAACAAAABEAAAAKAAAAGAAAAAwAAAAgAAAAEAAAADQAAAAUAAAASwAAABgAAABkAAAAIAAAAKAAAAArAAAA7wAAADQAAAEuAAAAOwAAAV0AAABBAAABgQAAAEcAAAGkAAAAAsAAADwAAgAAAAIAAAAEAAAABoAAAAYAAAAMAAAACAAAABQAAAAKAAAAHQAAAAwAAAAnAAAAEAAAAEEAAAAUAAAAXgAAABgAAAB/AAAAIAAAAMgAAAArAAABKAAAADQAAAFyAAAAOwAAAaQAAABBAAABywAAAEcAAAHrAAAAA4AAADwAAgAAAAKAAAAEAAAABwAAAAYAAAANgAAACAAAABeAAAAKAAAAIoAAAAwAAAAvAAAAEAAAAE8AAAAUAAAAdQAAABgAAACfAAAAIAAAAPcAAAArAAABZAAAADQAAAG3AAAAOwAAAe0AAABBAAACFQAAAEcAAAIxAAAABAAAADwAAgAAAAMAAAAEAAAACAAAAAYAAAAPgAAACAAAABsAAAAKAAAAKQAAAAwAAAA5gAAAEAAAAGMAAAAUAAAAkwAAABgAAADLAAAAIAAAATUAAAArAAABugAAADQAAAIMAAAAOwAAAj0AAABBAAACXAAAAEcAAAJxAAA==" ;
-
-    static const char *accl_cc3ffdf944e6aeb717d6c93b47f8fc44cf659119 = "AACAAEAyMDAAAgAAAAAAAQABAAAAAQAAAAEAAAAJAABxOwAAYAAABE7FABCAAAAMAAAAXwAAABbsTwCLAAAAHTsUAJSAAAAidicAlgAAACRidgCWAAAAJgAAAJYAAAAoAAAAlgAA" ;
-
     if (nameOrPath.empty() || nameOrPath=="mouse") {
-        accltable = Base64::decode(accl_afe940c03abcb5d03e6d4e1e4bca1470be2fe550) ;
+        // Generic mouse, OS X 10.6.0
+        table = &osx_mouse_table ;
         // std::cerr << "Using builtin mouse acceleration table" << std::endl ;
     } else if (nameOrPath=="touchpad") {
-        accltable = Base64::decode(accl_6cae1281d58cf4db979ee8e0be48e55200a933d8) ;
+        // Multitouch, OS X 10.6.0
+        table = &osx_touchpad_table ;
         // std::cerr << "Using builtin touchpad acceleration table" << std::endl ;
     } else if (nameOrPath=="IOHIPointing") {
-        accltable = Base64::decode(accl_cc3ffdf944e6aeb717d6c93b47f8fc44cf659119) ;
+        table = &osx_iohipointing_table ;
         // std::cerr << "Using hard-coded IOHIPointing acceleration table" << std::endl ;
     } else {
-        LOG("invalid nameOrPath: %s\n", nameOrPath.c_str());
-        exit(0);
+        tableFile = osx_table_file_load(nameOrPath, &tableError) ;
+        if (tableFile != NULL) {
+            table = &tableFile->table ;
+        } else {
+            // keep working with the generic mouse table
+            LOG("invalid nameOrPath: %s\n", tableError.c_str());
+            table = &osx_mouse_table ;
+        }
     }
 }
 
@@ -694,19 +1213,97 @@ OSXFunction::clearState(void) {
     fractX = fractY = 0 ;
 }
 
+void
+OSXFunction::getState(OSXFunctionState *state) const {
+    state->fractX = fractX ;
+    state->fractY = fractY ;
+}
+
+void
+OSXFunction::setState(const OSXFunctionState *state) {
+    fractX = state->fractX ;
+    fractY = state->fractY ;
+}
+
 void
 OSXFunction::configure(float s) {
-    if (Wrapped_SetupAcceleration((void*)accltable.c_str(), (uint32_t)accltable.size(),
-                                  400 /*dpi, TODO*/, s,
-                                  &scaleSegments, &scaleSegCount)) {
+    void *segments ;
+    uint32_t segCount ;
+    int32_t *scale ;
+    int slot = acceleration_cache_acquire(table, s, deviceResolution, screenResolution, frameRate,
+                                          &segments, &segCount, &scale) ;
+    if (slot != -1) {
+        acceleration_cache_release(cacheSlot, &scaleSegments, &scaleSegCount, &scaleTable) ;
+        cacheSlot = slot ;
+        scaleSegments = segments ;
+        scaleSegCount = segCount ;
+        scaleTable = scale ;
         setting = s ;
         clearState() ;
     } else
         configure(OSX_DEFAULT_SETTING) ;
 }
 
+// 0 for the default, any other value has to be within [min, max]
+static bool ResolutionInRange(int value, int min, int max) {
+    return value == 0 || (value >= min && value <= max) ;
+}
+
+bool
+OSXFunction::setResolutions(int deviceRes, int screenRes, int rate) {
+    if (!ResolutionInRange(deviceRes, OSX_MIN_DEVICE_RESOLUTION, OSX_MAX_DEVICE_RESOLUTION) ||
+        !ResolutionInRange(screenRes, OSX_MIN_SCREEN_RESOLUTION, OSX_MAX_SCREEN_RESOLUTION) ||
+        !ResolutionInRange(rate, OSX_MIN_FRAME_RATE, OSX_MAX_FRAME_RATE)) {
+        LOG("OSXFunction, unsupported resolutions: %d cpi, %d ppi, %d Hz\n", deviceRes, screenRes, rate);
+        return false ;
+    }
+    deviceResolution = (deviceRes > 0) ? deviceRes : OSX_DEFAULT_DEVICE_RESOLUTION ;
+    screenResolution = (screenRes > 0) ? screenRes : OSX_DEFAULT_SCREEN_RESOLUTION ;
+    frameRate = (rate > 0) ? rate : OSX_DEFAULT_FRAME_RATE ;
+    configure(setting) ;
+    LOG("OSXFunction, resolutions: %d cpi, %d ppi, %d Hz\n", deviceResolution, screenResolution, frameRate);
+    return true ;
+}
+
 void
 OSXFunction::apply(int dxMickey, int dyMickey, int *dxPixel, int *dyPixel) {
+    Wrapped_ScaleAxesWithTable(scaleTable, scaleSegments, &dxMickey, &fractX, &dyMickey, &fractY) ;
+    *dxPixel = dxMickey ;
+    *dyPixel = dyMickey ;
+}
+
+void
+OSXFunction::apply_batch(const int16_t *dxMickey, const int16_t *dyMickey, int *dxPixel, int *dyPixel, size_t count) {
+    Wrapped_ScaleAxesBatch(scaleTable, scaleSegments, dxMickey, dyMickey, dxPixel, dyPixel, (uint32_t)count, &fractX, &fractY) ;
+}
+
+float
+OSXFunction::gainAtSpeed(float deviceSpeed) {
+    CursorDeviceSegment *segment ;
+    double units ;
+    SInt32 mag ;
+
+    if (!scaleSegments)
+        return 1.0 ;
+
+    // device units per frame, as ScaleAxes() computes from the deltas
+    units = deviceSpeed * deviceResolution / (double)frameRate ;
+    if (units < 1.0 / 65536.0)
+        units = 1.0 / 65536.0 ;
+    if (units > 32767.0)
+        units = 32767.0 ;
+    mag = (SInt32)(units * 65536.0) ;
+
+    for(
+        segment = (CursorDeviceSegment *) scaleSegments;
+        mag > segment->devUnits;
+        segment++)	{}
+
+    return (float)IOFixedDivide(segment->intercept + IOFixedMultiply(mag, segment->slope), mag) / 65536.0f ;
+}
+
+void
+OSXFunction::applyReference(int dxMickey, int dyMickey, int *dxPixel, int *dyPixel) {
     Wrapped_ScaleAxes(scaleSegments, &dxMickey, &fractX, &dyMickey, &fractY) ;
     // std::cerr << "OSXFunction::apply: " << dxMickey << " " << dyMickey << std::endl ;
     
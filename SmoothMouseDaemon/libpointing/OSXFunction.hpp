@@ -20,23 +20,80 @@
 
 #include <string>
 #include <stdint.h>
+#include <stddef.h>
+
+// what setResolutions() accepts, the acceleration is set up in 16.16 fixed
+// point (see SetupAcceleration()) and overflows beyond these
+#define OSX_MIN_DEVICE_RESOLUTION   200
+#define OSX_MAX_DEVICE_RESOLUTION   32767
+#define OSX_MIN_SCREEN_RESOLUTION   50
+#define OSX_MAX_SCREEN_RESOLUTION   600
+#define OSX_MIN_FRAME_RATE          48
+#define OSX_MAX_FRAME_RATE          1000
+
+struct OSXAccelerationTable ;
+
+typedef struct osx_table_file_s osx_table_file_t ;
+
+// what apply() keeps between events, see getState()
+struct OSXFunctionState {
+    int32_t fractX, fractY ;
+} ;
 
 class OSXFunction {
 
-    std::string accltable ;
+    const struct OSXAccelerationTable *table ;
+    osx_table_file_t *tableFile ;
+    std::string tableError ;
+    int cacheSlot ;
     float setting ;
+    int deviceResolution, screenResolution, frameRate ;
     int32_t fractX, fractY ;
     uint32_t scaleSegCount ;
     void *scaleSegments ;
+    int32_t *scaleTable ;
 
     void loadTable(std::string nameOrPath) ;
 
 public:
 
+    // deviceType is one of the builtin tables (mouse, touchpad, IOHIPointing)
+    // or the path of a table file, see OSXFunction.cpp for the formats
     OSXFunction(std::string deviceType, float speed) ;
+    ~OSXFunction() ;
+
+    // empty unless the table file could not be loaded, the builtin mouse
+    // table is used instead then
+    const std::string &getTableError(void) const { return tableError ; }
 
     void clearState(void) ;
+
+    // the state can be saved and restored to use one function for several
+    // devices, each with its own state
+    void getState(OSXFunctionState *state) const ;
+    void setState(const OSXFunctionState *state) ;
+
     void configure(float setting) ;
+
+    // the acceleration is set up for a device resolution in counts per inch
+    // and a screen resolution in pixels per inch refreshed at frameRate Hz,
+    // like IOHIPointing does with 400 cpi, 96 ppi and 67 Hz (the values used
+    // for 0), the function is configured again for them. Returns false and
+    // leaves the function as it was if one is outside of the OSX_MIN_* and
+    // OSX_MAX_* limits.
+    bool setResolutions(int deviceResolution, int screenResolution, int frameRate) ;
     void apply(int dxMickey, int dyMickey, int *dxPixel, int *dyPixel) ;
+
+    // applies the function to a burst of count events, with the same result
+    // and state as calling apply() for each of them in order
+    void apply_batch(const int16_t *dxMickey, const int16_t *dyMickey, int *dxPixel, int *dyPixel, size_t count) ;
+
+    // same as apply() but walks the segments instead of using the
+    // precomputed scale table, the result is identical
+    void applyReference(int dxMickey, int dyMickey, int *dxPixel, int *dyPixel) ;
+
+    // the gain (pixels per mickey) for a device moving at deviceSpeed inches
+    // per second, does not touch the state kept between events
+    float gainAtSpeed(float deviceSpeed) ;
 } ;
 
@@ -0,0 +1,312 @@
+// Generated by GenerateOSXFunctionTables.cpp, do not edit.
+
+#pragma once
+
+#include <stdint.h>
+
+// one acceleration curve, points are (device speed, cursor speed) pairs in
+// 16.16 fixed point
+typedef struct OSXAccelerationCurve {
+    int32_t accl;
+    int32_t numPoints;
+    const int32_t (*points)[2];
+} OSXAccelerationCurve;
+
+// the curves ordered by acceleration, scale is the table's default setting
+typedef struct OSXAccelerationTable {
+    int32_t scale;
+    int32_t numCurves;
+    const OSXAccelerationCurve *curves;
+} OSXAccelerationTable;
+
+// Generic mouse, OS X 10.6.0
+
+static const int32_t osx_mouse_points_0[][2] = {
+    { 0x00010000, 0x00010000 },
+};
+
+static const int32_t osx_mouse_points_1[][2] = {
+    { 0x0000713b, 0x00004ce3 },
+    { 0x00044ec5, 0x000d3704 },
+    { 0x00054400, 0x00148000 },
+    { 0x00072c00, 0x0023e000 },
+    { 0x00090000, 0x0034b000 },
+    { 0x000ad800, 0x0045f000 },
+    { 0x000d0800, 0x00579000 },
+    { 0x000f6000, 0x00690000 },
+    { 0x00121000, 0x007a8000 },
+    { 0x00150000, 0x00890000 },
+    { 0x0017c000, 0x00910000 },
+    { 0x001ac000, 0x0096b000 },
+    { 0x001d9000, 0x0099b000 },
+    { 0x0020a000, 0x009b3000 },
+    { 0x0023f000, 0x009c3000 },
+    { 0x0027b000, 0x009c3000 },
+};
+
+static const int32_t osx_mouse_points_2[][2] = {
+    { 0x0000713b, 0x0000567f },
+    { 0x00044a00, 0x000ea000 },
+    { 0x00063a00, 0x001f4000 },
+    { 0x00072800, 0x00290000 },
+    { 0x0008d800, 0x003c6000 },
+    { 0x0009b800, 0x00474000 },
+    { 0x000ab000, 0x00533000 },
+    { 0x000bc000, 0x00603000 },
+    { 0x000cc000, 0x006c2000 },
+    { 0x000ee000, 0x00842000 },
+    { 0x00116000, 0x009d2000 },
+    { 0x00140000, 0x00b40000 },
+    { 0x0016c000, 0x00c70000 },
+    { 0x0019a000, 0x00d40000 },
+    { 0x001ce000, 0x00db0000 },
+    { 0x00208000, 0x00e00000 },
+    { 0x00244000, 0x00e30000 },
+    { 0x0027a000, 0x00e30000 },
+};
+
+static const int32_t osx_mouse_points_3[][2] = {
+    { 0x0000713b, 0x0000614e },
+    { 0x00044a00, 0x000f6000 },
+    { 0x00053200, 0x00176000 },
+    { 0x00063200, 0x0020a000 },
+    { 0x00072c00, 0x002c2000 },
+    { 0x00080800, 0x0037a000 },
+    { 0x0008e400, 0x00434000 },
+    { 0x0009c000, 0x00508000 },
+    { 0x000aa000, 0x005f2200 },
+    { 0x000b9000, 0x006d7000 },
+    { 0x000c7000, 0x007b0000 },
+    { 0x000e8000, 0x0098a000 },
+    { 0x0010c000, 0x00b60000 },
+    { 0x00134000, 0x00d20000 },
+    { 0x00166000, 0x00e90000 },
+    { 0x001a2000, 0x00fa0000 },
+    { 0x001da000, 0x01030000 },
+    { 0x00212000, 0x01070000 },
+    { 0x00248000, 0x010a0000 },
+    { 0x0027a000, 0x010c0000 },
+};
+
+static const int32_t osx_mouse_points_4[][2] = {
+    { 0x0000713b, 0x00006d77 },
+    { 0x00041a00, 0x0011f000 },
+    { 0x00051a00, 0x001bf000 },
+    { 0x0005f000, 0x00266000 },
+    { 0x0006fc00, 0x00340000 },
+    { 0x00084c00, 0x004fe000 },
+    { 0x00096c00, 0x006de000 },
+    { 0x000a7800, 0x008dc000 },
+    { 0x000bb000, 0x00b64000 },
+    { 0x000d5000, 0x00d98000 },
+    { 0x00110000, 0x00f78000 },
+    { 0x0015c000, 0x01110000 },
+    { 0x00196000, 0x01200000 },
+    { 0x001d4000, 0x01280000 },
+    { 0x00210000, 0x012e0000 },
+    { 0x00248000, 0x01320000 },
+    { 0x00278000, 0x01350000 },
+};
+
+static const int32_t osx_mouse_points_5[][2] = {
+    { 0x0000713b, 0x00004bb0 },
+    { 0x00044c00, 0x000e0000 },
+    { 0x00054000, 0x00155000 },
+    { 0x00072400, 0x00262000 },
+    { 0x0008b400, 0x0035c000 },
+    { 0x000a9000, 0x00498000 },
+    { 0x000be800, 0x00568000 },
+    { 0x000d2000, 0x00620000 },
+    { 0x000e1800, 0x006ad000 },
+    { 0x000f1800, 0x00740000 },
+    { 0x00119000, 0x00878000 },
+    { 0x00145000, 0x009a0000 },
+    { 0x00176000, 0x00a98000 },
+    { 0x001a6000, 0x00b40000 },
+    { 0x001d5000, 0x00b90000 },
+    { 0x0020d000, 0x00bc8000 },
+    { 0x00242000, 0x00bd8000 },
+    { 0x0027b000, 0x00be8000 },
+};
+
+static const int32_t osx_mouse_points_6[][2] = {
+    { 0x0000713b, 0x0000567f },
+    { 0x0003b800, 0x0012a000 },
+    { 0x00052000, 0x00254000 },
+    { 0x00060800, 0x00378000 },
+    { 0x0006f000, 0x005f0000 },
+    { 0x0007f000, 0x008a0000 },
+    { 0x00092800, 0x00cb2000 },
+    { 0x000af000, 0x00f78000 },
+    { 0x000d2000, 0x011c8000 },
+    { 0x00100000, 0x01380000 },
+    { 0x00144000, 0x014a0000 },
+    { 0x00190000, 0x01530000 },
+    { 0x001cd000, 0x01570000 },
+    { 0x0020e000, 0x015b8000 },
+    { 0x00242000, 0x015d8000 },
+    { 0x0027a000, 0x015e0000 },
+};
+
+static const OSXAccelerationCurve osx_mouse_curves[] = {
+    { 0x00000000, 1, osx_mouse_points_0 },
+    { 0x00002000, 16, osx_mouse_points_1 },
+    { 0x00008000, 18, osx_mouse_points_2 },
+    { 0x0000b000, 20, osx_mouse_points_3 },
+    { 0x0000e000, 17, osx_mouse_points_4 },
+    { 0x00005000, 18, osx_mouse_points_5 },
+    { 0x00010000, 16, osx_mouse_points_6 },
+};
+
+static const OSXAccelerationTable osx_mouse_table = { 0x00008000, 7, osx_mouse_curves };
+
+// Multitouch, OS X 10.6.0
+
+static const int32_t osx_touchpad_points_0[][2] = {
+    { 0x00040000, 0x00040000 },
+    { 0x00100000, 0x00100000 },
+};
+
+static const int32_t osx_touchpad_points_1[][2] = {
+    { 0x00008000, 0x00008000 },
+    { 0x00014000, 0x00018000 },
+    { 0x00020000, 0x0002e000 },
+    { 0x00030000, 0x0004e000 },
+    { 0x00040000, 0x00074000 },
+    { 0x00050000, 0x000a0000 },
+    { 0x00060000, 0x000d4000 },
+    { 0x00080000, 0x00160000 },
+    { 0x000ac000, 0x00230000 },
+    { 0x000d0000, 0x002f0000 },
+    { 0x000ec000, 0x0038c000 },
+    { 0x00104000, 0x00410000 },
+    { 0x0011c000, 0x0048c000 },
+};
+
+static const int32_t osx_touchpad_points_2[][2] = {
+    { 0x00008000, 0x00008000 },
+    { 0x00010000, 0x00014000 },
+    { 0x00018000, 0x00024000 },
+    { 0x00020000, 0x00038000 },
+    { 0x00028000, 0x0004e000 },
+    { 0x00030000, 0x00066000 },
+    { 0x00040000, 0x000a0000 },
+    { 0x00050000, 0x000e4000 },
+    { 0x00060000, 0x00134000 },
+    { 0x00080000, 0x001ec000 },
+    { 0x000ac000, 0x002ec000 },
+    { 0x000d0000, 0x003c8000 },
+    { 0x000ec000, 0x00470000 },
+    { 0x00104000, 0x004fc000 },
+    { 0x0011c000, 0x00588000 },
+};
+
+static const int32_t osx_touchpad_points_3[][2] = {
+    { 0x00008000, 0x00008000 },
+    { 0x00010000, 0x00016000 },
+    { 0x00018000, 0x0002a000 },
+    { 0x00020000, 0x00044000 },
+    { 0x00028000, 0x00060000 },
+    { 0x00030000, 0x00080000 },
+    { 0x00040000, 0x000d0000 },
+    { 0x00050000, 0x0012c000 },
+    { 0x00060000, 0x00190000 },
+    { 0x00080000, 0x00280000 },
+    { 0x000ac000, 0x003bc000 },
+    { 0x000d0000, 0x004b8000 },
+    { 0x000ec000, 0x00574000 },
+    { 0x00104000, 0x00604000 },
+    { 0x0011c000, 0x00690000 },
+};
+
+static const int32_t osx_touchpad_points_4[][2] = {
+    { 0x00008000, 0x00008000 },
+    { 0x00010000, 0x0001a000 },
+    { 0x00018000, 0x00030000 },
+    { 0x00020000, 0x00050000 },
+    { 0x00028000, 0x00074000 },
+    { 0x00030000, 0x0009c000 },
+    { 0x00040000, 0x00104000 },
+    { 0x00050000, 0x00178000 },
+    { 0x00060000, 0x001fc000 },
+    { 0x00080000, 0x00320000 },
+    { 0x000ac000, 0x004a0000 },
+    { 0x000d0000, 0x005c8000 },
+    { 0x000ec000, 0x00690000 },
+    { 0x00104000, 0x0072c000 },
+    { 0x0011c000, 0x007ac000 },
+};
+
+static const int32_t osx_touchpad_points_5[][2] = {
+    { 0x00008000, 0x0000a000 },
+    { 0x00010000, 0x0001c000 },
+    { 0x00018000, 0x00036000 },
+    { 0x00020000, 0x0005e000 },
+    { 0x00028000, 0x0008a000 },
+    { 0x00030000, 0x000bc000 },
+    { 0x00040000, 0x0013c000 },
+    { 0x00050000, 0x001d4000 },
+    { 0x00060000, 0x0027c000 },
+    { 0x00080000, 0x003dc000 },
+    { 0x000ac000, 0x00590000 },
+    { 0x000d0000, 0x006dc000 },
+    { 0x000ec000, 0x007b4000 },
+    { 0x00104000, 0x00854000 },
+    { 0x0011c000, 0x008c4000 },
+};
+
+static const int32_t osx_touchpad_points_6[][2] = {
+    { 0x00008000, 0x0000c000 },
+    { 0x00010000, 0x00020000 },
+    { 0x00018000, 0x0003e000 },
+    { 0x00020000, 0x0006c000 },
+    { 0x00028000, 0x000a4000 },
+    { 0x00030000, 0x000e6000 },
+    { 0x00040000, 0x0018c000 },
+    { 0x00050000, 0x0024c000 },
+    { 0x00060000, 0x0032c000 },
+    { 0x00080000, 0x004d4000 },
+    { 0x000ac000, 0x006e8000 },
+    { 0x000d0000, 0x00830000 },
+    { 0x000ec000, 0x008f4000 },
+    { 0x00104000, 0x00970000 },
+    { 0x0011c000, 0x009c4000 },
+};
+
+static const OSXAccelerationCurve osx_touchpad_curves[] = {
+    { 0x00000000, 2, osx_touchpad_points_0 },
+    { 0x00002000, 13, osx_touchpad_points_1 },
+    { 0x00005000, 15, osx_touchpad_points_2 },
+    { 0x00008000, 15, osx_touchpad_points_3 },
+    { 0x0000b000, 15, osx_touchpad_points_4 },
+    { 0x0000e000, 15, osx_touchpad_points_5 },
+    { 0x00010000, 15, osx_touchpad_points_6 },
+};
+
+static const OSXAccelerationTable osx_touchpad_table = { 0x00008000, 7, osx_touchpad_curves };
+
+// Hard-coded table of IOHIPointing.cpp
+
+static const int32_t osx_iohipointing_points_0[][2] = {
+    { 0x00010000, 0x00010000 },
+};
+
+static const int32_t osx_iohipointing_points_1[][2] = {
+    { 0x0000713b, 0x00006000 },
+    { 0x00044ec5, 0x00108000 },
+    { 0x000c0000, 0x005f0000 },
+    { 0x0016ec4f, 0x008b0000 },
+    { 0x001d3b14, 0x00948000 },
+    { 0x00227627, 0x00960000 },
+    { 0x00246276, 0x00960000 },
+    { 0x00260000, 0x00960000 },
+    { 0x00280000, 0x00960000 },
+};
+
+static const OSXAccelerationCurve osx_iohipointing_curves[] = {
+    { 0x00000000, 1, osx_iohipointing_points_0 },
+    { 0x00010000, 9, osx_iohipointing_points_1 },
+};
+
+static const OSXAccelerationTable osx_iohipointing_table = { 0x00008000, 2, osx_iohipointing_curves };
+
@@ -15,6 +15,13 @@
 #include <sstream>
 #include <cmath>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 #define Sign(X) ((X>0)?(1):(-1))
 
 #ifndef min
@@ -32,7 +39,12 @@
 #define WINDOWS_DEFAULT_SLIDER 0
 #define WINDOWS_DEFAULT_NOSUBPIX false
 #define WINDOWS_DEFAULT_ENHANCE true
-#define WINDOWS_USE_DEFAULT_CONSTANTS 1
+
+// what the curve is defined for: the pointer ballistics assume a 400 cpi
+// mouse, a 96 dpi screen and a 60 Hz refresh rate
+#define WINDOWS_DEFAULT_DEVICE_RESOLUTION 400
+#define WINDOWS_DEFAULT_SCREEN_RESOLUTION 96
+#define WINDOWS_DEFAULT_SCREEN_REFRESH_RATE 60
 
 WindowsFunction::WindowsFunction(int slider) {
     
@@ -74,6 +86,31 @@ WindowsFunction::WindowsFunction(int slider) {
     previousMouseXRemainder = 0.0;
     previousMouseYRemainder = 0.0;
     pixelGain = 0.0;
+    deviceResolution = WINDOWS_DEFAULT_DEVICE_RESOLUTION;
+    screenResolution = WINDOWS_DEFAULT_SCREEN_RESOLUTION;
+    screenRefreshRate = WINDOWS_DEFAULT_SCREEN_REFRESH_RATE;
+    mickeyScale = 1.0;
+}
+
+// 0 for the default, any other value has to be within [min, max]
+static bool ResolutionInRange(int value, int min, int max)
+{
+    return value == 0 || (value >= min && value <= max);
+}
+
+bool WindowsFunction::setResolutions(int deviceRes, int screenRes, int refreshRate)
+{
+    if (!ResolutionInRange(deviceRes, WINDOWS_MIN_DEVICE_RESOLUTION, WINDOWS_MAX_DEVICE_RESOLUTION) ||
+        !ResolutionInRange(screenRes, WINDOWS_MIN_SCREEN_RESOLUTION, WINDOWS_MAX_SCREEN_RESOLUTION) ||
+        !ResolutionInRange(refreshRate, WINDOWS_MIN_REFRESH_RATE, WINDOWS_MAX_REFRESH_RATE)) {
+        return false;
+    }
+    deviceResolution = (deviceRes > 0) ? deviceRes : WINDOWS_DEFAULT_DEVICE_RESOLUTION;
+    screenResolution = (screenRes > 0) ? screenRes : WINDOWS_DEFAULT_SCREEN_RESOLUTION;
+    screenRefreshRate = (refreshRate > 0) ? refreshRate : WINDOWS_DEFAULT_SCREEN_REFRESH_RATE;
+    mickeyScale = (float)WINDOWS_DEFAULT_DEVICE_RESOLUTION / deviceResolution;
+    clearState();
+    return true;
 }
 
 float WindowsFunction::SmoothMouseGain(float deviceSpeed, int& segment)
@@ -102,13 +139,10 @@ float WindowsFunction::SmoothMouseGain(float deviceSpeed, int& segment)
         return deviceSpeed;
     }
     
-    float smoothX[5] = {0.0, 0.43, 1.25,  3.86,  40.0};
-    float smoothY[5] = {0.0, 1.37, 5.30, 24.30, 568.0};
-    
     int i;
     if (segment == FINDSEGMENT) {
         for (i=0; i<3; i++) {
-            if (deviceSpeed < smoothX[i+1])
+            if (deviceSpeed < SmoothMouseThreshold(i+1))
                 break;
         }
         segment = i;
@@ -116,11 +150,64 @@ float WindowsFunction::SmoothMouseGain(float deviceSpeed, int& segment)
         i = segment;
     }
     
-    float slope = (smoothY[i+1] - smoothY[i]) / (smoothX[i+1] - smoothX[i]);
-    float intercept = smoothY[i] - slope * smoothX[i];
+    float slope, intercept;
+    SmoothMouseSegment(i, &slope, &intercept);
     return slope + intercept/deviceSpeed;
 }
 
+float WindowsFunction::SmoothMouseThreshold(int i)
+{
+    float smoothX[5] = {0.0, 0.43, 1.25,  3.86,  40.0};
+    return smoothX[i];
+}
+
+void WindowsFunction::SmoothMouseSegment(int i, float *slope, float *intercept)
+{
+    float smoothX[5] = {0.0, 0.43, 1.25,  3.86,  40.0};
+    float smoothY[5] = {0.0, 1.37, 5.30, 24.30, 568.0};
+    
+    *slope = (smoothY[i+1] - smoothY[i]) / (smoothX[i+1] - smoothX[i]);
+    *intercept = smoothY[i] - *slope * smoothX[i];
+}
+
+float WindowsFunction::MouseMagnitude(int mouseRawX, int mouseRawY)
+{
+    return max(abs(mouseRawX), abs(mouseRawY))
+    + min(abs(mouseRawX), abs(mouseRawY)) / 2.0;
+}
+
+float WindowsFunction::PixelGain(float screenResolutionFactor, float mouseMag, int& segment)
+{
+    return screenResolutionFactor
+    * (mouseSensitivity / 10.0)
+    * SmoothMouseGain(mouseMag / 3.5, segment)
+    / 3.5;
+}
+
+float WindowsFunction::ScreenResolutionFactor(void)
+{
+    float resolution = max((double)screenResolution, 96.0);
+    float refreshRate = max((double)screenRefreshRate, 60.0);
+    if (windows7 && _gbNewMouseAccel) {
+        return resolution / 150.0;
+    } else {
+        return refreshRate / resolution;
+    }
+}
+
+float
+WindowsFunction::gainAtSpeed(float deviceSpeed) {
+    if (!enhancePointerPrecision) {
+        float pixelGain[11] = {0.03125, 0.0625, 0.25, 0.5, 0.75, 1.0, 1.5, 2.0, 2.5, 3.0, 3.5};
+        return (mouseSensitivity == 10) ? 1.0 : pixelGain[slider+5];
+    }
+    // PixelGain() takes the magnitude in mickeys per report and turns it
+    // back into inches/s by dividing by 3.5, the gain is per mickey of a
+    // 400 cpi mouse
+    int segment = FINDSEGMENT;
+    return PixelGain(ScreenResolutionFactor(), deviceSpeed * 3.5, segment) * mickeyScale;
+}
+
 void
 WindowsFunction::clearState(void) {
     previousSegmentIndex = 0;
@@ -132,6 +219,24 @@ WindowsFunction::clearState(void) {
     pixelGain = 0.0;
 }
 
+void
+WindowsFunction::getState(WindowsFunctionState *state) const {
+    state->previousSegmentIndex = previousSegmentIndex;
+    state->previousMouseRawX = previousMouseRawX;
+    state->previousMouseRawY = previousMouseRawY;
+    state->previousMouseXRemainder = previousMouseXRemainder;
+    state->previousMouseYRemainder = previousMouseYRemainder;
+}
+
+void
+WindowsFunction::setState(const WindowsFunctionState *state) {
+    previousSegmentIndex = state->previousSegmentIndex;
+    previousMouseRawX = state->previousMouseRawX;
+    previousMouseRawY = state->previousMouseRawY;
+    previousMouseXRemainder = state->previousMouseXRemainder;
+    previousMouseYRemainder = state->previousMouseYRemainder;
+}
+
 void
 WindowsFunction::apply(int mouseRawX, int mouseRawY, int *mouseX, int *mouseY) {
     if (enhancePointerPrecision) {
@@ -160,40 +265,20 @@ WindowsFunction::apply(int mouseRawX, int mouseRawY, int *mouseX, int *mouseY) {
         }
         
         // (Windows 7 does not clear remainders)
-#ifdef WINDOWS_USE_DEFAULT_CONSTANTS
-        float resolution = 96.0;
-        float refreshRate = 60.0;
-#else
-        float resolution = max((double)screenResolution, 96.0);
-        float refreshRate = max((double)screenRefreshRate, 60.0);
-#endif
-        float screenResolutionFactor;
-        if (windows7 && _gbNewMouseAccel) {
-            screenResolutionFactor = resolution / 150.0;
-        } else {
-            screenResolutionFactor = refreshRate / resolution;
-        }
+        float screenResolutionFactor = ScreenResolutionFactor();
         
-        // Calculate accelerated mouse deltas
-        float mouseMag = max(abs(mouseRawX), abs(mouseRawY))
-        + min(abs(mouseRawX), abs(mouseRawY)) / 2.0;
+        // Calculate accelerated mouse deltas, in mickeys of a 400 cpi mouse
+        float mouseMag = MouseMagnitude(mouseRawX, mouseRawY) * mickeyScale;
         int currentSegmentIndex;
-        pixelGain =
-        screenResolutionFactor
-        * (mouseSensitivity / 10.0)
-        * SmoothMouseGain(mouseMag / 3.5, currentSegmentIndex = FINDSEGMENT)
-        / 3.5;
+        pixelGain = PixelGain(screenResolutionFactor, mouseMag, currentSegmentIndex = FINDSEGMENT);
         
         if (currentSegmentIndex > previousSegmentIndex) {
             // Average with calculation using previous curve segment
-            float pixelGainUsingPreviousSegment =
-            screenResolutionFactor
-            * (mouseSensitivity / 10.0)
-            * SmoothMouseGain(mouseMag / 3.5, previousSegmentIndex)
-            / 3.5;
+            float pixelGainUsingPreviousSegment = PixelGain(screenResolutionFactor, mouseMag, previousSegmentIndex);
             pixelGain = (pixelGain + pixelGainUsingPreviousSegment) / 2.0;
         }
         previousSegmentIndex = currentSegmentIndex;
+        pixelGain *= mickeyScale;
         
         // Calculate accelerated mouse deltas
         float mouseXplusRemainder = mouseRawX * pixelGain + previousMouseXRemainder;
@@ -269,3 +354,166 @@ WindowsFunction::apply(int mouseRawX, int mouseRawY, int *mouseX, int *mouseY) {
     }
 }
 
+#define WINDOWS_BATCH_CHUNK 64
+
+void
+WindowsFunction::PixelGains(const int16_t *mouseRawX, const int16_t *mouseRawY, float screenResolutionFactor,
+                            float *mouseMags, float *pixelGains, int *segments, size_t count) {
+    // The same steps as MouseMagnitude() and PixelGain() for a segment to
+    // find, four events at a time. The magnitudes are exact in float for
+    // 16 bit deltas, and the steps PixelGain() does in double are done in
+    // double too, so every lane gives the value apply() computes.
+    size_t i = 0;
+    
+#if defined(__SSE2__) || (defined(__ARM_NEON) && defined(__aarch64__))
+    float slopes[4], intercepts[4];
+    for (int s = 0; s < 4; s++)
+        SmoothMouseSegment(s, &slopes[s], &intercepts[s]);
+    double sensitivity = mouseSensitivity / 10.0;
+#endif
+
+#if defined(__SSE2__)
+    const __m128 scale = _mm_set1_ps(mickeyScale);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128d factor = _mm_set1_pd(screenResolutionFactor * sensitivity);
+    const __m128d divisor = _mm_set1_pd(3.5);
+    for (; i + 4 <= count; i += 4) {
+        __m128i x = _mm_loadl_epi64((const __m128i *)(mouseRawX + i));
+        __m128i y = _mm_loadl_epi64((const __m128i *)(mouseRawY + i));
+        x = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+        y = _mm_srai_epi32(_mm_unpacklo_epi16(y, y), 16);
+        __m128i signX = _mm_srai_epi32(x, 31);
+        __m128i signY = _mm_srai_epi32(y, 31);
+        __m128 absX = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_xor_si128(x, signX), signX));
+        __m128 absY = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_xor_si128(y, signY), signY));
+        __m128 mag = _mm_add_ps(_mm_max_ps(absX, absY), _mm_mul_ps(_mm_min_ps(absX, absY), half));
+        mag = _mm_mul_ps(mag, scale);
+        _mm_storeu_ps(mouseMags + i, mag);
+        
+        // SmoothMouseGain(mouseMag / 3.5)
+        __m128 speed = _mm_movelh_ps(_mm_cvtpd_ps(_mm_div_pd(_mm_cvtps_pd(mag), divisor)),
+                                     _mm_cvtpd_ps(_mm_div_pd(_mm_cvtps_pd(_mm_movehl_ps(mag, mag)), divisor)));
+        __m128 still = _mm_cmpeq_ps(speed, zero);
+        __m128 slope = _mm_set1_ps(slopes[0]);
+        __m128 intercept = _mm_set1_ps(intercepts[0]);
+        __m128i segment = _mm_setzero_si128();
+        for (int s = 1; s < 4; s++) {
+            __m128 above = _mm_cmpge_ps(speed, _mm_set1_ps(SmoothMouseThreshold(s)));
+            slope = _mm_or_ps(_mm_and_ps(above, _mm_set1_ps(slopes[s])), _mm_andnot_ps(above, slope));
+            intercept = _mm_or_ps(_mm_and_ps(above, _mm_set1_ps(intercepts[s])), _mm_andnot_ps(above, intercept));
+            segment = _mm_sub_epi32(segment, _mm_castps_si128(above));
+        }
+        _mm_storeu_si128((__m128i *)(segments + i), segment);
+        // a device that does not move has no gain, divide by 1 instead of 0
+        __m128 gain = _mm_add_ps(slope, _mm_div_ps(intercept, _mm_or_ps(_mm_and_ps(still, one), _mm_andnot_ps(still, speed))));
+        gain = _mm_andnot_ps(still, gain);
+        
+        // PixelGain()
+        __m128 pixelGain = _mm_movelh_ps(_mm_cvtpd_ps(_mm_div_pd(_mm_mul_pd(factor, _mm_cvtps_pd(gain)), divisor)),
+                                         _mm_cvtpd_ps(_mm_div_pd(_mm_mul_pd(factor, _mm_cvtps_pd(_mm_movehl_ps(gain, gain))), divisor)));
+        _mm_storeu_ps(pixelGains + i, pixelGain);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const float64x2_t factor = vdupq_n_f64(screenResolutionFactor * sensitivity);
+    const float64x2_t divisor = vdupq_n_f64(3.5);
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t absX = vcvtq_f32_s32(vabsq_s32(vmovl_s16(vld1_s16(mouseRawX + i))));
+        float32x4_t absY = vcvtq_f32_s32(vabsq_s32(vmovl_s16(vld1_s16(mouseRawY + i))));
+        float32x4_t mag = vaddq_f32(vmaxq_f32(absX, absY), vmulq_n_f32(vminq_f32(absX, absY), 0.5f));
+        mag = vmulq_n_f32(mag, mickeyScale);
+        vst1q_f32(mouseMags + i, mag);
+        
+        // SmoothMouseGain(mouseMag / 3.5)
+        float32x4_t speed = vcombine_f32(vcvt_f32_f64(vdivq_f64(vcvt_f64_f32(vget_low_f32(mag)), divisor)),
+                                         vcvt_f32_f64(vdivq_f64(vcvt_high_f64_f32(mag), divisor)));
+        uint32x4_t still = vceqq_f32(speed, vdupq_n_f32(0.0f));
+        float32x4_t slope = vdupq_n_f32(slopes[0]);
+        float32x4_t intercept = vdupq_n_f32(intercepts[0]);
+        int32x4_t segment = vdupq_n_s32(0);
+        for (int s = 1; s < 4; s++) {
+            uint32x4_t above = vcgeq_f32(speed, vdupq_n_f32(SmoothMouseThreshold(s)));
+            slope = vbslq_f32(above, vdupq_n_f32(slopes[s]), slope);
+            intercept = vbslq_f32(above, vdupq_n_f32(intercepts[s]), intercept);
+            segment = vsubq_s32(segment, vreinterpretq_s32_u32(above));
+        }
+        vst1q_s32(segments + i, segment);
+        // a device that does not move has no gain, divide by 1 instead of 0
+        float32x4_t gain = vaddq_f32(slope, vdivq_f32(intercept, vbslq_f32(still, vdupq_n_f32(1.0f), speed)));
+        gain = vbslq_f32(still, vdupq_n_f32(0.0f), gain);
+        
+        // PixelGain()
+        float32x4_t pixelGain = vcombine_f32(vcvt_f32_f64(vdivq_f64(vmulq_f64(factor, vcvt_f64_f32(vget_low_f32(gain))), divisor)),
+                                             vcvt_f32_f64(vdivq_f64(vmulq_f64(factor, vcvt_high_f64_f32(gain)), divisor)));
+        vst1q_f32(pixelGains + i, pixelGain);
+    }
+#endif
+    
+    for (; i < count; i++) {
+        mouseMags[i] = MouseMagnitude(mouseRawX[i], mouseRawY[i]) * mickeyScale;
+        pixelGains[i] = PixelGain(screenResolutionFactor, mouseMags[i], segments[i] = FINDSEGMENT);
+    }
+}
+
+void
+WindowsFunction::apply_batch(const int16_t *mouseRawX, const int16_t *mouseRawY, int *mouseX, int *mouseY, size_t count) {
+    // Only the Windows 7 curve with enhanced pointer precision, the one
+    // configured by the constructor, has a batched implementation. The
+    // remainder handling of XP and Vista depends on the previous event
+    // too closely to be worth it.
+    if (!enhancePointerPrecision || !windows7 || !_gbNewMouseAccel) {
+        for (size_t i = 0; i < count; i++) {
+            apply(mouseRawX[i], mouseRawY[i], &mouseX[i], &mouseY[i]);
+        }
+        return;
+    }
+    
+    float screenResolutionFactor = ScreenResolutionFactor();
+    
+    float mouseMags[WINDOWS_BATCH_CHUNK];
+    float pixelGains[WINDOWS_BATCH_CHUNK];
+    int segments[WINDOWS_BATCH_CHUNK];
+    
+    for (size_t base = 0; base < count; base += WINDOWS_BATCH_CHUNK) {
+        size_t n = count - base;
+        if (n > WINDOWS_BATCH_CHUNK) {
+            n = WINDOWS_BATCH_CHUNK;
+        }
+        
+        // The gain of an event only depends on its own magnitude, except
+        // for the averaging when the curve segment goes up. Compute the
+        // gains for the whole chunk first, then handle the averaging and
+        // the remainders in order.
+        PixelGains(mouseRawX + base, mouseRawY + base, screenResolutionFactor, mouseMags, pixelGains, segments, n);
+        
+        for (size_t i = 0; i < n; i++) {
+            pixelGain = pixelGains[i];
+            
+            if (segments[i] > previousSegmentIndex) {
+                // Average with calculation using previous curve segment
+                float pixelGainUsingPreviousSegment = PixelGain(screenResolutionFactor, mouseMags[i], previousSegmentIndex);
+                pixelGain = (pixelGain + pixelGainUsingPreviousSegment) / 2.0;
+            }
+            previousSegmentIndex = segments[i];
+            pixelGain *= mickeyScale;
+            
+            float mouseXplusRemainder = mouseRawX[base + i] * pixelGain + previousMouseXRemainder;
+            float mouseYplusRemainder = mouseRawY[base + i] * pixelGain + previousMouseYRemainder;
+            
+            if (mouseXplusRemainder >= 0) {
+                mouseX[base + i] = (int)floor(mouseXplusRemainder);
+            } else {
+                mouseX[base + i] = -(int)floor(-mouseXplusRemainder);
+            }
+            previousMouseXRemainder = mouseXplusRemainder - mouseX[base + i];
+            
+            if (mouseYplusRemainder >= 0) {
+                mouseY[base + i] = (int)floor(mouseYplusRemainder);
+            } else {
+                mouseY[base + i] = -(int)floor(-mouseYplusRemainder);
+            }
+            previousMouseYRemainder = mouseYplusRemainder - mouseY[base + i];
+        }
+    }
+}
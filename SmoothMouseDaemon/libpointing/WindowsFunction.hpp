@@ -12,6 +12,31 @@
 #ifndef WindowsFunction_h
 #define WindowsFunction_h
 
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ What setResolutions() accepts, the same as OSXFunction so one setting works
+ for both curves.
+ */
+#define WINDOWS_MIN_DEVICE_RESOLUTION   200
+#define WINDOWS_MAX_DEVICE_RESOLUTION   32767
+#define WINDOWS_MIN_SCREEN_RESOLUTION   50
+#define WINDOWS_MAX_SCREEN_RESOLUTION   600
+#define WINDOWS_MIN_REFRESH_RATE        48
+#define WINDOWS_MAX_REFRESH_RATE        1000
+
+/**
+ What apply() keeps between events, see getState().
+ */
+struct WindowsFunctionState {
+    int previousSegmentIndex;
+    int previousMouseRawX;
+    int previousMouseRawY;
+    float previousMouseXRemainder;
+    float previousMouseYRemainder;
+};
+
 class WindowsFunction {
     
 private:
@@ -28,14 +53,23 @@ private:
     int previousMouseRawY;
     float previousMouseXRemainder;
     float previousMouseYRemainder;
+    int deviceResolution; // CPI
     int screenResolution; // DPI
-    int screenRefreshRate; // DPI
+    int screenRefreshRate; // Hz
+    float mickeyScale; // mickeys of a 400 cpi mouse per count
     float mouseSensitivity; // From registry HKEY_CURRENT_USER\Control Panel\Mouse\MouseSensitivity
     float pixelGain;
     
 protected:
     
     float SmoothMouseGain(float deviceSpeed, int& segment);
+    float SmoothMouseThreshold(int i);
+    void SmoothMouseSegment(int i, float *slope, float *intercept);
+    float MouseMagnitude(int mouseRawX, int mouseRawY);
+    float PixelGain(float screenResolutionFactor, float mouseMag, int& segment);
+    float ScreenResolutionFactor(void);
+    void PixelGains(const int16_t *mouseRawX, const int16_t *mouseRawY, float screenResolutionFactor,
+                    float *mouseMags, float *pixelGains, int *segments, size_t count);
     
 public:
 
@@ -51,10 +85,41 @@ public:
      -5 <= slider <= 5
      */
     WindowsFunction(int slider);
+
+    /**
+     The curve is defined for a 400 cpi mouse on a 96 dpi, 60 Hz screen. The
+     counts of a mouse with another resolution are converted to the
+     mickeys of a 400 cpi mouse moving the same distance, and the screen
+     resolution and refresh rate change the gain like they do on Windows.
+     0 keeps the default. Clears the state. Returns false and leaves the
+     function as it was if one is outside of the WINDOWS_MIN_* and
+     WINDOWS_MAX_* limits.
+     */
+    bool setResolutions(int deviceResolution, int screenResolution, int refreshRate);
     
     void clearState(void) ;
+
+    /**
+     The state can be saved and restored to use one function for several
+     devices, each with its own state.
+     */
+    void getState(WindowsFunctionState *state) const ;
+    void setState(const WindowsFunctionState *state) ;
     
     void apply(int dxMickey, int dyMickey, int *dxPixel, int *dyPixel) ;
+
+    /**
+     Applies the function to a burst of count events, with the same result
+     and state as calling apply() for each of them in order.
+     */
+    void apply_batch(const int16_t *dxMickey, const int16_t *dyMickey, int *dxPixel, int *dyPixel, size_t count) ;
+
+    /**
+     Returns the gain (pixels per mickey) for a device moving at deviceSpeed
+     inches per second. It does not depend on or change the state kept
+     between events, so the segment averaging of apply() is not done.
+     */
+    float gainAtSpeed(float deviceSpeed) ;
     
     ~WindowsFunction() {}
     
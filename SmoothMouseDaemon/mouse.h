@@ -4,18 +4,7 @@
 #import "MouseSupervisor.h"
 
 #include "KextProtocol.h"
-
-#define LEFT_BUTTON     (1 << 0)
-#define RIGHT_BUTTON    (1 << 1)
-#define MIDDLE_BUTTON   (1 << 2)
-#define BUTTON4         (1 << 3)
-#define BUTTON5         (1 << 4)
-#define BUTTON6         (1 << 5)
-#define NUM_BUTTONS     6
-
-#define BUTTON_DOWN(curbuttons, button)                         (((button) & curbuttons) == (button))
-#define BUTTON_UP(curbuttons, button)                           (((button) & curbuttons) == 0)
-#define BUTTON_STATE_CHANGED(curbuttons, lastbuttons, button)   ((lastButtons & (button)) != (curbuttons & (button)))
+#include "pipeline.h"
 
 extern int totalNumberOfLostEvents;
 
@@ -24,18 +13,25 @@ typedef enum RefreshReason_s {
     REFRESH_REASON_SEQUENCE_NUMBER_INVALID,
     REFRESH_REASON_POSITION_TAMPERING,
     REFRESH_REASON_BUTTON_CLICK,
-    REFRESH_REASON_FORCE_DRAG_REFRESH
+    REFRESH_REASON_FORCE_DRAG_REFRESH,
+    REFRESH_REASON_RESUME
 } RefreshReason;
 
-typedef enum AccelerationCurve_s {
-    ACCELERATION_CURVE_LINEAR   = 0,
-    ACCELERATION_CURVE_WINDOWS  = 1,
-    ACCELERATION_CURVE_OSX      = 2
-} AccelerationCurve;
-
 BOOL mouse_init();
 BOOL mouse_cleanup();
-void mouse_process_kext_event(mouse_event_t *event);
+void mouse_process_kext_event(mouse_event_t *event, const config_snapshot_t *config);
+// the events read from the kext at once, in order
+void mouse_process_kext_events(mouse_event_t *events, size_t count, const config_snapshot_t *config);
 void mouse_refresh(RefreshReason reason);
+// any thread, while paused the moves are posted with their raw deltas (see
+// pipeline_passthrough()), without waiting for the kext to be reconfigured
+void mouse_set_paused(BOOL pause);
+// the kext was paused, the system moved the cursor in the meantime and the
+// kext may have skipped sequence numbers, any thread
+void mouse_resume();
+// reads the double click speed of the system and publishes a new config
+// snapshot if it changed
 void mouse_update_clicktime();
+// must be called from the main thread, the callbacks are delivered there
+void mouse_watch_displays();
 CGPoint mouse_get_current_pos();
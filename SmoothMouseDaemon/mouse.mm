@@ -3,58 +3,26 @@
 
 #include "mouse.h"
 #include "debug.h"
-#include <sys/time.h>
 #include <pthread.h>
 #include <IOKit/hidsystem/event_status_driver.h>
 #include <IOKit/hidsystem/IOHIDShared.h>
 
 #import "Config.h"
 
-#include "WindowsFunction.hpp"
-#include "OSXFunction.hpp"
 #include "driver.h"
+#include "displays.h"
 
-WindowsFunction *win = NULL;
-OSXFunction *osx_mouse = NULL;
-OSXFunction *osx_trackpad = NULL;
-
-static CGPoint deltaPosInt;
-static CGPoint deltaPosFloat;
+static pipeline_state_t pipeline;
+static display_index_t displayIndex;
 static CGPoint currentPos;
 static CGPoint lastPos;
 static int lastButtons = 0;
-static int nclicks = 0;
-static CGPoint lastClickPos;
-static double lastClickTime = 0;
-static double doubleClickSpeed;
-static uint64_t lastSequenceNumber = 0;
+static pipeline_clicks_t clicks;
 int totalNumberOfLostEvents = 0;
 static int needs_refresh = 0;
 static RefreshReason refresh_reason = REFRESH_REASON_UNKNOWN;
-
-static int doubleClickSpeedUpdated = 0;
-static double newDoubleClickSpeed;
-
-static int remap_buttons(int buttons) {
-
-    int bl = !!(buttons & 4);
-    int bm = !!(buttons & 2);
-    int br = !!(buttons & 1);
-    int b4 = !!(buttons & 8);
-    int b5 = !!(buttons & 16);
-    int b6 = !!(buttons & 32);
-
-    int remapped = 0;
-
-    remapped |= (bl << 0);
-    remapped |= (br << 1);
-    remapped |= (bm << 2);
-    remapped |= (b4 << 3);
-    remapped |= (b5 << 4);
-    remapped |= (b6 << 5);
-
-    return remapped;
-}
+static volatile int resumed = 0;
+static volatile int paused = 0;
 
 static const char *get_refresh_reason_string(RefreshReason reason) {
     switch (reason) {
@@ -62,57 +30,43 @@ static const char *get_refresh_reason_string(RefreshReason reason) {
         case REFRESH_REASON_POSITION_TAMPERING: return "REFRESH_REASON_POSITION_TAMPERING";
         case REFRESH_REASON_BUTTON_CLICK: return "REFRESH_REASON_BUTTON_CLICK";
         case REFRESH_REASON_FORCE_DRAG_REFRESH: return "REFRESH_REASON_FORCE_DRAG_REFRESH";
+        case REFRESH_REASON_RESUME: return "REFRESH_REASON_RESUME";
         case REFRESH_REASON_UNKNOWN: return "REFRESH_REASON_UNKNOWN";
         default: return "?";
     }
 }
 
-static double timestamp()
-{
-	struct timeval t;
-	gettimeofday(&t, NULL);
-	return (double)t.tv_sec + 1.0e-6 * (double)t.tv_usec;
+static void update_displays() {
+    CGDirectDisplayID displays[DISPLAY_INDEX_MAX_DISPLAYS];
+    CGRect bounds[DISPLAY_INDEX_MAX_DISPLAYS];
+    uint32_t count = 0;
+
+    if (CGGetOnlineDisplayList(DISPLAY_INDEX_MAX_DISPLAYS, displays, &count) != kCGErrorSuccess) {
+        NSLog(@"Failed to get display list");
+        count = 0;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        bounds[i] = CGDisplayBounds(displays[i]);
+    }
+
+    display_index_update(&displayIndex, bounds, count);
 }
 
-static double get_distance(CGPoint pos0, CGPoint pos1) {
-    CGFloat deltaX = pos1.x - pos0.x;
-    CGFloat deltaY = pos1.y - pos0.y;
-    CGFloat distance = sqrt(deltaX * deltaX + deltaY * deltaY);
-    return distance;
+static void display_reconfiguration_callback(CGDirectDisplayID display, CGDisplayChangeSummaryFlags flags, void *userInfo) {
+    if (flags & kCGDisplayBeginConfigurationFlag) {
+        return;
+    }
+    update_displays();
 }
 
 static CGPoint restrict_to_screen_boundaries(CGPoint lastPos, CGPoint newPos) {
     /*
 	 The following code checks if cursor is in screen borders. It was ported
-	 from Synergy.
+	 from Synergy, but uses the local display index instead of asking the
+	 window server on every event.
 	 */
-    CGPoint pos = newPos;
-    CGDisplayCount displayCount = 0;
-	CGGetDisplaysWithPoint(newPos, 0, NULL, &displayCount);
-	if (displayCount == 0) {
-		displayCount = 0;
-		CGDirectDisplayID displayID;
-		CGGetDisplaysWithPoint(lastPos, 1,
-							   &displayID, &displayCount);
-		if (displayCount != 0) {
-			CGRect displayRect = CGDisplayBounds(displayID);
-			if (pos.x < displayRect.origin.x) {
-				pos.x = displayRect.origin.x;
-			}
-			else if (pos.x > displayRect.origin.x +
-					 displayRect.size.width - 1) {
-				pos.x = displayRect.origin.x + displayRect.size.width - 1;
-			}
-			if (pos.y < displayRect.origin.y) {
-				pos.y = displayRect.origin.y;
-			}
-			else if (pos.y > displayRect.origin.y +
-					 displayRect.size.height - 1) {
-				pos.y = displayRect.origin.y + displayRect.size.height - 1;
-			}
-		}
-	}
-    return pos;
+    return display_index_restrict(&displayIndex, lastPos, newPos);
 }
 
 static CGPoint get_current_mouse_pos() {
@@ -137,146 +91,72 @@ static CGPoint get_current_mouse_pos() {
     return currentPos;
 }
 
-static void refresh_mouse_location() {
+static void refresh_mouse_location(const config_snapshot_t *config) {
     CGPoint oldPos = currentPos;
     currentPos = get_current_mouse_pos();
 
     float movedX = currentPos.x - oldPos.x;
     float movedY = currentPos.y - oldPos.y;
 
-    deltaPosFloat.x += movedX;
-    deltaPosFloat.y += movedY;
-    deltaPosInt.x += movedX;
-    deltaPosInt.y += movedY;
+    pipeline_cursor_moved(&pipeline, movedX, movedY);
 
-    if ([[Config instance] debugEnabled]) {
+    if (config->debugEnabled) {
         LOG(@"Mouse location refreshed (%s), new: %dx%d, old: %dx%d", get_refresh_reason_string(refresh_reason),(int)currentPos.x, (int)currentPos.y, (int)oldPos.x, (int)oldPos.y);
     }
 }
 
 void mouse_update_clicktime() {
-    // only update once every sec (TODO: prettier)
-    // this operation is pretty costly
-    static int counter = 0;
-    if ((counter++) % 2 == 0) {
-        NXEventHandle handle = NXOpenEventStatus();
-        newDoubleClickSpeed = NXClickTime(handle);
-        NXCloseEventStatus(handle);
-        if (newDoubleClickSpeed != doubleClickSpeed) {
-            doubleClickSpeedUpdated = 1;
-        }
-        //NSLog(@"current system double click speed: %f", newDoubleClickSpeed);
+    NXEventHandle handle = NXOpenEventStatus();
+    double clickTime = NXClickTime(handle);
+    NXCloseEventStatus(handle);
+
+    Config *config = [Config instance];
+    if (clickTime != [config doubleClickInterval]) {
+        [config setDoubleClickInterval: clickTime];
+        [config publishSnapshot];
+        //NSLog(@"Double click speed updated to %f", clickTime);
     }
 }
 
-static void mouse_handle_move(mouse_event_t *event, double velocity, AccelerationCurve curve) {
-    CGPoint newPos;
-
-    float calcdx;
-    float calcdy;
-
-    if (curve == ACCELERATION_CURVE_WINDOWS) {
-        // map slider to [-5 <=> +5]
-        int slider = (int)((velocity * 4) - 6);
-        if (slider > 5) {
-            slider = 5;
-        }
-        if (win == NULL) {
-            win = new WindowsFunction(slider);
-        }
-        if (win->slider != slider) {
-            delete win;
-            win = new WindowsFunction(slider);
+// the deltas of the moves among count events, 0, 0 for the others
+static void mouse_accelerate(mouse_event_t *events, size_t count, int *deltaX, int *deltaY, const config_snapshot_t *config) {
+    if (paused) {
+        // an excluded app is in front, see mouse_set_paused()
+        for (size_t i = 0; i < count; i++) {
+            pipeline_passthrough(&pipeline, &events[i], &deltaX[i], &deltaY[i]);
         }
-        int newdx;
-        int newdy;
-        win->apply(event->dx, event->dy, &newdx, &newdy);
-        calcdx = (float) newdx;
-        calcdy = (float) newdy;
-    } else if (curve == ACCELERATION_CURVE_OSX) {
-        float speed = velocity;
-        if (event->device_type == kDeviceTypeTrackpad && osx_trackpad == NULL) {
-            osx_trackpad = new OSXFunction("touchpad", speed);
-        } else if (event->device_type == kDeviceTypeMouse && osx_mouse == NULL) {
-            osx_mouse = new OSXFunction("mouse", speed);
-        }
-        int newdx;
-        int newdy;
-        OSXFunction *osx = NULL;
-        switch (event->device_type) {
-            case kDeviceTypeTrackpad:
-                osx = osx_trackpad;
-                break;
-            case kDeviceTypeMouse:
-                osx = osx_mouse;
-                break;
-            default:
-                NSLog(@"invalid deviceType: %d", event->device_type);
-                exit(0);
-        }
-        osx->apply(event->dx, event->dy, &newdx, &newdy);
-        calcdx = (float) newdx;
-        calcdy = (float) newdy;
-    }
-    else {
-        calcdx = (velocity * event->dx);
-        calcdy = (velocity * event->dy);
+    } else if (!pipeline_accelerate_burst(&pipeline, config->curves, events, count, deltaX, deltaY)) {
+        NSLog(@"invalid deviceType");
+        exit(0);
     }
+}
 
-    deltaPosFloat.x += calcdx;
-    deltaPosFloat.y += calcdy;
-    int deltaX = (int) (deltaPosFloat.x - deltaPosInt.x);
-    int deltaY = (int) (deltaPosFloat.y - deltaPosInt.y);
-    deltaPosInt.x += deltaX;
-    deltaPosInt.y += deltaY;
+static void mouse_handle_move(mouse_event_t *event, int deltaX, int deltaY, const config_snapshot_t *config) {
+    CGPoint newPos;
 
     newPos.x = currentPos.x + deltaX;
     newPos.y = currentPos.y + deltaY;
 
     newPos = restrict_to_screen_boundaries(currentPos, newPos);
 
-    CGEventType eventType = kCGEventMouseMoved;
-    CGMouseButton otherButton = 0;
-
-    if (BUTTON_DOWN(event->buttons, LEFT_BUTTON)) {
-        eventType = kCGEventLeftMouseDragged;
-        otherButton = kCGMouseButtonLeft;
-    } else if (BUTTON_DOWN(event->buttons, RIGHT_BUTTON)) {
-        eventType = kCGEventRightMouseDragged;
-        otherButton = kCGMouseButtonRight;
-    } else if (BUTTON_DOWN(event->buttons, MIDDLE_BUTTON)) {
-        eventType = kCGEventOtherMouseDragged;
-        otherButton = kCGMouseButtonCenter;
-    } else if (BUTTON_DOWN(event->buttons, BUTTON4)) {
-        eventType = kCGEventOtherMouseDragged;
-        otherButton = 3;
-    } else if (BUTTON_DOWN(event->buttons, BUTTON5)) {
-        eventType = kCGEventOtherMouseDragged;
-        otherButton = 4;
-    } else if (BUTTON_DOWN(event->buttons, BUTTON6)) {
-        eventType = kCGEventOtherMouseDragged;
-        otherButton = 5;
-    }
-
-    if ([[Config instance] debugEnabled]) {
-        LOG(@"processed move event: move dx: %02d, dy: %02d, new pos: %03dx%03d, delta: %02d,%02d, deltaPos: %03dx%03d, buttons(LRM456): %d%d%d%d%d%d, eventType: %s(%d), otherButton: %d",
-            event->dx,
-            event->dy,
-            (int)newPos.x,
-            (int)newPos.y,
-            deltaX,
-            deltaY,
-            (int)deltaPosInt.x,
-            (int)deltaPosInt.y,
-            BUTTON_DOWN(event->buttons, LEFT_BUTTON),
-            BUTTON_DOWN(event->buttons, RIGHT_BUTTON),
-            BUTTON_DOWN(event->buttons, MIDDLE_BUTTON),
-            BUTTON_DOWN(event->buttons, BUTTON4),
-            BUTTON_DOWN(event->buttons, BUTTON5),
-            BUTTON_DOWN(event->buttons, BUTTON6),
-            driver_quartz_event_type_to_string(eventType),
-            eventType,
-            otherButton);
+    CGEventType eventType;
+    CGMouseButton otherButton;
+
+    pipeline_move_event_type(event->buttons, &eventType, &otherButton);
+
+    if (config->debugEnabled) {
+        TRACE(TRACE_EVENT_MOUSE_MOVE,
+              event->dx,
+              event->dy,
+              (int)newPos.x,
+              (int)newPos.y,
+              deltaX,
+              deltaY,
+              (int)pipeline.deltaPosInt.x,
+              (int)pipeline.deltaPosInt.y,
+              event->buttons,
+              (int)eventType,
+              (int)otherButton);
     }
 
 //    if (!(deltaX == 0 && deltaY == 0)) {
@@ -290,25 +170,25 @@ static void mouse_handle_move(mouse_event_t *event, double velocity, Acceleratio
         driverEvent.move.deltaY = deltaY;
         driverEvent.move.buttons = event->buttons;
         driverEvent.move.otherButton = otherButton;
-        driver_post_event((driver_event_t *)&driverEvent);
+        driver_post_event((driver_event_t *)&driverEvent, config);
 //    }
 
     currentPos = newPos;
 
-    if ([[Config instance] overlayEnabled]) {
+    if (config->overlayEnabled) {
         [[Daemon instance] redrawOverlay];
     }
 
     if (eventType != kCGEventMouseMoved) {
         // some games require the mouse position to be refreshed continuously during drags
-        if ([[Config instance] forceDragRefreshEnabled] ||
-            [[Config instance] activeAppRequiresRefreshOnDrag]) {
+        if (config->forceDragRefreshEnabled ||
+            config->activeAppRequiresRefreshOnDrag) {
             mouse_refresh(REFRESH_REASON_FORCE_DRAG_REFRESH);
         }
     }
 }
 
-static void mouse_handle_buttons(mouse_event_t *event) {
+static void mouse_handle_buttons(mouse_event_t *event, const config_snapshot_t *config) {
 
     int buttons;
 
@@ -323,65 +203,21 @@ static void mouse_handle_buttons(mouse_event_t *event) {
     for(int i = 0; i < NUM_BUTTONS; i++) {
         int buttonIndex = (1 << i);
         if (BUTTON_STATE_CHANGED(buttons, lastButtons, buttonIndex)) {
-            if (BUTTON_DOWN(buttons, buttonIndex)) {
-                switch(buttonIndex) {
-                    case LEFT_BUTTON:   eventType = kCGEventLeftMouseDown; break;
-                    case RIGHT_BUTTON:  eventType = kCGEventRightMouseDown; break;
-                    default:            eventType = kCGEventOtherMouseDown; break;
-                }
-            } else {
-                switch(buttonIndex) {
-                    case LEFT_BUTTON:   eventType = kCGEventLeftMouseUp; break;
-                    case RIGHT_BUTTON:  eventType = kCGEventRightMouseUp; break;
-                    default:            eventType = kCGEventOtherMouseUp; break;
-                }
-            }
-
-            CGMouseButton otherButton = 0;
-            switch(buttonIndex) {
-                case LEFT_BUTTON: otherButton = kCGMouseButtonLeft; break;
-                case RIGHT_BUTTON: otherButton = kCGMouseButtonRight; break;
-                case MIDDLE_BUTTON: otherButton = kCGMouseButtonCenter; break;
-                case BUTTON4: otherButton = 3; break;
-                case BUTTON5: otherButton = 4; break;
-                case BUTTON6: otherButton = 5; break;
-            }
+            CGMouseButton otherButton;
+            pipeline_button_event_type(buttonIndex, BUTTON_DOWN(buttons, buttonIndex), &eventType, &otherButton);
 
             if (eventType == kCGEventLeftMouseDown) {
-                CGFloat maxDistanceAllowed = sqrt(2) + 0.0001;
-                CGFloat distanceMovedSinceLastClick = get_distance(lastClickPos, currentPos);
-                double now = timestamp();
-
-                if (doubleClickSpeedUpdated) {
-                    doubleClickSpeed = newDoubleClickSpeed;
-                    doubleClickSpeedUpdated = 0;
-                    //NSLog(@"Double click speed updated to %f", doubleClickSpeed);
-                }
-
-                if (now - lastClickTime <= doubleClickSpeed &&
-                    distanceMovedSinceLastClick <= maxDistanceAllowed) {
-                    lastClickTime = timestamp();
-                    nclicks++;
-                } else {
-                    nclicks = 1;
-                    lastClickTime = timestamp();
-                    lastClickPos = currentPos;
-                }
+                // only events carry presses, the release on termination has none
+                pipeline_count_click(&clicks, currentPos, event->timestamp, config->doubleClickInterval);
             }
 
-            if ([[Config instance] debugEnabled]) {
-                LOG(@"processed button event: buttons(LRM456): %d%d%d%d%d%d, eventType: %s(%d), otherButton: %d, buttonIndex(654MRL): %d, nclicks: %d",
-                    BUTTON_DOWN(buttons, LEFT_BUTTON),
-                    BUTTON_DOWN(buttons, RIGHT_BUTTON),
-                    BUTTON_DOWN(buttons, MIDDLE_BUTTON),
-                    BUTTON_DOWN(buttons, BUTTON4),
-                    BUTTON_DOWN(buttons, BUTTON5),
-                    BUTTON_DOWN(buttons, BUTTON6),
-                    driver_quartz_event_type_to_string(eventType),
-                    eventType,
-                    otherButton,
-                    ((int)log2(buttonIndex)),
-                    nclicks);
+            if (config->debugEnabled) {
+                TRACE(TRACE_EVENT_MOUSE_BUTTON,
+                      buttons,
+                      (int)eventType,
+                      (int)otherButton,
+                      ((int)log2(buttonIndex)),
+                      clicks.nclicks);
             }
 
             driver_event_t driverEvent;
@@ -397,26 +233,26 @@ static void mouse_handle_buttons(mouse_event_t *event) {
             driverEvent.button.type = eventType;
             driverEvent.button.buttons = buttons;
             driverEvent.button.otherButton = otherButton;
-            driverEvent.button.nclicks = nclicks;
-            driver_post_event((driver_event_t *)&driverEvent);
+            driverEvent.button.nclicks = clicks.nclicks;
+            driver_post_event((driver_event_t *)&driverEvent, config);
         }
     }
 }
 
-void check_sequence_number(mouse_event_t *event) {
-    uint64_t seqnumExpected = (lastSequenceNumber + 1);
-    int seqNumOk = (event->seqnum == seqnumExpected);
-    uint64_t lostEvents = (event->seqnum - seqnumExpected);
-    if (lastSequenceNumber == 0) {
-        lostEvents = 0;
-    }
+void check_sequence_number(mouse_event_t *event, const config_snapshot_t *config) {
+    uint64_t seqnumExpected;
+    uint64_t lostEvents;
+    BOOL seqNumOk = pipeline_check_sequence_number(&pipeline, event->seqnum, &seqnumExpected, &lostEvents);
     totalNumberOfLostEvents += lostEvents;
     if (!seqNumOk) {
-        LOG(@"seqnum: %llu, expected: %llu (%llu lost events)",
-            event->seqnum,
-            seqnumExpected,
-            lostEvents);
-        if (lostEvents != 0 && [[Config instance] sayEnabled]) {
+        TRACE(TRACE_EVENT_MOUSE_SEQNUM,
+              TRACE_U64_LO(event->seqnum),
+              TRACE_U64_HI(event->seqnum),
+              TRACE_U64_LO(seqnumExpected),
+              TRACE_U64_HI(seqnumExpected),
+              TRACE_U64_LO(lostEvents),
+              TRACE_U64_HI(lostEvents));
+        if (lostEvents != 0 && config->sayEnabled) {
             NSString *stringToSay;
             if (lostEvents == 1) {
                 stringToSay = [NSString stringWithFormat:@"Lost 1 kernel event"];
@@ -430,55 +266,65 @@ void check_sequence_number(mouse_event_t *event) {
     }
 }
 
-void check_needs_refresh(mouse_event_t *event) {
+void check_needs_refresh(mouse_event_t *event, const config_snapshot_t *config) {
     if (needs_refresh) {
-        refresh_mouse_location();
+        refresh_mouse_location(config);
         needs_refresh = 0;
     }
 }
 
-void mouse_process_kext_event(mouse_event_t *event) {
+void mouse_process_kext_events(mouse_event_t *events, size_t count, const config_snapshot_t *config) {
+    int deltaX[PIPELINE_BURST_CHUNK];
+    int deltaY[PIPELINE_BURST_CHUNK];
 
-    event->buttons = remap_buttons(event->buttons);
+    for (size_t base = 0; base < count; base += PIPELINE_BURST_CHUNK) {
+        size_t n = MIN(count - base, (size_t) PIPELINE_BURST_CHUNK);
 
-    check_sequence_number(event);
+        for (size_t i = 0; i < n; i++) {
+            events[base + i].buttons = pipeline_remap_buttons(events[base + i].buttons);
+        }
 
-    if (event->buttons != lastButtons) {
-        check_needs_refresh(event);
-        mouse_handle_buttons(event);
+        // the moves are accelerated together, what happens to the buttons and
+        // the cursor position in between does not change them
+        mouse_accelerate(events + base, n, deltaX, deltaY, config);
 
-        // on all clicks, refresh mouse position
-        mouse_refresh(REFRESH_REASON_BUTTON_CLICK);
-    }
+        for (size_t i = 0; i < n; i++) {
+            mouse_event_t *event = &events[base + i];
 
-    if (event->dx != 0 || event->dy != 0) {
-        check_needs_refresh(event);
-        double velocity;
-        AccelerationCurve curve;
-        switch (event->device_type) {
-            case kDeviceTypeMouse:
-                velocity = [[Config instance] mouseVelocity];
-                curve = [[Config instance] mouseCurve];
-                break;
-            case kDeviceTypeTrackpad:
-                velocity = [[Config instance] trackpadVelocity];
-                curve = [[Config instance] trackpadCurve];
-                break;
-            default:
-                NSLog(@"INTERNAL ERROR: device type not mouse or trackpad");
-                exit(0);
-        }
+            if (resumed) {
+                // the events of the pause were not lost, they went to the system
+                resumed = 0;
+                pipeline.lastSequenceNumber = 0;
+            }
 
-        mouse_handle_move(event, velocity, curve);
-    }
+            check_sequence_number(event, config);
 
-    if ([[Config instance] debugEnabled]) {
-        debug_register_event(event);
+            if (event->buttons != lastButtons) {
+                check_needs_refresh(event, config);
+                mouse_handle_buttons(event, config);
+
+                // on all clicks, refresh mouse position
+                mouse_refresh(REFRESH_REASON_BUTTON_CLICK);
+            }
+
+            if (event->dx != 0 || event->dy != 0) {
+                check_needs_refresh(event, config);
+                mouse_handle_move(event, deltaX[i], deltaY[i], config);
+            }
+
+            if (config->debugEnabled) {
+                debug_register_event(event);
+            }
+
+            pipeline.lastSequenceNumber = event->seqnum;
+            lastButtons = event->buttons;
+            lastPos = currentPos;
+        }
     }
+}
 
-    lastSequenceNumber = event->seqnum;
-    lastButtons = event->buttons;
-    lastPos = currentPos;
+void mouse_process_kext_event(mouse_event_t *event, const config_snapshot_t *config) {
+    mouse_process_kext_events(event, 1, config);
 }
 
 void mouse_refresh(RefreshReason reason) {
@@ -488,12 +334,21 @@ void mouse_refresh(RefreshReason reason) {
     }
 }
 
-BOOL mouse_init() {
-    mouse_update_clicktime();
+void mouse_set_paused(BOOL pause) {
+    paused = pause;
+    __sync_synchronize();
+}
+
+void mouse_resume() {
+    resumed = 1;
+    mouse_refresh(REFRESH_REASON_RESUME);
+}
 
-    currentPos = deltaPosFloat = deltaPosInt = get_current_mouse_pos();
+BOOL mouse_init() {
+    currentPos = get_current_mouse_pos();
 
-    lastSequenceNumber = 0;
+    pipeline_init(&pipeline, currentPos);
+    pipeline_clicks_init(&clicks);
     totalNumberOfLostEvents = 0;
 
     return driver_init();
@@ -502,25 +357,25 @@ BOOL mouse_init() {
 BOOL mouse_cleanup() {
     if (lastButtons != 0) {
         NSLog(@"Force mouse button release");
-        mouse_handle_buttons(0);
-    }
-
-    if (win != NULL) {
-        delete win;
-        win = NULL;
-    }
-    if (osx_mouse != NULL) {
-        delete osx_mouse;
-        osx_mouse = NULL;
-    }
-    if (osx_trackpad != NULL) {
-        delete osx_trackpad;
-        osx_trackpad = NULL;
+        const config_snapshot_t *config = config_acquire(CONFIG_READER_KERNEL_EVENT_THREAD);
+        mouse_handle_buttons(0, config);
+        config_release(CONFIG_READER_KERNEL_EVENT_THREAD);
     }
 
     return driver_cleanup();
 }
 
+void mouse_watch_displays() {
+    static BOOL registered = NO;
+
+    update_displays();
+
+    if (!registered) {
+        CGDisplayRegisterReconfigurationCallback(display_reconfiguration_callback, NULL);
+        registered = YES;
+    }
+}
+
 CGPoint mouse_get_current_pos() {
     return currentPos;
 }
@@ -0,0 +1,325 @@
+/*
+ smoothmouse-kextsim stands in for the kext: a producer process fills the
+ event ring (see KextProtocol.h and eventring.h) in shared memory at a fixed
+ report rate, and the consumer runs the events through the acceleration
+ pipeline in place, the way the KernelEventThread does. The notification
+ port of the kext is a pipe.
+
+ It reports the events per record, the number of wakeups and notifications,
+ the events the producer dropped and the consumer found missing (sequence
+ number gaps), the latency from the event timestamp until the consumer takes
+ the record and the consumer's CPU time per event. --consumer-delay makes the
+ consumer slow enough to fill the ring.
+
+ It does not depend on OS X and builds on Linux with:
+
+   c++ -O2 -ISmoothMouseDaemon -ISmoothMouseDaemon/core -ISmoothMouseDaemon/libpointing \
+       SmoothMouseKextSim/main.cpp \
+       SmoothMouseDaemon/core/eventring.cpp \
+       SmoothMouseDaemon/core/pipeline.cpp SmoothMouseDaemon/core/processor.cpp \
+       SmoothMouseDaemon/libpointing/OSXFunction.cpp SmoothMouseDaemon/libpointing/WindowsFunction.cpp \
+       -o smoothmouse-kextsim
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "eventring.h"
+#include "pipeline.h"
+#include "processor.h"
+
+#define DEFAULT_RATE        (8000)
+#define DEFAULT_DURATION    (5.0)
+#define DEFAULT_NUM_RECORDS (256)
+
+typedef struct sim_settings_s {
+    double rate;            // reports per second, 0 for as fast as possible
+    double duration;        // seconds
+    int burst;              // events per report
+    uint32_t numRecords;
+    int consumerDelay;      // microseconds per record
+} sim_settings_t;
+
+// written by the producer, read by the consumer after the producer exited
+typedef struct sim_stats_s {
+    uint64_t events;
+    uint64_t reports;
+    uint64_t notifications;
+    uint64_t late;          // reports sent later than one period after their time
+} sim_stats_t;
+
+static uint64_t monotonic_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static double cpu_time() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+           usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+static void sleep_until(uint64_t deadline) {
+    struct timespec ts;
+    ts.tv_sec = deadline / 1000000000ull;
+    ts.tv_nsec = deadline % 1000000000ull;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
+// the kext side: one report of settings->burst events per period, a circle
+// with a button press every 512 events
+static void produce(const sim_settings_t *settings, event_ring_t *ring, sim_stats_t *stats, int notifyFd) {
+    uint64_t period = settings->rate > 0 ? (uint64_t) (1e9 / settings->rate) : 0;
+    uint64_t start = monotonic_now();
+    uint64_t end = start + (uint64_t) (settings->duration * 1e9);
+    uint64_t next = start;
+    uint64_t seqnum = 0;
+
+    mouse_event_t event;
+    memset(&event, 0, sizeof(event));
+    event.device_type = kDeviceTypeMouse;
+    event.device_id = 1;
+
+    while (true) {
+        if (period != 0) {
+            next += period;
+            sleep_until(next);
+        }
+        uint64_t now = monotonic_now();
+        if (now >= end) {
+            break;
+        }
+        if (period != 0 && now > next + period) {
+            stats->late++;
+        }
+
+        for (int i = 0; i < settings->burst; i++) {
+            double angle = seqnum * 0.01;
+            event.dx = (int) lround(8 * cos(angle));
+            event.dy = (int) lround(8 * sin(angle));
+            event.buttons = ((seqnum >> 9) & 1) ? 4 : 0; // raw left button
+            event.seqnum = seqnum++;
+            event.timestamp = now;
+            event_ring_push(ring, &event);
+            stats->events++;
+        }
+        stats->reports++;
+
+        if (event_ring_publish(ring)) {
+            char c = 0;
+            if (write(notifyFd, &c, 1) == 1) {
+                stats->notifications++;
+            }
+        }
+    }
+}
+
+static void null_post_callback(driver_event_t *, void *context) {
+    (*(uint64_t *)context)++;
+}
+
+#define CONSUMER_BURST 64
+
+typedef struct consumer_s {
+    processor_t processor;
+    uint64_t posted;
+    uint64_t events;
+    uint64_t records;
+    uint64_t wakeups;
+    std::vector<uint64_t> latencies;
+} consumer_t;
+
+// the KernelEventThread side, see KernelEventRingLoop()
+static void consume(const sim_settings_t *settings, event_ring_t *ring, consumer_t *consumer, int notifyFd) {
+    BOOL producerDone = NO;
+    while (true) {
+        // the events published up to now are processed together, like
+        // KernelEventRingLoop() does
+        mouse_event_t events[CONSUMER_BURST];
+        size_t numEvents = 0;
+        event_ring_record_t *record;
+        while ((record = event_ring_peek(ring)) != NULL) {
+            uint64_t now = monotonic_now();
+            uint32_t numRecordEvents = event_ring_num_events(ring, record);
+            for (uint32_t i = 0; i < numRecordEvents; i++) {
+                events[numEvents] = *event_ring_event(ring, record, i);
+                consumer->latencies.push_back(now - events[numEvents].timestamp);
+                if (++numEvents == CONSUMER_BURST) {
+                    processor_process_events(&consumer->processor, events, numEvents);
+                    numEvents = 0;
+                }
+                consumer->events++;
+            }
+            consumer->records++;
+            if (settings->consumerDelay > 0) {
+                usleep(settings->consumerDelay);
+            }
+            event_ring_consume(ring);
+        }
+        if (numEvents > 0) {
+            processor_process_events(&consumer->processor, events, numEvents);
+        }
+
+        if (producerDone) {
+            break;
+        }
+
+        if (event_ring_begin_wait(ring)) {
+            char buf[64];
+            ssize_t n;
+            do {
+                n = read(notifyFd, buf, sizeof(buf));
+            } while (n < 0 && errno == EINTR);
+            event_ring_end_wait(ring);
+            if (n <= 0) {
+                // the producer exited, take what it left in the ring
+                producerDone = YES;
+            }
+            consumer->wakeups++;
+        }
+    }
+}
+
+static uint64_t percentile(const std::vector<uint64_t> &sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t i = (size_t) (p / 100.0 * (sorted.size() - 1));
+    return sorted[i];
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [--rate <hz>] [--duration <s>] [--burst <events>] [--records <n>] [--consumer-delay <us>]\n", argv0);
+    fprintf(stderr, "  --rate <hz>        reports per second (default %d), 0 for as fast as possible\n", DEFAULT_RATE);
+    fprintf(stderr, "  --duration <s>     seconds to produce (default %.0f)\n", DEFAULT_DURATION);
+    fprintf(stderr, "  --burst <events>   events per report (default 1)\n");
+    fprintf(stderr, "  --records <n>      records in the ring, a power of two (default %d)\n", DEFAULT_NUM_RECORDS);
+    fprintf(stderr, "  --consumer-delay <us>\n");
+    fprintf(stderr, "                     let the consumer spend <us> microseconds more on every record\n");
+}
+
+int main(int argc, char *argv[]) {
+    sim_settings_t settings;
+    settings.rate = DEFAULT_RATE;
+    settings.duration = DEFAULT_DURATION;
+    settings.burst = 1;
+    settings.numRecords = DEFAULT_NUM_RECORDS;
+    settings.consumerDelay = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            settings.rate = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) {
+            settings.duration = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--burst") == 0 && i + 1 < argc) {
+            settings.burst = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--records") == 0 && i + 1 < argc) {
+            settings.numRecords = (uint32_t) atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--consumer-delay") == 0 && i + 1 < argc) {
+            settings.consumerDelay = atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (settings.rate < 0 || settings.duration <= 0 || settings.burst < 1 || settings.consumerDelay < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // the ring and the producer's statistics share one mapping
+    size_t ringSize = event_ring_size(settings.numRecords);
+    size_t size = ringSize + sizeof(sim_stats_t);
+    void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+
+    event_ring_t producerRing;
+    if (!event_ring_create(&producerRing, memory, ringSize, settings.numRecords)) {
+        fprintf(stderr, "invalid number of records %u, must be a power of two\n", settings.numRecords);
+        return 1;
+    }
+    sim_stats_t *stats = (sim_stats_t *) ((uint8_t *) memory + ringSize);
+    memset(stats, 0, sizeof(sim_stats_t));
+
+    int fds[2];
+    if (pipe(fds) != 0) {
+        perror("pipe");
+        return 1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        produce(&settings, &producerRing, stats, fds[1]);
+        _exit(0);
+    }
+    close(fds[1]);
+
+    // the consumer only knows the memory, like the daemon
+    event_ring_t ring;
+    if (!event_ring_attach(&ring, memory, ringSize)) {
+        fprintf(stderr, "failed to attach to the event ring\n");
+        kill(pid, SIGKILL);
+        return 1;
+    }
+
+    consumer_t *consumer = new consumer_t();
+    pipeline_curves_t *curves = pipeline_curves_create(ACCELERATION_CURVE_OSX, 1.0, NULL, ACCELERATION_CURVE_OSX, 1.0, NULL);
+    CGPoint pos = { 0, 0 };
+    processor_init(&consumer->processor, pos, curves, null_post_callback, &consumer->posted);
+    consumer->latencies.reserve((size_t) (settings.rate * settings.duration * settings.burst) + 1);
+
+    double cpuStart = cpu_time();
+    consume(&settings, &ring, consumer, fds[0]);
+    double cpu = cpu_time() - cpuStart;
+
+    int status;
+    waitpid(pid, &status, 0);
+
+    std::sort(consumer->latencies.begin(), consumer->latencies.end());
+
+    printf("produced:      %llu events in %llu reports (%llu late)\n",
+           (unsigned long long) stats->events, (unsigned long long) stats->reports, (unsigned long long) stats->late);
+    printf("consumed:      %llu events in %llu records, %.2f events per record\n",
+           (unsigned long long) consumer->events, (unsigned long long) consumer->records,
+           consumer->records > 0 ? (double) consumer->events / consumer->records : 0.0);
+    printf("dropped:       %u events (ring full), %llu missing by sequence number\n",
+           event_ring_dropped(&ring), (unsigned long long) consumer->processor.lostEvents);
+    printf("wakeups:       %llu, notifications: %llu\n",
+           (unsigned long long) consumer->wakeups, (unsigned long long) stats->notifications);
+    printf("latency:       p50 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us\n",
+           percentile(consumer->latencies, 50) / 1e3, percentile(consumer->latencies, 99) / 1e3,
+           percentile(consumer->latencies, 99.9) / 1e3, percentile(consumer->latencies, 100) / 1e3);
+    printf("consumer cpu:  %.3f s, %.0f ns per event\n",
+           cpu, consumer->events > 0 ? cpu * 1e9 / consumer->events : 0.0);
+
+    processor_release_buttons(&consumer->processor);
+    pipeline_curves_release(curves);
+    delete consumer;
+    munmap(memory, size);
+
+    return 0;
+}
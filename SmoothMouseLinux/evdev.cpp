@@ -0,0 +1,312 @@
+#include "evdev.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/input.h>
+
+#ifndef input_event_sec
+#define input_event_sec  time.tv_sec
+#define input_event_usec time.tv_usec
+#endif
+
+#define BITS_PER_LONG       (sizeof(unsigned long) * 8)
+#define NLONGS(bits)        (((bits) + BITS_PER_LONG - 1) / BITS_PER_LONG)
+#define TEST_BIT(bit, bits) (((bits)[(bit) / BITS_PER_LONG] >> ((bit) % BITS_PER_LONG)) & 1)
+
+// evdev button codes in the order of the kext's button bits, see
+// pipeline_remap_buttons()
+static const struct {
+    int code;
+    int button;
+} button_map[] = {
+    { BTN_RIGHT,   (1 << 0) },
+    { BTN_MIDDLE,  (1 << 1) },
+    { BTN_LEFT,    (1 << 2) },
+    { BTN_SIDE,    (1 << 3) },
+    { BTN_EXTRA,   (1 << 4) },
+    { BTN_FORWARD, (1 << 5) },
+};
+
+#define NUM_MAPPED_BUTTONS ((int)(sizeof(button_map) / sizeof(button_map[0])))
+
+static int evdev_button(int code) {
+    for (int i = 0; i < NUM_MAPPED_BUTTONS; i++) {
+        if (button_map[i].code == code) {
+            return button_map[i].button;
+        }
+    }
+    return 0;
+}
+
+// button state straight from the device, used after the kernel dropped events
+static int evdev_query_buttons(evdev_device_t *device) {
+    unsigned long keys[NLONGS(KEY_CNT)];
+    memset(keys, 0, sizeof(keys));
+
+    if (device->file || ioctl(device->fd, EVIOCGKEY(sizeof(keys)), keys) < 0) {
+        return device->buttons;
+    }
+
+    int buttons = 0;
+    for (int i = 0; i < NUM_MAPPED_BUTTONS; i++) {
+        if (TEST_BIT(button_map[i].code, keys)) {
+            buttons |= button_map[i].button;
+        }
+    }
+    return buttons;
+}
+
+BOOL evdev_init(evdev_source_t *source) {
+    memset(source, 0, sizeof(evdev_source_t));
+    source->epollFd = epoll_create1(EPOLL_CLOEXEC);
+    return (source->epollFd != -1);
+}
+
+static void evdev_remove_device(evdev_source_t *source, int index) {
+    evdev_device_t *device = &source->devices[index];
+
+    if (device->file) {
+        source->numFiles--;
+    } else {
+        epoll_ctl(source->epollFd, EPOLL_CTL_DEL, device->fd, NULL);
+    }
+    close(device->fd);
+
+    // keep the devices packed, epoll refers to them by fd
+    source->numDevices--;
+    source->devices[index] = source->devices[source->numDevices];
+}
+
+void evdev_cleanup(evdev_source_t *source) {
+    while (source->numDevices > 0) {
+        evdev_remove_device(source, source->numDevices - 1);
+    }
+    if (source->epollFd != -1) {
+        close(source->epollFd);
+        source->epollFd = -1;
+    }
+}
+
+BOOL evdev_add_device(evdev_source_t *source, const char *path, device_type_t deviceType) {
+    if (source->numDevices == EVDEV_MAX_DEVICES) {
+        errno = EMFILE;
+        return NO;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return NO;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return NO;
+    }
+
+    BOOL file = S_ISREG(st.st_mode);
+
+    if (!file) {
+        unsigned long rel[NLONGS(REL_CNT)];
+        memset(rel, 0, sizeof(rel));
+        if (ioctl(fd, EVIOCGBIT(EV_REL, sizeof(rel)), rel) < 0 ||
+            !TEST_BIT(REL_X, rel) || !TEST_BIT(REL_Y, rel)) {
+            close(fd);
+            errno = ENOTSUP;
+            return NO;
+        }
+
+        // same clock as latency_now()
+        int clock = CLOCK_MONOTONIC;
+        ioctl(fd, EVIOCSCLOCKID, &clock);
+
+        int flags = fcntl(fd, F_GETFL);
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(source->epollFd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+            close(fd);
+            return NO;
+        }
+    }
+
+    evdev_device_t *device = &source->devices[source->numDevices];
+    memset(device, 0, sizeof(evdev_device_t));
+    device->fd = fd;
+    device->file = file;
+    device->deviceType = deviceType;
+    device->id = ++source->lastDeviceId;
+    device->buttons = evdev_query_buttons(device);
+    device->lastButtons = device->buttons;
+
+    source->numDevices++;
+    if (file) {
+        source->numFiles++;
+    }
+
+    return YES;
+}
+
+BOOL evdev_grab(evdev_source_t *source, BOOL grab) {
+    BOOL ok = YES;
+    for (int i = 0; i < source->numDevices; i++) {
+        evdev_device_t *device = &source->devices[i];
+        if (!device->file && ioctl(device->fd, EVIOCGRAB, grab ? 1 : 0) < 0) {
+            ok = NO;
+        }
+    }
+    return ok;
+}
+
+// returns YES if the frame ended by this record produced an event
+static BOOL evdev_handle_record(evdev_source_t *source, evdev_device_t *device, const struct input_event *record, mouse_event_t *event) {
+    switch (record->type) {
+        case EV_REL:
+            if (record->code == REL_X) {
+                device->dx += record->value;
+            } else if (record->code == REL_Y) {
+                device->dy += record->value;
+            }
+            return NO;
+        case EV_KEY: {
+            int button = evdev_button(record->code);
+            if (record->value == 1) {
+                device->buttons |= button;
+            } else if (record->value == 0) {
+                device->buttons &= ~button;
+            }
+            return NO;
+        }
+        case EV_SYN:
+            break;
+        default:
+            return NO;
+    }
+
+    if (record->code == SYN_DROPPED) {
+        device->dropping = YES;
+        source->seqnum++;
+        source->numDropped++;
+        return NO;
+    }
+
+    if (record->code != SYN_REPORT) {
+        return NO;
+    }
+
+    if (device->dropping) {
+        // the frame is incomplete, only the button state can be recovered
+        device->dropping = NO;
+        device->dx = 0;
+        device->dy = 0;
+        device->buttons = evdev_query_buttons(device);
+        return NO;
+    }
+
+    if (device->dx == 0 && device->dy == 0 && device->buttons == device->lastButtons) {
+        return NO;
+    }
+
+    event->device_type = device->deviceType;
+    event->buttons = device->buttons;
+    event->dx = device->dx;
+    event->dy = device->dy;
+    event->timestamp = (uint64_t)record->input_event_sec * 1000000000ULL + (uint64_t)record->input_event_usec * 1000ULL;
+    event->seqnum = ++source->seqnum;
+    event->device_id = device->id;
+    event->reserved = 0;
+
+    device->dx = 0;
+    device->dy = 0;
+    device->lastButtons = device->buttons;
+
+    return YES;
+}
+
+// reads at most maxEvents records, every record completes at most one event,
+// returns -1 if the device has to be removed
+static int evdev_read_device(evdev_source_t *source, evdev_device_t *device, mouse_event_t *events, int maxEvents) {
+    struct input_event records[EVDEV_READ_BATCH];
+    int numRecords = (maxEvents < EVDEV_READ_BATCH ? maxEvents : EVDEV_READ_BATCH);
+
+    ssize_t n = read(device->fd, records, numRecords * sizeof(struct input_event));
+    if (n == -1 && (errno == EAGAIN || errno == EINTR)) {
+        return 0;
+    }
+    if (n <= 0) {
+        // end of file, or the device is gone (ENODEV)
+        return -1;
+    }
+
+    // a partial record can only be at the end of a truncated file
+    numRecords = (int)(n / sizeof(struct input_event));
+
+    int numEvents = 0;
+    for (int i = 0; i < numRecords; i++) {
+        if (evdev_handle_record(source, device, &records[i], &events[numEvents])) {
+            numEvents++;
+        }
+    }
+
+    return numEvents;
+}
+
+int evdev_read(evdev_source_t *source, mouse_event_t *events, int maxEvents, int timeout) {
+    if (source->numDevices == 0) {
+        return -1;
+    }
+
+    int numEvents = 0;
+
+    // files are always readable, read them before looking at the devices
+    for (int i = 0; i < source->numDevices && numEvents < maxEvents; i++) {
+        evdev_device_t *device = &source->devices[i];
+        if (!device->file) {
+            continue;
+        }
+        int n = evdev_read_device(source, device, events + numEvents, maxEvents - numEvents);
+        if (n == -1) {
+            evdev_remove_device(source, i);
+            i--;
+            continue;
+        }
+        numEvents += n;
+    }
+
+    if (numEvents > 0 || source->numDevices == source->numFiles) {
+        return (numEvents == 0 && source->numDevices == 0) ? -1 : numEvents;
+    }
+
+    struct epoll_event ready[EVDEV_MAX_DEVICES];
+    int numReady = epoll_wait(source->epollFd, ready, EVDEV_MAX_DEVICES, timeout);
+    if (numReady == -1) {
+        return (errno == EINTR ? 0 : -1);
+    }
+
+    for (int r = 0; r < numReady && numEvents < maxEvents; r++) {
+        for (int i = 0; i < source->numDevices; i++) {
+            evdev_device_t *device = &source->devices[i];
+            if (device->file || device->fd != ready[r].data.fd) {
+                continue;
+            }
+            int n = evdev_read_device(source, device, events + numEvents, maxEvents - numEvents);
+            if (n == -1) {
+                evdev_remove_device(source, i);
+            } else {
+                numEvents += n;
+            }
+            break;
+        }
+    }
+
+    return (source->numDevices == 0 && numEvents == 0) ? -1 : numEvents;
+}
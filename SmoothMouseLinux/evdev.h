@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "platform.h"
+#include "KextProtocol.h"
+
+/*
+ Linux event source: reads relative motion and button events from evdev
+ devices (/dev/input/event*) and turns every SYN_REPORT frame into a
+ mouse_event_t like the ones the kext sends. Timestamps are the kernel's
+ CLOCK_MONOTONIC event times in nanoseconds. The kernel has no sequence
+ numbers, so they are counted per source; when the kernel reports that it
+ dropped events (SYN_DROPPED) one number is skipped, which makes the pipeline
+ see a lost event. Every device added gets its own device id, starting at 1.
+
+ Instead of a device, a regular file with raw input_event records can be
+ added, for example one recorded with "cat /dev/input/event5 > mouse.rec".
+ Files are read until their end and do not go through epoll.
+ */
+
+#define EVDEV_MAX_DEVICES   (16)
+#define EVDEV_READ_BATCH    (64)    // input_event records per read()
+
+typedef struct evdev_device_s {
+    int fd;
+    BOOL file;
+    device_type_t deviceType;
+    uint32_t id;
+    int buttons;        // in the kext's button order
+    int lastButtons;    // buttons of the last mouse_event_t
+    int dx;
+    int dy;
+    BOOL dropping;      // discard everything up to the next SYN_REPORT
+} evdev_device_t;
+
+typedef struct evdev_source_s {
+    int epollFd;
+    int numDevices;
+    int numFiles;
+    uint32_t lastDeviceId;
+    uint64_t seqnum;
+    uint64_t numDropped;
+    evdev_device_t devices[EVDEV_MAX_DEVICES];
+} evdev_source_t;
+
+BOOL evdev_init(evdev_source_t *source);
+void evdev_cleanup(evdev_source_t *source);
+
+// returns NO and sets errno if the path can not be opened or, for devices,
+// does not report relative X and Y motion
+BOOL evdev_add_device(evdev_source_t *source, const char *path, device_type_t deviceType);
+
+// grabs all devices, so their events only reach us
+BOOL evdev_grab(evdev_source_t *source, BOOL grab);
+
+/*
+ Waits up to timeout milliseconds (-1 forever) for input and returns the
+ number of mouse events stored in events, 0 on timeout or when the input did
+ not complete a frame, and -1 when there are no devices left to read from
+ (all files read, all devices gone).
+ */
+int evdev_read(evdev_source_t *source, mouse_event_t *events, int maxEvents, int timeout);
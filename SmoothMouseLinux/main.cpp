@@ -0,0 +1,426 @@
+/*
+ smoothmouse-linux runs the events of evdev devices (or of recordings of
+ them, see evdev.h) through the daemon's acceleration pipeline. With
+ --output the resulting driver events are posted through a uinput device
+ (DRIVER_UINPUT, see uinput.h) and the input devices are grabbed, so that
+ only the accelerated events reach the system. Otherwise they are printed.
+
+ Driver events are queued while one batch of input is processed and
+ coalesced the same way the DriverEventThread does it, then passed on. With
+ --coalesce a move at the end of a batch is held back for the coalescing
+ interval like the DriverEventThread does (see pipeline_pacer_t).
+
+ Everything runs on an event loop (see eventloop.h) that only wakes up for
+ input, for a held move that is due and for SIGINT / SIGTERM.
+
+ It builds with:
+
+   c++ -O2 -ISmoothMouseDaemon -ISmoothMouseDaemon/core -ISmoothMouseDaemon/libpointing \
+       SmoothMouseLinux/main.cpp SmoothMouseLinux/evdev.cpp SmoothMouseLinux/uinput.cpp \
+       SmoothMouseDaemon/core/eventloop.cpp \
+       SmoothMouseDaemon/core/pipeline.cpp SmoothMouseDaemon/core/processor.cpp \
+       SmoothMouseDaemon/libpointing/OSXFunction.cpp SmoothMouseDaemon/libpointing/WindowsFunction.cpp \
+       -o smoothmouse-linux
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+#include "evdev.h"
+#include "uinput.h"
+#include "eventloop.h"
+#include "pipeline.h"
+#include "processor.h"
+
+#define MAX_EVENTS_PER_READ (256)
+
+typedef struct linux_daemon_s {
+    processor_t processor;
+    std::vector<driver_event_t> queue;
+    uinput_driver_t *output;
+    BOOL print;
+    uint64_t numKextEvents;
+    uint64_t numDriverEvents;
+    uint64_t numCoalescedEvents;
+    pipeline_pacer_t pacer;
+    BOOL holding;
+    uint64_t numHeld;
+    evdev_source_t *source;
+    event_loop_t *loop;
+    int filesReady;     // signal, recordings are always readable but not polled
+    int heldMoveDue;    // timer
+    mouse_event_t events[MAX_EVENTS_PER_READ];
+} linux_daemon_t;
+
+static event_loop_t *signal_loop = NULL;
+
+static void stop(int) {
+    event_loop_stop(signal_loop);
+}
+
+static void print_driver_event(const driver_event_t *event) {
+    switch (event->id) {
+        case DRIVER_EVENT_ID_MOVE:
+            printf("move seqnum: %llu, timestamp: %llu, type: %d, pos: %dx%d, delta: %d,%d, buttons: %d, otherButton: %d\n",
+                   (unsigned long long)event->kextSeqnum,
+                   (unsigned long long)event->kextTimestamp,
+                   (int)event->move.type,
+                   (int)event->move.pos.x,
+                   (int)event->move.pos.y,
+                   event->move.deltaX,
+                   event->move.deltaY,
+                   event->move.buttons,
+                   event->move.otherButton);
+            break;
+        case DRIVER_EVENT_ID_BUTTON:
+            printf("button seqnum: %llu, timestamp: %llu, type: %d, pos: %dx%d, buttons: %d, otherButton: %d\n",
+                   (unsigned long long)event->kextSeqnum,
+                   (unsigned long long)event->kextTimestamp,
+                   (int)event->button.type,
+                   (int)event->button.pos.x,
+                   (int)event->button.pos.y,
+                   event->button.buttons,
+                   event->button.otherButton);
+            break;
+        default:
+            break;
+    }
+}
+
+// same as driver_post_event()
+static void post_callback(driver_event_t *event, void *context) {
+    linux_daemon_t *daemon = (linux_daemon_t *)context;
+
+    if (!daemon->queue.empty() && event->id == DRIVER_EVENT_ID_MOVE) {
+        driver_event_t *last = &daemon->queue.back();
+        if (last->id == DRIVER_EVENT_ID_MOVE &&
+            pipeline_can_coalesce(&event->move, &last->move)) {
+            pipeline_coalesce(last, event);
+            daemon->numCoalescedEvents++;
+            return;
+        }
+    }
+    daemon->queue.push_back(*event);
+}
+
+// same clock as the event timestamps, see evdev_add_device()
+static uint64_t monotonic_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// the DriverEventThread's loop, with all queued events sent in one write, a
+// move at the end of the queue is held back for the coalescing interval
+// unless flush is set
+static BOOL drain(linux_daemon_t *daemon, BOOL flush) {
+    BOOL ok = YES;
+    uint64_t now = monotonic_now();
+    size_t count = daemon->queue.size();
+    BOOL hold = (!flush && count > 0 && daemon->queue.back().id == DRIVER_EVENT_ID_MOVE &&
+                 pipeline_pacer_release_time(&daemon->pacer, now) > now);
+    if (hold) {
+        count--;
+        // it is the move held by the last drain if that one is still queued
+        if (!daemon->holding || count > 0) {
+            daemon->numHeld++;
+        }
+    }
+    daemon->holding = hold;
+
+    for (size_t i = 0; i < count && ok; i++) {
+        const driver_event_t *event = &daemon->queue[i];
+        if (daemon->print) {
+            print_driver_event(event);
+        }
+        if (event->id == DRIVER_EVENT_ID_MOVE) {
+            if (daemon->output != NULL) {
+                ok = uinput_handle_move_event(daemon->output, &event->move);
+            }
+            pipeline_pacer_passed_on(&daemon->pacer, now);
+        } else if (event->id == DRIVER_EVENT_ID_BUTTON && daemon->output != NULL) {
+            ok = uinput_handle_button_event(daemon->output, &event->button);
+        }
+        daemon->numDriverEvents++;
+    }
+    daemon->queue.erase(daemon->queue.begin(), daemon->queue.begin() + count);
+
+    if (daemon->output != NULL && ok) {
+        ok = uinput_flush(daemon->output);
+    }
+    if (daemon->print) {
+        fflush(stdout);
+    }
+
+    return ok;
+}
+
+// wake up when a held move is due, there is nothing to do until then
+static void update_held_move_timer(linux_daemon_t *daemon) {
+    if (daemon->holding) {
+        uint64_t now = monotonic_now();
+        event_loop_arm_timer(daemon->loop, daemon->heldMoveDue, pipeline_pacer_release_time(&daemon->pacer, now) - now);
+    } else {
+        event_loop_disarm_timer(daemon->loop, daemon->heldMoveDue);
+    }
+}
+
+static void fail(linux_daemon_t *daemon) {
+    fprintf(stderr, "failed to post events: %s\n", strerror(errno));
+    event_loop_stop(daemon->loop);
+}
+
+static void input_ready(event_loop_t *loop, void *context) {
+    linux_daemon_t *daemon = (linux_daemon_t *)context;
+
+    int n = evdev_read(daemon->source, daemon->events, MAX_EVENTS_PER_READ, 0);
+    if (n == -1) {
+        event_loop_stop(loop);
+        return;
+    }
+    // a held move that is due goes out before the new events can merge into it
+    if (daemon->holding && !drain(daemon, NO)) {
+        fail(daemon);
+        return;
+    }
+    processor_process_events(&daemon->processor, daemon->events, n);
+    daemon->numKextEvents += n;
+    if (!drain(daemon, NO)) {
+        fail(daemon);
+        return;
+    }
+    update_held_move_timer(daemon);
+
+    if (daemon->source->numFiles > 0) {
+        event_loop_signal(loop, daemon->filesReady);
+    }
+}
+
+static void held_move_due(event_loop_t *, void *context) {
+    linux_daemon_t *daemon = (linux_daemon_t *)context;
+
+    if (!drain(daemon, NO)) {
+        fail(daemon);
+        return;
+    }
+    update_held_move_timer(daemon);
+}
+
+static BOOL parse_curve(const char *name, AccelerationCurve *curve) {
+    if (strcmp(name, "linear") == 0) {
+        *curve = ACCELERATION_CURVE_LINEAR;
+    } else if (strcmp(name, "windows") == 0) {
+        *curve = ACCELERATION_CURVE_WINDOWS;
+    } else if (strcmp(name, "osx") == 0) {
+        *curve = ACCELERATION_CURVE_OSX;
+    } else {
+        return NO;
+    }
+    return YES;
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [--curve <curve>] [--curve-file <path>] [--time-based <dpi>] [--dpi <dpi>] [--screen <ppi> <hz>] [--velocity <velocity>] [--coalesce <ms>] [--output <path>] [--quiet] [--trackpad] <device or recording>...\n", argv0);
+    fprintf(stderr, "  --curve <curve>    linear, windows or osx (default windows)\n");
+    fprintf(stderr, "  --curve-file <path>\n");
+    fprintf(stderr, "                     use the custom acceleration curve in <path> instead\n");
+    fprintf(stderr, "  --time-based <dpi> compute the gain from the device speed, using the event timestamps and\n");
+    fprintf(stderr, "                     the device resolution <dpi>, so it does not depend on the polling rate\n");
+    fprintf(stderr, "  --dpi <dpi>        set the curve up for a device resolution of <dpi> (default 400, or the\n");
+    fprintf(stderr, "                     --time-based resolution), evdev does not report it for mice\n");
+    fprintf(stderr, "  --screen <ppi> <hz>\n");
+    fprintf(stderr, "                     set the curve up for a screen of <ppi> pixels per inch refreshed at <hz>\n");
+    fprintf(stderr, "                     (default 96 ppi and 67 Hz for OS X, 60 Hz for Windows)\n");
+    fprintf(stderr, "  --velocity <v>     velocity, as in the preference pane (default 1.0)\n");
+    fprintf(stderr, "  --coalesce <ms>    pass on at most one move every <ms> milliseconds, merging the moves\n");
+    fprintf(stderr, "                     that come in the meantime\n");
+    fprintf(stderr, "  --output <path>    post the events through uinput, path is /dev/uinput or a file to\n");
+    fprintf(stderr, "                     append the input_event records to, implies --quiet\n");
+    fprintf(stderr, "  --quiet            do not print the driver events\n");
+    fprintf(stderr, "  --trackpad         the devices that follow are trackpads, not mice\n");
+}
+
+int main(int argc, char *argv[]) {
+    AccelerationCurve curve = ACCELERATION_CURVE_WINDOWS;
+    const char *curveFile = NULL;
+    double dpi = 0;
+    double deviceResolution = 0;
+    double screenResolution = 0;
+    double screenRefreshRate = 0;
+    double velocity = 1.0;
+    double coalesce = 0;
+    BOOL quiet = NO;
+    const char *outputPath = NULL;
+    device_type_t deviceType = kDeviceTypeMouse;
+
+    evdev_source_t source;
+    if (!evdev_init(&source)) {
+        fprintf(stderr, "epoll: %s\n", strerror(errno));
+        return 1;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--curve") == 0 && i + 1 < argc) {
+            if (!parse_curve(argv[++i], &curve)) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--curve-file") == 0 && i + 1 < argc) {
+            curveFile = argv[++i];
+            curve = ACCELERATION_CURVE_CUSTOM;
+        } else if (strcmp(argv[i], "--time-based") == 0 && i + 1 < argc) {
+            dpi = atof(argv[++i]);
+            if (dpi <= 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--dpi") == 0 && i + 1 < argc) {
+            deviceResolution = atof(argv[++i]);
+            if (deviceResolution <= 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--screen") == 0 && i + 2 < argc) {
+            screenResolution = atof(argv[++i]);
+            screenRefreshRate = atof(argv[++i]);
+            if (screenResolution <= 0 || screenRefreshRate <= 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--velocity") == 0 && i + 1 < argc) {
+            velocity = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--coalesce") == 0 && i + 1 < argc) {
+            coalesce = atof(argv[++i]);
+            if (coalesce <= 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            outputPath = argv[++i];
+            quiet = YES;
+        } else if (strcmp(argv[i], "--quiet") == 0) {
+            quiet = YES;
+        } else if (strcmp(argv[i], "--trackpad") == 0) {
+            deviceType = kDeviceTypeTrackpad;
+        } else if (argv[i][0] != '-') {
+            if (!evdev_add_device(&source, argv[i], deviceType)) {
+                fprintf(stderr, "%s: %s\n", argv[i], strerror(errno));
+                return 1;
+            }
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (source.numDevices == 0 || velocity <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    pipeline_curves_t *curves = pipeline_curves_create(curve, velocity, curveFile, curve, velocity, curveFile);
+    if (deviceResolution == 0) {
+        deviceResolution = dpi;
+    }
+    if (!pipeline_curve_set_resolution(&curves->mouse, deviceResolution, screenResolution, screenRefreshRate) ||
+        !pipeline_curve_set_resolution(&curves->trackpad, deviceResolution, screenResolution, screenRefreshRate)) {
+        fprintf(stderr, "unsupported resolution, the device resolution has to be %d to %d dpi, the screen %d to %d ppi and %d to %d Hz\n",
+                PIPELINE_MIN_DPI, PIPELINE_MAX_DPI, PIPELINE_MIN_PPI, PIPELINE_MAX_PPI, PIPELINE_MIN_HZ, PIPELINE_MAX_HZ);
+        pipeline_curves_release(curves);
+        return 1;
+    }
+    if (dpi > 0) {
+        pipeline_curve_use_timestamps(&curves->mouse, dpi);
+        pipeline_curve_use_timestamps(&curves->trackpad, dpi);
+    }
+    if (curves->mouse.error[0] != '\0') {
+        fprintf(stderr, "%s\n", curves->mouse.error);
+        pipeline_curves_release(curves);
+        return 1;
+    }
+
+    uinput_driver_t output;
+    if (outputPath != NULL) {
+        if (!uinput_open(&output, outputPath)) {
+            fprintf(stderr, "%s: %s\n", outputPath, strerror(errno));
+            pipeline_curves_release(curves);
+            return 1;
+        }
+        if (!evdev_grab(&source, YES)) {
+            fprintf(stderr, "failed to grab the input devices: %s\n", strerror(errno));
+            uinput_close(&output);
+            pipeline_curves_release(curves);
+            return 1;
+        }
+    }
+
+    linux_daemon_t daemon;
+    daemon.output = (outputPath != NULL ? &output : NULL);
+    daemon.print = !quiet;
+    daemon.numKextEvents = 0;
+    daemon.numDriverEvents = 0;
+    daemon.numCoalescedEvents = 0;
+    pipeline_pacer_init(&daemon.pacer, (uint64_t)(coalesce * 1.0e6));
+    daemon.holding = NO;
+    daemon.numHeld = 0;
+    daemon.source = &source;
+
+    // input, held moves and signals are the only reasons to wake up
+    daemon.loop = event_loop_create();
+    if (daemon.loop == NULL ||
+        event_loop_add_fd(daemon.loop, source.epollFd, input_ready, &daemon) == -1 ||
+        (daemon.filesReady = event_loop_add_signal(daemon.loop, input_ready, &daemon)) == -1 ||
+        (daemon.heldMoveDue = event_loop_add_timer(daemon.loop, held_move_due, &daemon)) == -1) {
+        fprintf(stderr, "event loop: %s\n", strerror(errno));
+        return 1;
+    }
+
+    signal_loop = daemon.loop;
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+
+    // there is no window server to ask, positions are relative to the start
+    CGPoint startPos;
+    startPos.x = 0;
+    startPos.y = 0;
+
+    processor_init(&daemon.processor, startPos, curves, post_callback, &daemon);
+
+    if (source.numFiles > 0) {
+        event_loop_signal(daemon.loop, daemon.filesReady);
+    }
+
+    if (!event_loop_run(daemon.loop)) {
+        fprintf(stderr, "event loop: %s\n", strerror(errno));
+    }
+
+    processor_release_buttons(&daemon.processor);
+    drain(&daemon, YES);
+
+    if (daemon.output != NULL) {
+        evdev_grab(&source, NO);
+        uinput_close(daemon.output);
+    }
+
+    fprintf(stderr, "input frames: %llu, driver events: %llu, coalesced: %llu, lost: %llu (kernel dropped %llu times)\n",
+            (unsigned long long)daemon.numKextEvents,
+            (unsigned long long)daemon.numDriverEvents,
+            (unsigned long long)daemon.numCoalescedEvents,
+            (unsigned long long)daemon.processor.lostEvents,
+            (unsigned long long)source.numDropped);
+    if (coalesce > 0) {
+        fprintf(stderr, "moves held back for the coalescing interval: %llu\n", (unsigned long long)daemon.numHeld);
+    }
+
+    event_loop_destroy(daemon.loop);
+    pipeline_curves_release(curves);
+    evdev_cleanup(&source);
+
+    return 0;
+}
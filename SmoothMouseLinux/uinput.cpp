@@ -0,0 +1,208 @@
+#include "uinput.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/uinput.h>
+
+#ifndef input_event_sec
+#define input_event_sec  time.tv_sec
+#define input_event_usec time.tv_usec
+#endif
+
+// indexed by CGMouseButton (otherButton)
+static const int button_codes[] = {
+    BTN_LEFT,
+    BTN_RIGHT,
+    BTN_MIDDLE,
+    BTN_SIDE,
+    BTN_EXTRA,
+    BTN_FORWARD,
+};
+
+#define NUM_BUTTON_CODES ((int)(sizeof(button_codes) / sizeof(button_codes[0])))
+
+static BOOL uinput_create_device(int fd) {
+    if (ioctl(fd, UI_SET_EVBIT, EV_SYN) < 0 ||
+        ioctl(fd, UI_SET_EVBIT, EV_KEY) < 0 ||
+        ioctl(fd, UI_SET_EVBIT, EV_REL) < 0 ||
+        ioctl(fd, UI_SET_RELBIT, REL_X) < 0 ||
+        ioctl(fd, UI_SET_RELBIT, REL_Y) < 0) {
+        return NO;
+    }
+
+    for (int i = 0; i < NUM_BUTTON_CODES; i++) {
+        if (ioctl(fd, UI_SET_KEYBIT, button_codes[i]) < 0) {
+            return NO;
+        }
+    }
+
+    struct uinput_user_dev dev;
+    memset(&dev, 0, sizeof(dev));
+    strncpy(dev.name, "SmoothMouse", UINPUT_MAX_NAME_SIZE - 1);
+    dev.id.bustype = BUS_VIRTUAL;
+    dev.id.version = 1;
+
+    // the old setup interface, it works with every kernel that has uinput
+    if (write(fd, &dev, sizeof(dev)) != (ssize_t)sizeof(dev)) {
+        return NO;
+    }
+
+    return (ioctl(fd, UI_DEV_CREATE) >= 0);
+}
+
+BOOL uinput_open(uinput_driver_t *driver, const char *path) {
+    driver->pendingX = 0;
+    driver->pendingY = 0;
+    driver->numRecords = 0;
+
+    driver->fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (driver->fd == -1) {
+        return NO;
+    }
+
+    struct stat st;
+    if (fstat(driver->fd, &st) == -1) {
+        close(driver->fd);
+        return NO;
+    }
+
+    driver->file = S_ISREG(st.st_mode);
+    if (driver->file) {
+        lseek(driver->fd, 0, SEEK_END);
+        return YES;
+    }
+
+    if (!uinput_create_device(driver->fd)) {
+        int error = errno;
+        close(driver->fd);
+        errno = error;
+        return NO;
+    }
+
+    return YES;
+}
+
+void uinput_close(uinput_driver_t *driver) {
+    uinput_flush(driver);
+    if (!driver->file) {
+        ioctl(driver->fd, UI_DEV_DESTROY);
+    }
+    close(driver->fd);
+    driver->fd = -1;
+}
+
+static void uinput_add_record(uinput_driver_t *driver, const struct timespec *now, int type, int code, int value) {
+    // the kernel stamps records written to a device itself, the time is only
+    // kept in files
+    struct input_event *record = &driver->records[driver->numRecords++];
+    record->input_event_sec = now->tv_sec;
+    record->input_event_usec = now->tv_nsec / 1000;
+    record->type = type;
+    record->code = code;
+    record->value = value;
+}
+
+// writes the records collected so far, the pending moves stay pending
+static BOOL uinput_write(uinput_driver_t *driver) {
+    if (driver->numRecords == 0) {
+        return YES;
+    }
+
+    size_t size = driver->numRecords * sizeof(struct input_event);
+    driver->numRecords = 0;
+
+    ssize_t written;
+    do {
+        written = write(driver->fd, driver->records, size);
+    } while (written == -1 && errno == EINTR);
+
+    return (written == (ssize_t)size);
+}
+
+// makes room for the records of one report
+static BOOL uinput_reserve(uinput_driver_t *driver, int numRecords, struct timespec *now) {
+    if (driver->numRecords + numRecords > UINPUT_MAX_RECORDS && !uinput_write(driver)) {
+        return NO;
+    }
+    clock_gettime(CLOCK_MONOTONIC, now);
+    return YES;
+}
+
+// turns the summed deltas of the pending moves into one report
+static BOOL uinput_report_moves(uinput_driver_t *driver) {
+    if (driver->pendingX == 0 && driver->pendingY == 0) {
+        return YES;
+    }
+
+    struct timespec now;
+    if (!uinput_reserve(driver, 3, &now)) {
+        return NO;
+    }
+
+    if (driver->pendingX != 0) {
+        uinput_add_record(driver, &now, EV_REL, REL_X, driver->pendingX);
+    }
+    if (driver->pendingY != 0) {
+        uinput_add_record(driver, &now, EV_REL, REL_Y, driver->pendingY);
+    }
+    uinput_add_record(driver, &now, EV_SYN, SYN_REPORT, 0);
+    driver->pendingX = 0;
+    driver->pendingY = 0;
+
+    return YES;
+}
+
+BOOL uinput_handle_move_event(uinput_driver_t *driver, const driver_move_event_t *event) {
+    driver->pendingX += event->deltaX;
+    driver->pendingY += event->deltaY;
+    return YES;
+}
+
+BOOL uinput_handle_button_event(uinput_driver_t *driver, const driver_button_event_t *event) {
+    if (event->otherButton < 0 || event->otherButton >= NUM_BUTTON_CODES) {
+        return NO;
+    }
+
+    int down;
+    switch (event->type) {
+        case kCGEventLeftMouseDown:
+        case kCGEventRightMouseDown:
+        case kCGEventOtherMouseDown:
+            down = 1;
+            break;
+        case kCGEventLeftMouseUp:
+        case kCGEventRightMouseUp:
+        case kCGEventOtherMouseUp:
+            down = 0;
+            break;
+        default:
+            return NO;
+    }
+
+    // the moves before the button event are reported before it
+    if (!uinput_report_moves(driver)) {
+        return NO;
+    }
+
+    struct timespec now;
+    if (!uinput_reserve(driver, 2, &now)) {
+        return NO;
+    }
+
+    uinput_add_record(driver, &now, EV_KEY, button_codes[event->otherButton], down);
+    uinput_add_record(driver, &now, EV_SYN, SYN_REPORT, 0);
+
+    return YES;
+}
+
+BOOL uinput_flush(uinput_driver_t *driver) {
+    if (!uinput_report_moves(driver)) {
+        return NO;
+    }
+    return uinput_write(driver);
+}
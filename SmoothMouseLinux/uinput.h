@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <linux/input.h>
+
+#include "platform.h"
+#include "Driver.h"
+
+/*
+ DRIVER_UINPUT: posts the driver events through a virtual uinput mouse. The
+ deltas of the moves are summed up and only become REL_X/REL_Y records when
+ the queued driver events have been handled or before a button event, each
+ button event becomes its BTN_* record, and every group ends with one
+ SYN_REPORT. A drained batch without button transitions is one report, so
+ readers of the device wake up once for it. The records are collected in one
+ buffer and written to the device with a single call, so a whole batch also
+ costs one syscall.
+
+ If path is a regular file instead of /dev/uinput, the records are appended
+ to it without creating a device. The file can be read back by the evdev
+ source (see evdev.h).
+ */
+
+#define UINPUT_MAX_RECORDS  (256)
+
+typedef struct uinput_driver_s {
+    int fd;
+    BOOL file;
+    int pendingX;   // summed deltas of the moves not in records yet
+    int pendingY;
+    int numRecords;
+    struct input_event records[UINPUT_MAX_RECORDS];
+} uinput_driver_t;
+
+// returns NO and sets errno if the device can not be created
+BOOL uinput_open(uinput_driver_t *driver, const char *path);
+void uinput_close(uinput_driver_t *driver);
+
+BOOL uinput_handle_move_event(uinput_driver_t *driver, const driver_move_event_t *event);
+BOOL uinput_handle_button_event(uinput_driver_t *driver, const driver_button_event_t *event);
+
+// writes the records of all events handled since the last flush, ending
+// with the report of the moves since the last button event
+BOOL uinput_flush(uinput_driver_t *driver);
@@ -79,5 +79,6 @@
 - (NSInteger)getIndexFromAccelerationCurveString: (NSString *) s;
 
 - (void)restartDaemonIfRunning;
+- (void)notifyDaemonSettingsChanged;
 @end
 
@@ -273,7 +273,7 @@ cleanup:
 
     if ((sender == velocityForMouse && [self getMouseEnabled]) ||
         (sender == velocityForTrackpad && [self getTrackpadEnabled])) {
-        [self restartDaemonIfRunning];
+        [self notifyDaemonSettingsChanged];
     }
 }
 
@@ -295,7 +295,7 @@ cleanup:
         [self saveAccelerationCurveForTrackpad:title];
     }
 
-    [self restartDaemonIfRunning];
+    [self notifyDaemonSettingsChanged];
 }
 
 - (IBAction)pressEnableDisableMouse:(id) sender
@@ -557,6 +557,13 @@ cleanup:
 	return [settings writeToFile:file atomically:YES];
 }
 
+- (void)notifyDaemonSettingsChanged {
+    [[NSDistributedNotificationCenter defaultCenter] postNotificationName:SETTINGS_CHANGED_NOTIFICATION
+                                                                   object:nil
+                                                                 userInfo:nil
+                                                       deliverImmediately:YES];
+}
+
 - (void)restartDaemonIfRunning {
 	if ([self isDaemonRunning]) {
 		[self stopDaemon];
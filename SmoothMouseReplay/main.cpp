@@ -0,0 +1,549 @@
+/*
+ SmoothMouseReplay feeds a capture recorded with "SmoothMouseDaemon --capture"
+ through the same button remapping, sequence number checking, acceleration and
+ coalescing code the daemon uses, and prints the resulting driver events. The
+ output only depends on the capture, so it can be diffed against the output of
+ an earlier build to catch changes in behaviour, or timed with --repeat.
+
+ The window server is not involved: the cursor is not restricted to the
+ screen boundaries and positions are never refreshed from the real cursor.
+ Click counting depends on the time of the click and is not replayed
+ (nclicks is always 0).
+
+ The curves are set up with the settings recorded in the capture, including
+ the custom curve files, the time based acceleration, the resolutions and the
+ coalescing interval, unless the options below override them. Captures of
+ older versions only record the curves and velocities.
+
+ With a coalescing interval the driver holds moves back like the
+ DriverEventThread does, with the event timestamps as the clock.
+
+ With --window-server the posted moves also go through the position tampering
+ check of MouseSupervisor, with the window server merging a fixed number of
+ moves into every event it delivers. Moves are never tampered with here, so
+ every reported tampering is a false positive. With --window-server-lag the
+ mouse event listener only sees an event once the window server delivered
+ that many more, which lets the ring of posted moves overflow (merging 1 move
+ into every event and a lag of 300 drops a run of moves, for example).
+
+ It does not depend on OS X and builds on Linux with:
+
+   c++ -O2 -ISmoothMouseDaemon -ISmoothMouseDaemon/core -ISmoothMouseDaemon/libpointing \
+       SmoothMouseReplay/main.cpp \
+       SmoothMouseDaemon/core/pipeline.cpp SmoothMouseDaemon/core/processor.cpp \
+       SmoothMouseDaemon/core/capture.cpp SmoothMouseDaemon/core/movering.cpp \
+       SmoothMouseDaemon/libpointing/OSXFunction.cpp SmoothMouseDaemon/libpointing/WindowsFunction.cpp \
+       -o smoothmouse-replay
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include <deque>
+#include <vector>
+
+#include "pipeline.h"
+#include "processor.h"
+#include "capture.h"
+#include "movering.h"
+
+typedef struct replay_s {
+    capture_settings_t settings;
+    processor_t processor;
+    pipeline_curves_t *curves;
+    const char *mouseCurveFile;
+    const char *trackpadCurveFile;
+    double mouseDpi;    // time based, see pipeline_curve_use_timestamps()
+    double trackpadDpi;
+    double mouseResolution;
+    double trackpadResolution;
+    double screenResolution;
+    double screenRefreshRate;
+    uint64_t lostEvents;
+    uint64_t numCoalescedEvents;
+    uint64_t numDriverEvents;
+    int drain;
+    int eventsSinceDrain;
+    // DriverEventThread emulation, see --coalesce
+    pipeline_pacer_t pacer;
+    uint64_t coalescingInterval;
+    uint64_t now;
+    BOOL holding;
+    uint64_t numHeld;
+    BOOL print;
+    std::vector<driver_event_t> queue;
+    // MouseSupervisor emulation, see --window-server
+    int windowServer;
+    move_ring_t *supervisor;
+    int pendingMoves;
+    int pendingDeltaX;
+    int pendingDeltaY;
+    size_t windowServerLag;
+    std::deque<std::pair<int, int> > delivered;
+    uint64_t numMatched;
+    uint64_t numTampered;
+    uint64_t numDropped;
+} replay_t;
+
+static double timestamp() {
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return (double)t.tv_sec + 1.0e-6 * (double)t.tv_usec;
+}
+
+static void print_driver_event(const driver_event_t *event) {
+    switch (event->id) {
+        case DRIVER_EVENT_ID_MOVE:
+            printf("move seqnum: %llu, timestamp: %llu, type: %d, pos: %dx%d, delta: %d,%d, buttons: %d, otherButton: %d\n",
+                   (unsigned long long)event->kextSeqnum,
+                   (unsigned long long)event->kextTimestamp,
+                   (int)event->move.type,
+                   (int)event->move.pos.x,
+                   (int)event->move.pos.y,
+                   event->move.deltaX,
+                   event->move.deltaY,
+                   event->move.buttons,
+                   event->move.otherButton);
+            break;
+        case DRIVER_EVENT_ID_BUTTON:
+            printf("button seqnum: %llu, timestamp: %llu, type: %d, pos: %dx%d, buttons: %d, otherButton: %d, nclicks: %d\n",
+                   (unsigned long long)event->kextSeqnum,
+                   (unsigned long long)event->kextTimestamp,
+                   (int)event->button.type,
+                   (int)event->button.pos.x,
+                   (int)event->button.pos.y,
+                   event->button.buttons,
+                   event->button.otherButton,
+                   event->button.nclicks);
+            break;
+        default:
+            break;
+    }
+}
+
+// the mouse event listener checks the events delivered more than lag events
+// ago against what the driver posted
+static void replay_mouse_event_listener(replay_t *replay, size_t lag) {
+    while (replay->delivered.size() > lag) {
+        std::pair<int, int> delta = replay->delivered.front();
+        replay->delivered.pop_front();
+        if (move_ring_match(replay->supervisor, delta.first, delta.second)) {
+            replay->numMatched++;
+        } else {
+            replay->numTampered++;
+        }
+    }
+}
+
+// the window server delivers the moves it merged to the mouse event listener
+static void replay_window_server_flush(replay_t *replay) {
+    if (replay->pendingMoves == 0) {
+        return;
+    }
+    replay->delivered.push_back(std::make_pair(replay->pendingDeltaX, replay->pendingDeltaY));
+    replay_mouse_event_listener(replay, replay->windowServerLag);
+    replay->pendingMoves = 0;
+    replay->pendingDeltaX = 0;
+    replay->pendingDeltaY = 0;
+}
+
+// every posted move is pushed to the supervisor like driver_handle_move_event()
+// does, the window server merges them into one event per --window-server moves
+static void replay_window_server(replay_t *replay, const driver_event_t *event) {
+    if (event->id != DRIVER_EVENT_ID_MOVE) {
+        replay_window_server_flush(replay);
+        return;
+    }
+    if (!move_ring_push(replay->supervisor, event->move.deltaX, event->move.deltaY)) {
+        replay->numDropped++;
+    }
+    replay->pendingMoves++;
+    replay->pendingDeltaX += event->move.deltaX;
+    replay->pendingDeltaY += event->move.deltaY;
+    if (replay->pendingMoves >= replay->windowServer) {
+        replay_window_server_flush(replay);
+    }
+}
+
+// passes on the first count queued events at replay->now
+static void replay_pass_on(replay_t *replay, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        const driver_event_t *event = &replay->queue[i];
+        if (replay->print) {
+            print_driver_event(event);
+        }
+        if (replay->windowServer > 0) {
+            replay_window_server(replay, event);
+        }
+        if (event->id == DRIVER_EVENT_ID_MOVE) {
+            pipeline_pacer_passed_on(&replay->pacer, replay->now);
+        }
+        replay->numDriverEvents++;
+    }
+    replay->queue.erase(replay->queue.begin(), replay->queue.begin() + count);
+}
+
+// a move at the end of the queue is held back for the coalescing interval
+// unless flush is set, the rest is passed on
+static void replay_drain(replay_t *replay, BOOL flush) {
+    size_t count = replay->queue.size();
+    BOOL hold = (!flush && count > 0 && replay->queue.back().id == DRIVER_EVENT_ID_MOVE &&
+                 pipeline_pacer_release_time(&replay->pacer, replay->now) > replay->now);
+    if (hold) {
+        count--;
+        // it is the move held by the last drain if that one is still queued
+        if (!replay->holding || count > 0) {
+            replay->numHeld++;
+        }
+    }
+    replay->holding = hold;
+    replay_pass_on(replay, count);
+}
+
+// same as driver_post_event(), except that the driver event thread is
+// replaced by draining the queue after every --drain kext events
+static void replay_post_event(replay_t *replay, driver_event_t *event) {
+    if (!replay->queue.empty() && event->id == DRIVER_EVENT_ID_MOVE) {
+        driver_event_t *last = &replay->queue.back();
+        if (last->id == DRIVER_EVENT_ID_MOVE &&
+            pipeline_can_coalesce(&event->move, &last->move)) {
+            pipeline_coalesce(last, event);
+            replay->numCoalescedEvents++;
+            return;
+        }
+    }
+    replay->queue.push_back(*event);
+}
+
+static void replay_post_callback(driver_event_t *event, void *context) {
+    replay_post_event((replay_t *)context, event);
+}
+
+static BOOL replay_process_kext_event(replay_t *replay, mouse_event_t *event) {
+    // the held move is passed on when the interval is over, unless an event
+    // it could not be merged with was queued behind it
+    if (replay->holding) {
+        uint64_t release = replay->pacer.lastMove + replay->pacer.interval;
+        if (event->timestamp >= release) {
+            replay->now = release;
+            replay_pass_on(replay, 1);
+            replay->holding = NO;
+        }
+    }
+    replay->now = event->timestamp;
+
+    if (!processor_process_event(&replay->processor, event)) {
+        fprintf(stderr, "invalid device type %d in event %llu\n", event->device_type, (unsigned long long)event->seqnum);
+        return NO;
+    }
+
+    if (++replay->eventsSinceDrain >= replay->drain) {
+        replay_drain(replay, NO);
+        replay->eventsSinceDrain = 0;
+    }
+
+    return YES;
+}
+
+static BOOL replay_run(replay_t *replay, const std::vector<mouse_event_t> &events) {
+    // every run starts with fresh transfer functions, like a new connection
+    replay->curves = pipeline_curves_create(replay->settings.mouseCurve,
+                                            replay->settings.mouseVelocity,
+                                            replay->mouseCurveFile,
+                                            replay->settings.trackpadCurve,
+                                            replay->settings.trackpadVelocity,
+                                            replay->trackpadCurveFile);
+    if (!pipeline_curve_set_resolution(&replay->curves->mouse, replay->mouseResolution, replay->screenResolution, replay->screenRefreshRate)) {
+        fprintf(stderr, "mouse curve: unsupported resolution, using the defaults\n");
+    }
+    if (!pipeline_curve_set_resolution(&replay->curves->trackpad, replay->trackpadResolution, replay->screenResolution, replay->screenRefreshRate)) {
+        fprintf(stderr, "trackpad curve: unsupported resolution, using the defaults\n");
+    }
+    if (replay->mouseDpi > 0) {
+        pipeline_curve_use_timestamps(&replay->curves->mouse, replay->mouseDpi);
+    }
+    if (replay->trackpadDpi > 0) {
+        pipeline_curve_use_timestamps(&replay->curves->trackpad, replay->trackpadDpi);
+    }
+    if (replay->curves->mouse.error[0] != '\0') {
+        fprintf(stderr, "mouse curve: %s, using linear\n", replay->curves->mouse.error);
+    }
+    if (replay->curves->trackpad.error[0] != '\0') {
+        fprintf(stderr, "trackpad curve: %s, using linear\n", replay->curves->trackpad.error);
+    }
+    processor_init(&replay->processor, replay->settings.startPos, replay->curves, replay_post_callback, replay);
+    replay->eventsSinceDrain = 0;
+    pipeline_pacer_init(&replay->pacer, replay->coalescingInterval);
+    replay->now = 0;
+    replay->holding = NO;
+    if (replay->windowServer > 0) {
+        move_ring_init(replay->supervisor);
+        replay->pendingMoves = 0;
+        replay->pendingDeltaX = 0;
+        replay->pendingDeltaY = 0;
+        replay->delivered.clear();
+    }
+
+    BOOL ok = YES;
+    std::vector<mouse_event_t>::const_iterator it;
+    for (it = events.begin(); it != events.end() && ok; it++) {
+        mouse_event_t event = *it;
+        ok = replay_process_kext_event(replay, &event);
+    }
+    replay_drain(replay, YES);
+    replay->lostEvents += replay->processor.lostEvents;
+    if (replay->windowServer > 0) {
+        replay_window_server_flush(replay);
+        replay_mouse_event_listener(replay, 0);
+    }
+
+    pipeline_curves_release(replay->curves);
+
+    return ok;
+}
+
+// the curves only load curve files from a path, the captured one is written
+// to a temporary file, returns NULL if that fails
+static char *replay_write_curve_file(const capture_curve_file_t *file) {
+    const char *dir = getenv("TMPDIR");
+    char *path = (char *)malloc(PATH_MAX);
+    snprintf(path, PATH_MAX, "%s/SmoothMouseReplay-curve-XXXXXX", (dir != NULL && dir[0] != '\0') ? dir : "/tmp");
+    int fd = mkstemp(path);
+    if (fd == -1) {
+        free(path);
+        return NULL;
+    }
+    BOOL ok = (write(fd, file->data, file->size) == (ssize_t)file->size);
+    close(fd);
+    if (!ok) {
+        unlink(path);
+        free(path);
+        return NULL;
+    }
+    return path;
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [--drain <events>] [--window-server <moves>] [--window-server-lag <events>] [--coalesce <ms>] [--curve-file <path>] [--time-based <dpi>] [--dpi <dpi>] [--screen <ppi> <hz>] [--repeat <times>] [--quiet] <capture file>\n", argv0);
+    fprintf(stderr, "  --drain <events>   pass queued driver events on every <events> kext events (default 1),\n");
+    fprintf(stderr, "                     values above 1 simulate a driver that falls behind and let moves coalesce\n");
+    fprintf(stderr, "  --coalesce <ms>    hold moves back until <ms> milliseconds (of event timestamps) passed\n");
+    fprintf(stderr, "                     since the last move, merging the moves that come in the meantime\n");
+    fprintf(stderr, "                     (default the captured interval, 0 turns it off)\n");
+    fprintf(stderr, "  --window-server <moves>\n");
+    fprintf(stderr, "                     check the posted moves for position tampering like the mouse event\n");
+    fprintf(stderr, "                     listener does, with the window server merging every <moves> moves\n");
+    fprintf(stderr, "  --window-server-lag <events>\n");
+    fprintf(stderr, "                     let the listener check an event only after the window server delivered\n");
+    fprintf(stderr, "                     <events> more (default 0), above %d moves the ring of posted moves overflows\n", MOVE_RING_SIZE);
+    fprintf(stderr, "  --curve-file <path>\n");
+    fprintf(stderr, "                     accelerate both device types with the custom curve in <path> instead of\n");
+    fprintf(stderr, "                     the captured curves\n");
+    fprintf(stderr, "  --time-based <dpi> compute the gain from the device speed, using the event timestamps and\n");
+    fprintf(stderr, "                     the device resolution <dpi>, instead of from the counts per report\n");
+    fprintf(stderr, "  --dpi <dpi>        set the curves up for a device resolution of <dpi> (default the captured\n");
+    fprintf(stderr, "                     resolution, the --time-based one or 400)\n");
+    fprintf(stderr, "  --screen <ppi> <hz>\n");
+    fprintf(stderr, "                     set the curves up for a screen of <ppi> pixels per inch refreshed at <hz>\n");
+    fprintf(stderr, "                     (default the captured screen, or 96 ppi and 67 Hz for OS X, 60 Hz for\n");
+    fprintf(stderr, "                     Windows)\n");
+    fprintf(stderr, "  --repeat <times>   replay the capture <times> times and report the throughput\n");
+    fprintf(stderr, "  --quiet            do not print the driver events\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = NULL;
+    int drain = 1;
+    int windowServer = 0;
+    int windowServerLag = 0;
+    double coalesce = -1;   // the captured interval
+    int repeat = 1;
+    const char *curveFile = NULL;
+    double dpi = 0;
+    double deviceResolution = 0;
+    double screenResolution = 0;
+    double screenRefreshRate = 0;
+    BOOL quiet = NO;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--drain") == 0 && i + 1 < argc) {
+            drain = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--window-server") == 0 && i + 1 < argc) {
+            windowServer = atoi(argv[++i]);
+            if (windowServer < 1) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--window-server-lag") == 0 && i + 1 < argc) {
+            windowServerLag = atoi(argv[++i]);
+            if (windowServerLag < 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--coalesce") == 0 && i + 1 < argc) {
+            coalesce = atof(argv[++i]);
+            if (coalesce < 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--curve-file") == 0 && i + 1 < argc) {
+            curveFile = argv[++i];
+        } else if (strcmp(argv[i], "--time-based") == 0 && i + 1 < argc) {
+            dpi = atof(argv[++i]);
+            if (dpi <= 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--dpi") == 0 && i + 1 < argc) {
+            deviceResolution = atof(argv[++i]);
+            if (deviceResolution <= 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--screen") == 0 && i + 2 < argc) {
+            screenResolution = atof(argv[++i]);
+            screenRefreshRate = atof(argv[++i]);
+            if (screenResolution <= 0 || screenRefreshRate <= 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--quiet") == 0) {
+            quiet = YES;
+        } else if (argv[i][0] != '-' && path == NULL) {
+            path = argv[i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (path == NULL || drain < 1 || repeat < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    replay_t replay;
+    replay.lostEvents = 0;
+    replay.numCoalescedEvents = 0;
+    replay.numDriverEvents = 0;
+    replay.drain = drain;
+    replay.numHeld = 0;
+    replay.windowServer = windowServer;
+    replay.windowServerLag = (size_t)windowServerLag;
+    replay.supervisor = (windowServer > 0) ? new move_ring_t : NULL;
+    replay.numMatched = 0;
+    replay.numTampered = 0;
+    replay.numDropped = 0;
+
+    capture_file_t *capture = capture_open(path, &replay.settings);
+    if (capture == NULL) {
+        fprintf(stderr, "%s: not a capture file\n", path);
+        return 1;
+    }
+
+    std::vector<mouse_event_t> events;
+    mouse_event_t event;
+    while (capture_read_event(capture, &event)) {
+        events.push_back(event);
+    }
+    if (!capture_ok(capture)) {
+        fprintf(stderr, "%s: truncated after %d events\n", path, (int)events.size());
+    }
+    capture_close(capture);
+
+    // the options override the captured settings
+    const capture_settings_t *settings = &replay.settings;
+    char *mouseCurveFile = NULL;
+    char *trackpadCurveFile = NULL;
+    if (curveFile != NULL) {
+        replay.settings.mouseCurve = ACCELERATION_CURVE_CUSTOM;
+        replay.settings.trackpadCurve = ACCELERATION_CURVE_CUSTOM;
+        replay.mouseCurveFile = curveFile;
+        replay.trackpadCurveFile = curveFile;
+    } else {
+        if (settings->mouseCurveFile.data != NULL) {
+            mouseCurveFile = replay_write_curve_file(&settings->mouseCurveFile);
+        }
+        if (settings->trackpadCurveFile.data != NULL) {
+            trackpadCurveFile = replay_write_curve_file(&settings->trackpadCurveFile);
+        }
+        if ((settings->mouseCurveFile.data != NULL && mouseCurveFile == NULL) ||
+            (settings->trackpadCurveFile.data != NULL && trackpadCurveFile == NULL)) {
+            fprintf(stderr, "failed to write the captured curve files\n");
+        }
+        replay.mouseCurveFile = mouseCurveFile;
+        replay.trackpadCurveFile = trackpadCurveFile;
+    }
+    replay.mouseDpi = (dpi > 0) ? dpi : settings->mouseTimeBasedDpi;
+    replay.trackpadDpi = (dpi > 0) ? dpi : settings->trackpadTimeBasedDpi;
+    if (deviceResolution > 0 || dpi > 0) {
+        replay.mouseResolution = (deviceResolution > 0) ? deviceResolution : dpi;
+        replay.trackpadResolution = replay.mouseResolution;
+    } else {
+        replay.mouseResolution = settings->mouseResolution;
+        replay.trackpadResolution = settings->trackpadResolution;
+    }
+    replay.screenResolution = (screenResolution > 0) ? screenResolution : settings->screenResolution;
+    replay.screenRefreshRate = (screenRefreshRate > 0) ? screenRefreshRate : settings->screenRefreshRate;
+    if (coalesce < 0) {
+        coalesce = settings->coalescingInterval;
+    }
+    replay.coalescingInterval = (uint64_t)(coalesce * 1.0e6);
+
+    double start = timestamp();
+    BOOL ok = YES;
+    for (int i = 0; i < repeat && ok; i++) {
+        replay.print = (!quiet && i == 0);
+        ok = replay_run(&replay, events);
+    }
+    double elapsed = timestamp() - start;
+
+    if (mouseCurveFile != NULL) {
+        unlink(mouseCurveFile);
+        free(mouseCurveFile);
+    }
+    if (trackpadCurveFile != NULL) {
+        unlink(trackpadCurveFile);
+        free(trackpadCurveFile);
+    }
+    if (!ok) {
+        delete replay.supervisor;
+        capture_settings_cleanup(&replay.settings);
+        return 1;
+    }
+
+    fprintf(stderr, "kext events: %llu, driver events: %llu, coalesced: %llu, lost: %llu\n",
+            (unsigned long long)events.size(),
+            (unsigned long long)(replay.numDriverEvents / repeat),
+            (unsigned long long)(replay.numCoalescedEvents / repeat),
+            (unsigned long long)(replay.lostEvents / repeat));
+
+    if (coalesce > 0) {
+        fprintf(stderr, "moves held back for the coalescing interval: %llu\n",
+                (unsigned long long)(replay.numHeld / repeat));
+    }
+
+    if (windowServer > 0) {
+        fprintf(stderr, "window server events: %llu, matched: %llu, tampering detected: %llu, dropped from ring: %llu\n",
+                (unsigned long long)((replay.numMatched + replay.numTampered) / repeat),
+                (unsigned long long)(replay.numMatched / repeat),
+                (unsigned long long)(replay.numTampered / repeat),
+                (unsigned long long)(replay.numDropped / repeat));
+    }
+
+    if (repeat > 1 && elapsed > 0) {
+        fprintf(stderr, "replayed %d times in %.3f s, %.0f kext events/s\n",
+                repeat, elapsed, (double)events.size() * repeat / elapsed);
+    }
+
+    delete replay.supervisor;
+    capture_settings_cleanup(&replay.settings);
+
+    return 0;
+}
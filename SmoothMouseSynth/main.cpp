@@ -0,0 +1,223 @@
+/*
+ smoothmouse-synth generates the events of a user moving a mouse (see
+ synth.h). With --output they are written to a capture file for
+ SmoothMouseReplay, otherwise they are run through the daemon's event
+ pipeline in process, which soaks hours of input in seconds: it reports the
+ throughput and fails if the pipeline counted a different number of lost
+ events than were skipped, or left a button pressed.
+
+ It does not depend on OS X and builds on Linux with:
+
+   c++ -O2 -ISmoothMouseDaemon -ISmoothMouseDaemon/core -ISmoothMouseDaemon/libpointing \
+       SmoothMouseSynth/main.cpp \
+       SmoothMouseDaemon/core/synth.cpp SmoothMouseDaemon/core/capture.cpp \
+       SmoothMouseDaemon/core/pipeline.cpp SmoothMouseDaemon/core/processor.cpp \
+       SmoothMouseDaemon/libpointing/OSXFunction.cpp SmoothMouseDaemon/libpointing/WindowsFunction.cpp \
+       -o smoothmouse-synth
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "synth.h"
+#include "capture.h"
+#include "pipeline.h"
+#include "processor.h"
+
+typedef struct soak_s {
+    uint64_t posted;
+    uint64_t presses;
+    uint64_t releases;
+} soak_t;
+
+static double timestamp() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void soak_post_callback(driver_event_t *event, void *context) {
+    soak_t *soak = (soak_t *) context;
+    soak->posted++;
+    if (event->id == DRIVER_EVENT_ID_BUTTON) {
+        if (event->button.type == kCGEventLeftMouseDown ||
+            event->button.type == kCGEventRightMouseDown ||
+            event->button.type == kCGEventOtherMouseDown) {
+            soak->presses++;
+        } else {
+            soak->releases++;
+        }
+    }
+}
+
+static BOOL parse_curve(const char *name, AccelerationCurve *curve) {
+    if (strcmp(name, "linear") == 0) {
+        *curve = ACCELERATION_CURVE_LINEAR;
+    } else if (strcmp(name, "windows") == 0) {
+        *curve = ACCELERATION_CURVE_WINDOWS;
+    } else if (strcmp(name, "osx") == 0) {
+        *curve = ACCELERATION_CURVE_OSX;
+    } else {
+        return NO;
+    }
+    return YES;
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [--model mixed|aimed|sweep|micro] [--rate <hz>] [--jitter <fraction>] [--dpi <dpi>] [--gaps <rate> <max>] [--chords <rate>] [--trackpad] [--seed <n>] [--duration <s>] [--curve linear|windows|osx] [--output <capture file>]\n", argv0);
+    fprintf(stderr, "  --model <model>    motion model (default mixed), see synth.h\n");
+    fprintf(stderr, "  --rate <hz>        polling rate, e.g. 125, 500, 1000 (default) or 8000\n");
+    fprintf(stderr, "  --jitter <fraction>\n");
+    fprintf(stderr, "                     polling period jitter (default 0.1)\n");
+    fprintf(stderr, "  --dpi <dpi>        device resolution (default 800)\n");
+    fprintf(stderr, "  --gaps <rate> <max>\n");
+    fprintf(stderr, "                     skip 1 to <max> sequence numbers with probability <rate> per event\n");
+    fprintf(stderr, "  --chords <rate>    make clicks chords of two buttons with probability <rate>\n");
+    fprintf(stderr, "  --trackpad         generate trackpad events\n");
+    fprintf(stderr, "  --seed <n>         random seed (default 1)\n");
+    fprintf(stderr, "  --duration <s>     seconds of input to generate (default 3600)\n");
+    fprintf(stderr, "  --curve <curve>    acceleration curve for both device types (default osx)\n");
+    fprintf(stderr, "  --output <path>    write a capture file instead of running the pipeline\n");
+}
+
+int main(int argc, char *argv[]) {
+    synth_settings_t settings;
+    synth_settings_default(&settings);
+    double duration = 3600;
+    AccelerationCurve curve = ACCELERATION_CURVE_OSX;
+    const char *output = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--model") == 0 && i + 1 < argc) {
+            if (!synth_model_from_name(argv[++i], &settings.model)) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            settings.pollingRate = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--jitter") == 0 && i + 1 < argc) {
+            settings.jitter = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--dpi") == 0 && i + 1 < argc) {
+            settings.dpi = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--gaps") == 0 && i + 2 < argc) {
+            settings.gapRate = atof(argv[++i]);
+            settings.maxGap = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--chords") == 0 && i + 1 < argc) {
+            settings.chordRate = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--trackpad") == 0) {
+            settings.deviceType = kDeviceTypeTrackpad;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            settings.seed = (uint32_t) strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) {
+            duration = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--curve") == 0 && i + 1 < argc) {
+            if (!parse_curve(argv[++i], &curve)) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (settings.pollingRate <= 0 || settings.jitter < 0 || settings.jitter > 1 || settings.dpi <= 0 || duration <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    synth_t synth;
+    synth_init(&synth, &settings);
+    uint64_t end = settings.startTime + (uint64_t) (duration * 1e9);
+    CGPoint pos = { 0, 0 };
+    mouse_event_t event;
+
+    if (output != NULL) {
+        capture_settings_t captureSettings;
+        capture_settings_init(&captureSettings);
+        captureSettings.mouseCurve = curve;
+        captureSettings.mouseVelocity = 1.0;
+        captureSettings.trackpadCurve = curve;
+        captureSettings.trackpadVelocity = 1.0;
+        captureSettings.startPos = pos;
+
+        capture_file_t *capture = capture_create(output, &captureSettings);
+        if (capture == NULL) {
+            fprintf(stderr, "failed to create %s\n", output);
+            return 1;
+        }
+        uint64_t numEvents = 0;
+        uint64_t lostEvents = 0;
+        while (true) {
+            synth_next(&synth, &event);
+            if (event.timestamp >= end) {
+                break;
+            }
+            numEvents++;
+            lostEvents = synth.lostEvents;
+            if (!capture_write_event(capture, &event)) {
+                fprintf(stderr, "failed to write %s\n", output);
+                capture_close(capture);
+                return 1;
+            }
+        }
+        capture_close(capture);
+        printf("%llu events, %llu clicks (%llu chords), %llu lost events written to %s\n",
+               (unsigned long long) numEvents, (unsigned long long) synth.numClicks,
+               (unsigned long long) synth.numChords, (unsigned long long) lostEvents, output);
+        return 0;
+    }
+
+    pipeline_curves_t *curves = pipeline_curves_create(curve, 1.0, NULL, curve, 1.0, NULL);
+    soak_t soak;
+    memset(&soak, 0, sizeof(soak));
+    processor_t processor;
+    processor_init(&processor, pos, curves, soak_post_callback, &soak);
+
+    uint64_t numEvents = 0;
+    uint64_t lostEvents = 0;
+    double start = timestamp();
+    while (true) {
+        synth_next(&synth, &event);
+        if (event.timestamp >= end) {
+            break;
+        }
+        processor_process_event(&processor, &event);
+        numEvents++;
+        // the skipped sequence numbers of the events that were processed
+        lostEvents = synth.lostEvents;
+    }
+    double elapsed = timestamp() - start;
+
+    // the generator may stop in the middle of a click
+    BOOL buttonsDown = (processor.lastButtons != 0);
+    processor_release_buttons(&processor);
+
+    printf("model %s at %.0f Hz: %.0f s of input, %llu events, %llu driver events, %llu clicks (%llu chords)\n",
+           synth_model_name(settings.model), settings.pollingRate, duration,
+           (unsigned long long) numEvents, (unsigned long long) soak.posted,
+           (unsigned long long) synth.numClicks, (unsigned long long) synth.numChords);
+    printf("%.3f s, %.0f events/s, %.0fx real time, cursor at %.0f, %.0f\n",
+           elapsed, numEvents / elapsed, duration / elapsed, processor.currentPos.x, processor.currentPos.y);
+
+    int status = 0;
+    if (processor.lostEvents != lostEvents) {
+        fprintf(stderr, "pipeline counted %llu lost events, %llu were skipped\n",
+                (unsigned long long) processor.lostEvents, (unsigned long long) lostEvents);
+        status = 1;
+    }
+    if (soak.presses != soak.releases) {
+        fprintf(stderr, "%llu button presses but %llu releases%s\n",
+                (unsigned long long) soak.presses, (unsigned long long) soak.releases,
+                buttonsDown ? "" : " with no button down");
+        status = 1;
+    }
+
+    pipeline_curves_release(curves);
+
+    return status;
+}
@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "test.h"
+#include "capture.h"
+
+static const char curve_text[] =
+    "curve 1.0\n"
+    "0.44 0.30\n"
+    "4.31 13.21\n";
+
+static BOOL write_bytes(const char *path, const void *data, size_t size) {
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) {
+        return NO;
+    }
+    BOOL ok = (fwrite(data, 1, size, fp) == size);
+    return (fclose(fp) == 0 && ok);
+}
+
+TEST(capture, settings) {
+    char path[] = "/tmp/smoothmouse-capture-test-XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd != -1);
+    close(fd);
+
+    capture_settings_t settings;
+    capture_settings_init(&settings);
+    settings.mouseCurve = ACCELERATION_CURVE_CUSTOM;
+    settings.mouseVelocity = 1.25;
+    settings.trackpadCurve = ACCELERATION_CURVE_OSX;
+    settings.trackpadVelocity = 0.5;
+    settings.startPos.x = -100;
+    settings.startPos.y = 200;
+    settings.mouseTimeBasedDpi = 1600;
+    settings.mouseResolution = 1600;
+    settings.trackpadResolution = 400;
+    settings.screenResolution = 110;
+    settings.screenRefreshRate = 144;
+    settings.coalescingInterval = 6.5;
+    settings.mouseCurveFile.data = (char *) curve_text;
+    settings.mouseCurveFile.size = sizeof(curve_text) - 1;
+
+    capture_file_t *file = capture_create(path, &settings);
+    CHECK(file != NULL);
+    mouse_event_t event;
+    memset(&event, 0, sizeof(event));
+    event.device_type = kDeviceTypeMouse;
+    event.dx = 3;
+    event.dy = -4;
+    event.timestamp = 1000;
+    event.seqnum = 1;
+    CHECK(capture_write_event(file, &event));
+    capture_close(file);
+
+    capture_settings_t read;
+    file = capture_open(path, &read);
+    CHECK(file != NULL);
+    mouse_event_t readEvent;
+    CHECK(capture_read_event(file, &readEvent));
+    CHECK(!capture_read_event(file, &readEvent));
+    CHECK(capture_ok(file));
+    capture_close(file);
+    unlink(path);
+
+    CHECK_EQ(ACCELERATION_CURVE_CUSTOM, read.mouseCurve);
+    CHECK(read.mouseVelocity == 1.25);
+    CHECK_EQ(ACCELERATION_CURVE_OSX, read.trackpadCurve);
+    CHECK(read.trackpadVelocity == 0.5);
+    CHECK_EQ(-100, read.startPos.x);
+    CHECK_EQ(200, read.startPos.y);
+    CHECK(read.mouseTimeBasedDpi == 1600);
+    CHECK(read.trackpadTimeBasedDpi == 0);
+    CHECK(read.mouseResolution == 1600);
+    CHECK(read.trackpadResolution == 400);
+    CHECK(read.screenResolution == 110);
+    CHECK(read.screenRefreshRate == 144);
+    CHECK(read.coalescingInterval == 6.5);
+    CHECK_EQ(sizeof(curve_text) - 1, read.mouseCurveFile.size);
+    CHECK(read.mouseCurveFile.data != NULL &&
+          memcmp(read.mouseCurveFile.data, curve_text, sizeof(curve_text) - 1) == 0);
+    CHECK(read.trackpadCurveFile.data == NULL);
+    CHECK_EQ(0, read.trackpadCurveFile.size);
+    CHECK_EQ(3, readEvent.dx);
+    CHECK_EQ(-4, readEvent.dy);
+    capture_settings_cleanup(&read);
+}
+
+TEST(capture, version2) {
+    // a version 2 header ends after the start position
+    const unsigned char header[] = {
+        'S', 'M', 'C', 'P', 2, 0, 0, 0,
+        ACCELERATION_CURVE_WINDOWS, 0, 0, 0, 0, 0, 0, 0xf0, 0x3f,   // 1.0
+        ACCELERATION_CURVE_OSX, 0, 0, 0, 0, 0, 0, 0xe0, 0x3f,       // 0.5
+        10, 0, 0, 0, 20, 0, 0, 0,
+        kDeviceTypeMouse, 0, 6, 2, 2, 2, 0,
+    };
+    char path[] = "/tmp/smoothmouse-capture-test-XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd != -1);
+    close(fd);
+    CHECK(write_bytes(path, header, sizeof(header)));
+
+    capture_settings_t read;
+    capture_file_t *file = capture_open(path, &read);
+    CHECK(file != NULL);
+    mouse_event_t event;
+    CHECK(capture_read_event(file, &event));
+    capture_close(file);
+    unlink(path);
+
+    CHECK_EQ(ACCELERATION_CURVE_WINDOWS, read.mouseCurve);
+    CHECK(read.mouseVelocity == 1.0);
+    CHECK(read.trackpadVelocity == 0.5);
+    CHECK_EQ(20, read.startPos.y);
+    CHECK(read.mouseResolution == 0);
+    CHECK(read.coalescingInterval == 0);
+    CHECK(read.mouseCurveFile.data == NULL);
+    CHECK_EQ(3, event.dx);
+    CHECK_EQ(1, event.dy);
+    capture_settings_cleanup(&read);
+}
+
+TEST(capture, curve_file) {
+    char path[] = "/tmp/smoothmouse-capture-test-XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd != -1);
+    close(fd);
+    CHECK(write_bytes(path, curve_text, sizeof(curve_text) - 1));
+
+    capture_curve_file_t file;
+    CHECK(capture_curve_file_load(&file, path));
+    unlink(path);
+    CHECK_EQ(sizeof(curve_text) - 1, file.size);
+    CHECK(memcmp(file.data, curve_text, file.size) == 0);
+
+    capture_settings_t settings;
+    capture_settings_init(&settings);
+    settings.mouseCurveFile = file;
+    capture_settings_cleanup(&settings);
+    CHECK(settings.mouseCurveFile.data == NULL);
+
+    CHECK(!capture_curve_file_load(&file, path));
+    CHECK(file.data == NULL);
+}
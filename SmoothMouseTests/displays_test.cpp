@@ -0,0 +1,163 @@
+#include <pthread.h>
+
+#include "test.h"
+#include "displays.h"
+
+static CGPoint point(CGFloat x, CGFloat y) {
+    CGPoint p = { x, y };
+    return p;
+}
+
+static CGRect rect(CGFloat x, CGFloat y, CGFloat width, CGFloat height) {
+    CGRect r = { { x, y }, { width, height } };
+    return r;
+}
+
+#define CHECK_POINT(expectedX, expectedY, actual) do { \
+        CGPoint check_point_ = (actual); \
+        CHECK_EQ(expectedX, check_point_.x); \
+        CHECK_EQ(expectedY, check_point_.y); \
+    } while (0)
+
+TEST(displays, no_displays) {
+    display_index_t index;
+    display_index_init(&index);
+    CHECK_EQ(0, display_index_count(&index));
+    CHECK_EQ(-1, display_index_find(&index, point(0, 0)));
+    // nothing to keep the cursor on
+    CHECK_POINT(-5000, 7000, display_index_restrict(&index, point(0, 0), point(-5000, 7000)));
+}
+
+TEST(displays, mixed_resolutions) {
+    // a 1080p main display with a taller 1440p display on its right, aligned
+    // at the top, which leaves an area below the main display off screen
+    CGRect bounds[] = { rect(0, 0, 1920, 1080), rect(1920, 0, 2560, 1440) };
+    display_index_t index;
+    display_index_init(&index);
+    display_index_update(&index, bounds, 2);
+    CHECK_EQ(2, display_index_count(&index));
+
+    CHECK_EQ(0, display_index_find(&index, point(1919, 1079)));
+    // the right and bottom edges belong to the next display or none
+    CHECK_EQ(1, display_index_find(&index, point(1920, 0)));
+    CHECK_EQ(-1, display_index_find(&index, point(100, 1080)));
+    CHECK_EQ(1, display_index_find(&index, point(4479, 1439)));
+    CHECK_EQ(-1, display_index_find(&index, point(4480, 100)));
+
+    // moving across the shared edge is not restricted
+    CHECK_POINT(2000, 500, display_index_restrict(&index, point(1900, 500), point(2000, 500)));
+    // down from the main display stops at its bottom edge
+    CHECK_POINT(500, 1079, display_index_restrict(&index, point(500, 1000), point(500, 1200)));
+    // left from the lower part of the tall display stops at its left edge,
+    // not on the main display
+    CHECK_POINT(1920, 1300, display_index_restrict(&index, point(1930, 1300), point(1800, 1300)));
+    // diagonally off the bottom right corner
+    CHECK_POINT(4479, 1439, display_index_restrict(&index, point(4400, 1400), point(4600, 1500)));
+}
+
+TEST(displays, negative_origins) {
+    // a display left of and one above the main display, as OS X places them
+    // with the main display at the origin
+    CGRect bounds[] = { rect(0, 0, 1440, 900), rect(-1280, -200, 1280, 1024), rect(0, -1080, 1920, 1080) };
+    display_index_t index;
+    display_index_init(&index);
+    display_index_update(&index, bounds, 3);
+
+    CHECK_EQ(1, display_index_find(&index, point(-1, 0)));
+    CHECK_EQ(1, display_index_find(&index, point(-1280, -200)));
+    CHECK_EQ(2, display_index_find(&index, point(1919, -1)));
+    CHECK_EQ(-1, display_index_find(&index, point(-1, -201)));
+
+    CHECK_POINT(-1280, 300, display_index_restrict(&index, point(-1200, 300), point(-1500, 300)));
+    CHECK_POINT(-640, -200, display_index_restrict(&index, point(-640, -150), point(-640, -400)));
+    CHECK_POINT(1919, -500, display_index_restrict(&index, point(1900, -500), point(2100, -500)));
+    // from the main display up onto the one above
+    CHECK_POINT(100, -50, display_index_restrict(&index, point(100, 10), point(100, -50)));
+}
+
+TEST(displays, gap) {
+    // two displays with a 200 pixel gap between them
+    CGRect bounds[] = { rect(0, 0, 1000, 800), rect(1200, 0, 1000, 800) };
+    display_index_t index;
+    display_index_init(&index);
+    display_index_update(&index, bounds, 2);
+
+    // the cursor does not jump the gap
+    CHECK_POINT(999, 400, display_index_restrict(&index, point(990, 400), point(1100, 400)));
+    CHECK_POINT(1200, 400, display_index_restrict(&index, point(1210, 400), point(1100, 400)));
+    // jumping right across it in one move is allowed
+    CHECK_POINT(1250, 400, display_index_restrict(&index, point(990, 400), point(1250, 400)));
+}
+
+TEST(displays, nearest_fallback) {
+    CGRect bounds[] = { rect(0, 0, 1000, 800), rect(1200, 0, 1000, 800) };
+    display_index_t index;
+    display_index_init(&index);
+    display_index_update(&index, bounds, 2);
+
+    // the last position is in the gap (the layout changed under the cursor),
+    // the new one is clamped to the nearest display
+    CHECK_POINT(1200, 400, display_index_restrict(&index, point(1150, 400), point(1160, 400)));
+    CHECK_POINT(999, 400, display_index_restrict(&index, point(1150, 400), point(1050, 400)));
+    CHECK_POINT(999, 0, display_index_restrict(&index, point(1100, -50), point(1090, -100)));
+    // far away below both
+    CHECK_POINT(999, 799, display_index_restrict(&index, point(1050, 5000), point(1050, 5000)));
+    CHECK_POINT(2199, 799, display_index_restrict(&index, point(9000, 9000), point(9000, 9000)));
+}
+
+TEST(displays, too_many) {
+    CGRect bounds[DISPLAY_INDEX_MAX_DISPLAYS + 4];
+    for (int i = 0; i < DISPLAY_INDEX_MAX_DISPLAYS + 4; i++) {
+        bounds[i] = rect(i * 100, 0, 100, 100);
+    }
+    display_index_t index;
+    display_index_init(&index);
+    display_index_update(&index, bounds, DISPLAY_INDEX_MAX_DISPLAYS + 4);
+    CHECK_EQ(DISPLAY_INDEX_MAX_DISPLAYS, display_index_count(&index));
+    CHECK_EQ(-1, display_index_find(&index, point(DISPLAY_INDEX_MAX_DISPLAYS * 100, 50)));
+}
+
+typedef struct updater_s {
+    display_index_t *index;
+    volatile int stop;
+} updater_t;
+
+static const CGRect layoutA[] = { { { 0, 0 }, { 1000, 800 } } };
+// a reader that sees the count of one layout with the bounds of the other
+// ends up on the far away first display of layoutB
+static const CGRect layoutB[] = { { { -9000, -9000 }, { 10, 10 } }, { { 4000, 4000 }, { 10, 10 } } };
+
+static void *update_layouts(void *context) {
+    updater_t *updater = (updater_t *) context;
+    while (!updater->stop) {
+        display_index_update(updater->index, layoutA, 1);
+        display_index_update(updater->index, layoutB, 2);
+    }
+    return NULL;
+}
+
+TEST(displays, concurrent_update) {
+    display_index_t index;
+    display_index_init(&index);
+    display_index_update(&index, layoutA, 1);
+
+    updater_t updater;
+    updater.index = &index;
+    updater.stop = 0;
+    pthread_t thread;
+    CHECK(pthread_create(&thread, NULL, update_layouts, &updater) == 0);
+
+    // every read sees one complete layout, never a mix of the two
+    int torn = 0;
+    for (int i = 0; i < 200000; i++) {
+        CGPoint pos = display_index_restrict(&index, point(500, 400), point(3000, 3000));
+        BOOL onA = (pos.x == 999 && pos.y == 799);
+        BOOL onB = (pos.x == 4000 && pos.y == 4000);
+        if (!onA && !onB) {
+            torn++;
+        }
+    }
+    updater.stop = 1;
+    pthread_join(thread, NULL);
+    CHECK_EQ(0, torn);
+}
@@ -0,0 +1,93 @@
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "test.h"
+#include "eventloop.h"
+
+typedef struct called_s {
+    int count;
+    pthread_t thread;
+} called_t;
+
+static void record_call(event_loop_t *, void *context) {
+    called_t *called = (called_t *) context;
+    called->count++;
+    called->thread = pthread_self();
+}
+
+TEST(eventloop, signal_coalesces) {
+    event_loop_t *loop = event_loop_create();
+    CHECK(loop != NULL);
+    called_t called;
+    memset(&called, 0, sizeof(called));
+    int source = event_loop_add_signal(loop, record_call, &called);
+    CHECK(source != -1);
+
+    for (int i = 0; i < 5; i++) {
+        CHECK(event_loop_signal(loop, source));
+    }
+    CHECK_EQ(1, event_loop_run_once(loop, 0));
+    CHECK_EQ(1, called.count);
+    CHECK_EQ(0, event_loop_run_once(loop, 0));
+
+    event_loop_destroy(loop);
+}
+
+TEST(eventloop, timer) {
+    event_loop_t *loop = event_loop_create();
+    CHECK(loop != NULL);
+    called_t called;
+    memset(&called, 0, sizeof(called));
+    int source = event_loop_add_timer(loop, record_call, &called);
+    CHECK(source != -1);
+
+    // re-arming replaces the expiry, disarming cancels it
+    CHECK(event_loop_arm_timer(loop, source, 1000000000ull));
+    CHECK(event_loop_arm_timer(loop, source, 1000000));
+    CHECK_EQ(1, event_loop_run_once(loop, 500));
+    CHECK(event_loop_arm_timer(loop, source, 1000000));
+    CHECK(event_loop_disarm_timer(loop, source));
+    CHECK_EQ(0, event_loop_run_once(loop, 20));
+    CHECK_EQ(1, called.count);
+
+    // timers are not signal sources
+    CHECK(!event_loop_signal(loop, source));
+
+    event_loop_destroy(loop);
+}
+
+static void *send_sigusr1(void *) {
+    usleep(10000);
+    kill(getpid(), SIGUSR1);
+    return NULL;
+}
+
+TEST(eventloop, unix_signal) {
+    event_loop_t *loop = event_loop_create();
+    CHECK(loop != NULL);
+    called_t called;
+    memset(&called, 0, sizeof(called));
+    CHECK(event_loop_add_unix_signal(loop, SIGUSR1, record_call, &called) != -1);
+
+    // the callback runs on the loop's thread, not in the handler
+    pthread_t sender;
+    CHECK(pthread_create(&sender, NULL, send_sigusr1, NULL) == 0);
+    int numCallbacks = 0;
+    for (int i = 0; i < 10 && numCallbacks == 0; i++) {
+        numCallbacks = event_loop_run_once(loop, 100);
+    }
+    pthread_join(sender, NULL);
+    CHECK_EQ(1, numCallbacks);
+    CHECK_EQ(1, called.count);
+    CHECK(pthread_equal(called.thread, pthread_self()));
+
+    raise(SIGUSR1);
+    raise(SIGUSR1);
+    CHECK_EQ(1, event_loop_run_once(loop, 100));
+    CHECK_EQ(2, called.count);
+
+    event_loop_destroy(loop);
+    signal(SIGUSR1, SIG_IGN);
+}
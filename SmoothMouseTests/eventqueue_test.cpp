@@ -0,0 +1,184 @@
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "test.h"
+#include "eventqueue.h"
+#include "latency.h"
+
+#define NUM_STRESS_EVENTS   (200000)
+#define BUTTON_EVERY        (97)
+
+static event_queue_t queue;
+static BOOL queueCreated = NO;
+
+static BOOL reset_queue() {
+    if (!queueCreated) {
+        queueCreated = event_queue_init(&queue);
+        return queueCreated;
+    }
+    event_queue_reset(&queue);
+    return YES;
+}
+
+typedef struct consumed_s {
+    pipeline_pacer_t pacer;
+    useconds_t startDelay;  // lets the producer fill the ring
+    int numMoves;
+    int numButtons;
+    int64_t sumX;
+    int64_t sumY;
+    uint64_t lastSeqnum;
+    int outOfOrder;
+    int buttonsOutOfOrder;
+    int lastButton;
+} consumed_t;
+
+static void *consumer(void *context) {
+    consumed_t *consumed = (consumed_t *) context;
+    if (consumed->startDelay > 0) {
+        usleep(consumed->startDelay);
+    }
+    for (;;) {
+        driver_event_t event;
+        event_queue_pop(&queue, &event, &consumed->pacer);
+        if (event.id == DRIVER_EVENT_ID_TERMINATE) {
+            return NULL;
+        }
+        if (event.kextSeqnum <= consumed->lastSeqnum) {
+            consumed->outOfOrder++;
+        }
+        consumed->lastSeqnum = event.kextSeqnum;
+        if (event.id == DRIVER_EVENT_ID_MOVE) {
+            consumed->numMoves++;
+            consumed->sumX += event.move.deltaX;
+            consumed->sumY += event.move.deltaY;
+        } else {
+            // every button event carries the number of the previous one plus one
+            if (event.button.nclicks != consumed->lastButton + 1) {
+                consumed->buttonsOutOfOrder++;
+            }
+            consumed->lastButton = event.button.nclicks;
+            consumed->numButtons++;
+        }
+    }
+}
+
+static void start_consumer(pthread_t *thread, consumed_t *consumed, uint64_t interval, useconds_t startDelay) {
+    memset(consumed, 0, sizeof(*consumed));
+    pipeline_pacer_init(&consumed->pacer, interval);
+    consumed->startDelay = startDelay;
+    pthread_create(thread, NULL, consumer, consumed);
+}
+
+static void stop_consumer(pthread_t thread) {
+    driver_event_t event;
+    memset(&event, 0, sizeof(event));
+    event.id = DRIVER_EVENT_ID_TERMINATE;
+    event_queue_push(&queue, &event, NULL, NULL);
+    pthread_join(thread, NULL);
+}
+
+static void post_move(uint64_t seqnum, int dx, int dy) {
+    driver_event_t event;
+    memset(&event, 0, sizeof(event));
+    event.id = DRIVER_EVENT_ID_MOVE;
+    event.kextSeqnum = seqnum;
+    event.move.type = kCGEventMouseMoved;
+    event.move.deltaX = dx;
+    event.move.deltaY = dy;
+    event_queue_push(&queue, &event, NULL, NULL);
+}
+
+static void post_button(uint64_t seqnum, int number) {
+    driver_event_t event;
+    memset(&event, 0, sizeof(event));
+    event.id = DRIVER_EVENT_ID_BUTTON;
+    event.kextSeqnum = seqnum;
+    event.button.type = kCGEventLeftMouseDown;
+    event.button.nclicks = number;
+    event_queue_push(&queue, &event, NULL, NULL);
+}
+
+TEST(eventqueue, spsc_stress) {
+    CHECK(reset_queue());
+    pthread_t thread;
+    consumed_t consumed;
+    start_consumer(&thread, &consumed, 0, 0);
+
+    // moves are merged into the last slot whenever the consumer has not
+    // taken it yet, buttons never are and keep their order
+    int64_t sumX = 0;
+    int64_t sumY = 0;
+    int numMoves = 0;
+    int numButtons = 0;
+    for (int i = 1; i <= NUM_STRESS_EVENTS; i++) {
+        if (i % BUTTON_EVERY == 0) {
+            post_button(i, ++numButtons);
+        } else {
+            int dx = (i % 7) - 3;
+            int dy = (i % 5) - 2;
+            post_move(i, dx, dy);
+            sumX += dx;
+            sumY += dy;
+            numMoves++;
+        }
+    }
+    stop_consumer(thread);
+
+    CHECK_EQ(0, consumed.outOfOrder);
+    CHECK_EQ(0, consumed.buttonsOutOfOrder);
+    CHECK_EQ(numButtons, consumed.numButtons);
+    CHECK_EQ(numMoves, consumed.numMoves + queue.numCoalesced);
+    CHECK_EQ(sumX, consumed.sumX);
+    CHECK_EQ(sumY, consumed.sumY);
+    CHECK_EQ(NUM_STRESS_EVENTS, consumed.lastSeqnum);
+    CHECK_EQ(0, queue.numHeld);
+}
+
+TEST(eventqueue, full) {
+    CHECK(reset_queue());
+    pthread_t thread;
+    consumed_t consumed;
+    // the consumer only starts once the producer has been waiting for a while
+    start_consumer(&thread, &consumed, 0, 20000);
+
+    int numButtons = EVENT_QUEUE_SIZE * 4;
+    for (int i = 1; i <= numButtons; i++) {
+        post_button(i, i);
+    }
+    stop_consumer(thread);
+
+    CHECK(queue.numFull > 0);
+    CHECK_EQ(0, consumed.outOfOrder);
+    CHECK_EQ(0, consumed.buttonsOutOfOrder);
+    CHECK_EQ(numButtons, consumed.numButtons);
+}
+
+TEST(eventqueue, pacer) {
+    CHECK(reset_queue());
+    pthread_t thread;
+    consumed_t consumed;
+    uint64_t interval = 5000000; // 5 ms
+    start_consumer(&thread, &consumed, interval, 0);
+
+    // a move every 0.2 ms for 50 ms, the consumer holds each move back until
+    // 5 ms after the previous one and everything posted meanwhile is merged
+    uint64_t start = latency_now();
+    int numMoves = 250;
+    for (int i = 1; i <= numMoves; i++) {
+        post_move(i, 1, -1);
+        usleep(200);
+    }
+    uint64_t elapsed = latency_to_nanos(latency_now() - start);
+    // the held move is released at the latest one interval later
+    usleep(2 * interval / 1000);
+    stop_consumer(thread);
+
+    CHECK_EQ(0, consumed.outOfOrder);
+    CHECK_EQ(numMoves, consumed.sumX);
+    CHECK_EQ(-numMoves, consumed.sumY);
+    CHECK_EQ(numMoves, consumed.numMoves + queue.numCoalesced);
+    CHECK(consumed.numMoves <= (int)(elapsed / interval) + 2);
+    CHECK(queue.numHeld > 0);
+}
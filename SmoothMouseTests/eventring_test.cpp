@@ -0,0 +1,133 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "test.h"
+#include "eventring.h"
+
+#define NUM_RECORDS (4)
+
+// large enough for records of up to 8 events of 64 bytes
+static uint64_t memory[(sizeof(event_ring_header_t) + NUM_RECORDS * (8 + 8 * 64)) / sizeof(uint64_t)];
+
+static mouse_event_t event_with_seqnum(uint64_t seqnum) {
+    mouse_event_t event;
+    memset(&event, 0, sizeof(event));
+    event.device_type = kDeviceTypeMouse;
+    event.dx = (int) seqnum;
+    event.dy = -(int) seqnum;
+    event.seqnum = seqnum;
+    return event;
+}
+
+TEST(eventring, push_and_consume) {
+    event_ring_t producer;
+    event_ring_t consumer;
+    CHECK(event_ring_create(&producer, memory, sizeof(memory), NUM_RECORDS));
+    CHECK(event_ring_attach(&consumer, memory, sizeof(memory)));
+    CHECK(event_ring_peek(&consumer) == NULL);
+
+    // a full record is published right away, the rest with the report
+    for (uint64_t seqnum = 1; seqnum <= KEXT_EVENT_RING_MAX_EVENTS + 2; seqnum++) {
+        mouse_event_t event = event_with_seqnum(seqnum);
+        CHECK(event_ring_push(&producer, &event));
+    }
+    CHECK(event_ring_peek(&consumer) != NULL);
+    CHECK(!event_ring_publish(&producer));
+
+    uint64_t seqnum = 1;
+    event_ring_record_t *record;
+    while ((record = event_ring_peek(&consumer)) != NULL) {
+        for (uint32_t i = 0; i < event_ring_num_events(&consumer, record); i++) {
+            const mouse_event_t *event = event_ring_event(&consumer, record, i);
+            CHECK_EQ(seqnum, event->seqnum);
+            CHECK_EQ(-(int) seqnum, event->dy);
+            seqnum++;
+        }
+        event_ring_consume(&consumer);
+    }
+    CHECK_EQ(KEXT_EVENT_RING_MAX_EVENTS + 3, seqnum);
+
+    // a waiting consumer is notified
+    CHECK(event_ring_begin_wait(&consumer));
+    mouse_event_t event = event_with_seqnum(seqnum);
+    CHECK(event_ring_push(&producer, &event));
+    CHECK(event_ring_publish(&producer));
+    CHECK(!event_ring_begin_wait(&consumer));
+    event_ring_consume(&consumer);
+
+    // the producer drops what does not fit
+    for (int i = 0; i < NUM_RECORDS; i++) {
+        CHECK(event_ring_push(&producer, &event));
+        event_ring_publish(&producer);
+    }
+    CHECK(!event_ring_push(&producer, &event));
+    CHECK_EQ(1, event_ring_dropped(&consumer));
+}
+
+// writes the header of a ring a producer with eventSize bytes per event made
+static event_ring_header_t *create_header(uint32_t version, uint32_t eventSize) {
+    memset(memory, 0, sizeof(memory));
+    event_ring_header_t *header = (event_ring_header_t *) memory;
+    header->magic = KEXT_EVENT_RING_MAGIC;
+    header->version = version;
+    header->header_size = sizeof(event_ring_header_t);
+    header->record_size = offsetof(event_ring_record_t, events) + KEXT_EVENT_RING_MAX_EVENTS * (eventSize != 0 ? eventSize : 40);
+    header->num_records = NUM_RECORDS;
+    header->max_events = KEXT_EVENT_RING_MAX_EVENTS;
+    header->event_size = eventSize;
+    return header;
+}
+
+TEST(eventring, larger_events) {
+    // a newer producer with 56 byte events, the consumer reads ours of them
+    event_ring_header_t *header = create_header(KEXT_EVENT_RING_VERSION + 1, 56);
+    uint8_t *record = (uint8_t *) memory + header->header_size;
+    *(uint32_t *) record = 3;
+    for (int i = 0; i < 3; i++) {
+        mouse_event_t event = event_with_seqnum(10 + i);
+        memcpy(record + offsetof(event_ring_record_t, events) + i * 56, &event, sizeof(event));
+        memset(record + offsetof(event_ring_record_t, events) + i * 56 + sizeof(event), 0xff, 56 - sizeof(event));
+    }
+    header->producer_index = 1;
+
+    event_ring_t consumer;
+    CHECK(event_ring_attach(&consumer, memory, sizeof(memory)));
+    event_ring_record_t *peeked = event_ring_peek(&consumer);
+    CHECK(peeked != NULL);
+    CHECK_EQ(3, event_ring_num_events(&consumer, peeked));
+    for (uint32_t i = 0; i < 3; i++) {
+        const mouse_event_t *event = event_ring_event(&consumer, peeked, i);
+        CHECK_EQ(10 + i, event->seqnum);
+        CHECK_EQ(10 + i, event->dx);
+        CHECK_EQ(kDeviceTypeMouse, event->device_type);
+        CHECK_EQ(0, event->device_id);
+    }
+}
+
+TEST(eventring, event_size) {
+    event_ring_t consumer;
+
+    // minor version 0 has no event size, its events are the same as ours
+    create_header(0x00010000, 0);
+    CHECK(event_ring_attach(&consumer, memory, sizeof(memory)));
+    CHECK_EQ(sizeof(mouse_event_t), consumer.eventSize);
+
+    create_header(KEXT_EVENT_RING_VERSION, sizeof(mouse_event_t));
+    CHECK(event_ring_attach(&consumer, memory, sizeof(memory)));
+
+    // events without all of our fields, or not aligned for them, cannot be
+    // read in place
+    create_header(KEXT_EVENT_RING_VERSION, 32);
+    CHECK(!event_ring_attach(&consumer, memory, sizeof(memory)));
+    create_header(KEXT_EVENT_RING_VERSION, 44);
+    CHECK(!event_ring_attach(&consumer, memory, sizeof(memory)));
+
+    // records too small for the events
+    event_ring_header_t *header = create_header(KEXT_EVENT_RING_VERSION, 48);
+    header->record_size -= 8;
+    CHECK(!event_ring_attach(&consumer, memory, sizeof(memory)));
+
+    // another major version
+    create_header(0x00020000, sizeof(mouse_event_t));
+    CHECK(!event_ring_attach(&consumer, memory, sizeof(memory)));
+}
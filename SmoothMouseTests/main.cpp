@@ -0,0 +1,69 @@
+/*
+ smoothmouse-tests runs the unit tests of the portable core (see test.h). It
+ is built and registered with ctest by CMakeLists.txt, one test per suite:
+
+   smoothmouse-tests [<suite> ...]
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "test.h"
+
+static test_case_t *first_test = NULL;
+static test_case_t *last_test = NULL;
+static int failed = 0;
+
+void test_register(test_case_t *test) {
+    // in the order of registration, which is the order in the file
+    if (last_test == NULL) {
+        first_test = test;
+    } else {
+        last_test->next = test;
+    }
+    last_test = test;
+}
+
+void test_fail(const char *file, int line, const char *message) {
+    fprintf(stderr, "%s:%d: check failed: %s\n", file, line, message);
+    failed = 1;
+}
+
+static bool selected(const char *suite, int argc, char *argv[]) {
+    if (argc < 2) {
+        return true;
+    }
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], suite) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char *argv[]) {
+    int numRun = 0;
+    int numFailed = 0;
+
+    for (test_case_t *test = first_test; test != NULL; test = test->next) {
+        if (!selected(test->suite, argc, argv)) {
+            continue;
+        }
+        failed = 0;
+        test->function();
+        numRun++;
+        if (failed) {
+            numFailed++;
+            fprintf(stderr, "FAILED %s.%s\n", test->suite, test->name);
+        } else {
+            printf("ok     %s.%s\n", test->suite, test->name);
+        }
+    }
+
+    if (numRun == 0) {
+        fprintf(stderr, "no tests selected\n");
+        return 1;
+    }
+    printf("%d tests, %d failed\n", numRun, numFailed);
+    return numFailed > 0 ? 1 : 0;
+}
@@ -0,0 +1,140 @@
+#include "test.h"
+#include "movering.h"
+
+static move_ring_t ring;
+
+// fills the ring with moves of 1,1 and matches them one by one, returns the
+// number of moves that matched
+static int fill(move_ring_t *ring) {
+    int stored = 0;
+    for (int i = 0; i < MOVE_RING_SIZE; i++) {
+        stored += move_ring_push(ring, 1, 1);
+    }
+    return stored;
+}
+
+static int match_fill(move_ring_t *ring) {
+    int matched = 0;
+    for (int i = 0; i < MOVE_RING_SIZE; i++) {
+        matched += move_ring_match(ring, 1, 1);
+    }
+    return matched;
+}
+
+TEST(movering, merged) {
+    move_ring_init(&ring);
+    move_ring_push(&ring, 1, 2);
+    move_ring_push(&ring, 3, 4);
+    move_ring_push(&ring, -5, 0);
+    move_ring_push(&ring, 2, 2);
+
+    CHECK(move_ring_match(&ring, 4, 6));
+    CHECK_EQ(2, move_ring_size(&ring));
+    CHECK(move_ring_match(&ring, -3, 2));
+    CHECK_EQ(0, move_ring_size(&ring));
+}
+
+TEST(movering, not_ours) {
+    move_ring_init(&ring);
+    move_ring_push(&ring, 1, 2);
+    move_ring_push(&ring, 3, 4);
+
+    // everything posted up to now is consumed
+    CHECK(!move_ring_match(&ring, 100, 100));
+    CHECK_EQ(0, move_ring_size(&ring));
+    CHECK(!move_ring_match(&ring, 3, 4));
+
+    move_ring_push(&ring, 5, 6);
+    CHECK(move_ring_match(&ring, 5, 6));
+}
+
+TEST(movering, dropped_before_entry) {
+    move_ring_init(&ring);
+    CHECK_EQ(MOVE_RING_SIZE, fill(&ring));
+    CHECK(!move_ring_push(&ring, 5, 0));
+    CHECK_EQ(1, move_ring_dropped(&ring));
+
+    CHECK_EQ(MOVE_RING_SIZE, match_fill(&ring));
+    CHECK(move_ring_push(&ring, 7, 0));
+
+    // the dropped move and the one stored behind it each match on their own
+    CHECK(move_ring_match(&ring, 5, 0));
+    CHECK(move_ring_match(&ring, 7, 0));
+    CHECK_EQ(0, move_ring_size(&ring));
+}
+
+TEST(movering, dropped_merged) {
+    move_ring_init(&ring);
+    fill(&ring);
+    CHECK(!move_ring_push(&ring, 5, 0));
+    CHECK(!move_ring_push(&ring, 0, 3));
+    match_fill(&ring);
+    CHECK(move_ring_push(&ring, 7, 0));
+    CHECK(move_ring_push(&ring, 1, 0));
+
+    // the first dropped move alone can not be checked, the second one
+    // together with the stored move behind it can
+    CHECK(move_ring_match(&ring, 5, 0));
+    CHECK(move_ring_match(&ring, 7, 3));
+    CHECK(move_ring_match(&ring, 1, 0));
+    CHECK_EQ(0, move_ring_size(&ring));
+}
+
+TEST(movering, dropped_after_last_entry) {
+    move_ring_init(&ring);
+    fill(&ring);
+    CHECK(!move_ring_push(&ring, 5, 0));
+    CHECK_EQ(MOVE_RING_SIZE, match_fill(&ring));
+    CHECK(move_ring_match(&ring, 5, 0));
+
+    move_ring_init(&ring);
+    fill(&ring);
+    CHECK(!move_ring_push(&ring, 5, 0));
+    CHECK(!move_ring_push(&ring, 0, 3));
+    match_fill(&ring);
+    CHECK(move_ring_match(&ring, 5, 0));
+    CHECK(move_ring_match(&ring, 0, 3));
+
+    // nothing left to match
+    CHECK(!move_ring_match(&ring, 0, 3));
+}
+
+TEST(movering, tampered_in_gap) {
+    move_ring_init(&ring);
+    fill(&ring);
+    CHECK(!move_ring_push(&ring, 5, 0));
+    CHECK(!move_ring_push(&ring, 0, 3));
+    match_fill(&ring);
+    CHECK(move_ring_push(&ring, 7, 0));
+
+    // an event that was not ours in place of the first dropped move is only
+    // noticed at the end of the gap
+    CHECK(move_ring_match(&ring, 40, 40));
+    CHECK(!move_ring_match(&ring, 0, 3));
+    CHECK_EQ(0, move_ring_size(&ring));
+
+    move_ring_push(&ring, 2, 2);
+    CHECK(move_ring_match(&ring, 2, 2));
+}
+
+TEST(movering, lagging_listener) {
+    // the listener lags 300 events behind the driver posting single moves,
+    // so a run of moves does not fit into the ring, the moves go right so that
+    // no two prefixes have the same sum
+    const int lag = 300;
+    const int numMoves = 5000;
+    move_ring_init(&ring);
+    int matched = 0;
+    for (int i = 0; i < numMoves + lag; i++) {
+        if (i < numMoves) {
+            move_ring_push(&ring, 1 + (i % 3), (i % 11) - 5);
+        }
+        if (i >= lag) {
+            int j = i - lag;
+            matched += move_ring_match(&ring, 1 + (j % 3), (j % 11) - 5);
+        }
+    }
+    CHECK(move_ring_dropped(&ring) > 0);
+    CHECK_EQ(numMoves, matched);
+    CHECK_EQ(0, move_ring_size(&ring));
+}
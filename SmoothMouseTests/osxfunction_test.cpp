@@ -0,0 +1,216 @@
+#include <stdlib.h>
+
+#include "test.h"
+#include "platform.h"
+#include "OSXFunction.hpp"
+
+// the settings of the slider in System Preferences
+static const float settings[] = { 0, 0.125, 0.3125, 0.5, 0.6875, 0.875, 1.0, 1.5, 2.0, 2.5, 3.0 };
+#define NUM_SETTINGS ((int) (sizeof(settings) / sizeof(settings[0])))
+
+static const char *tables[] = { "mouse", "touchpad", "IOHIPointing" };
+#define NUM_TABLES ((int) (sizeof(tables) / sizeof(tables[0])))
+
+// device resolution, screen resolution and frame rate, 0 for the defaults
+static const int resolutions[][3] = { { 0, 0, 0 }, { 1600, 110, 60 }, { 12000, 220, 144 } };
+#define NUM_RESOLUTIONS ((int) (sizeof(resolutions) / sizeof(resolutions[0])))
+
+#define MAX_SMALL_DELTA (40)
+
+// runs the same deltas through apply() and applyReference() of two functions
+// and compares the pixels and the fractional parts carried between events
+static BOOL compare(OSXFunction *table, OSXFunction *reference, int dx, int dy) {
+    int tableX, tableY;
+    int referenceX, referenceY;
+    table->apply(dx, dy, &tableX, &tableY);
+    reference->applyReference(dx, dy, &referenceX, &referenceY);
+
+    OSXFunctionState tableState;
+    OSXFunctionState referenceState;
+    table->getState(&tableState);
+    reference->getState(&referenceState);
+
+    if (tableX != referenceX || tableY != referenceY ||
+        tableState.fractX != referenceState.fractX || tableState.fractY != referenceState.fractY) {
+        fprintf(stderr, "(%d, %d): apply (%d, %d) fract (%d, %d), reference (%d, %d) fract (%d, %d)\n",
+                dx, dy, tableX, tableY, tableState.fractX, tableState.fractY,
+                referenceX, referenceY, referenceState.fractX, referenceState.fractY);
+        return NO;
+    }
+    return YES;
+}
+
+static uint32_t next_random(uint32_t *random) {
+    *random = *random * 1664525 + 1013904223;
+    return *random >> 8;
+}
+
+TEST(osxfunction, table_matches_segment_walk) {
+    for (int t = 0; t < NUM_TABLES; t++) {
+        for (int s = 0; s < NUM_SETTINGS; s++) {
+            for (int r = 0; r < NUM_RESOLUTIONS; r++) {
+                OSXFunction table(tables[t], settings[s]);
+                OSXFunction reference(tables[t], settings[s]);
+                table.setResolutions(resolutions[r][0], resolutions[r][1], resolutions[r][2]);
+                reference.setResolutions(resolutions[r][0], resolutions[r][1], resolutions[r][2]);
+
+                // every small delta in order, the fractional parts carry over
+                // from one to the next like they do for a real mouse
+                for (int dy = -MAX_SMALL_DELTA; dy <= MAX_SMALL_DELTA; dy++) {
+                    for (int dx = -MAX_SMALL_DELTA; dx <= MAX_SMALL_DELTA; dx++) {
+                        CHECK(compare(&table, &reference, dx, dy));
+                    }
+                }
+
+                // then random deltas up to and beyond the end of the scale
+                // table (2048), where apply() walks the segments itself
+                uint32_t random = 1 + t * 100 + s * 10 + r;
+                for (int i = 0; i < 20000; i++) {
+                    int range = (i % 4 == 0) ? 3000 : 300;
+                    int dx = (int) (next_random(&random) % (2 * range + 1)) - range;
+                    int dy = (int) (next_random(&random) % (2 * range + 1)) - range;
+                    CHECK(compare(&table, &reference, dx, dy));
+                }
+            }
+        }
+    }
+}
+
+// deltas of a 400 dpi mouse, scaled up for the other resolutions
+static const int referenceDeltas[][2] = {
+    { 1, 0 }, { 2, -1 }, { 3, 2 }, { -4, 5 }, { 7, -3 }, { 10, 12 }, { -15, 8 }, { 20, -25 },
+    { 33, 4 }, { -40, -45 }, { 60, 70 }, { -90, 30 }, { 120, -100 }, { 5, 5 }, { 0, -3 }, { 200, 150 }
+};
+#define NUM_REFERENCE_DELTAS ((int) (sizeof(referenceDeltas) / sizeof(referenceDeltas[0])))
+
+// device resolution, screen resolution and frame rate, 0 for the defaults
+// (400 dpi, 96 ppi, 67 Hz)
+static const int referenceResolutions[][3] = { { 0, 0, 0 }, { 1600, 110, 144 }, { 3200, 220, 60 } };
+#define NUM_REFERENCE_RESOLUTIONS ((int) (sizeof(referenceResolutions) / sizeof(referenceResolutions[0])))
+
+// what libpointing's OSXFunction gives for the mouse table at the default
+// setting, with its resolution and FRAME_RATE / SCREEN_RESOLUTION constants
+// set to the values above
+static const int referencePixels[NUM_REFERENCE_RESOLUTIONS][NUM_REFERENCE_DELTAS][2] = {
+    { { 0, 0 }, { 0, 0 }, { 1, 0 }, { -1, 4 }, { 4, -2 }, { 8, 9 }, { -11, 7 }, { 23, -29 },
+      { 40, 4 }, { -87, -98 }, { 156, 182 }, { -234, 78 }, { 258, -215 }, { 3, 3 }, { 0, 0 }, { 279, 208 } },
+    { { 0, 0 }, { 1, 0 }, { 3, 0 }, { -3, 5 }, { 5, -2 }, { 15, 16 }, { -23, 13 }, { 53, -67 },
+      { 91, 10 }, { -111, -124 }, { 121, 141 }, { -174, 58 }, { 144, -119 }, { 5, 3 }, { 0, -1 }, { 148, 111 } },
+    { { 0, 0 }, { 1, 0 }, { 3, 1 }, { -5, 7 }, { 10, -4 }, { 18, 22 }, { -27, 15 }, { 49, -62 },
+      { 83, 9 }, { -181, -203 }, { 349, 407 }, { -530, 177 }, { 626, -521 }, { 7, 7 }, { 0, -1 }, { 715, 535 } },
+};
+
+TEST(osxfunction, libpointing_reference) {
+    for (int r = 0; r < NUM_REFERENCE_RESOLUTIONS; r++) {
+        OSXFunction function("mouse", 0.6875);
+        function.setResolutions(referenceResolutions[r][0], referenceResolutions[r][1], referenceResolutions[r][2]);
+        int scale = (referenceResolutions[r][0] > 0) ? referenceResolutions[r][0] / 400 : 1;
+        for (int i = 0; i < NUM_REFERENCE_DELTAS; i++) {
+            int pixelX, pixelY;
+            function.apply(referenceDeltas[i][0] * scale, referenceDeltas[i][1] * scale, &pixelX, &pixelY);
+            CHECK_EQ(referencePixels[r][i][0], pixelX);
+            CHECK_EQ(referencePixels[r][i][1], pixelY);
+        }
+    }
+}
+
+TEST(osxfunction, state_restores_carry) {
+    OSXFunction function("mouse", 1.0);
+    int x, y;
+
+    // a slow move leaves fractional parts behind
+    function.apply(1, -1, &x, &y);
+    OSXFunctionState saved;
+    function.getState(&saved);
+    CHECK(saved.fractX != 0 || saved.fractY != 0);
+
+    int firstX, firstY;
+    function.apply(3, 2, &firstX, &firstY);
+    function.setState(&saved);
+    int secondX, secondY;
+    function.apply(3, 2, &secondX, &secondY);
+    CHECK_EQ(firstX, secondX);
+    CHECK_EQ(firstY, secondY);
+
+    function.clearState();
+    OSXFunctionState cleared;
+    function.getState(&cleared);
+    CHECK_EQ(0, cleared.fractX);
+    CHECK_EQ(0, cleared.fractY);
+}
+
+// odd lengths leave events for the scalar tails of the vector loops, the
+// longer ones span several chunks
+static const size_t burstLengths[] = { 1, 3, 7, 8, 9, 63, 64, 65, 127, 200 };
+#define NUM_BURST_LENGTHS ((int) (sizeof(burstLengths) / sizeof(burstLengths[0])))
+
+#define MAX_BURST_LENGTH (200)
+
+TEST(osxfunction, batch_matches_apply) {
+    for (int t = 0; t < NUM_TABLES; t++) {
+        for (int s = 0; s < NUM_SETTINGS; s += 2) {
+            for (int r = 0; r < NUM_RESOLUTIONS; r++) {
+                OSXFunction batch(tables[t], settings[s]);
+                OSXFunction single(tables[t], settings[s]);
+                batch.setResolutions(resolutions[r][0], resolutions[r][1], resolutions[r][2]);
+                single.setResolutions(resolutions[r][0], resolutions[r][1], resolutions[r][2]);
+
+                uint32_t random = 1 + t * 100 + s * 10 + r;
+                for (int b = 0; b < 4 * NUM_BURST_LENGTHS; b++) {
+                    size_t count = burstLengths[b % NUM_BURST_LENGTHS];
+                    int16_t dx[MAX_BURST_LENGTH], dy[MAX_BURST_LENGTH];
+                    for (size_t i = 0; i < count; i++) {
+                        // mostly slow moves, some past the scale table and
+                        // the extremes of a 16 bit delta
+                        int range = (i % 5 == 0) ? 3000 : 40;
+                        dx[i] = (int16_t) ((int) (next_random(&random) % (2 * range + 1)) - range);
+                        dy[i] = (int16_t) ((int) (next_random(&random) % (2 * range + 1)) - range);
+                        if (i % 37 == 36) {
+                            dx[i] = (i % 2) ? 32767 : -32768;
+                        }
+                    }
+
+                    int batchX[MAX_BURST_LENGTH], batchY[MAX_BURST_LENGTH];
+                    batch.apply_batch(dx, dy, batchX, batchY, count);
+
+                    for (size_t i = 0; i < count; i++) {
+                        int singleX, singleY;
+                        single.apply(dx[i], dy[i], &singleX, &singleY);
+                        CHECK_EQ(singleX, batchX[i]);
+                        CHECK_EQ(singleY, batchY[i]);
+                    }
+
+                    OSXFunctionState batchState, singleState;
+                    batch.getState(&batchState);
+                    single.getState(&singleState);
+                    CHECK_EQ(singleState.fractX, batchState.fractX);
+                    CHECK_EQ(singleState.fractY, batchState.fractY);
+                }
+            }
+        }
+    }
+}
+
+TEST(osxfunction, resolution_limits) {
+    OSXFunction function("mouse", 1.0);
+    OSXFunction reference("mouse", 1.0);
+    CHECK(function.setResolutions(OSX_MAX_DEVICE_RESOLUTION, OSX_MAX_SCREEN_RESOLUTION, OSX_MAX_FRAME_RATE));
+    CHECK(reference.setResolutions(OSX_MAX_DEVICE_RESOLUTION, OSX_MAX_SCREEN_RESOLUTION, OSX_MAX_FRAME_RATE));
+    CHECK(function.setResolutions(OSX_MIN_DEVICE_RESOLUTION, OSX_MIN_SCREEN_RESOLUTION, OSX_MIN_FRAME_RATE));
+    CHECK(function.setResolutions(OSX_MAX_DEVICE_RESOLUTION, OSX_MAX_SCREEN_RESOLUTION, OSX_MAX_FRAME_RATE));
+
+    // anything just outside leaves the function as it was
+    CHECK(!function.setResolutions(OSX_MAX_DEVICE_RESOLUTION + 1, 0, 0));
+    CHECK(!function.setResolutions(0, OSX_MAX_SCREEN_RESOLUTION + 1, 0));
+    CHECK(!function.setResolutions(0, 0, OSX_MIN_FRAME_RATE - 1));
+    CHECK(!function.setResolutions(-1, 0, 0));
+
+    for (int dx = -MAX_SMALL_DELTA; dx <= MAX_SMALL_DELTA; dx++) {
+        int functionX, functionY;
+        int referenceX, referenceY;
+        function.apply(dx, -dx, &functionX, &functionY);
+        reference.apply(dx, -dx, &referenceX, &referenceY);
+        CHECK_EQ(referenceX, functionX);
+        CHECK_EQ(referenceY, functionY);
+    }
+}
@@ -0,0 +1,616 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "test.h"
+#include "pipeline.h"
+#include "processor.h"
+
+#define MS (1000000ull)
+
+static CGPoint point(CGFloat x, CGFloat y) {
+    CGPoint p = { x, y };
+    return p;
+}
+
+TEST(pipeline, remap_buttons) {
+    // the kext reports left, middle and right as 4, 2 and 1
+    CHECK_EQ(LEFT_BUTTON, pipeline_remap_buttons(4));
+    CHECK_EQ(MIDDLE_BUTTON, pipeline_remap_buttons(2));
+    CHECK_EQ(RIGHT_BUTTON, pipeline_remap_buttons(1));
+    CHECK_EQ(BUTTON4 | BUTTON5 | BUTTON6, pipeline_remap_buttons(8 | 16 | 32));
+    CHECK_EQ(LEFT_BUTTON | RIGHT_BUTTON, pipeline_remap_buttons(4 | 1));
+    CHECK_EQ(0, pipeline_remap_buttons(0));
+}
+
+TEST(pipeline, sequence_numbers) {
+    pipeline_state_t state;
+    pipeline_init(&state, point(0, 0));
+    uint64_t expected;
+    uint64_t lost;
+
+    // nothing is lost before the first event
+    CHECK(!pipeline_check_sequence_number(&state, 100, &expected, &lost));
+    CHECK_EQ(0, lost);
+    state.lastSequenceNumber = 100;
+
+    CHECK(pipeline_check_sequence_number(&state, 101, &expected, &lost));
+    CHECK_EQ(101, expected);
+    CHECK_EQ(0, lost);
+    state.lastSequenceNumber = 101;
+
+    CHECK(!pipeline_check_sequence_number(&state, 105, &expected, &lost));
+    CHECK_EQ(102, expected);
+    CHECK_EQ(3, lost);
+}
+
+TEST(pipeline, count_clicks) {
+    pipeline_clicks_t clicks;
+    pipeline_clicks_init(&clicks);
+    uint64_t interval = 500 * MS;
+
+    CHECK_EQ(1, pipeline_count_click(&clicks, point(10, 10), 1000 * MS, interval));
+    CHECK_EQ(2, pipeline_count_click(&clicks, point(11, 11), 1400 * MS, interval));
+    CHECK_EQ(3, pipeline_count_click(&clicks, point(10, 10), 1800 * MS, interval));
+    // too late
+    CHECK_EQ(1, pipeline_count_click(&clicks, point(10, 10), 2400 * MS, interval));
+    // moved too far from the first click
+    CHECK_EQ(1, pipeline_count_click(&clicks, point(13, 10), 2500 * MS, interval));
+    // a timestamp going backwards starts over
+    CHECK_EQ(1, pipeline_count_click(&clicks, point(13, 10), 2000 * MS, interval));
+}
+
+TEST(pipeline, event_types) {
+    CGEventType type;
+    CGMouseButton otherButton;
+
+    pipeline_move_event_type(0, &type, &otherButton);
+    CHECK_EQ(kCGEventMouseMoved, type);
+    pipeline_move_event_type(LEFT_BUTTON | RIGHT_BUTTON, &type, &otherButton);
+    CHECK_EQ(kCGEventLeftMouseDragged, type);
+    CHECK_EQ(kCGMouseButtonLeft, otherButton);
+    pipeline_move_event_type(BUTTON5, &type, &otherButton);
+    CHECK_EQ(kCGEventOtherMouseDragged, type);
+    CHECK_EQ(4, otherButton);
+
+    pipeline_button_event_type(RIGHT_BUTTON, YES, &type, &otherButton);
+    CHECK_EQ(kCGEventRightMouseDown, type);
+    CHECK_EQ(kCGMouseButtonRight, otherButton);
+    pipeline_button_event_type(MIDDLE_BUTTON, NO, &type, &otherButton);
+    CHECK_EQ(kCGEventOtherMouseUp, type);
+    CHECK_EQ(kCGMouseButtonCenter, otherButton);
+}
+
+TEST(pipeline, coalesce) {
+    driver_event_t last;
+    driver_event_t event;
+    memset(&last, 0, sizeof(last));
+    memset(&event, 0, sizeof(event));
+    last.id = event.id = DRIVER_EVENT_ID_MOVE;
+    last.move.type = event.move.type = kCGEventMouseMoved;
+    last.move.deltaX = 3;
+    last.move.deltaY = -1;
+    last.move.pos = point(3, -1);
+    event.move.deltaX = 2;
+    event.move.deltaY = 4;
+    event.move.pos = point(5, 3);
+    event.kextSeqnum = 7;
+
+    CHECK(pipeline_can_coalesce(&last.move, &event.move));
+    pipeline_coalesce(&last, &event);
+    CHECK_EQ(5, last.move.deltaX);
+    CHECK_EQ(3, last.move.deltaY);
+    CHECK_EQ(5, last.move.pos.x);
+    CHECK_EQ(7, last.kextSeqnum);
+
+    event.move.type = kCGEventLeftMouseDragged;
+    event.move.buttons = LEFT_BUTTON;
+    CHECK(!pipeline_can_coalesce(&last.move, &event.move));
+}
+
+TEST(pipeline, pacer) {
+    pipeline_pacer_t pacer;
+    pipeline_pacer_init(&pacer, 0);
+    CHECK_EQ(100, pipeline_pacer_release_time(&pacer, 100));
+
+    pipeline_pacer_init(&pacer, 8);
+    CHECK_EQ(100, pipeline_pacer_release_time(&pacer, 100));
+    pipeline_pacer_passed_on(&pacer, 100);
+    CHECK_EQ(108, pipeline_pacer_release_time(&pacer, 103));
+    CHECK_EQ(110, pipeline_pacer_release_time(&pacer, 110));
+}
+
+TEST(pipeline, linear_remainders) {
+    pipeline_curves_t *curves = pipeline_curves_create(ACCELERATION_CURVE_LINEAR, 0.5, NULL,
+                                                       ACCELERATION_CURVE_LINEAR, 1.0, NULL);
+    pipeline_state_t state;
+    pipeline_init(&state, point(0, 0));
+
+    mouse_event_t event;
+    memset(&event, 0, sizeof(event));
+    event.device_type = kDeviceTypeMouse;
+    event.dx = 1;
+    event.dy = -3;
+
+    // half a pixel per count, the remainders carry over to the next move
+    int sumX = 0;
+    int sumY = 0;
+    for (int i = 0; i < 10; i++) {
+        int deltaX;
+        int deltaY;
+        CHECK(pipeline_accelerate(&state, curves, &event, &deltaX, &deltaY));
+        sumX += deltaX;
+        sumY += deltaY;
+    }
+    CHECK_EQ(5, sumX);
+    CHECK_EQ(-15, sumY);
+    CHECK_EQ(5, state.deltaPosInt.x);
+    CHECK_EQ(-15, state.deltaPosInt.y);
+
+    event.device_type = kDeviceTypeUnknown;
+    int deltaX;
+    int deltaY;
+    CHECK(!pipeline_accelerate(&state, curves, &event, &deltaX, &deltaY));
+
+    pipeline_curves_release(curves);
+}
+
+// moves a 800 dpi mouse along a few straight strokes of different speeds and
+// directions, polled at rate Hz, and sums up the cursor movement
+static void move_strokes(AccelerationCurve type, BOOL timeBased, int rate, int *sumX, int *sumY) {
+    static const double speeds[] = { 1.0, 4.0, 12.0, 0.5, 8.0 };     // inches per second
+    static const double directions[][2] = { { 1, 0 }, { 0.6, 0.8 }, { -1, 0 }, { 0, -1 }, { 0.8, -0.6 } };
+
+    pipeline_curves_t *curves = pipeline_curves_create(type, 1.0, NULL, type, 1.0, NULL);
+    pipeline_curve_set_resolution(&curves->mouse, 800, 0, 0);
+    if (timeBased) {
+        pipeline_curve_use_timestamps(&curves->mouse, 800);
+    }
+    pipeline_state_t state;
+    pipeline_init(&state, point(0, 0));
+
+    mouse_event_t event;
+    memset(&event, 0, sizeof(event));
+    event.device_type = kDeviceTypeMouse;
+    event.timestamp = 1000 * MS;
+
+    double totalX = 0;
+    double totalY = 0;
+    int sentX = 0;
+    int sentY = 0;
+    *sumX = 0;
+    *sumY = 0;
+    for (int stroke = 0; stroke < 5; stroke++) {
+        for (int i = 0; i < rate / 2; i++) {
+            event.timestamp += 1000 * MS / rate;
+            totalX += speeds[stroke] * 800 * directions[stroke][0] / rate;
+            totalY += speeds[stroke] * 800 * directions[stroke][1] / rate;
+            // like a sensor, only whole counts are reported
+            event.dx = (int)lround(totalX) - sentX;
+            event.dy = (int)lround(totalY) - sentY;
+            if (event.dx == 0 && event.dy == 0) {
+                continue;
+            }
+            sentX += event.dx;
+            sentY += event.dy;
+            int deltaX;
+            int deltaY;
+            pipeline_accelerate(&state, curves, &event, &deltaX, &deltaY);
+            *sumX += deltaX;
+            *sumY += deltaY;
+        }
+        event.timestamp += 300 * MS;
+    }
+
+    pipeline_curves_release(curves);
+}
+
+static BOOL roughly_equal(int expected, int actual) {
+    return abs(actual - expected) <= abs(expected) * 3 / 100;
+}
+
+TEST(pipeline, polling_rate_independence) {
+    static const AccelerationCurve types[] = { ACCELERATION_CURVE_OSX, ACCELERATION_CURVE_WINDOWS };
+    static const int rates[] = { 1000, 8000 };
+
+    for (int t = 0; t < 2; t++) {
+        int slowX;
+        int slowY;
+        move_strokes(types[t], YES, 125, &slowX, &slowY);
+        for (int r = 0; r < 2; r++) {
+            int fastX;
+            int fastY;
+            move_strokes(types[t], YES, rates[r], &fastX, &fastY);
+            CHECK(roughly_equal(slowX, fastX));
+            CHECK(roughly_equal(slowY, fastY));
+        }
+
+        // the gain per report makes the same strokes much shorter when polled faster
+        int perReportSlowX;
+        int perReportSlowY;
+        int perReportFastX;
+        int perReportFastY;
+        move_strokes(types[t], NO, 125, &perReportSlowX, &perReportSlowY);
+        move_strokes(types[t], NO, 8000, &perReportFastX, &perReportFastY);
+        CHECK(abs(perReportFastX) * 2 < abs(perReportSlowX));
+    }
+}
+
+TEST(pipeline, resolution_limits) {
+    static const AccelerationCurve types[] = { ACCELERATION_CURVE_OSX, ACCELERATION_CURVE_WINDOWS };
+
+    for (int t = 0; t < 2; t++) {
+        pipeline_curves_t *curves = pipeline_curves_create(types[t], 1.0, NULL, types[t], 1.0, NULL);
+        pipeline_curves_t *reference = pipeline_curves_create(types[t], 1.0, NULL, types[t], 1.0, NULL);
+        CHECK(pipeline_curve_set_resolution(&curves->mouse, PIPELINE_MAX_DPI, PIPELINE_MAX_PPI, PIPELINE_MAX_HZ));
+        CHECK(pipeline_curve_set_resolution(&reference->mouse, PIPELINE_MAX_DPI, PIPELINE_MAX_PPI, PIPELINE_MAX_HZ));
+
+        // rejected before the conversion to int, the curve stays as it was
+        CHECK(!pipeline_curve_set_resolution(&curves->mouse, PIPELINE_MAX_DPI + 1, 0, 0));
+        CHECK(!pipeline_curve_set_resolution(&curves->mouse, 1e300, 0, 0));
+        CHECK(!pipeline_curve_set_resolution(&curves->mouse, NAN, 0, 0));
+        CHECK(!pipeline_curve_set_resolution(&curves->mouse, 0, PIPELINE_MAX_PPI + 1, 0));
+        CHECK(!pipeline_curve_set_resolution(&curves->mouse, 0, 0, PIPELINE_MIN_HZ - 1));
+        CHECK(!pipeline_curve_set_resolution(&curves->mouse, 0, 0, -1e300));
+
+        pipeline_state_t state;
+        pipeline_state_t referenceState;
+        pipeline_init(&state, point(0, 0));
+        pipeline_init(&referenceState, point(0, 0));
+        mouse_event_t event;
+        memset(&event, 0, sizeof(event));
+        event.device_type = kDeviceTypeMouse;
+        for (int i = 1; i <= 50; i++) {
+            event.dx = i * 40;
+            event.dy = -i * 25;
+            int deltaX, deltaY;
+            int referenceX, referenceY;
+            CHECK(pipeline_accelerate(&state, curves, &event, &deltaX, &deltaY));
+            CHECK(pipeline_accelerate(&referenceState, reference, &event, &referenceX, &referenceY));
+            CHECK_EQ(referenceX, deltaX);
+            CHECK_EQ(referenceY, deltaY);
+        }
+
+        pipeline_curves_release(curves);
+        pipeline_curves_release(reference);
+    }
+}
+
+typedef struct posted_s {
+    int numMoves;
+    int numButtons;
+    driver_event_t last;
+} posted_t;
+
+static void record_post(driver_event_t *event, void *context) {
+    posted_t *posted = (posted_t *) context;
+    if (event->id == DRIVER_EVENT_ID_MOVE) {
+        posted->numMoves++;
+    } else {
+        posted->numButtons++;
+    }
+    posted->last = *event;
+}
+
+TEST(pipeline, processor) {
+    pipeline_curves_t *curves = pipeline_curves_create(ACCELERATION_CURVE_LINEAR, 1.0, NULL,
+                                                       ACCELERATION_CURVE_LINEAR, 1.0, NULL);
+    posted_t posted;
+    memset(&posted, 0, sizeof(posted));
+    processor_t processor;
+    processor_init(&processor, point(100, 100), curves, record_post, &posted);
+
+    mouse_event_t event;
+    memset(&event, 0, sizeof(event));
+    event.device_type = kDeviceTypeMouse;
+    event.seqnum = 1;
+    event.dx = 4;
+    CHECK(processor_process_event(&processor, &event));
+    CHECK_EQ(1, posted.numMoves);
+    CHECK_EQ(104, posted.last.move.pos.x);
+
+    // a left press (4 from the kext) with a move, then a gap of two events
+    memset(&event, 0, sizeof(event));
+    event.device_type = kDeviceTypeMouse;
+    event.seqnum = 4;
+    event.buttons = 4;
+    event.dy = 2;
+    CHECK(processor_process_event(&processor, &event));
+    CHECK_EQ(1, posted.numButtons);
+    CHECK_EQ(2, posted.numMoves);
+    CHECK_EQ(kCGEventLeftMouseDragged, posted.last.move.type);
+    CHECK_EQ(2, processor.lostEvents);
+
+    processor_release_buttons(&processor);
+    CHECK_EQ(2, posted.numButtons);
+    CHECK_EQ(kCGEventLeftMouseUp, posted.last.button.type);
+
+    pipeline_curves_release(curves);
+}
+
+static void record_all(driver_event_t *event, void *context) {
+    ((std::vector<driver_event_t> *) context)->push_back(*event);
+}
+
+// events of two mice and a trackpad mixed together, with button changes,
+// reports that do not move, moves too large for a burst and a few of an
+// unknown device
+static void mixed_events(std::vector<mouse_event_t> *events, int count) {
+    uint32_t random = 7;
+    for (int i = 0; i < count; i++) {
+        random = random * 1664525 + 1013904223;
+        uint32_t r = random >> 8;
+        mouse_event_t event;
+        memset(&event, 0, sizeof(event));
+        event.seqnum = i + 1;
+        event.timestamp = (uint64_t) (1000 + i) * MS;
+        int source = (i / 9) % 3;
+        event.device_type = (source == 2) ? kDeviceTypeTrackpad : kDeviceTypeMouse;
+        event.device_id = (source == 1) ? 2 : 1;
+        if (r % 97 == 0) {
+            event.device_type = kDeviceTypeUnknown;
+        }
+        event.buttons = ((i / 50) % 2) ? 4 : 0;
+        if (r % 11 != 0) {
+            int range = (r % 13 == 0) ? 400 : 12;
+            event.dx = (int) ((r >> 4) % (2 * range + 1)) - range;
+            event.dy = (int) ((r >> 14) % (2 * range + 1)) - range;
+        }
+        if (r % 89 == 0) {
+            event.dx = 70000;
+        }
+        events->push_back(event);
+    }
+}
+
+TEST(pipeline, burst_matches_single_events) {
+    static const AccelerationCurve types[][2] = {
+        { ACCELERATION_CURVE_OSX, ACCELERATION_CURVE_WINDOWS },
+        { ACCELERATION_CURVE_WINDOWS, ACCELERATION_CURVE_OSX },
+        { ACCELERATION_CURVE_LINEAR, ACCELERATION_CURVE_OSX },
+    };
+    static const size_t burstLengths[] = { 1, 3, 7, 64, 65, 130 };
+
+    std::vector<mouse_event_t> events;
+    mixed_events(&events, 1000);
+
+    for (int t = 0; t < 3; t++) {
+        pipeline_curves_t *curves = pipeline_curves_create(types[t][0], 1.0, NULL, types[t][1], 1.5, NULL);
+        pipeline_curve_set_resolution(&curves->mouse, 1600, 0, 0);
+        if (t == 2) {
+            // the trackpad gain comes from its speed
+            pipeline_curve_use_timestamps(&curves->trackpad, 800);
+        }
+
+        std::vector<driver_event_t> single;
+        processor_t processor;
+        processor_init(&processor, point(0, 0), curves, record_all, &single);
+        std::vector<mouse_event_t> singleEvents = events;
+        for (size_t i = 0; i < singleEvents.size(); i++) {
+            processor_process_event(&processor, &singleEvents[i]);
+        }
+        CHECK(single.size() > 900);
+
+        std::vector<driver_event_t> burst;
+        processor_t burstProcessor;
+        processor_init(&burstProcessor, point(0, 0), curves, record_all, &burst);
+        std::vector<mouse_event_t> burstEvents = events;
+        for (size_t i = 0, b = 0; i < burstEvents.size(); b++) {
+            size_t count = burstLengths[b % 6];
+            if (count > burstEvents.size() - i) {
+                count = burstEvents.size() - i;
+            }
+            BOOL known = YES;
+            for (size_t j = i; j < i + count; j++) {
+                if (events[j].device_type == kDeviceTypeUnknown && (events[j].dx != 0 || events[j].dy != 0)) {
+                    known = NO;
+                }
+            }
+            CHECK_EQ(known, processor_process_events(&burstProcessor, &burstEvents[i], count));
+            i += count;
+        }
+
+        CHECK_EQ(single.size(), burst.size());
+        for (size_t i = 0; i < single.size(); i++) {
+            CHECK_EQ(single[i].id, burst[i].id);
+            CHECK_EQ(single[i].kextSeqnum, burst[i].kextSeqnum);
+            if (single[i].id == DRIVER_EVENT_ID_MOVE) {
+                CHECK_EQ(single[i].move.deltaX, burst[i].move.deltaX);
+                CHECK_EQ(single[i].move.deltaY, burst[i].move.deltaY);
+                CHECK_EQ(single[i].move.pos.x, burst[i].move.pos.x);
+                CHECK_EQ(single[i].move.pos.y, burst[i].move.pos.y);
+                CHECK_EQ(single[i].move.type, burst[i].move.type);
+            } else {
+                CHECK_EQ(single[i].button.type, burst[i].button.type);
+            }
+        }
+        CHECK_EQ(processor.lostEvents, burstProcessor.lostEvents);
+        CHECK_EQ(processor.lastButtons, burstProcessor.lastButtons);
+
+        pipeline_curves_release(curves);
+    }
+}
+
+TEST(pipeline, paused_passes_through) {
+    pipeline_curves_t *curves = pipeline_curves_create(ACCELERATION_CURVE_OSX, 1.0, NULL,
+                                                       ACCELERATION_CURVE_WINDOWS, 1.0, NULL);
+    std::vector<mouse_event_t> events;
+    mixed_events(&events, 500);
+
+    // one by one and in bursts, the moves keep the deltas of the kext
+    for (int bursts = 0; bursts < 2; bursts++) {
+        std::vector<driver_event_t> posted;
+        processor_t processor;
+        processor_init(&processor, point(0, 0), curves, record_all, &posted);
+        processor_set_paused(&processor, YES);
+        std::vector<mouse_event_t> paused = events;
+        if (bursts) {
+            for (size_t i = 0; i < paused.size(); i += 64) {
+                processor_process_events(&processor, &paused[i], paused.size() - i < 64 ? paused.size() - i : 64);
+            }
+        } else {
+            for (size_t i = 0; i < paused.size(); i++) {
+                processor_process_event(&processor, &paused[i]);
+            }
+        }
+
+        int numMoves = 0;
+        int sumX = 0;
+        int sumY = 0;
+        for (size_t i = 0; i < posted.size(); i++) {
+            if (posted[i].id == DRIVER_EVENT_ID_MOVE) {
+                const mouse_event_t &event = events[posted[i].kextSeqnum - 1];
+                CHECK_EQ(event.dx, posted[i].move.deltaX);
+                CHECK_EQ(event.dy, posted[i].move.deltaY);
+                sumX += event.dx;
+                sumY += event.dy;
+                CHECK_EQ(sumX, posted[i].move.pos.x);
+                CHECK_EQ(sumY, posted[i].move.pos.y);
+                numMoves++;
+            }
+        }
+        CHECK(numMoves > 400);
+
+        // accelerated again once resumed
+        processor_set_paused(&processor, NO);
+        mouse_event_t event;
+        memset(&event, 0, sizeof(event));
+        event.device_type = kDeviceTypeMouse;
+        event.seqnum = events.size() + 1;
+        event.dx = 40;
+        CHECK(processor_process_event(&processor, &event));
+        CHECK(posted.back().move.deltaX > 40);
+    }
+
+    pipeline_curves_release(curves);
+}
+
+// the DriverEventThread, draining the queue after every kext event and
+// holding the last move back for the coalescing interval like the replay
+// tool does with --coalesce
+typedef struct paced_driver_s {
+    pipeline_pacer_t pacer;
+    uint64_t now;
+    BOOL holding;
+    uint64_t numCoalescedEvents;
+    std::vector<driver_event_t> queue;
+    std::vector<driver_event_t> posted;
+} paced_driver_t;
+
+static void paced_driver_post(driver_event_t *event, void *context) {
+    paced_driver_t *driver = (paced_driver_t *) context;
+    if (!driver->queue.empty() && event->id == DRIVER_EVENT_ID_MOVE) {
+        driver_event_t *last = &driver->queue.back();
+        if (last->id == DRIVER_EVENT_ID_MOVE && pipeline_can_coalesce(&event->move, &last->move)) {
+            pipeline_coalesce(last, event);
+            driver->numCoalescedEvents++;
+            return;
+        }
+    }
+    driver->queue.push_back(*event);
+}
+
+static void paced_driver_pass_on(paced_driver_t *driver, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (driver->queue[i].id == DRIVER_EVENT_ID_MOVE) {
+            pipeline_pacer_passed_on(&driver->pacer, driver->now);
+        }
+        driver->posted.push_back(driver->queue[i]);
+    }
+    driver->queue.erase(driver->queue.begin(), driver->queue.begin() + count);
+}
+
+static void paced_driver_drain(paced_driver_t *driver, BOOL flush) {
+    size_t count = driver->queue.size();
+    driver->holding = (!flush && count > 0 && driver->queue.back().id == DRIVER_EVENT_ID_MOVE &&
+                       pipeline_pacer_release_time(&driver->pacer, driver->now) > driver->now);
+    paced_driver_pass_on(driver, driver->holding ? count - 1 : count);
+}
+
+// 2 s of a 1 kHz mouse moving around, with a drag and a few clicks
+static void replay_strokes(uint64_t interval, paced_driver_t *driver, CGPoint *finalPos) {
+    pipeline_curves_t *curves = pipeline_curves_create(ACCELERATION_CURVE_OSX, 1.0, NULL,
+                                                       ACCELERATION_CURVE_OSX, 1.0, NULL);
+    pipeline_pacer_init(&driver->pacer, interval);
+    driver->now = 0;
+    driver->holding = NO;
+    driver->numCoalescedEvents = 0;
+    processor_t processor;
+    processor_init(&processor, point(500, 500), curves, paced_driver_post, driver);
+
+    mouse_event_t event;
+    memset(&event, 0, sizeof(event));
+    event.device_type = kDeviceTypeMouse;
+    for (int i = 0; i < 2000; i++) {
+        event.seqnum = i + 1;
+        event.timestamp = (1000 + i) * MS;
+        event.dx = (i % 7) - 2;
+        event.dy = ((i / 100) % 2 == 0) ? 1 : -2;
+        // the left button (4 from the kext) is held for a drag, then clicked
+        event.buttons = ((i >= 700 && i < 1300) || (i >= 1500 && i < 1510) || (i >= 1600 && i < 1605)) ? 4 : 0;
+
+        // the held move goes out when the interval is over
+        if (driver->holding) {
+            uint64_t release = driver->pacer.lastMove + driver->pacer.interval;
+            if (event.timestamp >= release) {
+                driver->now = release;
+                paced_driver_pass_on(driver, 1);
+                driver->holding = NO;
+            }
+        }
+        driver->now = event.timestamp;
+        CHECK(processor_process_event(&processor, &event));
+        paced_driver_drain(driver, NO);
+    }
+    paced_driver_drain(driver, YES);
+    *finalPos = processor.currentPos;
+
+    pipeline_curves_release(curves);
+}
+
+TEST(pipeline, coalescing_replay) {
+    paced_driver_t unpaced;
+    paced_driver_t paced;
+    CGPoint unpacedPos;
+    CGPoint pacedPos;
+    replay_strokes(0, &unpaced, &unpacedPos);
+    replay_strokes(16 * MS, &paced, &pacedPos);
+
+    // far fewer events for the window server
+    CHECK_EQ(0, unpaced.numCoalescedEvents);
+    CHECK(paced.numCoalescedEvents > 0);
+    CHECK(paced.posted.size() * 5 < unpaced.posted.size());
+
+    // the cursor ends up in the same place
+    CHECK_EQ(unpacedPos.x, pacedPos.x);
+    CHECK_EQ(unpacedPos.y, pacedPos.y);
+    CHECK_EQ(DRIVER_EVENT_ID_MOVE, unpaced.posted.back().id);
+    CHECK_EQ(DRIVER_EVENT_ID_MOVE, paced.posted.back().id);
+    CHECK_EQ(unpaced.posted.back().move.pos.x, paced.posted.back().move.pos.x);
+    CHECK_EQ(unpaced.posted.back().move.pos.y, paced.posted.back().move.pos.y);
+
+    // and every button event is posted where it was, the moves are never
+    // merged across a button change
+    std::vector<driver_event_t> unpacedButtons;
+    std::vector<driver_event_t> pacedButtons;
+    for (size_t i = 0; i < unpaced.posted.size(); i++) {
+        if (unpaced.posted[i].id == DRIVER_EVENT_ID_BUTTON) {
+            unpacedButtons.push_back(unpaced.posted[i]);
+        }
+    }
+    for (size_t i = 0; i < paced.posted.size(); i++) {
+        if (paced.posted[i].id == DRIVER_EVENT_ID_BUTTON) {
+            pacedButtons.push_back(paced.posted[i]);
+        }
+    }
+    CHECK_EQ(6, unpacedButtons.size());
+    CHECK_EQ(unpacedButtons.size(), pacedButtons.size());
+    for (size_t i = 0; i < unpacedButtons.size() && i < pacedButtons.size(); i++) {
+        CHECK_EQ(unpacedButtons[i].button.type, pacedButtons[i].button.type);
+        CHECK_EQ(unpacedButtons[i].button.pos.x, pacedButtons[i].button.pos.x);
+        CHECK_EQ(unpacedButtons[i].button.pos.y, pacedButtons[i].button.pos.y);
+        CHECK_EQ(unpacedButtons[i].kextSeqnum, pacedButtons[i].kextSeqnum);
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdio.h>
+
+/*
+ A minimal unit test harness. Tests are functions registered with TEST(suite,
+ name); a failing CHECK reports the file and line and ends the test.
+ smoothmouse-tests runs every test, or those of the suites given as
+ arguments, and exits with 1 if one failed.
+ */
+
+typedef void (*test_function_t)();
+
+typedef struct test_case_s {
+    const char *suite;
+    const char *name;
+    test_function_t function;
+    struct test_case_s *next;
+} test_case_t;
+
+void test_register(test_case_t *test);
+void test_fail(const char *file, int line, const char *message);
+
+struct test_registrar_t {
+    test_registrar_t(test_case_t *test) { test_register(test); }
+};
+
+#define TEST(suite, name) \
+    static void test_##suite##_##name(); \
+    static test_case_t test_case_##suite##_##name = { #suite, #name, test_##suite##_##name, NULL }; \
+    static test_registrar_t test_registrar_##suite##_##name(&test_case_##suite##_##name); \
+    static void test_##suite##_##name()
+
+#define CHECK(condition) do { \
+        if (!(condition)) { \
+            test_fail(__FILE__, __LINE__, #condition); \
+            return; \
+        } \
+    } while (0)
+
+#define CHECK_EQ(expected, actual) do { \
+        long long test_expected_ = (long long) (expected); \
+        long long test_actual_ = (long long) (actual); \
+        if (test_expected_ != test_actual_) { \
+            char test_message_[256]; \
+            snprintf(test_message_, sizeof(test_message_), "%s == %s (%lld != %lld)", \
+                     #expected, #actual, test_expected_, test_actual_); \
+            test_fail(__FILE__, __LINE__, test_message_); \
+            return; \
+        } \
+    } while (0)
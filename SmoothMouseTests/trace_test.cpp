@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "test.h"
+#include "trace.h"
+
+#define RECORDS_PER_THREAD (64)
+
+// the rendered records in the order they were passed
+static void collect(const trace_record_t *record, const char *text, void *context) {
+    std::vector<std::string> *lines = (std::vector<std::string> *) context;
+    if (text != NULL) {
+        lines->push_back(text);
+    } else {
+        char buffer[512];
+        trace_render_record(record, buffer, sizeof(buffer));
+        lines->push_back(buffer);
+    }
+}
+
+TEST(trace, render) {
+    trace_record_t record;
+    memset(&record, 0, sizeof(record));
+    record.id = TRACE_EVENT_MOUSE_SEQNUM;
+    record.nargs = 6;
+    record.args[0] = TRACE_U64_LO(12);
+    record.args[2] = TRACE_U64_LO(10);
+    record.args[4] = TRACE_U64_LO(2);
+    char buffer[512];
+    trace_render_record(&record, buffer, sizeof(buffer));
+    CHECK(strcmp(buffer, "seqnum: 12, expected: 10 (2 lost events)") == 0);
+
+    record.id = TRACE_EVENT_NUM_IDS;
+    trace_render_record(&record, buffer, sizeof(buffer));
+    CHECK(strstr(buffer, "unknown trace event") != NULL);
+}
+
+TEST(trace, write_and_read) {
+    CHECK(trace_init(RECORDS_PER_THREAD));
+
+    // more than fit into the ring, the oldest are overwritten
+    for (int i = 0; i < RECORDS_PER_THREAD + 10; i++) {
+        int32_t args[] = { i, i * 2, 3 };
+        trace_record(TRACE_EVENT_DRIVER_CANT_COALESCE, 3, args);
+    }
+    std::string longText(3 * TRACE_TEXT_BYTES + 5, 'x');
+    trace_text("short message");
+    trace_text(longText.c_str());
+
+    std::vector<std::string> dumped;
+    trace_dump(collect, &dumped);
+    CHECK(dumped.size() > 2);
+    CHECK(dumped.back() == longText);
+
+    char path[] = "/tmp/smoothmouse-trace-test-XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    close(fd);
+    CHECK(trace_write(path));
+
+    trace_file_info_t info;
+    std::vector<std::string> read;
+    CHECK(trace_read(path, &info, collect, &read));
+    CHECK_EQ(trace_num_overwritten(), info.num_overwritten);
+    CHECK(info.num_overwritten > 0);
+    CHECK(info.timebase_denom != 0);
+    CHECK_EQ(dumped.size(), read.size());
+    for (size_t i = 0; i < dumped.size(); i++) {
+        CHECK(dumped[i] == read[i]);
+    }
+
+    // a truncated file is rejected
+    CHECK(truncate(path, 100) == 0);
+    CHECK(!trace_read(path, &info, collect, &read));
+    unlink(path);
+
+    trace_cleanup();
+}
@@ -0,0 +1,126 @@
+#include <string.h>
+
+#include "test.h"
+#include "platform.h"
+#include "WindowsFunction.hpp"
+
+// deltas of a 400 dpi mouse, scaled up for the other resolutions
+static const int referenceDeltas[][2] = {
+    { 1, 0 }, { 2, -1 }, { 3, 2 }, { -4, 5 }, { 7, -3 }, { 10, 12 }, { -15, 8 }, { 20, -25 },
+    { 33, 4 }, { -40, -45 }, { 60, 70 }, { -90, 30 }, { 120, -100 }, { 5, 5 }, { 0, -3 }, { 200, 150 }
+};
+#define NUM_REFERENCE_DELTAS ((int) (sizeof(referenceDeltas) / sizeof(referenceDeltas[0])))
+
+// device resolution, screen resolution and refresh rate, 0 for the defaults
+// (400 dpi, 96 ppi, 60 Hz)
+static const int referenceResolutions[][3] = { { 0, 0, 0 }, { 1600, 110, 144 }, { 3200, 220, 60 } };
+#define NUM_REFERENCE_RESOLUTIONS ((int) (sizeof(referenceResolutions) / sizeof(referenceResolutions[0])))
+
+// what libpointing's WindowsFunction gives at the default slider, built
+// without WINDOWS_USE_DEFAULT_CONSTANTS for the screen resolution and refresh
+// rate above. It knows nothing of the device resolution and was given the 400
+// dpi deltas, the same motion has to move the cursor as far at any resolution.
+static const int referencePixels[NUM_REFERENCE_RESOLUTIONS][NUM_REFERENCE_DELTAS][2] = {
+    { { 0, 0 }, { 1, 0 }, { 3, 0 }, { -3, 5 }, { 6, -2 }, { 14, 15 }, { -23, 13 }, { 41, -53 },
+      { 71, 8 }, { -96, -108 }, { 151, 176 }, { -228, 77 }, { 314, -262 }, { 5, 4 }, { 0, -1 }, { 354, 265 } },
+    { { 0, 0 }, { 2, 0 }, { 2, 1 }, { -3, 5 }, { 8, -3 }, { 15, 17 }, { -27, 15 }, { 48, -60 },
+      { 81, 9 }, { -110, -124 }, { 173, 202 }, { -261, 88 }, { 359, -300 }, { 6, 5 }, { 0, -1 }, { 407, 303 } },
+    { { 1, 0 }, { 3, -1 }, { 5, 3 }, { -7, 10 }, { 16, -6 }, { 30, 35 }, { -54, 30 }, { 96, -121 },
+      { 162, 18 }, { -221, -248 }, { 348, 405 }, { -524, 175 }, { 720, -600 }, { 12, 11 }, { 0, -4 }, { 813, 608 } },
+};
+
+TEST(windowsfunction, libpointing_reference) {
+    for (int r = 0; r < NUM_REFERENCE_RESOLUTIONS; r++) {
+        WindowsFunction function(0);
+        function.setResolutions(referenceResolutions[r][0], referenceResolutions[r][1], referenceResolutions[r][2]);
+        int scale = (referenceResolutions[r][0] > 0) ? referenceResolutions[r][0] / 400 : 1;
+        for (int i = 0; i < NUM_REFERENCE_DELTAS; i++) {
+            int pixelX, pixelY;
+            function.apply(referenceDeltas[i][0] * scale, referenceDeltas[i][1] * scale, &pixelX, &pixelY);
+            CHECK_EQ(referencePixels[r][i][0], pixelX);
+            CHECK_EQ(referencePixels[r][i][1], pixelY);
+        }
+    }
+}
+
+static uint32_t next_random(uint32_t *random) {
+    *random = *random * 1664525 + 1013904223;
+    return *random >> 8;
+}
+
+// odd lengths leave events for the scalar tail of the vector loop, the
+// longer ones span several chunks
+static const size_t burstLengths[] = { 1, 3, 4, 5, 7, 63, 64, 65, 127, 200 };
+#define NUM_BURST_LENGTHS ((int) (sizeof(burstLengths) / sizeof(burstLengths[0])))
+
+#define MAX_BURST_LENGTH (200)
+
+TEST(windowsfunction, batch_matches_apply) {
+    for (int slider = -5; slider <= 5; slider++) {
+        for (int r = 0; r < NUM_REFERENCE_RESOLUTIONS; r++) {
+            WindowsFunction batch(slider);
+            WindowsFunction single(slider);
+            batch.setResolutions(referenceResolutions[r][0], referenceResolutions[r][1], referenceResolutions[r][2]);
+            single.setResolutions(referenceResolutions[r][0], referenceResolutions[r][1], referenceResolutions[r][2]);
+
+            uint32_t random = 1 + (slider + 5) * 10 + r;
+            for (int b = 0; b < 4 * NUM_BURST_LENGTHS; b++) {
+                size_t count = burstLengths[b % NUM_BURST_LENGTHS];
+                int16_t dx[MAX_BURST_LENGTH], dy[MAX_BURST_LENGTH];
+                for (size_t i = 0; i < count; i++) {
+                    // slow moves cross the segments of the curve back and
+                    // forth, with some stops and the extremes of a 16 bit
+                    // delta
+                    int range = (i % 7 == 0) ? 1000 : 6;
+                    dx[i] = (int16_t) ((int) (next_random(&random) % (2 * range + 1)) - range);
+                    dy[i] = (int16_t) ((int) (next_random(&random) % (2 * range + 1)) - range);
+                    if (i % 37 == 36) {
+                        dy[i] = (i % 2) ? 32767 : -32768;
+                    }
+                }
+
+                int batchX[MAX_BURST_LENGTH], batchY[MAX_BURST_LENGTH];
+                batch.apply_batch(dx, dy, batchX, batchY, count);
+
+                for (size_t i = 0; i < count; i++) {
+                    int singleX, singleY;
+                    single.apply(dx[i], dy[i], &singleX, &singleY);
+                    CHECK_EQ(singleX, batchX[i]);
+                    CHECK_EQ(singleY, batchY[i]);
+                }
+
+                // the remainders are compared bit for bit
+                WindowsFunctionState batchState, singleState;
+                batch.getState(&batchState);
+                single.getState(&singleState);
+                CHECK_EQ(singleState.previousSegmentIndex, batchState.previousSegmentIndex);
+                CHECK(memcmp(&singleState.previousMouseXRemainder, &batchState.previousMouseXRemainder, sizeof(float)) == 0);
+                CHECK(memcmp(&singleState.previousMouseYRemainder, &batchState.previousMouseYRemainder, sizeof(float)) == 0);
+            }
+        }
+    }
+}
+
+TEST(windowsfunction, resolution_limits) {
+    WindowsFunction function(0);
+    WindowsFunction reference(0);
+    CHECK(function.setResolutions(WINDOWS_MAX_DEVICE_RESOLUTION, WINDOWS_MAX_SCREEN_RESOLUTION, WINDOWS_MAX_REFRESH_RATE));
+    CHECK(reference.setResolutions(WINDOWS_MAX_DEVICE_RESOLUTION, WINDOWS_MAX_SCREEN_RESOLUTION, WINDOWS_MAX_REFRESH_RATE));
+    CHECK(function.setResolutions(WINDOWS_MIN_DEVICE_RESOLUTION, WINDOWS_MIN_SCREEN_RESOLUTION, WINDOWS_MIN_REFRESH_RATE));
+    CHECK(function.setResolutions(WINDOWS_MAX_DEVICE_RESOLUTION, WINDOWS_MAX_SCREEN_RESOLUTION, WINDOWS_MAX_REFRESH_RATE));
+
+    // anything just outside leaves the function as it was
+    CHECK(!function.setResolutions(WINDOWS_MAX_DEVICE_RESOLUTION + 1, 0, 0));
+    CHECK(!function.setResolutions(0, WINDOWS_MAX_SCREEN_RESOLUTION + 1, 0));
+    CHECK(!function.setResolutions(0, 0, WINDOWS_MIN_REFRESH_RATE - 1));
+    CHECK(!function.setResolutions(-1, 0, 0));
+
+    for (int i = 0; i < NUM_REFERENCE_DELTAS; i++) {
+        int functionX, functionY;
+        int referenceX, referenceY;
+        function.apply(referenceDeltas[i][0] * 80, referenceDeltas[i][1] * 80, &functionX, &functionY);
+        reference.apply(referenceDeltas[i][0] * 80, referenceDeltas[i][1] * 80, &referenceX, &referenceY);
+        CHECK_EQ(referenceX, functionX);
+        CHECK_EQ(referenceY, functionY);
+    }
+}
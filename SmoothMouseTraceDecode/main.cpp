@@ -0,0 +1,66 @@
+/*
+ smoothmouse-tracedecode turns the trace file the daemon writes with memory
+ logging (--memory) when it shuts down into the same messages debug_end()
+ logs, one line per record with the time since the first record:
+
+   smoothmouse-tracedecode /tmp/SmoothMouse-trace-<time>.bin
+
+ It does not depend on OS X and builds on Linux with:
+
+   c++ -O2 -ISmoothMouseDaemon -ISmoothMouseDaemon/core -ISmoothMouseDaemon/libpointing \
+       SmoothMouseTraceDecode/main.cpp \
+       SmoothMouseDaemon/core/trace.cpp SmoothMouseDaemon/core/pipeline.cpp \
+       SmoothMouseDaemon/libpointing/OSXFunction.cpp SmoothMouseDaemon/libpointing/WindowsFunction.cpp \
+       -lpthread -o smoothmouse-tracedecode
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "trace.h"
+
+typedef struct decoder_s {
+    const trace_file_info_t *info;
+    uint64_t first;
+    uint64_t numRecords;
+} decoder_t;
+
+static void print_record(const trace_record_t *record, const char *text, void *context) {
+    decoder_t *decoder = (decoder_t *) context;
+    if (decoder->numRecords++ == 0) {
+        decoder->first = record->timestamp;
+    }
+
+    double nanos = (double)(record->timestamp - decoder->first) *
+        decoder->info->timebase_numer / decoder->info->timebase_denom;
+
+    if (text != NULL) {
+        printf("%12.6f %s\n", nanos / 1.0e9, text);
+    } else {
+        char buffer[512];
+        trace_render_record(record, buffer, sizeof(buffer));
+        printf("%12.6f %s\n", nanos / 1.0e9, buffer);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 2 || strcmp(argv[1], "--help") == 0) {
+        fprintf(stderr, "usage: %s <trace file>\n", argv[0]);
+        return 1;
+    }
+
+    trace_file_info_t info;
+    decoder_t decoder;
+    decoder.info = &info;
+    decoder.first = 0;
+    decoder.numRecords = 0;
+
+    if (!trace_read(argv[1], &info, print_record, &decoder)) {
+        fprintf(stderr, "%s: not a trace file or truncated\n", argv[1]);
+        return 1;
+    }
+
+    fprintf(stderr, "%llu records (%llu older records overwritten)\n",
+            (unsigned long long)decoder.numRecords, (unsigned long long)info.num_overwritten);
+    return 0;
+}
@@ -11,20 +11,44 @@
 #define SETTINGS_TRACKPAD_ENABLED @"Trackpad enabled"
 #define SETTINGS_MOUSE_ACCELERATION_CURVE @"Mouse acceleration curve"
 #define SETTINGS_TRACKPAD_ACCELERATION_CURVE @"Trackpad acceleration curve"
+// acceleration table files used when the curve is "Custom"
+#define SETTINGS_MOUSE_ACCELERATION_CURVE_FILE @"Mouse acceleration curve file"
+#define SETTINGS_TRACKPAD_ACCELERATION_CURVE_FILE @"Trackpad acceleration curve file"
+// compute the gain from the device speed (event timestamps and resolution)
+// instead of from the counts per report
+#define SETTINGS_MOUSE_TIME_BASED_ACCELERATION @"Mouse time based acceleration"
+#define SETTINGS_TRACKPAD_TIME_BASED_ACCELERATION @"Trackpad time based acceleration"
+#define SETTINGS_MOUSE_DPI @"Mouse DPI"
+#define SETTINGS_TRACKPAD_DPI @"Trackpad DPI"
+// the screen the curves are set up for, in pixels per inch and Hz
+#define SETTINGS_SCREEN_RESOLUTION @"Screen resolution"
+#define SETTINGS_SCREEN_REFRESH_RATE @"Screen refresh rate"
 #define SETTINGS_MOUSE_VELOCITY @"Mouse velocity"
 #define SETTINGS_TRACKPAD_VELOCITY @"Trackpad velocity"
 #define SETTINGS_DRIVER @"Driver"
 #define SETTINGS_FORCE_DRAG_REFRESH @"Force drag refresh"
+// pass on at most one move per interval (in ms) or per screen refresh
+#define SETTINGS_COALESCING_INTERVAL @"Coalescing interval"
+#define SETTINGS_COALESCE_PER_FRAME @"Coalesce per frame"
 
 #define SETTINGS_EXCLUDED_APPS @"Excluded apps"
 
+// posted by the preference pane after changing the velocity or curve settings,
+// the daemon re-reads the settings file without reconnecting to the kext
+#define SETTINGS_CHANGED_NOTIFICATION @"com.cyberic.SmoothMouse.SettingsChanged"
+
 #define SETTINGS_MOUSE_ENABLED_DEFAULT NO
 #define SETTINGS_TRACKPAD_ENABLED_DEFAULT NO
 #define SETTINGS_MOUSE_ACCELERATION_CURVE_DEFAULT @"Linear"
 #define SETTINGS_TRACKPAD_ACCELERATION_CURVE_DEFAULT @"Linear"
 #define SETTINGS_MOUSE_VELOCITY_DEFAULT 1.0
 #define SETTINGS_TRACKPAD_VELOCITY_DEFAULT 1.0
+#define SETTINGS_TIME_BASED_ACCELERATION_DEFAULT NO
+#define SETTINGS_DPI_DEFAULT 400.0
 #define SETTINGS_DRIVER_DEFAULT 2 // IOHID
 #define SETTINGS_FORCE_DRAG_REFRESH_DEFAULT NO
+#define SETTINGS_COALESCING_INTERVAL_DEFAULT 0.0
+#define SETTINGS_COALESCE_PER_FRAME_DEFAULT NO
+#define SETTINGS_COALESCING_FRAME_RATE_DEFAULT 60.0
 
 #define KEY_SELECTED_TAB @"SelectedTab"